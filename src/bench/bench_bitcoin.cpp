@@ -4,6 +4,7 @@
 
 #include "bench.h"
 
+#include "crypto/keccak256.h"
 #include "key.h"
 #include "validation.h"
 #include "util.h"
@@ -12,6 +13,7 @@ int
 main(int argc, char** argv)
 {
     ECC_Start();
+    Keccak256AutoDetect();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
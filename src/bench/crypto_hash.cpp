@@ -9,10 +9,12 @@
 #include "hash.h"
 #include "uint256.h"
 #include "utiltime.h"
+#include "crypto/keccak256.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
+#include "crypto/sph_keccak.h"
 
 /* Number of bytes to hash per iteration */
 static const uint64_t BUFFER_SIZE = 1000*1000;
@@ -59,6 +61,48 @@ static void SHA512(benchmark::State& state)
         CSHA512().Write(begin_ptr(in), in.size()).Finalize(hash);
 }
 
+static void KECCAK256(benchmark::State& state)
+{
+    uint8_t hash[CKeccak256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        CKeccak256().Write(begin_ptr(in), in.size()).Finalize(hash);
+}
+
+static void KECCAK256_SPH(benchmark::State& state)
+{
+    uint8_t hash[CKeccak256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    sph_keccak256_context ctx;
+    while (state.KeepRunning()) {
+        sph_keccak256_init(&ctx);
+        sph_keccak256(&ctx, begin_ptr(in), in.size());
+        sph_keccak256_close(&ctx, hash);
+    }
+}
+
+static void KECCAK256_80b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80,0);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            CKeccak256().Write(begin_ptr(in), in.size()).Finalize(&in[0]);
+        }
+    }
+}
+
+// The miner inner loop: 1000 nonces of the same header
+static void KECCAK256_Header_1000Nonces(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80,0);
+    std::vector<uint8_t> hashes(1000 * CKeccak256::OUTPUT_SIZE);
+    uint32_t nNonce = 0;
+    while (state.KeepRunning()) {
+        CKeccak256Header(begin_ptr(in)).HashNonces(nNonce, 1000, begin_ptr(hashes));
+        nNonce += 1000;
+    }
+}
+
 static void SipHash_32b(benchmark::State& state)
 {
     uint256 x;
@@ -73,6 +117,10 @@ static void SipHash_32b(benchmark::State& state)
 //BENCHMARK(SHA1);
 //BENCHMARK(SHA256);
 //BENCHMARK(SHA512);
+BENCHMARK(KECCAK256);
+BENCHMARK(KECCAK256_SPH);
+BENCHMARK(KECCAK256_80b);
+BENCHMARK(KECCAK256_Header_1000Nonces);
 
 //BENCHMARK(SHA256_32b);
 //BENCHMARK(SipHash_32b);
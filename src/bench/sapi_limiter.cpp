@@ -0,0 +1,61 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "netaddress.h"
+#include "sapi/sapi.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+
+static std::vector<CNetAddr> CreatePeers(size_t nCount)
+{
+    std::vector<CNetAddr> vecPeers;
+
+    for( size_t i = 0; i < nCount; ++i ){
+        struct in_addr addr;
+        addr.s_addr = htonl(0x0A000000 | uint32_t(i));
+        vecPeers.push_back(CNetAddr(addr));
+    }
+
+    return vecPeers;
+}
+
+// Cost of one limiter request while 31 other threads hammer the limiter
+// with requests from the same set of peers.
+static void SAPILimiterRequest_32Threads(benchmark::State& state)
+{
+    const int nThreads = 32;
+    const std::vector<CNetAddr> vecPeers = CreatePeers(4096);
+
+    std::atomic<bool> fStop(false);
+    std::vector<std::thread> vecThreads;
+
+    for( int t = 1; t < nThreads; ++t ){
+        vecThreads.push_back(std::thread([&vecPeers, &fStop, t]() {
+            int64_t nLockSeconds;
+            size_t i = t * 127;
+            while( !fStop.load(std::memory_order_relaxed) ){
+                SAPI::Limits::Request(vecPeers[i++ % vecPeers.size()], nLockSeconds);
+            }
+        }));
+    }
+
+    int64_t nLockSeconds;
+    size_t i = 0;
+
+    while (state.KeepRunning()) {
+        SAPI::Limits::Request(vecPeers[i++ % vecPeers.size()], nLockSeconds);
+    }
+
+    fStop = true;
+
+    for( std::thread &thread : vecThreads ) thread.join();
+}
+
+BENCHMARK(SAPILimiterRequest_32Threads);
@@ -0,0 +1,59 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "random.h"
+#include "smartnode/smartnodeman.h"
+
+#include <map>
+
+static const size_t BENCH_SMARTNODES = 10000;
+
+static std::map<COutPoint, CSmartnode> CreateSmartnodes(size_t nCount)
+{
+    std::map<COutPoint, CSmartnode> mapSmartnodes;
+
+    for( size_t i = 0; i < nCount; ++i ){
+        COutPoint outpoint(GetRandHash(), i % 4);
+        CSmartnode mn(CService(), outpoint, CPubKey(), CPubKey(), PROTOCOL_VERSION);
+        // every 8th smartnode is not enabled and doesn't get a rank
+        mn.nActiveState = i % 8 ? CSmartnode::SMARTNODE_ENABLED : CSmartnode::SMARTNODE_EXPIRED;
+        mapSmartnodes[outpoint] = mn;
+    }
+
+    return mapSmartnodes;
+}
+
+// Rank lookup the way it was done before the cache: score and sort
+// the full list for every single lookup.
+static void SmartnodeRank_10k_Uncached(benchmark::State& state)
+{
+    std::map<COutPoint, CSmartnode> mapSmartnodes = CreateSmartnodes(BENCH_SMARTNODES);
+    const uint256 nBlockHash = GetRandHash();
+    const COutPoint outpoint = mapSmartnodes.rbegin()->first;
+    int nRank;
+
+    while (state.KeepRunning()) {
+        CSmartnodeRanks ranks(mapSmartnodes, nBlockHash, 0);
+        ranks.GetRank(outpoint, nRank);
+    }
+}
+
+// Rank lookup for a block hash that is already in the ranks cache.
+static void SmartnodeRank_10k_Cached(benchmark::State& state)
+{
+    std::map<COutPoint, CSmartnode> mapSmartnodes = CreateSmartnodes(BENCH_SMARTNODES);
+    CSmartnodeRanksCache cache(8);
+    const uint256 nBlockHash = GetRandHash();
+    const COutPoint outpoint = mapSmartnodes.rbegin()->first;
+    int nRank;
+
+    while (state.KeepRunning()) {
+        cache.Get(mapSmartnodes, 1, nBlockHash, 0)->GetRank(outpoint, nRank);
+    }
+}
+
+BENCHMARK(SmartnodeRank_10k_Uncached);
+BENCHMARK(SmartnodeRank_10k_Cached);
@@ -0,0 +1,143 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "random.h"
+#include "smartrewards/rewards.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+static const size_t BENCH_REWARD_ENTRIES = 50000;
+static const size_t BENCH_BLOCK_TRANSACTIONS = 500;
+static const int BENCH_PREFETCH_THREADS = 4;
+
+// An in-memory rewards database with BENCH_REWARD_ENTRIES funded addresses
+// and a block of transactions moving funds between random ones of them.
+class CSmartRewardsBench
+{
+    CCoinsView coinsDummy;
+    uint256 hashBlock;
+
+public:
+    CSmartRewards *prewardsBench;
+    CCoinsViewCache coins;
+    CBlock block;
+    CBlockIndex index;
+
+    CSmartRewardsBench() : coins(&coinsDummy)
+    {
+        SelectParams(CBaseChainParams::MAIN);
+        // The database lives in memory, the data directory only names it.
+        mapArgs["-datadir"] = boost::filesystem::temp_directory_path().string();
+        ClearDatadirCache();
+
+        CSmartRewardsDB *pdb = new CSmartRewardsDB(64 << 20, true, true);
+
+        std::vector<CScript> vecScripts;
+        CSmartRewardEntryList entries;
+
+        for( size_t i = 0; i < BENCH_REWARD_ENTRIES; ++i ){
+            uint256 hash = GetRandHash();
+            CKeyID keyID = CKeyID(uint160(std::vector<unsigned char>(hash.begin(), hash.begin() + 20)));
+            vecScripts.push_back(GetScriptForDestination(keyID));
+
+            CSmartRewardEntry entry = CSmartRewardEntry(CSmartAddress(keyID));
+            entry.balance = entry.balanceEligible = (1000 + i) * COIN;
+            entries.push_back(entry);
+        }
+
+        pdb->WriteCache(CSmartRewardBlock(), CSmartRewardRound(), CSmartRewardBlockList(), entries,
+                        CSmartRewardTransactionMap(), std::set<uint256>());
+
+        prewardsBench = new CSmartRewards(pdb);
+
+        // Two inputs and two outputs per transaction, the inputs spend
+        // coins of random addresses added to the view up front.
+        for( size_t i = 0; i < BENCH_BLOCK_TRANSACTIONS; ++i ){
+            CMutableTransaction tx;
+            tx.vin.resize(2);
+            tx.vout.resize(2);
+
+            for( size_t n = 0; n < 2; ++n ){
+                tx.vin[n].prevout = COutPoint(GetRandHash(), n);
+                CTxOut prevout(10 * COIN, vecScripts[GetRand(vecScripts.size())]);
+                coins.AddCoin(tx.vin[n].prevout, Coin(prevout, nRewardsDuplicateTxHeight, false), false);
+
+                tx.vout[n] = CTxOut(9 * COIN, vecScripts[GetRand(vecScripts.size())]);
+            }
+
+            block.vtx.push_back(tx);
+        }
+
+        hashBlock = GetRandHash();
+        index.phashBlock = &hashBlock;
+        // Above the duplicate transaction checks, which would need the
+        // transaction records of the database.
+        index.nHeight = nRewardsDuplicateTxHeight + 1;
+    }
+
+    ~CSmartRewardsBench()
+    {
+        prewardsBench->StartBlock();
+        delete prewardsBench;
+    }
+
+    void ProcessBlock(bool fPrefetch)
+    {
+        prewardsBench->StartBlock();
+
+        if( fPrefetch ) prewardsBench->PrefetchBlock(&index, block, coins);
+
+        CSmartRewardsUpdateResult result(index.nHeight, index.phashBlock, 0);
+
+        BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            prewardsBench->ProcessTransaction(&index, tx, coins, Params(), result);
+        }
+    }
+};
+
+// ProcessTransaction reading every entry when it comes up, the way
+// ConnectBlock did it before the prefetch.
+static void SmartRewardsBlock_Serial(benchmark::State& state)
+{
+    CSmartRewardsBench bench;
+
+    while (state.KeepRunning()) {
+        bench.ProcessBlock(false);
+    }
+}
+
+// The entries of the block read by the prefetch threads first, then
+// ProcessTransaction working on the cache only.
+static void SmartRewardsBlock_Prefetched(benchmark::State& state)
+{
+    CSmartRewardsBench bench;
+
+    int nScriptCheckThreadsOld = nScriptCheckThreads;
+    nScriptCheckThreads = BENCH_PREFETCH_THREADS;
+
+    boost::thread_group threads;
+    for( int i = 0; i < BENCH_PREFETCH_THREADS - 1; ++i ){
+        threads.create_thread(&ThreadSmartRewardsPrefetch);
+    }
+
+    while (state.KeepRunning()) {
+        bench.ProcessBlock(true);
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+
+    nScriptCheckThreads = nScriptCheckThreadsOld;
+}
+
+BENCHMARK(SmartRewardsBlock_Serial);
+BENCHMARK(SmartRewardsBlock_Prefetched);
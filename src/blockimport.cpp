@@ -0,0 +1,372 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockimport.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/consensus.h"
+#include "streams.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <univalue.h>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+CBlockImportStats blockImportStats;
+
+void CBlockImportStats::Reset(int nFilesIn, int nDecodersIn)
+{
+    nStartTime = GetTimeMicros();
+    nFiles = nFilesIn;
+    nFile = 0;
+    nDecoders = nDecodersIn;
+
+    nBlocksRead = 0;
+    nBytesRead = 0;
+    nBlocksDecoded = 0;
+    nDecodeErrors = 0;
+    nBlocksConnected = 0;
+    nBlocksLoaded = 0;
+
+    nReadMicros = 0;
+    nDecodeMicros = 0;
+    nConnectMicros = 0;
+
+    nQueuedBlocks = 0;
+    nQueuedBytes = 0;
+}
+
+static UniValue ImportStageToJSON(uint64_t nBlocks, int64_t nBusyMicros, double dElapsed)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("blocks", nBlocks));
+    obj.push_back(Pair("busy_seconds", nBusyMicros * 0.000001));
+    obj.push_back(Pair("blocks_per_second", dElapsed > 0 ? nBlocks / dElapsed : 0.0));
+    return obj;
+}
+
+UniValue CBlockImportStats::ToJSON() const
+{
+    double dElapsed = nStartTime ? (GetTimeMicros() - nStartTime) * 0.000001 : 0.0;
+
+    UniValue queue(UniValue::VOBJ);
+    queue.push_back(Pair("blocks", (uint64_t)nQueuedBlocks));
+    queue.push_back(Pair("bytes", (uint64_t)nQueuedBytes));
+
+    UniValue read = ImportStageToJSON(nBlocksRead, nReadMicros, dElapsed);
+    read.push_back(Pair("bytes", (uint64_t)nBytesRead));
+
+    UniValue decode = ImportStageToJSON(nBlocksDecoded, nDecodeMicros, dElapsed);
+    decode.push_back(Pair("errors", (uint64_t)nDecodeErrors));
+
+    UniValue connect = ImportStageToJSON(nBlocksConnected, nConnectMicros, dElapsed);
+    connect.push_back(Pair("loaded", (uint64_t)nBlocksLoaded));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("active", (bool)fActive));
+    obj.push_back(Pair("elapsed_seconds", dElapsed));
+    obj.push_back(Pair("files", (int)nFiles));
+    obj.push_back(Pair("file", (int)nFile));
+    obj.push_back(Pair("decoders", (int)nDecoders));
+    obj.push_back(Pair("queue", queue));
+    obj.push_back(Pair("read", read));
+    obj.push_back(Pair("decode", decode));
+    obj.push_back(Pair("connect", connect));
+    return obj;
+}
+
+CBlockImporter::CBlockImporter(const CChainParams& chainparamsIn, const std::vector<int>& vFilesIn) :
+    chainparams(chainparamsIn),
+    vFiles(vFilesIn),
+    nQueuedBytes(0),
+    fReaderDone(false),
+    fStop(false)
+{
+}
+
+CBlockImporter::~CBlockImporter()
+{
+    Stop();
+    blockImportStats.fActive = false;
+}
+
+void CBlockImporter::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+        condReader.notify_all();
+        condDecoder.notify_all();
+        condConnector.notify_all();
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+bool CBlockImporter::IsBlockEnd(CBufferedFile& blkdat, uint64_t nBlockEnd)
+{
+    static const unsigned char zero[MESSAGE_START_SIZE] = {};
+    unsigned char buf[MESSAGE_START_SIZE];
+
+    blkdat.SetLimit();
+    try {
+        blkdat >> FLATDATA(buf);
+    } catch (const std::exception&) {
+        // end of file
+        blkdat.SetPos(nBlockEnd);
+        return true;
+    }
+    blkdat.SetPos(nBlockEnd);
+
+    return memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE) == 0 ||
+           memcmp(buf, zero, MESSAGE_START_SIZE) == 0;
+}
+
+bool CBlockImporter::ReadFile(int nFile)
+{
+    CDiskBlockPos pos(nFile, 0);
+    FILE *file = OpenBlockFile(pos, true);
+    if (!file)
+        return false; // This error is logged in OpenBlockFile
+
+    LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+    blockImportStats.nFile = nFile;
+
+    // This takes over file and calls fclose() on it in the CBufferedFile destructor
+    // The rewind covers a whole block plus the message start read behind it
+    CBufferedFile blkdat(file, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8+MESSAGE_START_SIZE, SER_DISK, CLIENT_VERSION);
+    uint64_t nRewind = blkdat.GetPos();
+    while (!blkdat.eof()) {
+        boost::this_thread::interruption_point();
+
+        int64_t nTime1 = GetTimeMicros();
+
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(chainparams.MessageStart()[0]);
+            nRewind = blkdat.GetPos()+1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+
+        // Only copy the raw block here, the decoders deserialize it.
+        CImportBlockRef pblock = std::make_shared<CImportBlock>();
+        uint64_t nBlockEnd;
+        try {
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            pblock->pos = CDiskBlockPos(nFile, nBlockPos);
+            pblock->nSize = nSize;
+            pblock->vData.resize(nSize);
+            blkdat.read(&pblock->vData[0], nSize);
+            nBlockEnd = blkdat.GetPos();
+        } catch (const std::exception& e) {
+            LogPrintf("%s: I/O error - %s\n", __func__, e.what());
+            continue;
+        }
+
+        // The decoders only find a bogus size from a false message start after
+        // the reader moved on. Blocks are stored back to back, so a block has to
+        // be followed by the next message start, the zero padding of the file or
+        // its end. Otherwise rescan from the byte after the message start, like
+        // LoadExternalBlockFile does after a deserialize failure.
+        if (!IsBlockEnd(blkdat, nBlockEnd))
+            continue;
+
+        nRewind = nBlockEnd;
+
+        blockImportStats.nReadMicros += GetTimeMicros() - nTime1;
+        blockImportStats.nBlocksRead++;
+        blockImportStats.nBytesRead += nSize;
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+
+        // Always accept a block into an empty queue, whatever its size.
+        while (!fStop && nQueuedBytes && nQueuedBytes + nSize > MAX_IMPORT_QUEUE_BYTES) {
+            condReader.wait(lock);
+        }
+
+        if (fStop)
+            return false;
+
+        nQueuedBytes += nSize;
+        queueConnect.push_back(pblock);
+        queueDecode.push_back(pblock);
+
+        blockImportStats.nQueuedBlocks = queueConnect.size();
+        blockImportStats.nQueuedBytes = nQueuedBytes;
+
+        condDecoder.notify_one();
+    }
+
+    return true;
+}
+
+void CBlockImporter::ReaderThread()
+{
+    RenameThread("smartcash-importrd");
+
+    try {
+        BOOST_FOREACH(int nFile, vFiles) {
+            if (!ReadFile(nFile))
+                break;
+        }
+    } catch (const std::runtime_error& e) {
+        LogPrintf("%s: System error - %s\n", __func__, e.what());
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fReaderDone = true;
+    condDecoder.notify_all();
+    condConnector.notify_all();
+}
+
+void CBlockImporter::DecoderThread()
+{
+    RenameThread("smartcash-importdc");
+
+    while (true) {
+        CImportBlockRef pblock;
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+
+            while (!fStop && !fReaderDone && queueDecode.empty()) {
+                condDecoder.wait(lock);
+            }
+
+            if (fStop || queueDecode.empty())
+                return;
+
+            pblock = queueDecode.front();
+            queueDecode.pop_front();
+        }
+
+        int64_t nTime1 = GetTimeMicros();
+        bool fValid = false;
+
+        // Deserializing computes the transaction hashes, the header hash
+        // gets used by the connector.
+        try {
+            CDataStream ssBlock(pblock->vData, SER_DISK, CLIENT_VERSION);
+            ssBlock >> pblock->block;
+            pblock->hash = pblock->block.GetHash();
+            fValid = true;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize error - %s at %s\n", __func__, e.what(), pblock->pos.ToString());
+            blockImportStats.nDecodeErrors++;
+        }
+
+        std::vector<char>().swap(pblock->vData);
+
+        blockImportStats.nDecodeMicros += GetTimeMicros() - nTime1;
+        blockImportStats.nBlocksDecoded++;
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+
+        pblock->fDecoded = true;
+        pblock->fValid = fValid;
+
+        if (!queueConnect.empty() && queueConnect.front() == pblock)
+            condConnector.notify_one();
+    }
+}
+
+int CBlockImporter::Run(int nDecoders)
+{
+    blockImportStats.Reset(vFiles.size(), nDecoders);
+    blockImportStats.fActive = true;
+
+    threads.create_thread(boost::bind(&CBlockImporter::ReaderThread, this));
+
+    for (int i = 0; i < nDecoders; i++) {
+        threads.create_thread(boost::bind(&CBlockImporter::DecoderThread, this));
+    }
+
+    int nLoaded = 0;
+
+    while (true) {
+        CImportBlockRef pblock;
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+
+            while (!fStop && (queueConnect.empty() ? !fReaderDone : !queueConnect.front()->fDecoded)) {
+                condConnector.wait(lock);
+            }
+
+            if (fStop || queueConnect.empty())
+                break;
+
+            pblock = queueConnect.front();
+            queueConnect.pop_front();
+            nQueuedBytes -= pblock->nSize;
+
+            blockImportStats.nQueuedBlocks = queueConnect.size();
+            blockImportStats.nQueuedBytes = nQueuedBytes;
+
+            condReader.notify_one();
+        }
+
+        boost::this_thread::interruption_point();
+
+        if (!pblock->fValid)
+            continue;
+
+        int64_t nTime1 = GetTimeMicros();
+        bool fContinue = true;
+
+        try {
+            fContinue = ProcessImportedBlock(chainparams, pblock->block, pblock->hash, &pblock->pos, nLoaded);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: I/O error - %s\n", __func__, e.what());
+        }
+
+        blockImportStats.nConnectMicros += GetTimeMicros() - nTime1;
+        blockImportStats.nBlocksConnected++;
+        blockImportStats.nBlocksLoaded = nLoaded;
+
+        if (!fContinue)
+            break;
+    }
+
+    Stop();
+
+    return nLoaded;
+}
+
+void ReindexBlockFiles(const CChainParams& chainparams)
+{
+    std::vector<int> vFiles;
+
+    while (boost::filesystem::exists(GetBlockPosFilename(CDiskBlockPos(vFiles.size(), 0), "blk"))) {
+        vFiles.push_back(vFiles.size());
+    }
+
+    int nDecoders = std::max(1, std::min(GetNumCores() - 1, MAX_IMPORT_DECODER_THREADS));
+    int64_t nStart = GetTimeMillis();
+
+    CBlockImporter importer(chainparams, vFiles);
+    int nLoaded = importer.Run(nDecoders);
+
+    LogPrintf("Loaded %i blocks from %u block files in %dms, %d decoder threads\n", nLoaded, vFiles.size(), GetTimeMillis() - nStart, nDecoders);
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKIMPORT_H
+#define BITCOIN_BLOCKIMPORT_H
+
+#include "chain.h"
+#include "primitives/block.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+class CBufferedFile;
+class CChainParams;
+class UniValue;
+
+/** Maximum size of the raw blocks read ahead of the connector */
+static const size_t MAX_IMPORT_QUEUE_BYTES = 64 << 20;
+/** Maximum number of decoder threads */
+static const int MAX_IMPORT_DECODER_THREADS = 8;
+
+/** Progress and per stage throughput of the running or last block import */
+struct CBlockImportStats
+{
+    std::atomic<bool> fActive;
+    std::atomic<int64_t> nStartTime;
+    std::atomic<int> nFiles;
+    std::atomic<int> nFile;
+    std::atomic<int> nDecoders;
+
+    std::atomic<uint64_t> nBlocksRead;
+    std::atomic<uint64_t> nBytesRead;
+    std::atomic<uint64_t> nBlocksDecoded;
+    std::atomic<uint64_t> nDecodeErrors;
+    std::atomic<uint64_t> nBlocksConnected;
+    std::atomic<uint64_t> nBlocksLoaded;
+
+    //! Time the stages were busy, summed over the decoder threads
+    std::atomic<int64_t> nReadMicros;
+    std::atomic<int64_t> nDecodeMicros;
+    std::atomic<int64_t> nConnectMicros;
+
+    std::atomic<size_t> nQueuedBlocks;
+    std::atomic<size_t> nQueuedBytes;
+
+    CBlockImportStats() { Reset(0, 0); fActive = false; }
+
+    void Reset(int nFilesIn, int nDecodersIn);
+    UniValue ToJSON() const;
+};
+
+extern CBlockImportStats blockImportStats;
+
+/**
+ * Pipelined import of the blk?????.dat files for -reindex.
+ *
+ * A reader thread scans the files sequentially and queues the raw blocks,
+ * at most MAX_IMPORT_QUEUE_BYTES ahead of the connector. Decoder threads
+ * deserialize them, which also computes the transaction hashes, and hash
+ * the headers. The calling thread connects the decoded blocks in file
+ * order with ProcessImportedBlock, which runs CheckBlock and the rest of
+ * the validation as before. CheckBlock depends on the height and the
+ * InstantSend locks here, so it can't move to the decoders.
+ */
+class CBlockImporter
+{
+private:
+    struct CImportBlock
+    {
+        CDiskBlockPos pos;
+        unsigned int nSize;
+        std::vector<char> vData;
+        CBlock block;
+        uint256 hash;
+        //! Set by the decoder, protected by mutex
+        bool fDecoded;
+        bool fValid;
+
+        CImportBlock() : nSize(0), fDecoded(false), fValid(false) {}
+    };
+
+    typedef std::shared_ptr<CImportBlock> CImportBlockRef;
+
+    const CChainParams& chainparams;
+    std::vector<int> vFiles;
+
+    //! Mutex to protect the inner state
+    boost::mutex mutex;
+    boost::condition_variable condReader;
+    boost::condition_variable condDecoder;
+    boost::condition_variable condConnector;
+
+    //! All queued blocks in file order, popped by the connector
+    std::deque<CImportBlockRef> queueConnect;
+    //! Queued blocks not taken by a decoder yet
+    std::deque<CImportBlockRef> queueDecode;
+    size_t nQueuedBytes;
+
+    bool fReaderDone;
+    bool fStop;
+
+    boost::thread_group threads;
+
+    void ReaderThread();
+    void DecoderThread();
+    bool ReadFile(int nFile);
+    /** Whether the block read up to nBlockEnd is followed by a message start, zero padding or the end of the file */
+    bool IsBlockEnd(CBufferedFile& blkdat, uint64_t nBlockEnd);
+    void Stop();
+
+public:
+    CBlockImporter(const CChainParams& chainparamsIn, const std::vector<int>& vFilesIn);
+    ~CBlockImporter();
+
+    /** Import all files, returns the number of blocks stored in the block index */
+    int Run(int nDecoders);
+};
+
+/** Reindex the block files in order, until the first missing one */
+void ReindexBlockFiles(const CChainParams& chainparams);
+
+#endif // BITCOIN_BLOCKIMPORT_H
@@ -0,0 +1,408 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+
+#include "coins.h"
+#include "hash.h"
+#include "primitives/transaction.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "version.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+//! Number of txid prefix ranges the coins database gets scanned in
+static const int COINS_SCAN_RANGES = 1024;
+//! Ranges the workers may scan ahead of the serialized hash, bounds the buffered data
+static const int COINS_SCAN_AHEAD = 32;
+
+CCoinsCommitment* pcoinscommitment = NULL;
+
+uint64_t GetBogoSize(const CScript& scriptPubKey)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + scriptPubKey.size() /* scriptPubKey */;
+}
+
+static void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin, bool fRemove)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+
+    const unsigned char* data = (const unsigned char*)ss.data();
+    if (fRemove) {
+        muhash.Remove(data, ss.size());
+    } else {
+        muhash.Insert(data, ss.size());
+    }
+}
+
+void CCoinsCommitment::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    ApplyCoinHash(muhash, outpoint, coin, false);
+    nTransactionOutputs++;
+    nBogoSize += GetBogoSize(coin.out.scriptPubKey);
+    nTotalAmount += coin.out.nValue;
+}
+
+void CCoinsCommitment::RemoveCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    ApplyCoinHash(muhash, outpoint, coin, true);
+    nTransactionOutputs--;
+    nBogoSize -= GetBogoSize(coin.out.scriptPubKey);
+    nTotalAmount -= coin.out.nValue;
+}
+
+void CCoinsCommitment::AddOutputs(const CTransaction& tx, int nHeight)
+{
+    const uint256& txid = tx.GetHash();
+    for (size_t i = 0; i < tx.vout.size(); ++i) {
+        if (!tx.vout[i].scriptPubKey.IsUnspendable())
+            AddCoin(COutPoint(txid, i), Coin(tx.vout[i], nHeight, tx.IsCoinBase()));
+    }
+}
+
+void CCoinsCommitment::Apply(const CCoinsCommitment& delta, const uint256& hashBlockIn)
+{
+    muhash *= delta.muhash;
+    nTransactionOutputs += delta.nTransactionOutputs;
+    nBogoSize += delta.nBogoSize;
+    nTotalAmount += delta.nTotalAmount;
+    hashBlock = hashBlockIn;
+}
+
+void CCoinsCommitment::GetStats(CCoinsStats& stats) const
+{
+    stats.hashBlock = hashBlock;
+    stats.nTransactionOutputs = nTransactionOutputs;
+    stats.nBogoSize = nBogoSize;
+    stats.nTotalAmount = nTotalAmount;
+    stats.fFromCommitment = true;
+
+    MuHash3072 muhashFinal = muhash;
+    muhashFinal.Finalize(stats.hashMuHash.begin());
+}
+
+static void ApplyStats(CCoinsStats &stats, const std::map<uint32_t, Coin>& outputs)
+{
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += output.second.out.nValue;
+        stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
+    }
+}
+
+static void ApplyHash(CDataStream& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << *(const CScriptBase*)(&output.second.out.scriptPubKey);
+        ss << VARINT(output.second.out.nValue);
+    }
+    ss << VARINT(0);
+}
+
+//! Two byte txid prefix, the order of the keys in the coins database
+static unsigned int GetScanPrefix(const uint256& hash)
+{
+    return (*hash.begin() << 8) | *(hash.begin() + 1);
+}
+
+/**
+ * Scans the coins database from one snapshot with a pool of workers, each
+ * taking the next txid prefix range. The calling thread merges the ranges in
+ * key order and at most COINS_SCAN_AHEAD ranges wait for it.
+ */
+class CCoinsScanner
+{
+private:
+    struct CScanRange
+    {
+        CCoinsStats stats;
+        MuHash3072 muhash;
+        //! Serialized coins for the hash, dropped once merged
+        std::unique_ptr<CDataStream> pss;
+        //! Set by the worker, protected by mutex
+        bool fDone;
+
+        CScanRange() : fDone(false) {}
+    };
+
+    CCoinsViewDB* view;
+    const CoinStatsHashType hashType;
+    const leveldb::Snapshot* psnapshot;
+
+    //! Mutex to protect the inner state
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condMerge;
+
+    std::vector<CScanRange> vRanges;
+    //! Next range to scan
+    int nNext;
+    //! Ranges merged by the calling thread
+    int nMerged;
+    bool fError;
+    bool fStop;
+
+    boost::thread_group threads;
+
+    bool ScanRange(int nRange, CScanRange& range);
+    void WorkerThread();
+    void Stop();
+
+public:
+    CCoinsScanner(CCoinsViewDB* viewIn, CoinStatsHashType hashTypeIn);
+    ~CCoinsScanner();
+
+    bool Run(int nThreads, CCoinsStats& stats, MuHash3072& muhash);
+};
+
+CCoinsScanner::CCoinsScanner(CCoinsViewDB* viewIn, CoinStatsHashType hashTypeIn) :
+    view(viewIn),
+    hashType(hashTypeIn),
+    psnapshot(viewIn->GetSnapshot()),
+    vRanges(COINS_SCAN_RANGES),
+    nNext(0),
+    nMerged(0),
+    fError(false),
+    fStop(false)
+{
+}
+
+CCoinsScanner::~CCoinsScanner()
+{
+    Stop();
+    view->ReleaseSnapshot(psnapshot);
+}
+
+void CCoinsScanner::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+        condWorker.notify_all();
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+bool CCoinsScanner::ScanRange(int nRange, CScanRange& range)
+{
+    const unsigned int nPrefixes = 0x10000 / COINS_SCAN_RANGES;
+    const unsigned int nEnd = (nRange + 1) * nPrefixes;
+
+    uint256 hashStart;
+    *hashStart.begin() = (nRange * nPrefixes) >> 8;
+    *(hashStart.begin() + 1) = (nRange * nPrefixes) & 0xff;
+
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor(COutPoint(hashStart, 0), psnapshot));
+
+    if (hashType == COINSTATS_HASH_SERIALIZED)
+        range.pss.reset(new CDataStream(SER_GETHASH, PROTOCOL_VERSION));
+
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+            return error("%s: unable to read value", __func__);
+        if (GetScanPrefix(key.hash) >= nEnd)
+            break;
+
+        if (hashType == COINSTATS_HASH_MUHASH)
+            ApplyCoinHash(range.muhash, key, coin, false);
+
+        if (!outputs.empty() && key.hash != prevkey) {
+            ApplyStats(range.stats, outputs);
+            if (range.pss)
+                ApplyHash(*range.pss, prevkey, outputs);
+            outputs.clear();
+        }
+        prevkey = key.hash;
+        outputs[key.n] = std::move(coin);
+    }
+    if (!outputs.empty()) {
+        ApplyStats(range.stats, outputs);
+        if (range.pss)
+            ApplyHash(*range.pss, prevkey, outputs);
+    }
+    return true;
+}
+
+void CCoinsScanner::WorkerThread()
+{
+    RenameThread("smartcash-coinscan");
+
+    while (true) {
+        int nRange;
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+
+            // Only the serialized hash needs the ranges in order.
+            while (!fStop && nNext < COINS_SCAN_RANGES && hashType == COINSTATS_HASH_SERIALIZED &&
+                   nNext >= nMerged + COINS_SCAN_AHEAD) {
+                condWorker.wait(lock);
+            }
+
+            if (fStop || nNext == COINS_SCAN_RANGES)
+                return;
+
+            nRange = nNext++;
+        }
+
+        bool fOk = false;
+        try {
+            fOk = ScanRange(nRange, vRanges[nRange]);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: Database error - %s\n", __func__, e.what());
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        vRanges[nRange].fDone = true;
+        fError |= !fOk;
+        condMerge.notify_one();
+    }
+}
+
+bool CCoinsScanner::Run(int nThreads, CCoinsStats& stats, MuHash3072& muhash)
+{
+    for (int i = 0; i < nThreads; i++) {
+        threads.create_thread(boost::bind(&CCoinsScanner::WorkerThread, this));
+    }
+
+    // All cursors read the same snapshot, so any of them has the best block.
+    {
+        boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor(COutPoint(), psnapshot));
+        stats.hashBlock = pcursor->GetBestBlock();
+    }
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << stats.hashBlock;
+
+    for (int i = 0; i < COINS_SCAN_RANGES; i++) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+
+            while (!vRanges[i].fDone && !fError) {
+                condMerge.wait(lock);
+            }
+
+            if (fError)
+                return false;
+
+            nMerged = i + 1;
+            condWorker.notify_all();
+        }
+
+        // The workers are done with this range.
+        CScanRange& range = vRanges[i];
+        stats.nTransactions += range.stats.nTransactions;
+        stats.nTransactionOutputs += range.stats.nTransactionOutputs;
+        stats.nBogoSize += range.stats.nBogoSize;
+        stats.nTotalAmount += range.stats.nTotalAmount;
+
+        if (hashType == COINSTATS_HASH_MUHASH)
+            muhash *= range.muhash;
+
+        if (range.pss) {
+            ss.write(range.pss->data(), range.pss->size());
+            range.pss.reset();
+        }
+    }
+
+    if (hashType == COINSTATS_HASH_SERIALIZED)
+        stats.hashSerialized = ss.GetHash();
+
+    return true;
+}
+
+static bool ScanCoins(CCoinsViewDB* view, CCoinsStats& stats, CoinStatsHashType hashType, MuHash3072& muhash)
+{
+    int nThreads = std::max(1, std::min(GetNumCores(), MAX_COINS_SCAN_THREADS));
+    int64_t nStart = GetTimeMillis();
+
+    CCoinsScanner scanner(view, hashType);
+    if (!scanner.Run(nThreads, stats, muhash))
+        return false;
+
+    LogPrint("bench", "Scanned %u transaction outputs in %dms, %d threads\n", stats.nTransactionOutputs, GetTimeMillis() - nStart, nThreads);
+    return true;
+}
+
+bool GetUTXOStats(CCoinsViewDB* view, CCoinsStats& stats, CoinStatsHashType hashType)
+{
+    MuHash3072 muhash;
+    if (!ScanCoins(view, stats, hashType, muhash))
+        return false;
+
+    if (hashType == COINSTATS_HASH_MUHASH)
+        muhash.Finalize(stats.hashMuHash.begin());
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(stats.hashBlock);
+        if (mi != mapBlockIndex.end())
+            stats.nHeight = mi->second->nHeight;
+    }
+
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
+
+bool LoadCoinsCommitment(CCoinsViewDB* view)
+{
+    if (!pcoinscommitment)
+        pcoinscommitment = new CCoinsCommitment();
+
+    // Don't store a commitment which is still being built.
+    view->SetCoinsCommitment(NULL);
+
+    uint256 hashBestBlock = view->GetBestBlock();
+    if (view->ReadCoinsCommitment(*pcoinscommitment) && pcoinscommitment->hashBlock == hashBestBlock) {
+        LogPrintf("Loaded the UTXO set commitment at %s\n", hashBestBlock.ToString());
+    } else {
+        *pcoinscommitment = CCoinsCommitment();
+
+        LogPrintf("Building the UTXO set commitment at %s...\n", hashBestBlock.ToString());
+        int64_t nStart = GetTimeMillis();
+
+        CCoinsStats stats;
+        MuHash3072 muhash;
+        if (!ScanCoins(view, stats, COINSTATS_HASH_MUHASH, muhash))
+            return false;
+
+        pcoinscommitment->hashBlock = stats.hashBlock;
+        pcoinscommitment->muhash = muhash;
+        pcoinscommitment->nTransactionOutputs = stats.nTransactionOutputs;
+        pcoinscommitment->nBogoSize = stats.nBogoSize;
+        pcoinscommitment->nTotalAmount = stats.nTotalAmount;
+
+        LogPrintf("Built the UTXO set commitment of %u transaction outputs in %dms\n", stats.nTransactionOutputs, GetTimeMillis() - nStart);
+    }
+
+    view->SetCoinsCommitment(pcoinscommitment);
+    return true;
+}
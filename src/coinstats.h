@@ -0,0 +1,118 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATS_H
+#define BITCOIN_COINSTATS_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+class CCoinsViewDB;
+class COutPoint;
+class CScript;
+class CTransaction;
+class Coin;
+
+/** Default for -coinstatsindex */
+static const bool DEFAULT_COINSTATSINDEX = false;
+/** Maximum number of threads scanning the coins database */
+static const int MAX_COINS_SCAN_THREADS = 8;
+
+enum CoinStatsHashType {
+    COINSTATS_HASH_SERIALIZED,
+    COINSTATS_HASH_MUHASH,
+    COINSTATS_HASH_NONE,
+};
+
+/** Statistics about the unspent transaction output set */
+struct CCoinsStats
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    uint256 hashSerialized;
+    uint256 hashMuHash;
+    uint64_t nDiskSize;
+    CAmount nTotalAmount;
+    //! Taken from the -coinstatsindex commitment instead of a scan, without nTransactions
+    bool fFromCommitment;
+
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0), fFromCommitment(false) {}
+};
+
+/**
+ * Rolling commitment to the unspent transaction output set of hashBlock,
+ * maintained by -coinstatsindex. ConnectBlock and DisconnectBlock collect
+ * the changes of a block in a delta, which gets applied once the block
+ * made it into pcoinsTip. The commitment gets stored with the coins it
+ * belongs to, so gettxoutsetinfo doesn't have to scan the coins database.
+ */
+class CCoinsCommitment
+{
+public:
+    uint256 hashBlock;
+    MuHash3072 muhash;
+    int64_t nTransactionOutputs;
+    int64_t nBogoSize;
+    CAmount nTotalAmount;
+
+    CCoinsCommitment() : nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(hashBlock);
+        unsigned char state[MuHash3072::STATE_SIZE];
+        if (!ser_action.ForRead())
+            muhash.GetState(state);
+        READWRITE(FLATDATA(state));
+        if (ser_action.ForRead())
+            muhash.SetState(state);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+    }
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void RemoveCoin(const COutPoint& outpoint, const Coin& coin);
+    /** Add the spendable outputs of tx, as AddCoins does */
+    void AddOutputs(const CTransaction& tx, int nHeight);
+
+    /** Apply the changes collected in delta, this then commits to hashBlockIn */
+    void Apply(const CCoinsCommitment& delta, const uint256& hashBlockIn);
+
+    /** Fill the counters and the muhash of stats */
+    void GetStats(CCoinsStats& stats) const;
+};
+
+/** The -coinstatsindex commitment of pcoinsTip, NULL if disabled. Protected by cs_main */
+extern CCoinsCommitment* pcoinscommitment;
+
+/** Size of a coin as counted by bogosize, independent of the database format */
+uint64_t GetBogoSize(const CScript& scriptPubKey);
+
+/**
+ * Calculate statistics about the unspent transaction output set.
+ *
+ * The key space of the coins database gets split into ranges by the txid
+ * prefix, which worker threads scan in parallel from the same snapshot.
+ * The serialized hash depends on the order, so its ranges get hashed in key
+ * order while the workers scan the next ones.
+ */
+bool GetUTXOStats(CCoinsViewDB* view, CCoinsStats& stats, CoinStatsHashType hashType);
+
+/**
+ * Load the -coinstatsindex commitment stored with the coins of view into
+ * pcoinscommitment, or build it with a full scan if it doesn't match them.
+ */
+bool LoadCoinsCommitment(CCoinsViewDB* view);
+
+#endif // BITCOIN_COINSTATS_H
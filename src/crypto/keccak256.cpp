@@ -0,0 +1,358 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/keccak256.h"
+
+#include "crypto/common.h"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ENABLE_KECCAK_X86_LANES
+#endif
+
+#if defined(__GNUC__)
+#define KECCAK_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define KECCAK_ALWAYS_INLINE inline
+#endif
+
+// Internal implementation code.
+namespace
+{
+/// Internal Keccak-f[1600] implementation.
+namespace keccak
+{
+/** Maximum number of interleaved states one permutation call works on. */
+static const size_t MAX_LANES = 8;
+
+static const size_t RATE_LANES = CKeccak256::RATE / 8;
+
+static const uint64_t RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+    0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+    0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+#define ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+/**
+ * Keccak-f[1600] with the steps of a round fully unrolled. T is either a
+ * single 64 bit lane or a vector of lanes of independent states, the
+ * states are stored lane by lane: st[i] holds lane i of all of them.
+ */
+template<typename T>
+KECCAK_ALWAYS_INLINE void Permute(T* st)
+{
+    T a00 = st[0], a01 = st[1], a02 = st[2], a03 = st[3], a04 = st[4];
+    T a05 = st[5], a06 = st[6], a07 = st[7], a08 = st[8], a09 = st[9];
+    T a10 = st[10], a11 = st[11], a12 = st[12], a13 = st[13], a14 = st[14];
+    T a15 = st[15], a16 = st[16], a17 = st[17], a18 = st[18], a19 = st[19];
+    T a20 = st[20], a21 = st[21], a22 = st[22], a23 = st[23], a24 = st[24];
+    T c0, c1, c2, c3, c4;
+    T d0, d1, d2, d3, d4;
+    T b00, b01, b02, b03, b04;
+    T b05, b06, b07, b08, b09;
+    T b10, b11, b12, b13, b14;
+    T b15, b16, b17, b18, b19;
+    T b20, b21, b22, b23, b24;
+
+    for (int round = 0; round < 24; ++round) {
+        c0 = a00 ^ a05 ^ a10 ^ a15 ^ a20;
+        c1 = a01 ^ a06 ^ a11 ^ a16 ^ a21;
+        c2 = a02 ^ a07 ^ a12 ^ a17 ^ a22;
+        c3 = a03 ^ a08 ^ a13 ^ a18 ^ a23;
+        c4 = a04 ^ a09 ^ a14 ^ a19 ^ a24;
+        d0 = c4 ^ ROTL64(c1, 1);
+        d1 = c0 ^ ROTL64(c2, 1);
+        d2 = c1 ^ ROTL64(c3, 1);
+        d3 = c2 ^ ROTL64(c4, 1);
+        d4 = c3 ^ ROTL64(c0, 1);
+        b00 = a00 ^ d0;
+        b10 = ROTL64(a01 ^ d1, 1);
+        b20 = ROTL64(a02 ^ d2, 62);
+        b05 = ROTL64(a03 ^ d3, 28);
+        b15 = ROTL64(a04 ^ d4, 27);
+        b16 = ROTL64(a05 ^ d0, 36);
+        b01 = ROTL64(a06 ^ d1, 44);
+        b11 = ROTL64(a07 ^ d2, 6);
+        b21 = ROTL64(a08 ^ d3, 55);
+        b06 = ROTL64(a09 ^ d4, 20);
+        b07 = ROTL64(a10 ^ d0, 3);
+        b17 = ROTL64(a11 ^ d1, 10);
+        b02 = ROTL64(a12 ^ d2, 43);
+        b12 = ROTL64(a13 ^ d3, 25);
+        b22 = ROTL64(a14 ^ d4, 39);
+        b23 = ROTL64(a15 ^ d0, 41);
+        b08 = ROTL64(a16 ^ d1, 45);
+        b18 = ROTL64(a17 ^ d2, 15);
+        b03 = ROTL64(a18 ^ d3, 21);
+        b13 = ROTL64(a19 ^ d4, 8);
+        b14 = ROTL64(a20 ^ d0, 18);
+        b24 = ROTL64(a21 ^ d1, 2);
+        b09 = ROTL64(a22 ^ d2, 61);
+        b19 = ROTL64(a23 ^ d3, 56);
+        b04 = ROTL64(a24 ^ d4, 14);
+        a00 = b00 ^ (~b01 & b02);
+        a01 = b01 ^ (~b02 & b03);
+        a02 = b02 ^ (~b03 & b04);
+        a03 = b03 ^ (~b04 & b00);
+        a04 = b04 ^ (~b00 & b01);
+        a05 = b05 ^ (~b06 & b07);
+        a06 = b06 ^ (~b07 & b08);
+        a07 = b07 ^ (~b08 & b09);
+        a08 = b08 ^ (~b09 & b05);
+        a09 = b09 ^ (~b05 & b06);
+        a10 = b10 ^ (~b11 & b12);
+        a11 = b11 ^ (~b12 & b13);
+        a12 = b12 ^ (~b13 & b14);
+        a13 = b13 ^ (~b14 & b10);
+        a14 = b14 ^ (~b10 & b11);
+        a15 = b15 ^ (~b16 & b17);
+        a16 = b16 ^ (~b17 & b18);
+        a17 = b17 ^ (~b18 & b19);
+        a18 = b18 ^ (~b19 & b15);
+        a19 = b19 ^ (~b15 & b16);
+        a20 = b20 ^ (~b21 & b22);
+        a21 = b21 ^ (~b22 & b23);
+        a22 = b22 ^ (~b23 & b24);
+        a23 = b23 ^ (~b24 & b20);
+        a24 = b24 ^ (~b20 & b21);
+        a00 ^= RC[round];
+    }
+
+    st[0] = a00; st[1] = a01; st[2] = a02; st[3] = a03; st[4] = a04;
+    st[5] = a05; st[6] = a06; st[7] = a07; st[8] = a08; st[9] = a09;
+    st[10] = a10; st[11] = a11; st[12] = a12; st[13] = a13; st[14] = a14;
+    st[15] = a15; st[16] = a16; st[17] = a17; st[18] = a18; st[19] = a19;
+    st[20] = a20; st[21] = a21; st[22] = a22; st[23] = a23; st[24] = a24;
+}
+
+/** A permutation of one or more interleaved states, lane i of state j is st[i * lanes + j]. */
+typedef void (*PermuteFn)(uint64_t* st);
+
+void Permute1(uint64_t* st)
+{
+    Permute<uint64_t>(st);
+}
+
+#ifdef ENABLE_KECCAK_X86_LANES
+typedef uint64_t v4u64 __attribute__((vector_size(32)));
+typedef uint64_t v8u64 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2"))) void Permute4AVX2(uint64_t* st)
+{
+    v4u64 v[25];
+    memcpy(v, st, sizeof(v));
+    Permute<v4u64>(v);
+    memcpy(st, v, sizeof(v));
+}
+
+__attribute__((target("avx512f"))) void Permute8AVX512(uint64_t* st)
+{
+    v8u64 v[25];
+    memcpy(v, st, sizeof(v));
+    Permute<v8u64>(v);
+    memcpy(st, v, sizeof(v));
+}
+#endif
+
+PermuteFn PermuteLanes = Permute1;
+size_t nLanes = 1;
+
+void inline Absorb(uint64_t* s, const unsigned char* block)
+{
+    for (size_t i = 0; i < RATE_LANES; ++i)
+        s[i] ^= ReadLE64(block + 8 * i);
+    Permute1(s);
+}
+
+/** Hash up to w inputs of the same length with one permutation of w interleaved states per block. */
+void HashGroup(const unsigned char* const* inputs, size_t len, unsigned char* const* hashes, size_t nCount, PermuteFn permute, size_t w)
+{
+    uint64_t st[25 * MAX_LANES] = {0};
+    size_t pos = 0;
+
+    for (; len - pos >= CKeccak256::RATE; pos += CKeccak256::RATE) {
+        for (size_t j = 0; j < nCount; ++j)
+            for (size_t i = 0; i < RATE_LANES; ++i)
+                st[i * w + j] ^= ReadLE64(inputs[j] + pos + 8 * i);
+        permute(st);
+    }
+
+    unsigned char block[CKeccak256::RATE];
+    size_t nRemaining = len - pos;
+
+    for (size_t j = 0; j < nCount; ++j) {
+        memcpy(block, inputs[j] + pos, nRemaining);
+        memset(block + nRemaining, 0, CKeccak256::RATE - nRemaining);
+        block[nRemaining] ^= 0x01;
+        block[CKeccak256::RATE - 1] ^= 0x80;
+        for (size_t i = 0; i < RATE_LANES; ++i)
+            st[i * w + j] ^= ReadLE64(block + 8 * i);
+    }
+    permute(st);
+
+    for (size_t j = 0; j < nCount; ++j)
+        for (size_t i = 0; i < 4; ++i)
+            WriteLE64(hashes[j] + 8 * i, st[i * w + j]);
+}
+
+} // namespace keccak
+
+} // namespace
+
+////// CKeccak256
+
+CKeccak256::CKeccak256()
+{
+    Reset();
+}
+
+CKeccak256& CKeccak256::Write(const unsigned char* data, size_t len)
+{
+    const unsigned char* end = data + len;
+
+    if (bufsize + len < RATE) {
+        memcpy(buf + bufsize, data, len);
+        bufsize += len;
+        return *this;
+    }
+
+    if (bufsize > 0) {
+        // Fill the buffer, and process it.
+        memcpy(buf + bufsize, data, RATE - bufsize);
+        data += RATE - bufsize;
+        keccak::Absorb(s, buf);
+        bufsize = 0;
+    }
+
+    while ((size_t)(end - data) >= RATE) {
+        // Process full chunks directly from the source.
+        keccak::Absorb(s, data);
+        data += RATE;
+    }
+
+    // Fill the buffer with what remains.
+    memcpy(buf, data, end - data);
+    bufsize = end - data;
+    return *this;
+}
+
+void CKeccak256::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    memset(buf + bufsize, 0, RATE - bufsize);
+    buf[bufsize] ^= 0x01;
+    buf[RATE - 1] ^= 0x80;
+    keccak::Absorb(s, buf);
+
+    for (size_t i = 0; i < 4; ++i)
+        WriteLE64(hash + 8 * i, s[i]);
+}
+
+CKeccak256& CKeccak256::Reset()
+{
+    memset(s, 0, sizeof(s));
+    bufsize = 0;
+    return *this;
+}
+
+////// CKeccak256Header
+
+CKeccak256Header::CKeccak256Header(const unsigned char header[HEADER_SIZE])
+{
+    memset(s, 0, sizeof(s));
+
+    for (size_t i = 0; i < 9; ++i)
+        s[i] = ReadLE64(header + 8 * i);
+
+    // The nonce is the upper half of lane 9
+    s[9] = ReadLE32(header + 72);
+
+    // Padding of the single block: 0x01 right after the header, 0x80 in the last byte of the rate
+    s[HEADER_SIZE / 8] ^= 0x01;
+    s[keccak::RATE_LANES - 1] ^= 0x8000000000000000ULL;
+}
+
+void CKeccak256Header::Hash(uint32_t nNonce, unsigned char hash[CKeccak256::OUTPUT_SIZE]) const
+{
+    uint64_t st[25];
+    memcpy(st, s, sizeof(st));
+    st[9] ^= (uint64_t)nNonce << 32;
+
+    keccak::Permute1(st);
+
+    for (size_t i = 0; i < 4; ++i)
+        WriteLE64(hash + 8 * i, st[i]);
+}
+
+void CKeccak256Header::HashNonces(uint32_t nNonceStart, size_t nCount, unsigned char* hashes) const
+{
+    const size_t w = keccak::nLanes;
+    uint64_t st[25 * keccak::MAX_LANES];
+
+    for (size_t n = 0; n < nCount; n += w) {
+        size_t nGroup = std::min(w, nCount - n);
+
+        if (nGroup == 1) {
+            Hash(nNonceStart + n, hashes + CKeccak256::OUTPUT_SIZE * n);
+            continue;
+        }
+
+        for (size_t i = 0; i < 25; ++i)
+            for (size_t j = 0; j < w; ++j)
+                st[i * w + j] = s[i];
+
+        for (size_t j = 0; j < nGroup; ++j)
+            st[9 * w + j] ^= (uint64_t)(uint32_t)(nNonceStart + n + j) << 32;
+
+        keccak::PermuteLanes(st);
+
+        for (size_t j = 0; j < nGroup; ++j)
+            for (size_t i = 0; i < 4; ++i)
+                WriteLE64(hashes + CKeccak256::OUTPUT_SIZE * (n + j) + 8 * i, st[i * w + j]);
+    }
+}
+
+void Keccak256Multi(const unsigned char* const* inputs, size_t len, unsigned char* const* hashes, size_t nCount)
+{
+    const size_t w = keccak::nLanes;
+
+    for (size_t n = 0; n < nCount; n += w) {
+        size_t nGroup = std::min(w, nCount - n);
+
+        if (nGroup == 1)
+            keccak::HashGroup(inputs + n, len, hashes + n, 1, keccak::Permute1, 1);
+        else
+            keccak::HashGroup(inputs + n, len, hashes + n, nGroup, keccak::PermuteLanes, w);
+    }
+}
+
+std::string Keccak256AutoDetect(size_t nMaxLanes)
+{
+    keccak::PermuteLanes = keccak::Permute1;
+    keccak::nLanes = 1;
+
+#ifdef ENABLE_KECCAK_X86_LANES
+    __builtin_cpu_init();
+
+    if (nMaxLanes >= 8 && __builtin_cpu_supports("avx512f")) {
+        keccak::PermuteLanes = keccak::Permute8AVX512;
+        keccak::nLanes = 8;
+        return "avx512f(8-way)";
+    }
+
+    if (nMaxLanes >= 4 && __builtin_cpu_supports("avx2")) {
+        keccak::PermuteLanes = keccak::Permute4AVX2;
+        keccak::nLanes = 4;
+        return "avx2(4-way)";
+    }
+#endif
+
+    return "standard";
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_KECCAK256_H
+#define BITCOIN_CRYPTO_KECCAK256_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** A hasher class for Keccak-256 (original Keccak padding, same output as sph_keccak256). */
+class CKeccak256
+{
+private:
+    uint64_t s[25];
+    unsigned char buf[136];
+    size_t bufsize;
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t RATE = 136;
+
+    CKeccak256();
+    CKeccak256& Write(const unsigned char* data, size_t len);
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+    CKeccak256& Reset();
+};
+
+/**
+ * Keccak-256 of 80 byte block headers which only differ in the nonce (the
+ * last 4 bytes). The constant 76 byte prefix and the padding get absorbed
+ * once, every nonce then only costs a single permutation.
+ */
+class CKeccak256Header
+{
+private:
+    uint64_t s[25];
+
+public:
+    static const size_t HEADER_SIZE = 80;
+
+    /** The nonce bytes of the header are ignored. */
+    explicit CKeccak256Header(const unsigned char header[HEADER_SIZE]);
+
+    void Hash(uint32_t nNonce, unsigned char hash[CKeccak256::OUTPUT_SIZE]) const;
+
+    /** Hash the nonces nNonceStart .. nNonceStart + nCount - 1 into nCount consecutive 32 byte hashes. */
+    void HashNonces(uint32_t nNonceStart, size_t nCount, unsigned char* hashes) const;
+};
+
+/** Hash nCount inputs of the same length len, using multiple lanes per permutation if the CPU supports it. */
+void Keccak256Multi(const unsigned char* const* inputs, size_t len, unsigned char* const* hashes, size_t nCount);
+
+/**
+ * Select the widest Keccak-f[1600] kernel the CPU supports, with at most nMaxLanes
+ * lanes per permutation, and return a description of it.
+ */
+std::string Keccak256AutoDetect(size_t nMaxLanes = 8);
+
+#endif // BITCOIN_CRYPTO_KECCAK256_H
@@ -0,0 +1,169 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+
+#include <string.h>
+
+//! Add v to r, return the carry out of the top limb
+static Num3072::limb_t AddSmall(Num3072::limb_t* r, Num3072::double_limb_t v)
+{
+    for (int i = 0; i < Num3072::LIMBS && v; ++i) {
+        v += r[i];
+        r[i] = (Num3072::limb_t)v;
+        v >>= Num3072::LIMB_SIZE;
+    }
+    return (Num3072::limb_t)v;
+}
+
+Num3072::Num3072(const unsigned char data[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t v = 0;
+        for (int b = sizeof(limb_t) - 1; b >= 0; --b) {
+            v = (v << 8) | data[i * sizeof(limb_t) + b];
+        }
+        limbs[i] = v;
+    }
+    FullReduce();
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+void Num3072::FullReduce()
+{
+    // Adding MAX_PRIME_DIFF overflows 2^3072 exactly if this is at least the
+    // modulus, the truncated sum is the difference then.
+    limb_t tmp[LIMBS];
+    memcpy(tmp, limbs, sizeof(limbs));
+    if (AddSmall(tmp, MAX_PRIME_DIFF))
+        memcpy(limbs, tmp, sizeof(limbs));
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t t[2 * LIMBS];
+    memset(t, 0, sizeof(t));
+
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t cur = (double_limb_t)limbs[i] * a.limbs[j] + t[i + j] + carry;
+            t[i + j] = (limb_t)cur;
+            carry = cur >> LIMB_SIZE;
+        }
+        t[i + LIMBS] = carry;
+    }
+
+    // high * 2^3072 + low is low + high * MAX_PRIME_DIFF modulo the prime
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t cur = (double_limb_t)t[LIMBS + i] * MAX_PRIME_DIFF + t[i] + carry;
+        limbs[i] = (limb_t)cur;
+        carry = cur >> LIMB_SIZE;
+    }
+
+    // Fold the remaining carry the same way. If that overflows again the
+    // result is below MAX_PRIME_DIFF^2, so the second fold can't.
+    if (AddSmall(limbs, (double_limb_t)carry * MAX_PRIME_DIFF))
+        AddSmall(limbs, MAX_PRIME_DIFF);
+
+    FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat's little theorem, this^(p - 2) with a window of four exponent bits
+    Num3072 table[16];
+    for (int i = 1; i < 16; ++i) {
+        table[i] = table[i - 1];
+        table[i].Multiply(*this);
+    }
+
+    Num3072 out;
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        limb_t e = i ? ~(limb_t)0 : ~(limb_t)0 - MAX_PRIME_DIFF - 1;
+        for (int shift = LIMB_SIZE - 4; shift >= 0; shift -= 4) {
+            for (int k = 0; k < 4; ++k) {
+                out.Multiply(out);
+            }
+            out.Multiply(table[(e >> shift) & 15]);
+        }
+    }
+    return out;
+}
+
+void Num3072::ToBytes(unsigned char out[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t v = limbs[i];
+        for (size_t b = 0; b < sizeof(limb_t); ++b) {
+            out[i * sizeof(limb_t) + b] = (unsigned char)v;
+            v >>= 8;
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hash);
+
+    unsigned char tmp[Num3072::BYTE_SIZE];
+    for (size_t i = 0; i < Num3072::BYTE_SIZE / CSHA512::OUTPUT_SIZE; ++i) {
+        unsigned char counter = i;
+        CSHA512().Write(hash, sizeof(hash)).Write(&counter, 1).Finalize(tmp + i * CSHA512::OUTPUT_SIZE);
+    }
+    return Num3072(tmp);
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char out[OUTPUT_SIZE])
+{
+    numerator.Multiply(denominator.GetInverse());
+    denominator.SetToOne();
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out);
+}
+
+void MuHash3072::GetState(unsigned char out[STATE_SIZE]) const
+{
+    numerator.ToBytes(out);
+    denominator.ToBytes(out + Num3072::BYTE_SIZE);
+}
+
+void MuHash3072::SetState(const unsigned char in[STATE_SIZE])
+{
+    numerator = Num3072(in);
+    denominator = Num3072(in + Num3072::BYTE_SIZE);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** Integers modulo the prime 2^3072 - 1103717, always fully reduced. */
+class Num3072
+{
+public:
+#ifdef __SIZEOF_INT128__
+    typedef uint64_t limb_t;
+    typedef unsigned __int128 double_limb_t;
+#else
+    typedef uint32_t limb_t;
+    typedef uint64_t double_limb_t;
+#endif
+    static const int LIMB_SIZE = 8 * sizeof(limb_t);
+    static const int LIMBS = 3072 / LIMB_SIZE;
+    static const size_t BYTE_SIZE = 384;
+    //! 2^3072 - MAX_PRIME_DIFF is the modulus
+    static const limb_t MAX_PRIME_DIFF = 1103717;
+
+    limb_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    /** Little endian, values above the modulus get reduced. */
+    explicit Num3072(const unsigned char data[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    /** Multiplicative inverse, this must not be zero. */
+    Num3072 GetInverse() const;
+    void ToBytes(unsigned char out[BYTE_SIZE]) const;
+
+private:
+    //! Subtract the modulus if this is at least the modulus
+    void FullReduce();
+};
+
+/**
+ * A hash of a set of byte strings, which can be updated with both insertions
+ * and removals in constant time, in any order (MuHash, see Maitin-Shepard et
+ * al., "Elliptic Curve Multiset Hash").
+ *
+ * Every element gets mapped to a number modulo a 3072 bit prime, the set is
+ * the product of its elements. Insertions multiply the numerator, removals
+ * the denominator, only Finalize has to compute an inverse. The elements are
+ * mapped by expanding their SHA256 hash with SHA512 in counter mode.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t STATE_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    /** The hash of the empty set. */
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** Apply the insertions and removals of mul to this set. */
+    MuHash3072& operator*=(const MuHash3072& mul);
+
+    /** Hash of the set, this divides the numerator by the denominator once. */
+    void Finalize(unsigned char out[OUTPUT_SIZE]);
+
+    /** Raw numerator and denominator, for storing an unfinalized hash. */
+    void GetState(unsigned char out[STATE_SIZE]) const;
+    void SetState(const unsigned char in[STATE_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
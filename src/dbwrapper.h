@@ -131,6 +131,7 @@ public:
     bool Valid();
 
     void SeekToFirst();
+    void SeekToLast();
 
     template<typename K> void Seek(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -225,15 +226,18 @@ public:
     ~CDBWrapper();
 
     template <typename K, typename V>
-    bool Read(const K& key, V& value) const
+    bool Read(const K& key, V& value, const leveldb::Snapshot *psnapshot = NULL) const
     {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
+        leveldb::ReadOptions options = readoptions;
+        options.snapshot = psnapshot;
+
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(options, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -299,9 +303,26 @@ public:
         return WriteBatch(batch, true);
     }
 
-    CDBIterator *NewIterator()
+    CDBIterator *NewIterator(const leveldb::Snapshot *psnapshot = NULL)
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = psnapshot;
+        return new CDBIterator(*this, pdb->NewIterator(options));
+    }
+
+    /**
+     * Return a consistent read view of the current state of the database
+     * which can be passed to Read and NewIterator. It has to be freed with
+     * ReleaseSnapshot before the database gets closed.
+     */
+    const leveldb::Snapshot *GetSnapshot()
+    {
+        return pdb->GetSnapshot();
+    }
+
+    void ReleaseSnapshot(const leveldb::Snapshot *psnapshot)
     {
-        return new CDBIterator(*this, pdb->NewIterator(iteroptions));
+        pdb->ReleaseSnapshot(psnapshot);
     }
 
     /**
@@ -8,7 +8,7 @@
 
 #include "crypto/ripemd160.h"
 #include "crypto/sha256.h"
-#include "crypto/sph_keccak.h"
+#include "crypto/keccak256.h"
 #include "prevector.h"
 #include "serialize.h"
 #include "uint256.h"
@@ -132,15 +132,13 @@ inline uint160 Hash160(const prevector<N, unsigned char>& vch)
 
 template<typename T1>
 inline uint256 HashKeccak(const T1 pbegin, const T1 pend)
-{        {
-    sph_keccak256_context ctx_keccak;
-    static unsigned char pblank[1];
+{
+    static const unsigned char pblank[1] = {};
     uint256 hash;
-    sph_keccak256_init(&ctx_keccak);
-    sph_keccak256 (&ctx_keccak, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), (pend - pbegin) * sizeof(pbegin[0]));
-    sph_keccak256_close(&ctx_keccak, static_cast<void*>(&hash));
+    CKeccak256().Write(pbegin == pend ? pblank : (const unsigned char*)&pbegin[0], (pend - pbegin) * sizeof(pbegin[0]))
+                .Finalize((unsigned char*)&hash);
     return hash;
-}        }
+}
 
 template<typename T1, typename T2>
 inline uint256 Hash4(const T1 p1begin, const T1 p1end,
@@ -12,11 +12,14 @@
 #include "addrman.h"
 #include "amount.h"
 #include "base58.h"
+#include "blockimport.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "coinstats.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/keccak256.h"
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
@@ -63,6 +66,7 @@
 #include "smartnode/smartnodeconfig.h"
 #include "smartnode/spork.h"
 #include "messagesigner.h"
+#include "sigverifier.h"
 // #ifdef ENABLE_WALLET
 // #include "privatesend-client.h"
 // #endif // ENABLE_WALLET
@@ -97,6 +101,8 @@
 
 #if ENABLE_ZMQ
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqpublisher.h"
+#include "zmq/zmqrpc.h"
 #endif
 
 using namespace std;
@@ -119,10 +125,6 @@ static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
 
-#if ENABLE_ZMQ
-static CZMQNotificationInterface* pzmqNotificationInterface = NULL;
-#endif
-
 static CDSNotificationInterface* pdsNotificationInterface = NULL;
 
 #ifdef WIN32
@@ -254,7 +256,8 @@ void PrepareShutdown()
     if (pwalletMain)
         pwalletMain->Flush(false);
 #endif
-    //GenerateBitcoins(false, 0, Params(), *g_connman);
+    if (g_connman)
+        GenerateBitcoins(false, 0, Params(), *g_connman);
     MapPort(false);
     UnregisterValidationInterface(peerLogic.get());
     peerLogic.reset();
@@ -320,6 +323,8 @@ void PrepareShutdown()
         pcoinscatcher = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
+        delete pcoinscommitment;
+        pcoinscommitment = NULL;
         delete pblocktree;
         pblocktree = NULL;
         delete prewards;
@@ -344,6 +349,8 @@ void PrepareShutdown()
         pdsNotificationInterface = NULL;
     }
 
+    UnregisterSmartVotingInterface();
+
 #ifndef WIN32
     try {
         boost::filesystem::remove(GetPidFile());
@@ -463,13 +470,16 @@ std::string HelpMessage(HelpMessageMode mode)
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
+    strUsage += HelpMessageOpt("-rewardsverify=<mode>", _("How the SmartRewards block records get verified at startup, \"full\" checks all records instead of the ones added since the last start"));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
     // ### SMARTCASH ###
     // txindex option is currently disabled, defaults to true.
     //strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-coinstatsindex", strprintf(_("Maintain a commitment to the UTXO set and its totals, used by gettxoutsetinfo with hash_type \"muhash\" (default: %u)"), DEFAULT_COINSTATSINDEX));
     strUsage += HelpMessageOpt("-depositindex", strprintf(_("Maintain a address deposit index, used by the SAPI and the getdeposits rpc call (not yet implemented) (default: %u)"), DEFAULT_DEPOSITINDEX));
+    strUsage += HelpMessageOpt("-miningsignatureindex", strprintf(_("Maintain an index of the mining signature key per block, used by the smartmining rpc call (default: %u)"), DEFAULT_MININGSIGNATUREINDEX));
 
     strUsage += HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -524,6 +534,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqhwm=<n>", strprintf(_("Maximum number of notifications waiting to be published (default: %u)"), DEFAULT_ZMQ_HWM));
+    strUsage += HelpMessageOpt("-zmqdroppolicy=<policy>", strprintf(_("Notification to drop once -zmqhwm is reached, <policy> is oldest or newest (default: %s)"), DEFAULT_ZMQ_DROP_POLICY));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -708,18 +720,7 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
-        }
+        ReindexBlockFiles(chainparams);
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -932,6 +933,7 @@ void InitParameterInteraction()
     }
 
     fInstantPayIndex = GetBoolArg("-instantpayindex", DEFAULT_INSTANTPAYINDEX);
+    fMiningSignatureIndex = GetBoolArg("-miningsignatureindex", DEFAULT_MININGSIGNATUREINDEX);
 
     // Make sure additional indexes are recalculated correctly in VerifyDB
     // (we must reconnect blocks whenever we disconnect them for these indexes to work)
@@ -1289,6 +1291,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 4: application initialization: dir lock, daemonize, pidfile, debug log
 
+    // Select the Keccak-f[1600] kernel for this CPU
+    std::string strKeccakImpl = Keccak256AutoDetect();
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1338,12 +1343,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Using data directory %s\n", strDataDir);
     LogPrintf("Using config file %s\n", GetConfigFile().string());
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
+    LogPrintf("Using the '%s' Keccak-256 implementation\n", strKeccakImpl);
     std::ostringstream strErrors;
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadSmartRewardsPrefetch);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadSignatureVerify);
     }
 
     if (!sporkManager.SetSporkAddress(GetArg("-sporkaddr", Params().SporkAddress())))
@@ -1371,6 +1381,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
      * that the server is there and will be ready later).  Warmup mode will
      * be disabled when initialisation is finished.
      */
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
+
     if (fServer)
     {
         uiInterface.InitMessage.connect(SetRPCWarmupStatus);
@@ -1643,11 +1657,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
 
     int64_t nRewardsCache = (GetArg("-rewardsdbcache", nRewardsDefaultDbCache) << 20);
-    LogPrintf("* Using %.1fMiB for smart rewards database\n", nRewardsCache * (1.0 / 1024 / 1024));
+    int64_t nRewardsDBCache = nRewardsCache / nRewardsDbCacheShare;
+    nRewardsCacheUsage = nRewardsCache - nRewardsDBCache; // the rest goes to the in-memory reward entry cache
+    LogPrintf("* Using %.1fMiB for smart rewards database\n", nRewardsDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for in-memory smart rewards cache\n", nRewardsCacheUsage * (1.0 / 1024 / 1024));
 
     delete prewards;
 
-    CSmartRewardsDB *prewardsdb = new CSmartRewardsDB(nRewardsCache, false, false);
+    CSmartRewardsDB *prewardsdb = new CSmartRewardsDB(nRewardsDBCache, false, false);
 
     prewards = new CSmartRewards(prewardsdb);
 
@@ -1691,6 +1708,15 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // Before InitBlockIndex, which might connect the genesis block.
+                if (GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+                    uiInterface.InitMessage(_("Loading UTXO set commitment..."));
+                    if (!LoadCoinsCommitment(pcoinsdbview)) {
+                        strLoadError = _("Error building the UTXO set commitment");
+                        break;
+                    }
+                }
+
                 // If the loaded chain has a wrong genesis, bail out immediately
                 // (we're likely using a testnet datadir, or the other way around).
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashGenesisBlock) == 0)
@@ -1795,18 +1821,34 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 if( fResetRewards ){
                     delete prewards;
 
-                    prewardsdb = new CSmartRewardsDB(nRewardsCache, false, true);
+                    prewardsdb = new CSmartRewardsDB(nRewardsDBCache, false, true);
                     prewards = new CSmartRewards(prewardsdb);
                 }
 
-                if( prewards->IsLocked() ) throw std::runtime_error(_("SmartRewards database is incomplete."));
+                if( prewards->IsLocked() ){
+                    // Not shut down cleanly. The rewards get flushed right before the chainstate,
+                    // so the database is still usable if its last block is part of the active chain.
+                    // If not the chainstate flush didn't make it, undo the blocks it is missing.
+                    CSmartRewardBlock last;
+                    if( prewards->GetLastBlock(last) ){
+                        CBlockIndex *pindexLast = chainActive[last.nHeight];
+                        if( (pindexLast == NULL || pindexLast->GetBlockHash() != last.blockHash) &&
+                            !RewindSmartRewards(chainparams) ) throw std::runtime_error(_("SmartRewards database is incomplete."));
+                    }
+                    LogPrintf("SmartRewards database was not closed cleanly, continue at block %d\n", prewards->GetLastHeight());
+                }
 
-                if( !(fLoaded = prewards->Verify()) ) throw std::runtime_error(_("Failed to verify SmartRewards database."));
+                if( !(fLoaded = prewards->Verify(GetArg("-rewardsverify", "") == "full")) ) throw std::runtime_error(_("Failed to verify SmartRewards database."));
 
                 if( pLastIndex != NULL && !(fLoaded = (prewards->GetLastHeight() <= pLastIndex->nHeight)) ) throw std::runtime_error(_("SmartRewards database exceeds current chain height."));
 
                 if (fRequestShutdown) break;
 
+                if( !prewards->PruneTransactions() ){
+                    if (fRequestShutdown) break;
+                    throw std::runtime_error(_("Failed to prune the SmartRewards transaction records."));
+                }
+
                 prewards->Lock();
 
             } catch (const std::runtime_error &e) {
@@ -2055,6 +2097,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+
+    if (fMiningSignatureIndex)
+        threadGroup.create_thread(&ThreadBuildMiningSignatureIndex);
     if (chainActive.Tip() == NULL) {
         LogPrintf("Waiting for genesis block to be imported...\n");
         while (!fRequestShutdown && chainActive.Tip() == NULL)
@@ -2224,6 +2269,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     threadGroup.create_thread(boost::bind(&ThreadSmartnode, boost::ref(*g_connman)));
 
 //  WIP-VOTING uncomment
+//    RegisterSmartVotingInterface();
 //    threadGroup.create_thread(&ThreadSmartVoting);
 
     // ********************************************************* Step 12: start node
@@ -6,9 +6,76 @@
 #include "hash.h"
 #include "validation.h" // For strMessageMagic
 #include "messagesigner.h"
+#include "random.h"
 #include "tinyformat.h"
 #include "utilstrencodings.h"
 
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace {
+
+class CMessageSignatureCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/**
+ * Keys recovered from compact message signatures. Recovering the key is the
+ * expensive part of every signature check and doesn't depend on the key the
+ * caller expects, so the recovered key can be looked up by any message type
+ * which signed the same hash.
+ */
+class CMessageSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || hash || signature)
+    uint256 nonce;
+    typedef boost::unordered_map<uint256, CKeyID, CMessageSignatureCacheHasher> map_type;
+    map_type mapRecovered;
+    boost::shared_mutex cs_msgsigcache;
+
+public:
+    CMessageSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry, CKeyID& keyIDRet)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_msgsigcache);
+        map_type::const_iterator it = mapRecovered.find(entry);
+        if (it == mapRecovered.end()) return false;
+        keyIDRet = it->second;
+        return true;
+    }
+
+    void Set(const uint256& entry, const CKeyID& keyID)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_msgsigcache);
+        while (mapRecovered.size() >= MAX_MESSAGE_SIG_CACHE_ENTRIES)
+        {
+            map_type::size_type s = GetRand(mapRecovered.bucket_count());
+            map_type::local_iterator it = mapRecovered.begin(s);
+            if (it != mapRecovered.end(s)) {
+                mapRecovered.erase(it->first);
+            }
+        }
+
+        mapRecovered.emplace(entry, keyID);
+    }
+};
+
+}
+
 bool CMessageSigner::GetKeysFromSecret(const std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
     CBitcoinSecret vchSecret;
@@ -36,12 +103,17 @@ bool CMessageSigner::VerifyMessage(const CPubKey& pubkey, const std::vector<unsi
 }
 
 bool CMessageSigner::VerifyMessage(const CKeyID& keyID, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet)
+{
+    return CHashSigner::VerifyHash(GetMessageHash(strMessage), keyID, vchSig, strErrorRet);
+}
+
+uint256 CMessageSigner::GetMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
 
-    return CHashSigner::VerifyHash(ss.GetHash(), keyID, vchSig, strErrorRet);
+    return ss.GetHash();
 }
 
 bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsigned char>& vchSigRet)
@@ -56,18 +128,46 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey& pubkey, const s
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
-    CPubKey pubkeyFromSig;
-    if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
+    CKeyID keyIDFromSig;
+    if(!RecoverKeyID(hash, vchSig, keyIDFromSig)) {
         strErrorRet = "Error recovering public key.";
         return false;
     }
 
-    if(pubkeyFromSig.GetID() != keyID) {
+    if(keyIDFromSig != keyID) {
         strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, hash=%s, vchSig=%s",
-                    keyID.ToString(), pubkeyFromSig.GetID().ToString(), hash.ToString(),
+                    keyID.ToString(), keyIDFromSig.ToString(), hash.ToString(),
                     EncodeBase64(&vchSig[0], vchSig.size()));
         return false;
     }
 
     return true;
 }
+
+bool CHashSigner::RecoverKeyID(const uint256& hash, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet)
+{
+    static CMessageSignatureCache messageSignatureCache;
+
+    uint256 entry;
+    messageSignatureCache.ComputeEntry(entry, hash, vchSig);
+
+    if(messageSignatureCache.Get(entry, keyIDRet)) {
+        return true;
+    }
+
+    CPubKey pubkeyFromSig;
+    if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
+        return false;
+    }
+
+    keyIDRet = pubkeyFromSig.GetID();
+    messageSignatureCache.Set(entry, keyIDRet);
+
+    return true;
+}
+
+bool CHashSignatureCheck::operator()() const
+{
+    CKeyID keyID;
+    return CHashSigner::RecoverKeyID(hash, vchSig, keyID);
+}
@@ -7,6 +7,9 @@
 
 #include "key.h"
 
+// Limit the cache of recovered message signature keys to ~10MB
+static const unsigned int MAX_MESSAGE_SIG_CACHE_ENTRIES = 100000;
+
 /** Helper class for signing messages and checking their signatures
  */
 class CMessageSigner
@@ -20,6 +23,8 @@ public:
     static bool VerifyMessage(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
     /// Verify the message signature, returns true if succcessful
     static bool VerifyMessage(const CKeyID& keyID, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
+    /// Get the hash which gets signed for the message
+    static uint256 GetMessageHash(const std::string& strMessage);
 };
 
 /** Helper class for signing hashes and checking their signatures
@@ -33,6 +38,27 @@ public:
     static bool VerifyHash(const uint256& hash, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
     /// Verify the hash signature, returns true if succcessful
     static bool VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
+    /// Recover the key which signed the hash, returns true if successful.
+    /// Recovered keys are kept in a salted cache shared by all message types.
+    static bool RecoverKeyID(const uint256& hash, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet);
+};
+
+/** A signature to recover ahead of time so that the message handler
+ *  finds the signing key in the signature cache later.
+ */
+class CHashSignatureCheck
+{
+private:
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+
+public:
+    CHashSignatureCheck() {}
+    CHashSignatureCheck(const uint256& hashIn, const std::vector<unsigned char>& vchSigIn) :
+        hash(hashIn), vchSig(vchSigIn) {}
+
+    /// Recover the signing key and store it in the signature cache, returns true if successful
+    bool operator()() const;
 };
 
 #endif
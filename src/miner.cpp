@@ -13,6 +13,7 @@
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/keccak256.h"
 #include "hash.h"
 #include "net.h"
 #include "policy/policy.h"
@@ -32,8 +33,10 @@
 #include "smartmining/miningpayments.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <memory>
 #include <queue>
 
 using namespace std;
@@ -824,114 +827,273 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     return true;
 }
 
-// ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
-void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
+/** Number of nonces a miner thread hashes before it checks for a new job */
+static const uint32_t MINER_NONCE_BATCH = 0x100;
+/** Get a new coinbase once the nonces of a job are used up to this one */
+static const uint64_t MINER_NONCE_LIMIT = 0xffff0000;
+/** Interval of the miner control thread checks, in milliseconds */
+static const int64_t MINER_CONTROL_INTERVAL = 100;
+/** Interval of the hash rate samples, in milliseconds */
+static const int64_t MINER_STATS_INTERVAL = 2000;
+/** Minimum age of a block template before it gets rebuilt for new mempool transactions, in seconds */
+static const int64_t MINER_TEMPLATE_REFRESH_INTERVAL = 10;
+
+namespace {
+
+/**
+ * A block header to mine, shared by all miner threads. The constant part of
+ * the header is absorbed once into headerHasher and the threads take batches
+ * of nonces from nNextNonce, so they partition the nonce space of the job
+ * without any further coordination.
+ */
+struct CMinerJob
 {
-    LogPrintf("SmartCashMiner -- started\n");
+    const CBlock block;
+    const CBlockIndex* const pindexPrev;
+    const arith_uint256 hashTarget;
+    const CKeccak256Header headerHasher;
+    //! First nonce not yet taken by a miner thread
+    std::atomic<uint64_t> nNextNonce;
+    //! Set once a miner thread found a solution
+    std::atomic<bool> fSolved;
+    //! Set once the job got replaced by a newer one
+    std::atomic<bool> fStale;
+
+    CMinerJob(const CBlock& blockIn, const CBlockIndex* pindexPrevIn) :
+        block(blockIn),
+        pindexPrev(pindexPrevIn),
+        hashTarget(arith_uint256().SetCompact(blockIn.nBits)),
+        headerHasher((const unsigned char*)BEGIN(block.nVersion)),
+        nNextNonce(0), fSolved(false), fStale(false) {}
+};
+
+/**
+ * The internal miner: a control thread which keeps the block template up to
+ * date with the chain tip and the mempool and publishes jobs for it, and
+ * the miner threads which hash the nonces of the current job.
+ */
+class CMinerEngine
+{
+private:
+    const CChainParams& chainparams;
+    CConnman& connman;
+    boost::shared_ptr<CReserveScript> coinbaseScript;
+    const size_t nThreads;
+
+    //! Mutex to protect the inner state
+    boost::mutex mutex;
+    //! Miner threads wait on this for a new job
+    boost::condition_variable condWorker;
+    //! The control thread waits on this for a refresh request
+    boost::condition_variable condControl;
+    //! The job to mine, NULL while there is nothing to do
+    std::shared_ptr<CMinerJob> job;
+    //! A miner thread asks the control thread for a new job
+    bool fRefresh;
+    //! Cleared once the control thread gave up mining on its own
+    bool fRunning;
+    //! Why the control thread gave up mining
+    std::string strStopReason;
+    //! Last hash rate sample
+    CMinerStats stats;
+
+    //! Hashes done by each miner thread
+    std::unique_ptr<std::atomic<uint64_t>[]> vHashesDone;
+    std::atomic<uint64_t> nBlocksFound;
+
+    void SetJob(const std::shared_ptr<CMinerJob>& jobNew);
+    void RequestRefresh();
+    void StopMining(const std::string& strReason);
+    void FoundSolution(CMinerJob& jobSolved, uint32_t nNonce, const uint256& hash);
+    void UpdateStats(int64_t& nStatsTime, std::vector<uint64_t>& vHashesLast);
+
+public:
+    CMinerEngine(const CChainParams& chainparamsIn, CConnman& connmanIn, const boost::shared_ptr<CReserveScript>& coinbaseScriptIn, size_t nThreadsIn) :
+        chainparams(chainparamsIn), connman(connmanIn), coinbaseScript(coinbaseScriptIn), nThreads(nThreadsIn),
+        fRefresh(false), fRunning(true), vHashesDone(new std::atomic<uint64_t>[nThreadsIn]), nBlocksFound(0)
+    {
+        for (size_t i = 0; i < nThreads; ++i) {
+            vHashesDone[i] = 0;
+        }
+        stats.vThreadHashesPerSec.resize(nThreads, 0);
+    }
+
+    void ControlThread();
+    void WorkerThread(size_t nThread);
+    CMinerStats GetStats();
+};
+
+void CMinerEngine::SetJob(const std::shared_ptr<CMinerJob>& jobNew)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (job) {
+        job->fStale = true;
+    }
+    job = jobNew;
+    condWorker.notify_all();
+}
+
+void CMinerEngine::RequestRefresh()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fRefresh = true;
+    condControl.notify_one();
+}
+
+void CMinerEngine::StopMining(const std::string& strReason)
+{
+    LogPrintf("SmartCashMiner -- stopped: %s\n", strReason);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (job) {
+        job->fStale = true;
+    }
+    job.reset();
+    fRunning = false;
+    strStopReason = strReason;
+    // The miner threads sit idle from now on
+    stats = CMinerStats();
+    stats.vThreadHashesPerSec.resize(nThreads, 0);
+}
+
+void CMinerEngine::FoundSolution(CMinerJob& jobSolved, uint32_t nNonce, const uint256& hash)
+{
+    // Only the first solution of a job gets submitted
+    if (jobSolved.fSolved.exchange(true))
+        return;
+
+    CBlock block(jobSolved.block);
+    block.nNonce = nNonce;
+
+    SetThreadPriority(THREAD_PRIORITY_NORMAL);
+    LogPrintf("SmartCashMiner:\n  proof-of-work found\n  hash: %s\n  target: %s\n", hash.GetHex(), jobSolved.hashTarget.GetHex());
+    if (ProcessBlockFound(&block, chainparams))
+        nBlocksFound++;
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
-    RenameThread("smartcash-miner");
+    coinbaseScript->KeepScript();
+
+    RequestRefresh();
+}
+
+void CMinerEngine::UpdateStats(int64_t& nStatsTime, std::vector<uint64_t>& vHashesLast)
+{
+    int64_t nNow = GetTimeMillis();
+    if (nNow - nStatsTime < MINER_STATS_INTERVAL)
+        return;
+
+    CMinerStats statsNew;
+    statsNew.vThreadHashesPerSec.resize(nThreads);
+    for (size_t i = 0; i < nThreads; ++i) {
+        uint64_t nHashes = vHashesDone[i];
+        statsNew.vThreadHashesPerSec[i] = (nHashes - vHashesLast[i]) * 1000.0 / (nNow - nStatsTime);
+        statsNew.dHashesPerSec += statsNew.vThreadHashesPerSec[i];
+        vHashesLast[i] = nHashes;
+    }
+    nStatsTime = nNow;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (fRunning)
+        stats = statsNew;
+}
 
+CMinerStats CMinerEngine::GetStats()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    CMinerStats statsRet = stats;
+    statsRet.nBlocksFound = nBlocksFound;
+    statsRet.fRunning = fRunning;
+    statsRet.strStopReason = strStopReason;
+    return statsRet;
+}
+
+void CMinerEngine::ControlThread()
+{
+    LogPrintf("SmartCashMiner -- started with %d threads\n", nThreads);
+    RenameThread("smartcash-minerctl");
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    std::shared_ptr<CMinerJob> jobCurrent;
+    const CBlockIndex* pindexPrev = NULL;
+    unsigned int nTransactionsUpdatedLast = 0;
+    int64_t nTemplateTime = 0;
     unsigned int nExtraNonce = 0;
 
-    boost::shared_ptr<CReserveScript> coinbaseScript;
-    GetMainSignals().ScriptForMining(coinbaseScript);
+    int64_t nStatsTime = GetTimeMillis();
+    std::vector<uint64_t> vHashesLast(nThreads, 0);
 
     try {
-        // Throw an error if no script was provided.  This can happen
-        // due to some internal error but also if the keypool is empty.
-        // In the latter case, already the pointer is NULL.
-        if (!coinbaseScript || coinbaseScript->reserveScript.empty())
-            throw std::runtime_error("No coinbase script available (mining requires a wallet)");
-
         while (true) {
-            if (chainparams.MiningRequiresPeers()) {
-                // Busy-wait for the network to come online so we don't waste time mining
-                // on an obsolete chain. In regtest mode we expect to fly solo.
-                do {
-                    bool fvNodesEmpty = connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0;
-                    if (!fvNodesEmpty && !IsInitialBlockDownload() && smartnodeSync.IsSynced())
-                        break;
-                    MilliSleep(1000);
-                } while (true);
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (!fRefresh)
+                    condControl.timed_wait(lock, boost::posix_time::milliseconds(MINER_CONTROL_INTERVAL));
+                fRefresh = false;
             }
 
+            boost::this_thread::interruption_point();
 
-            //
-            // Create new block
-            //
-            unsigned int nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-            CBlockIndex* pindexPrev = chainActive.Tip();
-            if(!pindexPrev) break;
+            UpdateStats(nStatsTime, vHashesLast);
 
-            static CBlockTemplate* pblocktemplate = BlockAssembler(Params()).CreateNewBlock(coinbaseScript->reserveScript, nullptr);
-            if (!pblocktemplate)
-            {
-                LogPrintf("SmartCashMiner -- Keypool ran out, please call keypoolrefill before restarting the mining thread\n");
-                return;
-            }
-            CBlock *pblock = &pblocktemplate->block;
-            IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
-
-            LogPrintf("SmartCashMiner -- Running miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
-                ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
-
-            //
-            // Search
-            //
-            int64_t nStart = GetTime();
-            arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
-            while (true)
-            {
-                unsigned int nHashesDone = 0;
-
-                uint256 hash;
-                while (true)
-                {
-                    hash = pblock->GetHash();
-                    if (UintToArith256(hash) <= hashTarget)
-                    {
-                        // Found a solution
-                        SetThreadPriority(THREAD_PRIORITY_NORMAL);
-                        LogPrintf("SmartCashMiner:\n  proof-of-work found\n  hash: %s\n  target: %s\n", hash.GetHex(), hashTarget.GetHex());
-                        ProcessBlockFound(pblock, chainparams);
-                        SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                        coinbaseScript->KeepScript();
-
-                        // In regression test mode, stop mining after a block is found. This
-                        // allows developers to controllably generate a block on demand.
-                        if (chainparams.MineBlocksOnDemand())
-                            throw boost::thread_interrupted();
-
-                        break;
-                    }
-                    pblock->nNonce += 1;
-                    nHashesDone += 1;
-                    if ((pblock->nNonce & 0xFF) == 0)
-                        break;
+            if (chainparams.MiningRequiresPeers() &&
+                (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 || IsInitialBlockDownload() || !smartnodeSync.IsSynced())) {
+                // Don't waste time mining on an obsolete chain. In regtest mode we expect to fly solo.
+                if (jobCurrent) {
+                    jobCurrent.reset();
+                    pblocktemplate.reset();
+                    SetJob(jobCurrent);
                 }
+                continue;
+            }
 
-                // Check for stop or if block needs to be rebuilt
-                boost::this_thread::interruption_point();
-                // Regtest mode doesn't require peers
-                if (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 && chainparams.MiningRequiresPeers())
-                    break;
-                if (pblock->nNonce >= 0xffff0000)
-                    break;
-                if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
-                    break;
-                if (pindexPrev != chainActive.Tip())
-                    break;
+            // In regression test mode, stop mining after a block is found. This
+            // allows developers to controllably generate a block on demand.
+            if (jobCurrent && jobCurrent->fSolved && chainparams.MineBlocksOnDemand()) {
+                StopMining("Found a block on demand");
+                throw boost::thread_interrupted();
+            }
 
-                // Update nTime every few seconds
-                if (UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev) < 0)
-                    break; // Recreate the block if the clock has run backwards,
-                           // so that we can use the correct time.
-                if (chainparams.GetConsensus().fPowAllowMinDifficultyBlocks)
-                {
-                    // Changing pblock->nTime can change work required on testnet:
-                    hashTarget.SetCompact(pblock->nBits);
+            const CBlockIndex* pindexTip;
+            {
+                LOCK(cs_main);
+                pindexTip = chainActive.Tip();
+            }
+            if (!pindexTip)
+                continue;
+
+            if (!pblocktemplate || pindexPrev != pindexTip || jobCurrent->fSolved ||
+                (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nTemplateTime > MINER_TEMPLATE_REFRESH_INTERVAL)) {
+                // Create new block
+                nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+                nTemplateTime = GetTime();
+                pindexPrev = pindexTip;
+
+                pblocktemplate.reset(BlockAssembler(chainparams).CreateNewBlock(coinbaseScript->reserveScript, CSmartAddress()));
+                if (!pblocktemplate) {
+                    StopMining("Keypool ran out, please call keypoolrefill before restarting the mining thread");
+                    return;
+                }
+                IncrementExtraNonce(&pblocktemplate->block, pindexPrev, nExtraNonce);
+
+                LogPrintf("SmartCashMiner -- Running miner with %u transactions in block (%u bytes)\n", pblocktemplate->block.vtx.size(),
+                    ::GetSerializeSize(pblocktemplate->block, SER_NETWORK, PROTOCOL_VERSION));
+            } else if (jobCurrent->nNextNonce >= MINER_NONCE_LIMIT) {
+                // All nonces of this coinbase are taken
+                IncrementExtraNonce(&pblocktemplate->block, pindexPrev, nExtraNonce);
+            } else {
+                int64_t nTimeDiff = UpdateTime(&pblocktemplate->block, chainparams.GetConsensus(), pindexPrev);
+                if (nTimeDiff < 0) {
+                    // Recreate the block if the clock has run backwards,
+                    // so that we can use the correct time.
+                    pblocktemplate.reset();
+                    continue;
                 }
+                // Keep mining the current job until there is a new time for the header
+                if (nTimeDiff == 0)
+                    continue;
             }
+
+            jobCurrent = std::make_shared<CMinerJob>(pblocktemplate->block, pindexPrev);
+            SetJob(jobCurrent);
         }
     }
     catch (const boost::thread_interrupted&)
@@ -941,29 +1103,110 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
     }
     catch (const std::runtime_error &e)
     {
-        LogPrintf("SmartCashMiner -- runtime error: %s\n", e.what());
+        StopMining(strprintf("Runtime error: %s", e.what()));
         return;
     }
 }
 
-void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman& connman)
+void CMinerEngine::WorkerThread(size_t nThread)
 {
-    static boost::thread_group* minerThreads = NULL;
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    RenameThread("smartcash-miner");
+
+    std::shared_ptr<CMinerJob> jobCurrent;
+    uint256 vHashes[MINER_NONCE_BATCH];
+
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // Wait for a job other than the one we are done with
+            while (!job || job == jobCurrent) {
+                condWorker.wait(lock);
+            }
+            jobCurrent = job;
+        }
+
+        while (!jobCurrent->fStale && !jobCurrent->fSolved) {
+            boost::this_thread::interruption_point();
+
+            uint64_t nNonceStart = jobCurrent->nNextNonce.fetch_add(MINER_NONCE_BATCH);
+            if (nNonceStart >= MINER_NONCE_LIMIT) {
+                RequestRefresh();
+                break;
+            }
 
+            jobCurrent->headerHasher.HashNonces(nNonceStart, MINER_NONCE_BATCH, (unsigned char*)vHashes);
+            vHashesDone[nThread] += MINER_NONCE_BATCH;
+
+            for (uint32_t i = 0; i < MINER_NONCE_BATCH; ++i) {
+                if (UintToArith256(vHashes[i]) <= jobCurrent->hashTarget) {
+                    FoundSolution(*jobCurrent, nNonceStart + i, vHashes[i]);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+} // anon namespace
+
+static CCriticalSection cs_miner;
+static boost::thread_group* minerThreads = NULL;
+static CMinerEngine* minerEngine = NULL;
+
+void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman& connman)
+{
     if (nThreads < 0)
         nThreads = GetNumCores();
 
-    if (minerThreads != NULL)
+    boost::thread_group* minerThreadsOld;
+    CMinerEngine* minerEngineOld;
     {
-        minerThreads->interrupt_all();
-        delete minerThreads;
+        LOCK(cs_miner);
+        minerThreadsOld = minerThreads;
+        minerEngineOld = minerEngine;
         minerThreads = NULL;
+        minerEngine = NULL;
+    }
+
+    // The miner threads might wait for cs_main, so never join them while
+    // holding cs_miner
+    if (minerThreadsOld != NULL)
+    {
+        minerThreadsOld->interrupt_all();
+        minerThreadsOld->join_all();
+        delete minerThreadsOld;
+        delete minerEngineOld;
     }
 
     if (nThreads == 0 || !fGenerate)
         return;
 
+    boost::shared_ptr<CReserveScript> coinbaseScript;
+    GetMainSignals().ScriptForMining(coinbaseScript);
+
+    // Don't start if no script was provided. This can happen due to some
+    // internal error but also if the keypool is empty. In the latter case,
+    // already the pointer is NULL.
+    if (!coinbaseScript || coinbaseScript->reserveScript.empty()) {
+        LogPrintf("SmartCashMiner -- No coinbase script available (mining requires a wallet)\n");
+        return;
+    }
+
+    LOCK(cs_miner);
+    minerEngine = new CMinerEngine(chainparams, connman, coinbaseScript, nThreads);
     minerThreads = new boost::thread_group();
+    minerThreads->create_thread(boost::bind(&CMinerEngine::ControlThread, minerEngine));
     for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), boost::ref(connman)));
+        minerThreads->create_thread(boost::bind(&CMinerEngine::WorkerThread, minerEngine, i));
+}
+
+bool GetMinerStats(CMinerStats& stats)
+{
+    LOCK(cs_miner);
+    if (minerEngine == NULL)
+        return false;
+
+    stats = minerEngine->GetStats();
+    return stats.fRunning;
 }
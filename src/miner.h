@@ -11,6 +11,8 @@
 
 #include <stdint.h>
 #include <memory>
+#include <string>
+#include <vector>
 #include "boost/multi_index_container.hpp"
 #include "boost/multi_index/ordered_index.hpp"
 #include "smarthive/hive.h"
@@ -40,6 +42,29 @@ struct CBlockTemplate
 /** Run the miner threads */
 void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman& connman);
 
+/** Hash rates of the internal miner */
+struct CMinerStats
+{
+    //! Hashes per second of each miner thread
+    std::vector<double> vThreadHashesPerSec;
+    //! Hashes per second of all miner threads together
+    double dHashesPerSec;
+    //! Blocks found and accepted since the miner got started
+    uint64_t nBlocksFound;
+    //! False once the miner gave up on its own, see strStopReason
+    bool fRunning;
+    //! Why the miner gave up, empty while it runs
+    std::string strStopReason;
+
+    CMinerStats() : dHashesPerSec(0), nBlocksFound(0), fRunning(false) {}
+};
+
+/**
+ * Get the hash rates of the internal miner, returns false if it is not running.
+ * A miner which stopped on its own still fills in the stats with the reason.
+ */
+bool GetMinerStats(CMinerStats& stats);
+
 // Container for tracking updates to ancestor feerate as we include (parent)
 // transactions in a block
 // struct CTxMemPoolModifiedEntry {
@@ -2809,6 +2809,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     fPauseRecv = false;
     fPauseSend = false;
     nProcessQueueSize = 0;
+    nProcessMsgPrefetched = 0;
     nPaymentMessagesInSync = 0;
 
     BOOST_FOREACH(const std::string &msg, getAllNetMessageTypes())
@@ -2897,7 +2898,7 @@ void CConnman::EndMessage(CDataStream& strm)
 
 }
 
-void CConnman::PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand)
+void CConnman::PushMessage(CNode* pnode, const CDataStream& strm, const std::string& sCommand)
 {
     if(strm.empty())
         return;
@@ -39,6 +39,7 @@
 class CAddrMan;
 class CScheduler;
 class CNode;
+class CPrefetchedMessage;
 
 namespace boost {
     class thread_group;
@@ -221,6 +222,16 @@ public:
         PushMessageWithVersionAndFlag(pnode, 0, 0, sCommand, std::forward<Args>(args)...);
     }
 
+    /**
+     * Push a message completed with EndMessage before. It doesn't depend on
+     * the peer, so the same message can be pushed to several of them without
+     * serializing it again.
+     */
+    void PushMessage(CNode* pnode, const CDataStream& strm, const std::string& sCommand);
+
+    /** Set the payload size and the checksum in the header of a message */
+    static void EndMessage(CDataStream& strm);
+
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
     {
@@ -413,6 +424,8 @@ public:
     CSipHasher GetDeterministicRandomizer(uint64_t id) const;
 
     unsigned int GetReceiveFloodSize() const;
+
+    void WakeMessageHandler();
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -432,8 +445,6 @@ private:
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
 
-    void WakeMessageHandler();
-
     CNode* FindNode(const CNetAddr& ip);
     CNode* FindNode(const CSubNet& subNet);
     CNode* FindNode(const std::string& addrName);
@@ -459,8 +470,6 @@ private:
 
     CDataStream BeginMessage(CNode* node, int nVersion, int flags, const std::string& sCommand);
 
-    void PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand);
-    void EndMessage(CDataStream& strm);
 
     // Network stats
     void RecordBytesRecv(uint64_t bytes);
@@ -670,6 +679,8 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    std::shared_ptr<CPrefetchedMessage> prefetched; // deserialized message waiting for its signature checks
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
@@ -715,6 +726,8 @@ public:
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg;
     size_t nProcessQueueSize;
+    // Number of messages at the front of vProcessMsg handed to the signature verifier already
+    size_t nProcessMsgPrefetched;
 
     CCriticalSection cs_sendProcessing;
 
@@ -21,6 +21,7 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "random.h"
+#include "sigverifier.h"
 #include "tinyformat.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -104,6 +105,58 @@ namespace {
 
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads = 0;
+
+    typedef std::shared_ptr<const CDataStream> CRawBlockMessageRef;
+
+    /**
+     * Complete block messages recently sent to peers, with the block read as
+     * raw bytes from the block files. Peers in initial block download mostly
+     * request the same blocks, those get read and checksummed only once.
+     * Protected by cs_main.
+     */
+    class CRawBlockCache
+    {
+    private:
+        typedef std::list<std::pair<uint256, CRawBlockMessageRef> > entry_list_t;
+
+        size_t nMaxEntries;
+        size_t nMaxSize;
+        size_t nSize;
+        entry_list_t listEntries;
+        std::map<uint256, entry_list_t::iterator> mapEntries;
+
+    public:
+        CRawBlockCache(size_t nMaxEntriesIn, size_t nMaxSizeIn) : nMaxEntries(nMaxEntriesIn), nMaxSize(nMaxSizeIn), nSize(0) {}
+
+        CRawBlockMessageRef Get(const uint256& hash)
+        {
+            auto it = mapEntries.find(hash);
+            if (it == mapEntries.end())
+                return CRawBlockMessageRef();
+
+            // move it to the front, it's the most recently used one now
+            listEntries.splice(listEntries.begin(), listEntries, it->second);
+            return it->second->second;
+        }
+
+        void Add(const uint256& hash, const CRawBlockMessageRef& msg)
+        {
+            if (mapEntries.count(hash) || msg->size() > nMaxSize)
+                return;
+
+            listEntries.push_front(std::make_pair(hash, msg));
+            mapEntries[hash] = listEntries.begin();
+            nSize += msg->size();
+
+            while (listEntries.size() > nMaxEntries || nSize > nMaxSize) {
+                nSize -= listEntries.back().second->size();
+                mapEntries.erase(listEntries.back().first);
+                listEntries.pop_back();
+            }
+        }
+    };
+
+    CRawBlockCache rawBlockCache(MAX_RAW_BLOCK_CACHE_ENTRIES, MAX_RAW_BLOCK_CACHE_SIZE);
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -707,6 +760,29 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman& connma
     connman.ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+// Requires cs_main.
+// Get the complete block message for pindex from the cache or from the raw
+// block files, returns NULL if the block can't be read that way.
+static CRawBlockMessageRef GetRawBlockMessage(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+
+    CRawBlockMessageRef msg = rawBlockCache.Get(pindex->GetBlockHash());
+    if (msg)
+        return msg;
+
+    std::shared_ptr<CDataStream> msgNew = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION);
+    *msgNew << CMessageHeader(Params().MessageStart(), NetMsgType::BLOCK, 0);
+
+    if (!ReadRawBlockFromDisk(*msgNew, pindex, Params().MessageStart()))
+        return CRawBlockMessageRef();
+
+    CConnman::EndMessage(*msgNew);
+    rawBlockCache.Add(pindex->GetBlockHash(), msgNew);
+
+    return msgNew;
+}
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams, CConnman& connman, std::atomic<bool>& interruptMsgProc)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
@@ -762,31 +838,39 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
+                    CRawBlockMessageRef rawBlockMsg;
                     if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, NetMsgType::BLOCK, block);
-                    else // MSG_FILTERED_BLOCK)
-                    {
-                        LOCK(pfrom->cs_filter);
-                        if (pfrom->pfilter)
+                        rawBlockMsg = GetRawBlockMessage((*mi).second);
+
+                    if (rawBlockMsg) {
+                        connman.PushMessage(pfrom, *rawBlockMsg, NetMsgType::BLOCK);
+                    } else {
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                        if (inv.type == MSG_BLOCK)
+                            connman.PushMessage(pfrom, NetMsgType::BLOCK, block);
+                        else // MSG_FILTERED_BLOCK)
                         {
-                            CMerkleBlock merkleBlock(block, *pfrom->pfilter);
-                            connman.PushMessage(pfrom, NetMsgType::MERKLEBLOCK, merkleBlock);
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
-                                connman.PushMessage(pfrom, NetMsgType::TX, block.vtx[pair.first]);
+                            LOCK(pfrom->cs_filter);
+                            if (pfrom->pfilter)
+                            {
+                                CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                                connman.PushMessage(pfrom, NetMsgType::MERKLEBLOCK, merkleBlock);
+                                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                                // This avoids hurting performance by pointlessly requiring a round-trip
+                                // Note that there is currently no way for a node to request any single transactions we didn't send here -
+                                // they must either disconnect and retry or request the full block.
+                                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                                // however we MUST always provide at least what the remote peer needs
+                                typedef std::pair<unsigned int, uint256> PairType;
+                                BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
+                                    connman.PushMessage(pfrom, NetMsgType::TX, block.vtx[pair.first]);
+                            }
+                            // else
+                                // no response
                         }
-                        // else
-                            // no response
                     }
 
                     // Trigger the peer node to send a getblocks request for the next batch of inventory
@@ -987,7 +1071,21 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
     }
 }
 
-bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived, CConnman& connman, std::atomic<bool>& interruptMsgProc)
+/** Hand a message which got deserialized by PrefetchMessageSignatures to its handler */
+static void ProcessPrefetchedMessage(CNode* pfrom, const std::string& strCommand, CPrefetchedMessage& prefetched, CConnman& connman)
+{
+    if (strCommand == NetMsgType::MNANNOUNCE) {
+        mnodeman.ProcessBroadcast(pfrom, static_cast<CPrefetchedMessageObject<CSmartnodeBroadcast>&>(prefetched).object, connman);
+    } else if (strCommand == NetMsgType::MNPING) {
+        mnodeman.ProcessPing(pfrom, static_cast<CPrefetchedMessageObject<CSmartnodePing>&>(prefetched).object, connman);
+    } else if (strCommand == NetMsgType::SMARTNODEPAYMENTVOTE) {
+        mnpayments.ProcessPaymentVote(pfrom, static_cast<CPrefetchedMessageObject<CSmartnodePaymentVote>&>(prefetched).object, connman);
+    } else if (strCommand == NetMsgType::TXLOCKVOTE) {
+        instantsend.ProcessTxLockVoteMessage(pfrom, static_cast<CPrefetchedMessageObject<CTxLockVote>&>(prefetched).object, connman);
+    }
+}
+
+bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived, CConnman& connman, std::atomic<bool>& interruptMsgProc, CPrefetchedMessage* pprefetched = NULL)
 {
     const CChainParams& chainparams = Params();
 
@@ -2118,7 +2216,11 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             }
         }
 
-        if (found)
+        if (found && pprefetched)
+        {
+            ProcessPrefetchedMessage(pfrom, strCommand, *pprefetched, connman);
+        }
+        else if (found)
         {
             mnodeman.ProcessMessage(pfrom, strCommand, vRecv, connman);
             mnpayments.ProcessMessage(pfrom, strCommand, vRecv, connman);
@@ -2139,6 +2241,122 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     return true;
 }
 
+static bool IsSignedSmartnodeMessage(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::MNANNOUNCE ||
+           strCommand == NetMsgType::MNPING ||
+           strCommand == NetMsgType::SMARTNODEPAYMENTVOTE ||
+           strCommand == NetMsgType::TXLOCKVOTE;
+}
+
+/**
+ * Deserialize the signed smartnode messages which got queued for pfrom since
+ * the last call and hand the signatures which still need a check over to the
+ * signature verifier threads as one batch. ProcessMessages holds a message
+ * back until its batch is verified and then passes the deserialized object to
+ * the handler, which finds the recovered signing key in the signature cache.
+ */
+static void PrefetchMessageSignatures(CNode* pfrom, const CChainParams& chainparams)
+{
+    std::vector<CNetMessage*> vecQueued;
+    std::vector<CNetMessage> vecMessages;
+
+    {
+        LOCK(pfrom->cs_vProcessMsg);
+
+        std::list<CNetMessage>::iterator it = pfrom->vProcessMsg.end();
+        for (size_t nNew = pfrom->vProcessMsg.size() - pfrom->nProcessMsgPrefetched; nNew > 0; --nNew) {
+            --it;
+        }
+
+        // messages of peers which didn't finish the handshake get rejected by ProcessMessage
+        for (; pfrom->fSuccessfullyConnected && it != pfrom->vProcessMsg.end(); ++it) {
+            if (it->complete() && IsSignedSmartnodeMessage(it->hdr.GetCommand())) {
+                vecQueued.push_back(&*it);
+                vecMessages.push_back(*it);
+            }
+        }
+
+        pfrom->nProcessMsgPrefetched = pfrom->vProcessMsg.size();
+    }
+
+    if (vecMessages.empty())
+        return;
+
+    std::vector<std::shared_ptr<CPrefetchedMessage> > vecPrefetched(vecMessages.size());
+    std::vector<std::shared_ptr<CPrefetchedMessage> > vecPending;
+    std::vector<CHashSignatureCheck> vecChecks;
+
+    for (size_t i = 0; i < vecMessages.size(); ++i) {
+        CNetMessage& msg = vecMessages[i];
+        std::string strCommand = msg.hdr.GetCommand();
+
+        // do the cheap checks of ProcessMessages first, it rejects broken messages later
+        if (memcmp(msg.hdr.pchMessageStart, chainparams.MessageStart(), MESSAGE_START_SIZE) != 0 ||
+            !msg.hdr.IsValid(chainparams.MessageStart()))
+            continue;
+
+        uint256 hash = HashKeccak(msg.vRecv.begin(), msg.vRecv.begin() + msg.hdr.nMessageSize);
+        if (memcmp(hash.begin(), msg.hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
+            continue;
+
+        msg.SetVersion(pfrom->GetRecvVersion());
+        size_t nChecks = vecChecks.size();
+
+        try {
+            std::shared_ptr<CPrefetchedMessage> prefetched;
+            if (strCommand == NetMsgType::MNANNOUNCE || strCommand == NetMsgType::MNPING) {
+                prefetched = mnodeman.PrefetchMessage(strCommand, msg.vRecv, vecChecks);
+            } else if (strCommand == NetMsgType::SMARTNODEPAYMENTVOTE) {
+                prefetched = mnpayments.PrefetchMessage(pfrom, strCommand, msg.vRecv, vecChecks);
+            } else if (strCommand == NetMsgType::TXLOCKVOTE) {
+                prefetched = instantsend.PrefetchMessage(pfrom, strCommand, msg.vRecv, vecChecks);
+            }
+            vecPrefetched[i] = prefetched;
+        } catch (const std::exception&) {
+            // malformed messages get rejected by ProcessMessage
+            vecChecks.resize(nChecks);
+            continue;
+        }
+
+        if (!vecPrefetched[i]) continue;
+
+        if (vecChecks.size() > nChecks) {
+            vecPending.push_back(vecPrefetched[i]);
+        } else {
+            vecPrefetched[i]->fVerified = true;
+        }
+    }
+
+    {
+        LOCK(pfrom->cs_vProcessMsg);
+        for (size_t i = 0; i < vecQueued.size(); ++i) {
+            vecQueued[i]->prefetched = vecPrefetched[i];
+        }
+    }
+
+    if (vecPending.empty())
+        return;
+
+    int nNodeId = pfrom->id;
+    bool fSubmitted = signatureVerifier.Submit(vecChecks, [nNodeId, vecPending](size_t nValid, size_t nTotal) {
+        for (const auto& prefetched : vecPending) {
+            prefetched->fVerified = true;
+        }
+        LogPrint("sigverify", "PrefetchMessageSignatures -- peer=%d verified %d of %d signatures\n", nNodeId, nValid, nTotal);
+        // the messages of this batch are ready for their handlers now
+        if (g_connman)
+            g_connman->WakeMessageHandler();
+    });
+
+    if (!fSubmitted) {
+        // no worker running or the queue is full, the handlers check the signatures themselves
+        for (const auto& prefetched : vecPending) {
+            prefetched->fVerified = true;
+        }
+    }
+}
+
 bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -2165,13 +2383,23 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
         if (pfrom->fPauseSend)
             return false;
 
+        if (!fLiteMode)
+            PrefetchMessageSignatures(pfrom, chainparams);
+
         std::list<CNetMessage> msgs;
         {
             LOCK(pfrom->cs_vProcessMsg);
             if (pfrom->vProcessMsg.empty())
                 return false;
+            // Keep the order of the messages, the signature verifier wakes us up once
+            // the signatures of the message in front are checked
+            const std::shared_ptr<CPrefetchedMessage>& prefetched = pfrom->vProcessMsg.front().prefetched;
+            if (prefetched && !prefetched->fVerified)
+                return false;
             // Just take one message
             msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
+            if (pfrom->nProcessMsgPrefetched > 0)
+                pfrom->nProcessMsgPrefetched--;
             pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
             pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman.GetReceiveFloodSize();
             fMoreWork = !pfrom->vProcessMsg.empty();
@@ -2214,7 +2442,7 @@ bool ProcessMessages(CNode* pfrom, CConnman& connman, std::atomic<bool>& interru
         bool fRet = false;
         try
         {
-            fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, connman, interruptMsgProc);
+            fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, connman, interruptMsgProc, msg.prefetched.get());
             if (interruptMsgProc)
                 return false;
             if (!pfrom->vRecvGetData.empty())
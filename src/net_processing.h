@@ -91,6 +91,10 @@ struct CNodeState {
  *  Timeout = base + per_header * (expected number of headers) */
 static constexpr int64_t HEADERS_DOWNLOAD_TIMEOUT_BASE = 15 * 60 * 1000000; // 15 minutes
 static constexpr int64_t HEADERS_DOWNLOAD_TIMEOUT_PER_HEADER = 1000; // 1ms/header
+/** Maximum number of serialized block messages kept for serving them to further peers */
+static const size_t MAX_RAW_BLOCK_CACHE_ENTRIES = 16;
+/** Maximum total size of the serialized block messages kept for serving them to further peers */
+static const size_t MAX_RAW_BLOCK_CACHE_SIZE = 32 * 1000 * 1000;
 
 /** Register with a network node to receive its signals */
 void RegisterNodeSignals(CNodeSignals& nodeSignals);
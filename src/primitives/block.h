@@ -24,6 +24,8 @@ class CBlockHeader
 public:
     // header
     static const int CURRENT_VERSION = 2;
+    // size of the serialized header
+    static const size_t HEADER_SIZE = 4 + 32 + 32 + 4 + 4 + 4;
 
     int nVersion;
     uint256 hashPrevBlock;
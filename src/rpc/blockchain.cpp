@@ -4,10 +4,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "blockimport.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
+#include "coinstats.h"
 #include "consensus/validation.h"
 #include "validation.h"
 #include "policy/policy.h"
@@ -569,108 +571,82 @@ UniValue getblock(const UniValue& params, bool fHelp)
     return blockToJSON(block, pblockindex);
 }
 
-struct CCoinsStats
-{
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint256 hashSerialized;
-    uint64_t nDiskSize;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nTotalAmount(0) {}
-};
-
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
-{
-    assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
-    stats.nTransactions++;
-    for (const auto output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << *(const CScriptBase*)(&output.second.out.scriptPubKey);
-        ss << VARINT(output.second.out.nValue);
-        stats.nTransactionOutputs++;
-        stats.nTotalAmount += output.second.out.nValue;
-    }
-    ss << VARINT(0);
-}
-
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
-{
-    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
-    }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
-        }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
-    }
-    stats.hashSerialized = ss.GetHash();
-    stats.nDiskSize = view->EstimateSize();
-    return true;
-}
-
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless hash_type is \"muhash\" and -coinstatsindex is enabled.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"   (string, optional, default=\"hash_serialized_2\") Which UTXO set hash should be calculated.\n"
+            "                   Options: \"hash_serialized_2\", \"muhash\", \"none\"\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, not available from -coinstatsindex\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)\n"
+            "  \"muhash\": \"hash\",      (string) The MuHash of the UTXO set (only present if 'muhash' hash_type is chosen)\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"coinstatsindex\": true|false   (boolean) Whether the result comes from -coinstatsindex\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\"")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    CoinStatsHashType hashType = COINSTATS_HASH_SERIALIZED;
+    if (params.size() > 0) {
+        std::string strHashType = params[0].get_str();
+        if (strHashType == "hash_serialized_2") {
+            hashType = COINSTATS_HASH_SERIALIZED;
+        } else if (strHashType == "muhash") {
+            hashType = COINSTATS_HASH_MUHASH;
+        } else if (strHashType == "none") {
+            hashType = COINSTATS_HASH_NONE;
+        } else {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", strHashType));
+        }
+    }
+
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview, stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+    if (hashType == COINSTATS_HASH_MUHASH && pcoinscommitment) {
+        CCoinsCommitment commitment;
+        {
+            LOCK(cs_main);
+            commitment = *pcoinscommitment;
+            BlockMap::const_iterator mi = mapBlockIndex.find(commitment.hashBlock);
+            if (mi != mapBlockIndex.end())
+                stats.nHeight = mi->second->nHeight;
+        }
+        commitment.GetStats(stats);
+        stats.nDiskSize = pcoinsdbview->EstimateSize();
+    } else {
+        FlushStateToDisk();
+        if (!GetUTXOStats(pcoinsdbview, stats, hashType))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    }
+
+    ret.push_back(Pair("height", (int64_t)stats.nHeight));
+    ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+    if (!stats.fFromCommitment)
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
-        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+    ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+    ret.push_back(Pair("bogosize", (int64_t)stats.nBogoSize));
+    if (hashType == COINSTATS_HASH_SERIALIZED)
         ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("disk_size", stats.nDiskSize));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
-    }
+    if (hashType == COINSTATS_HASH_MUHASH)
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
+    ret.push_back(Pair("disk_size", stats.nDiskSize));
+    ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    ret.push_back(Pair("coinstatsindex", stats.fFromCommitment));
     return ret;
 }
 
@@ -922,6 +898,40 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
     return obj;
 }
 
+UniValue getimportinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getimportinfo\n"
+            "Returns the progress and per stage throughput of the running or last -reindex block import.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"active\": xx,            (boolean) if the import is running\n"
+            "  \"elapsed_seconds\": x.x,  (numeric) time since the import started\n"
+            "  \"files\": xx,             (numeric) number of block files to import\n"
+            "  \"file\": xx,              (numeric) block file the reader is at\n"
+            "  \"decoders\": xx,          (numeric) number of decoder threads\n"
+            "  \"queue\": {               (object) blocks read but not connected yet\n"
+            "     \"blocks\": xx,\n"
+            "     \"bytes\": xx\n"
+            "  },\n"
+            "  \"read\": {                (object) reader stage\n"
+            "     \"blocks\": xx,         (numeric) blocks processed by the stage\n"
+            "     \"busy_seconds\": x.x,  (numeric) time the stage was busy, summed over its threads\n"
+            "     \"blocks_per_second\": x.x, (numeric) throughput of the stage\n"
+            "     \"bytes\": xx           (numeric) bytes read\n"
+            "  },\n"
+            "  \"decode\": { ... },       (object) decoder stage, same fields as \"read\" plus \"errors\" instead of \"bytes\"\n"
+            "  \"connect\": { ... }       (object) connector stage, same fields as \"read\" plus \"loaded\" (blocks added to the index) instead of \"bytes\"\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getimportinfo", "")
+            + HelpExampleRpc("getimportinfo", "")
+        );
+
+    return blockImportStats.ToJSON();
+}
+
 /** Comparison function for sorting the getchaintips heads.  */
 struct CompareBlocksByHeight
 {
@@ -10,6 +10,7 @@
 #include "consensus/consensus.h"
 #include "consensus/params.h"
 #include "consensus/validation.h"
+#include "crypto/keccak256.h"
 #include "core_io.h"
 #include "init.h"
 #include "validation.h"
@@ -106,6 +107,7 @@ UniValue getnetworkhashps(const UniValue& params, bool fHelp)
 UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript, const CSmartAddress &signingAddress)
 {
     static const int nInnerLoopCount = 0x10000;
+    static const size_t nBatchSize = 0x100;
     int nHeightStart = 0;
     int nHeightEnd = 0;
     int nHeight = 0;
@@ -128,9 +130,21 @@ UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nG
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(nHeight, pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
+        // Hash the nonces in batches, the header prefix only gets absorbed once
+        CKeccak256Header headerHasher((const unsigned char*)BEGIN(pblock->nVersion));
+        uint256 vHashes[nBatchSize];
+        bool fFound = false;
+        while (!fFound && nMaxTries > 0 && pblock->nNonce < nInnerLoopCount) {
+            size_t nCount = std::min<uint64_t>(nMaxTries, std::min<uint64_t>(nBatchSize, nInnerLoopCount - pblock->nNonce));
+            headerHasher.HashNonces(pblock->nNonce, nCount, (unsigned char*)vHashes);
+            for (size_t i = 0; i < nCount; ++i) {
+                if (CheckProofOfWork(nHeight, vHashes[i], pblock->nBits, Params().GetConsensus())) {
+                    fFound = true;
+                    break;
+                }
+                ++pblock->nNonce;
+                --nMaxTries;
+            }
         }
         if (nMaxTries == 0) {
             break;
@@ -320,12 +334,24 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
             "  \"chain\": \"xxxx\",           (string) current network name as defined in BIP70 (main, test, regtest)\n"
+            "  \"generate\": true|false     (boolean) If the internal miner is running\n"
+            "  \"genproclimit\": n          (numeric) The processor limit for generation. -1 if no generation. (see getgenerate or setgenerate calls)\n"
+            "  \"hashespersec\": n          (numeric) The hashes per second of the internal miner\n"
+            "  \"threadhashespersec\": [    (array) The hashes per second of each internal miner thread\n"
+            "     n,                       (numeric)\n"
+            "     ...\n"
+            "  ],\n"
+            "  \"blocksfound\": n           (numeric) The number of blocks found since the internal miner got started\n"
+            "  \"stopreason\": \"...\"        (string, optional) Why the internal miner stopped on its own\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmininginfo", "")
             + HelpExampleRpc("getmininginfo", "")
         );
 
+    // Not under cs_main, stopping the miner joins threads which might wait for it
+    CMinerStats minerStats;
+    bool fMining = GetMinerStats(minerStats);
 
     LOCK(cs_main);
 
@@ -339,6 +365,17 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
     obj.pushKV("chain",            Params().NetworkIDString());
     obj.pushKV("warnings",         GetWarnings("statusbar"));
+    obj.pushKV("generate",         fMining);
+    obj.pushKV("genproclimit",     fMining ? (int)minerStats.vThreadHashesPerSec.size() : -1);
+    obj.pushKV("hashespersec",     minerStats.dHashesPerSec);
+
+    UniValue threadHashesPerSec(UniValue::VARR);
+    for (double dHashesPerSec : minerStats.vThreadHashesPerSec)
+        threadHashesPerSec.push_back(dHashesPerSec);
+    obj.pushKV("threadhashespersec", threadHashesPerSec);
+    obj.pushKV("blocksfound",      minerStats.nBlocksFound);
+    if (!minerStats.strStopReason.empty())
+        obj.pushKV("stopreason",   minerStats.strStopReason);
 
     return obj;
 }
@@ -18,33 +18,52 @@
 
 int64_t GetKeyForBlock(const CBlockIndex * pIndex){
 
+    if( !pIndex ) return -1;
+
+    std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > vecIndex;
+
+    if( GetMiningSignatureIndex(pIndex->nHeight, pIndex->nHeight, vecIndex) && vecIndex.size() ){
+        return vecIndex[0].second.GetKey();
+    }
+
+    // Not indexed (yet), fall back to the coinbase of the block on disk.
     CBlock block;
-    if(pIndex && ReadBlockFromDisk(block, pIndex, Params().GetConsensus())){
+    if( ReadBlockFromDisk(block, pIndex, Params().GetConsensus()) ){
 
-        if( block.vtx.size() >= 1 ){
+        if( !block.vtx.size() ){
+            return -2;
+        }
 
-            if( block.vtx[0].vout.size() >= 2){
+        return SmartMining::GetSignatureIndexValue(block).GetKey();
+    }
 
-                // Second output of the coinbase needs to be the signature.
-                const CScript &sigScript = block.vtx[0].vout[1].scriptPubKey;
+    return -1;
+}
 
-                // Check if it is an OP_RETURN and if the startvalue is OP_DATA_MINING_FLAG
-                if( sigScript.size() > nMiningSignatureMinScriptLength &&
-                    sigScript[0] == OP_RETURN && sigScript[2] == OP_RETURN_MINING_FLAG ){
-                    return sigScript[3];
-                }
+// Keys used in the active chain from nStart to nStop, read sequentially from the mining signature index.
+std::map<int, int64_t> GetKeysForRange(int nStart, int nStop)
+{
+    std::map<int, int64_t> mapKeys;
+    std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > vecIndex;
 
-            }else{
-                return -3;
-            }
+    nStart = std::max(nStart, 0);
+    nStop = std::min(nStop, chainActive.Height());
 
-        }else{
-            return -2;
+    if( nStart > nStop ) return mapKeys;
+
+    if( GetMiningSignatureIndex(nStart, nStop, vecIndex) ){
+        for( auto &entry : vecIndex ){
+            mapKeys[entry.first.nHeight] = entry.second.GetKey();
         }
+    }
 
+    for( int nHeight = nStart; nHeight <= nStop; ++nHeight ){
+        if( !mapKeys.count(nHeight) ){
+            mapKeys[nHeight] = GetKeyForBlock(chainActive[nHeight]);
+        }
     }
 
-    return -1;
+    return mapKeys;
 }
 
 std::pair<int64_t,int64_t> GetBlockRange(const UniValue& params)
@@ -281,11 +300,13 @@ UniValue smartmining(const UniValue& params, bool fHelp)
 
             if( pLastIndex && range.first < range.second ){
 
+                std::map<int, int64_t> mapKeys = GetKeysForRange(range.first, range.second - 1);
+
                 while( pIndex && pIndex->nHeight != range.second ){
 
                     UniValue block(UniValue::VOBJ);
 
-                    int64_t nKey = GetKeyForBlock(pIndex);
+                    int64_t nKey = mapKeys[pIndex->nHeight];
                     block.pushKV("key", nKey);
                     block.pushKV("blocktime", pIndex->GetBlockTime() - pLastIndex->GetBlockTime());
                     obj.pushKV(std::to_string(pIndex->nHeight),block);
@@ -386,11 +407,8 @@ UniValue smartmining(const UniValue& params, bool fHelp)
             int64_t nCount = params[1].get_int64();
             int64_t nStartHeight = pIndex->nHeight - nCount + 1;
 
-            pIndex = chainActive[nStartHeight];
-
-            while( pIndex ){
-                mapUsage[GetKeyForBlock(pIndex)]++;
-                pIndex = chainActive.Next(pIndex);
+            for( auto &entry : GetKeysForRange(nStartHeight, pIndex->nHeight) ){
+                mapUsage[entry.second]++;
             }
 
             auto it = mapUsage.begin();
@@ -49,21 +49,15 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
     if( !fDebug && !prewards->IsSynced() )
         throw JSONRPCError(RPC_DATABASE_ERROR, strprintf("Rewards database is not up to date. Current progress %d%%",int(prewards->GetProgress() * 100)));
 
-    TRY_LOCK(cs_rewardsdb, lockRewardsDb);
-
-    if (!lockRewardsDb) {
-        throw JSONRPCError(RPC_DATABASE_ERROR, "Rewards database is busy..Try it again!");
-    }
+    // Read from the state of the last committed block, no need to wait for
+    // the block processing or the round finalization.
+    CSmartRewardsSnapshotRef snapshot = prewards->GetSnapshot();
 
     if (strCommand == "current")
     {
         UniValue obj(UniValue::VOBJ);
 
-        TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-        if(!roundsLocked) throw JSONRPCError(RPC_DATABASE_ERROR, "Rewards database is busy..Try it again!");
-
-        const CSmartRewardRound& current = prewards->GetCurrentRound();
+        const CSmartRewardRound& current = snapshot->currentRound;
 
         if( !current.number ) throw JSONRPCError(RPC_DATABASE_ERROR, "No active reward round available yet.");
 
@@ -86,11 +80,7 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
     {
         UniValue obj(UniValue::VARR);
 
-        TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-        if(!roundsLocked) throw JSONRPCError(RPC_DATABASE_ERROR, "Rewards database is busy..Try it again!");
-
-        const CSmartRewardRoundList& history = prewards->GetRewardRounds();
+        const CSmartRewardRoundList& history = snapshot->finishedRounds;
 
         int64_t nPayoutDelay = Params().GetConsensus().nRewardsPayoutStartDelay;
 
@@ -145,11 +135,7 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
 
     if(strCommand == "payouts")
     {
-        TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-        if(!roundsLocked) throw JSONRPCError(RPC_DATABASE_ERROR, "Rewards database is busy..Try it again!");
-
-        const CSmartRewardRound& current = prewards->GetCurrentRound();
+        const CSmartRewardRound& current = snapshot->currentRound;
 
         if( !current.number ) throw JSONRPCError(RPC_DATABASE_ERROR, "No active reward round available yet.");
 
@@ -174,7 +160,7 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
 
         CSmartRewardRoundResultList payouts;
 
-        if( !prewards->GetRewardPayouts(round,payouts) )
+        if( !snapshot->GetRewardPayouts(round, payouts) )
             throw JSONRPCError(RPC_DATABASE_ERROR, "Couldn't fetch the list from the database.");
 
         UniValue obj(UniValue::VARR);
@@ -193,11 +179,7 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
 
     if(strCommand == "snapshot")
     {
-        TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-        if(!roundsLocked) throw JSONRPCError(RPC_DATABASE_ERROR, "Rewards database is busy..Try it again!");
-
-        const CSmartRewardRound& current = prewards->GetCurrentRound();
+        const CSmartRewardRound& current = snapshot->currentRound;
 
         if( !current.number ) throw JSONRPCError(RPC_DATABASE_ERROR, "No active reward round available yet.");
 
@@ -222,7 +204,7 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
 
         CSmartRewardRoundResultList results;
 
-        if( !prewards->GetRewardRoundResults(round, results) )
+        if( !snapshot->GetRewardRoundResults(round, results) )
             throw JSONRPCError(RPC_DATABASE_ERROR, "Couldn't fetch the list from the database.");
 
         UniValue obj(UniValue::VARR);
@@ -243,11 +225,7 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
     {
         if (params.size() != 2) throw JSONRPCError(RPC_INVALID_PARAMETER, "SmartCash address required.");
 
-        TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-        if(!roundsLocked) throw JSONRPCError(RPC_DATABASE_ERROR, "Rewards database is busy..Try it again!");
-
-        const CSmartRewardRound& current = prewards->GetCurrentRound();
+        const CSmartRewardRound& current = snapshot->currentRound;
 
         int nFirst_1_3_Round = Params().GetConsensus().nRewardsFirst_1_3_Round;
 
@@ -258,7 +236,7 @@ UniValue smartrewards(const UniValue& params, bool fHelp)
 
         CSmartRewardEntry entry;
 
-        if( !prewards->GetRewardEntry(id, entry) ) throw JSONRPCError(RPC_DATABASE_ERROR, "Couldn't find this SmartCash address in the database.");
+        if( !snapshot->GetRewardEntry(id, entry) ) throw JSONRPCError(RPC_DATABASE_ERROR, "Couldn't find this SmartCash address in the database.");
 
         UniValue obj(UniValue::VOBJ);
 
@@ -156,23 +156,13 @@ static void sapi_request_cb(struct evhttp_request* req, void* arg)
 
     if( !fWhitelisted ){
 
-        SAPI::Limits::Client * client = SAPI::Limits::GetClient(peer);
-
-        client->Request();
+        int64_t nLockSeconds;
 
         // Check the rate limiting for this peer
-        if( client->IsRequestLimited() ){
+        if( SAPI::Limits::Request(peer, nLockSeconds) ){
             sapiStatistics.request(peer, CSAPIStatistics::Blocked);
             SAPI::Result error(SAPI::RequestRateLimitExceeded,
-                               strprintf("Cool down! Requests locked for %d seconds", client->GetRequestLockSeconds()));
-            SAPI::Error(hreq.get(), HTTPStatus::FORBIDDEN, error);
-            return;
-        }
-
-        if( client->IsRessourceLimited() ){
-            sapiStatistics.request(peer, CSAPIStatistics::Blocked);
-            SAPI::Result error(SAPI::RessourceRateLimitExceeded,
-                               strprintf("Cool down! Ressources locked for %d seconds", client->GetRessourceLockSeconds()));
+                               strprintf("Cool down! Requests locked for %d seconds", nLockSeconds));
             SAPI::Error(hreq.get(), HTTPStatus::FORBIDDEN, error);
             return;
         }
@@ -602,6 +592,8 @@ bool StartSAPI()
         &smartrewardsEndpoints,
     };
 
+    RegisterSAPIBlockCache();
+
     return true;
 }
 
@@ -612,7 +604,7 @@ void InterruptSAPI()
 
 void StopSAPI()
 {
-    // Nothing to do here yet.
+    UnregisterSAPIBlockCache();
 }
 
 static bool SAPIValidateBody(HTTPRequest *req, const SAPI::Endpoint *endpoint, UniValue &bodyParameter)
@@ -197,37 +197,19 @@ namespace Limits {
     const int64_t nRequestsPerInterval = 20;
     const int64_t nRequestIntervalMs = 5000;
     const int64_t nClientRemovalMs = 10 * 60 * 1000;
-
-    class Client{
-
-        CCriticalSection cs;
-
-        double nRemainingRequests;
-        int64_t nLastRequestTime;
-
-        int64_t nThrottling;
-        int64_t nRequestsLimitUnlock;
-        int64_t nRessourcesLimitUnlock;
-
-    public:
-
-        Client() {
-            nRemainingRequests = nRequestsPerInterval;
-            nLastRequestTime = 0;
-            nThrottling = -1;
-            nRequestsLimitUnlock = -1;
-            nRessourcesLimitUnlock = -1;
-        }
-        void Request();
-        bool IsRequestLimited();
-        bool IsRessourceLimited();
-        bool IsLimited();
-        int64_t GetRequestLockSeconds();
-        int64_t GetRessourceLockSeconds();
-        bool CheckAndRemove();
-    };
-
-    Client *GetClient( const CService &peer );
+    //! Min. time between two sweeps for idle clients
+    const int64_t nClientSweepIntervalMs = 60 * 1000;
+    //! Number of shards of the client table
+    const size_t nClientShards = 64;
+    //! Number of client slots of each shard
+    const size_t nClientShardSlots = 1024;
+    //! Number of slots of each of the two windows probed to find or place a client in its shard
+    const size_t nClientProbeLength = 16;
+
+    /** Count a request of the peer. Returns true if it is rate limited,
+        nLockSeconds is set to the remaining lock time then. */
+    bool Request(const CNetAddr &peer, int64_t &nLockSeconds);
+    /** Free the slots of idle clients, does nothing if called within the same sweep interval. */
     void CheckAndRemove();
 }
 
@@ -292,8 +274,6 @@ void WriteReply(HTTPRequest *req, const std::string &str);
 
 bool CheckWarmup(HTTPRequest* req);
 
-SAPI::Limits::Client *GetClientLimiter(const CService &peer);
-
 int64_t GetStartTime();
 
 }
@@ -29,18 +29,6 @@ struct CAddressBalance
 };
 
 
-bool amountSortLTH(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
-                std::pair<CAddressUnspentKey, CAddressUnspentValue> b)
-{
-    return a.second.satoshis < b.second.satoshis;
-}
-
-bool amountSortHTL(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
-                std::pair<CAddressUnspentKey, CAddressUnspentValue> b)
-{
-    return a.second.satoshis > b.second.satoshis;
-}
-
 bool spendingSort(std::pair<CAddressIndexKey, CAmount> a,
                 std::pair<CAddressIndexKey, CAmount> b) {
     return a.first.spending != b.first.spending;
@@ -121,26 +109,19 @@ static bool GetAddressesBalances(HTTPRequest* req,
             continue;
         }
 
-        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        CAddressBalanceValue addressBalance;
 
-        if (!GetAddressIndex(hashBytes, type, addressIndex)) {
+        if (!GetAddressBalance(hashBytes, type, addressBalance)) {
             code = SAPI::AddressNotFound;
             std::string message = "No information available for " + addrStr;
             errors.push_back(SAPI::Result(code, message));
             continue;
         }
 
-        CAmount balance = 0;
-        CAmount received = 0;
+        CAmount balance = addressBalance.balance;
+        CAmount received = addressBalance.received;
         CAmount unconfirmed = 0;
 
-        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-            if (it->second > 0) {
-                received += it->second;
-            }
-            balance += it->second;
-        }
-
         std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > mempoolDelta;
         std::vector<std::pair<uint160,int>> vecAddresses = {std::make_pair(hashBytes,type)};
         if (mempool.getAddressIndex(vecAddresses, mempoolDelta)) {
@@ -495,14 +476,84 @@ static bool address_utxos(HTTPRequest* req, const std::map<std::string, std::str
     return true;
 }
 
+//! Maximum number of inputs of a solution of /address/unspent/amount
+static const int nUtxoAmountMaxInputs = 500;
+//! Number of amount index entries read at once while searching a solution
+static const int nUtxoAmountBatchSize = 256;
+//! Maximum number of amount index entries visited by a single search
+static const int nUtxoAmountMaxScan = 20000;
+
+/** Walks the unspent outputs of an address sorted by amount, bounded by nUtxoAmountMaxScan */
+class CAddressAmountCursor
+{
+    uint160 hashBytes;
+    int type;
+    bool fReverse;
+    int &nScanned;
+    CAddressAmountKey start;
+    std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > vecBatch;
+    size_t nPos;
+    bool fEnd;
+
+public:
+    bool fFailed;
+
+    CAddressAmountCursor(const uint160 &hashBytes, int type, CAmount nAmount, bool fReverse, int &nScanned) :
+        hashBytes(hashBytes), type(type), fReverse(fReverse), nScanned(nScanned), nPos(0), fEnd(false), fFailed(false)
+    {
+        if( fReverse )
+            start = CAddressAmountKey(type, hashBytes, nAmount, uint256S(std::string(64, 'f')), std::numeric_limits<uint32_t>::max());
+        else
+            start = CAddressAmountKey(type, hashBytes, nAmount, uint256(), 0);
+    }
+
+    /** Returns true if all outputs in the walked direction have been visited */
+    bool Exhausted() const { return fEnd && nPos == vecBatch.size(); }
+
+    bool Next(std::pair<CAddressAmountKey, CAddressAmountValue> &entry)
+    {
+        if( nPos == vecBatch.size() ){
+
+            if( fEnd || fFailed || nScanned >= nUtxoAmountMaxScan )
+                return false;
+
+            vecBatch.clear();
+            nPos = 0;
+
+            // Read one more entry than needed to know where to continue
+            if( !GetAddressAmounts(hashBytes, type, vecBatch, start, nUtxoAmountBatchSize + 1, fReverse) ){
+                fFailed = true;
+                return false;
+            }
+
+            if( vecBatch.size() > static_cast<size_t>(nUtxoAmountBatchSize) ){
+                start = vecBatch.back().first;
+                vecBatch.pop_back();
+            }else{
+                fEnd = true;
+            }
+
+            if( vecBatch.empty() )
+                return false;
+        }
+
+        ++nScanned;
+        entry = vecBatch[nPos++];
+        return true;
+    }
+};
+
+static std::pair<CAddressUnspentKey, CAddressUnspentValue> AmountEntryToUnspent(const std::pair<CAddressAmountKey, CAddressAmountValue> &entry)
+{
+    const CAddressAmountKey &key = entry.first;
+    return std::make_pair(CAddressUnspentKey(key.type, key.hashBytes, key.txhash, key.index, entry.second.nBlockHeight),
+                          CAddressUnspentValue(key.nAmount, CScript(), entry.second.nBlockHeight));
+}
+
 static bool address_utxos_amount(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter)
 {
     int64_t nTime0, nTime1, nTime2, nTime3, nTime4;
 
-    // matching algorithm parameters
-    const int nUtxosSlice = 2000;
-    const int nMatchTimeoutMicros = 5 * 1000000;
-
     nTime0 = GetTimeMicros();
 
     std::string addrStr = bodyParameter[SAPI::Keys::address].get_str();
@@ -513,7 +564,8 @@ static bool address_utxos_amount(HTTPRequest* req, const std::map<std::string, s
     CBitcoinAddress address(addrStr);
     CAddressUnspentKey lastIndex;
     int nUtxoCount = 0;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    uint160 hashBytes;
+    int type = 0;
 
     if( !GetUTXOCount(req, address, nUtxoCount, lastIndex ) ){
         return false;
@@ -522,93 +574,131 @@ static bool address_utxos_amount(HTTPRequest* req, const std::map<std::string, s
     if (!nUtxoCount)
         return SAPI::Error(req, SAPI::NoUtxosAvailble, "No unspent outputs available");
 
-    nTime1 = GetTimeMicros();
+    address.GetIndexKey(hashBytes, type);
 
-    bool fTimedOut = false;
-    int nPages = nUtxoCount / nUtxosSlice;
-    if( nUtxoCount % nUtxosSlice ) nPages++;
-    int nPageStart = GetRand(nPages);
-    int nPageCurrent = nPageStart;
+    nTime1 = GetTimeMicros();
 
     int64_t nHeight = chainActive.Height();
+    int nScanned = 0;
+    bool fExhausted = false;
 
-    CUnspentSolution currentSolution, bestSolution;
-
-    do{
+    // Ignore inputs currently used for tx in the mempool
+    // Ignore inputs that are not valid for instantpay if instantpay is requested
+    auto isSpendable = [&](const std::pair<CAddressAmountKey, CAddressAmountValue> &entry) -> bool {
+        CSpentIndexValue spentInfo;
+        CSpentIndexKey spentKey(entry.first.txhash, static_cast<unsigned int>(entry.first.index));
+        return !mempool.getSpentIndex(spentKey, spentInfo) &&
+               ( !fInstantPay || (nHeight - entry.second.nBlockHeight + 1) >= INSTANTSEND_CONFIRMATIONS_REQUIRED );
+    };
 
-        int nIndexOffset = static_cast<int>( (nPageCurrent % nPages) * nUtxosSlice);
-        int nLimit = static_cast<int>( (nUtxoCount % nUtxosSlice) &&
-                                       (nPageCurrent % nPages) == nPages - 1 ? (nUtxoCount % nUtxosSlice) :
-                                                                    nUtxosSlice);
+    std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > vecSelected;
+    CAmount nSelected = 0;
 
-        if( !fRandom && GetTimeMicros() - nTime0 > nMatchTimeoutMicros )
-            break;
+    // Select spendable outputs from the cursor until the amount is covered, stop at outputs of nStop or more.
+    auto selectOutputs = [&](CAddressAmountCursor &cursor, CAmount nStop) {
+        std::pair<CAddressAmountKey, CAddressAmountValue> entry;
 
-        if( !GetUTXOs(req, address, unspentOutputs, CAddressUnspentKey(), nIndexOffset , nLimit) )
-            return false;
+        while( static_cast<int>(vecSelected.size()) < nUtxoAmountMaxInputs &&
+               nSelected < expectedAmount + CalculateFee(static_cast<int>(vecSelected.size())) &&
+               cursor.Next(entry) && entry.first.nAmount < nStop ){
 
-        if( fRandom ){ // Pick random utxos until the amount is reached.
-            std::random_shuffle(unspentOutputs.begin(), unspentOutputs.end());
-        }else{ // Search a solution with fewest utxo's
-            std::sort(unspentOutputs.begin(), unspentOutputs.end(), amountSortHTL);
+            if( isSpendable(entry) ){
+                vecSelected.push_back(entry);
+                nSelected += entry.first.nAmount;
+            }
         }
+    };
 
-        for (auto it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
+    if( fRandom ){
+        // Collect outputs upwards from a random amount between the smallest and the largest output,
+        // wrap around to the smallest output if the ones above the pivot don't cover the amount.
+        std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > vecFirst, vecLast;
 
-            if( GetTimeMicros() - nTime0 > nMatchTimeoutMicros ){
-                fTimedOut = true;
-                break;
-            }
+        if( !GetAddressAmounts(hashBytes, type, vecFirst, CAddressAmountKey(), 1, false) ||
+            !GetAddressAmounts(hashBytes, type, vecLast, CAddressAmountKey(), 1, true) )
+            return SAPI::Error(req, SAPI::AddressNotFound, "No information available for address");
 
-            CSpentIndexValue spentInfo;
-            CSpentIndexKey spentKey(it->first.txhash, static_cast<unsigned int>(it->first.index));
+        if( !vecFirst.empty() && !vecLast.empty() ){
 
-            // Ignore inputs currently used for tx in the mempool
-            // Ignore inputs that are not valid for instantpay if instantpay is requested
-            if (!mempool.getSpentIndex(spentKey, spentInfo) &&
-               ( ( !fInstantPay || ( fInstantPay && (nHeight - it->first.nBlockHeight + 1) >= INSTANTSEND_CONFIRMATIONS_REQUIRED ) ) )){
+            CAmount nMin = vecFirst.front().first.nAmount;
+            CAmount nPivot = nMin + static_cast<CAmount>(GetRand(vecLast.front().first.nAmount - nMin + 1));
+            CAddressAmountCursor upper(hashBytes, type, nPivot, false, nScanned);
 
-                currentSolution.AddUtxo(*it);
+            selectOutputs(upper, std::numeric_limits<CAmount>::max());
+
+            if( upper.Exhausted() ){
+                CAddressAmountCursor lower(hashBytes, type, 0, false, nScanned);
+                selectOutputs(lower, nPivot);
             }
+        }
+
+        // Fall back to the fewest inputs search if the random range was not sufficient.
+        if( nSelected < expectedAmount + CalculateFee(static_cast<int>(vecSelected.size())) ){
+            vecSelected.clear();
+            nSelected = 0;
+            fRandom = false;
+        }
+    }
 
-            if( currentSolution.amount >= expectedAmount + currentSolution.fee ){
+    if( !fRandom ){
+        // The largest outputs give the fewest inputs.
+        CAddressAmountCursor cursor(hashBytes, type, std::numeric_limits<CAmount>::max(), true, nScanned);
+        std::pair<CAddressAmountKey, CAddressAmountValue> entry;
 
-                if( currentSolution.amount == expectedAmount + currentSolution.fee ){
-                     currentSolution.change = 0;
-                }else{
-                    currentSolution.change = currentSolution.amount - expectedAmount - currentSolution.fee;
-                }
+        selectOutputs(cursor, std::numeric_limits<CAmount>::max());
 
-                if( bestSolution.IsNull() ||
-                    ( !fRandom && currentSolution.vecUtxos.size() < bestSolution.vecUtxos.size() ) ){ // Looking for fewest inputs
+        fExhausted = cursor.Exhausted();
 
-                    bestSolution = currentSolution;
-                    currentSolution.SetNull();
-                }
+        if( cursor.fFailed )
+            return SAPI::Error(req, SAPI::AddressNotFound, "No information available for address");
 
-                break;
+        int nInputs = static_cast<int>(vecSelected.size());
+
+        if( nInputs && nSelected >= expectedAmount + CalculateFee(nInputs) ){
+            // Replace the last input with the smallest output which still covers the rest to reduce the change.
+            std::pair<CAddressAmountKey, CAddressAmountValue> last = vecSelected.back();
+            CAmount nMissing = expectedAmount + CalculateFee(nInputs) - (nSelected - last.first.nAmount);
+            CAddressAmountCursor smallest(hashBytes, type, nMissing, false, nScanned);
+
+            vecSelected.pop_back();
+            nSelected -= last.first.nAmount;
+
+            while( smallest.Next(entry) && entry.first.nAmount < last.first.nAmount ){
+
+                bool fSelected = std::find_if(vecSelected.begin(), vecSelected.end(),
+                                              [&entry](const std::pair<CAddressAmountKey, CAddressAmountValue> &selected) -> bool {
+                    return selected.first.txhash == entry.first.txhash && selected.first.index == entry.first.index;
+                }) != vecSelected.end();
+
+                if( !fSelected && isSpendable(entry) ){
+                    last = entry;
+                    break;
+                }
             }
+
+            vecSelected.push_back(last);
+            nSelected += last.first.nAmount;
         }
+    }
 
-        if(!bestSolution.IsNull() && fRandom )
-            break;
+    nTime2 = GetTimeMicros();
 
-        if( GetTimeMicros() - nTime0 > nMatchTimeoutMicros ){
-            fTimedOut = true;
-            break;
-        }
+    CUnspentSolution bestSolution;
 
-    }while( (++nPageCurrent % nPages) != nPageStart);
+    for( auto &entry : vecSelected )
+        bestSolution.AddUtxo(AmountEntryToUnspent(entry));
 
-    nTime2 = GetTimeMicros();
+    if( bestSolution.IsNull() || bestSolution.amount < expectedAmount + bestSolution.fee ){
 
-    // If we iterated over all utxos and we did not find a solution.
-    if( (++nPageCurrent % nPages) == nPageStart && bestSolution.IsNull() && !fTimedOut )
-        return SAPI::Error(req, SAPI::BalanceInsufficient, "Requested amount exceeds balance");
+        // If we iterated over all utxos and we did not find a solution.
+        if( fExhausted )
+            return SAPI::Error(req, SAPI::BalanceInsufficient, "Requested amount exceeds balance");
 
-    // We found no solution, but there still might be one..
-    if( bestSolution.IsNull() )
+        // We found no solution within the search limits, but there still might be one..
         return SAPI::Error(req, SAPI::TimedOut, "No solution found");
+    }
+
+    bestSolution.change = bestSolution.amount - expectedAmount - bestSolution.fee;
 
     nTime3 = GetTimeMicros();
 
@@ -644,10 +734,11 @@ static bool address_utxos_amount(HTTPRequest* req, const std::map<std::string, s
     nTime4 = GetTimeMicros();
 
     LogPrint("sapi-benchmark", "\naddress_utxos_amount\n");
-    LogPrint("sapi-benchmark", " Query utxos: %.2fms\n", (nTime2 - nTime1) * 0.001);
-    LogPrint("sapi-benchmark", " Evaluate inputs: %.2fms\n", (nTime2 - nTime3) * 0.001);
-    LogPrint("sapi-benchmark", " Write reply: %.2fms\n", (nTime3 - nTime4) * 0.001);
-    LogPrint("sapi-benchmark", " Total: %.2fms\n\n", (nTime3 - nTime0) * 0.001);
+    LogPrint("sapi-benchmark", " Query utxo count: %.2fms\n", (nTime1 - nTime0) * 0.001);
+    LogPrint("sapi-benchmark", " Select inputs (%d entries visited): %.2fms\n", nScanned, (nTime2 - nTime1) * 0.001);
+    LogPrint("sapi-benchmark", " Evaluate inputs: %.2fms\n", (nTime3 - nTime2) * 0.001);
+    LogPrint("sapi-benchmark", " Write reply: %.2fms\n", (nTime4 - nTime3) * 0.001);
+    LogPrint("sapi-benchmark", " Total: %.2fms\n\n", (nTime4 - nTime0) * 0.001);
 
     return true;
 }
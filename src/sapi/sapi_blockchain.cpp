@@ -8,6 +8,11 @@
 #include "smartnode/instantx.h"
 #include "validation.h"
 #include "checkpoints.h"
+#include "validationinterface.h"
+
+#include <limits>
+#include <list>
+#include <memory>
 
 
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
@@ -34,6 +39,298 @@ SAPI::EndpointGroup blockchainEndpoints = {
     }
 };
 
+//! Max. estimated memory usage of the rendered blocks and transactions kept by the block endpoints
+static const size_t nBlockRenderCacheBytes = 32 * 1024 * 1024;
+
+/** Key of a rendered block (nTx = -1) or of one of its transactions */
+struct CBlockRenderKey
+{
+    uint256 hash;
+    int64_t nTx;
+
+    CBlockRenderKey(const uint256 &hash, int64_t nTx = -1) : hash(hash), nTx(nTx) {}
+
+    friend bool operator<(const CBlockRenderKey &a, const CBlockRenderKey &b)
+    {
+        if( a.hash != b.hash ) return a.hash < b.hash;
+        return a.nTx < b.nTx;
+    }
+};
+
+typedef std::shared_ptr<const UniValue> UniValuePtr;
+
+/** Rough estimation of the memory used by a rendered value */
+static size_t EstimateRenderSize(const UniValue &value)
+{
+    size_t nSize = sizeof(UniValue) + value.getValStr().size();
+
+    std::vector<std::string> vecKeys = value.getKeys();
+
+    for( size_t i = 0; i < vecKeys.size(); ++i )
+        nSize += sizeof(std::string) + vecKeys[i].size();
+
+    for( size_t i = 0; i < value.size(); ++i )
+        nSize += EstimateRenderSize(value[static_cast<unsigned int>(i)]);
+
+    return nSize;
+}
+
+/**
+ * LRU of the chain independent parts of rendered blocks and transactions,
+ * bounded by their estimated size. Transactions are cached one by one and
+ * the pages get assembled per request, so the client chosen page sizes
+ * don't multiply the cached data. Everything that depends on the active
+ * chain (confirmations, next block, transaction heights) is added per
+ * request, entries of disconnected blocks get dropped by
+ * CBlockRenderCacheInterface.
+ */
+class CBlockRenderCache
+{
+    struct CItem
+    {
+        CBlockRenderKey key;
+        UniValuePtr value;
+        size_t nSize;
+
+        CItem(const CBlockRenderKey &key, const UniValuePtr &value, size_t nSize) : key(key), value(value), nSize(nSize) {}
+    };
+
+    typedef std::list<CItem> list_t;
+
+    CCriticalSection cs;
+    size_t nMaxBytes;
+    size_t nBytes;
+    list_t listItems;
+    std::map<CBlockRenderKey, list_t::iterator> mapIndex;
+
+    void EraseItem(std::map<CBlockRenderKey, list_t::iterator>::iterator it)
+    {
+        nBytes -= it->second->nSize;
+        listItems.erase(it->second);
+        mapIndex.erase(it);
+    }
+
+public:
+    CBlockRenderCache(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn), nBytes(0) {}
+
+    UniValuePtr Get(const CBlockRenderKey &key)
+    {
+        LOCK(cs);
+        auto it = mapIndex.find(key);
+        if( it == mapIndex.end() )
+            return UniValuePtr();
+        listItems.splice(listItems.begin(), listItems, it->second);
+        return it->second->value;
+    }
+
+    void Insert(const CBlockRenderKey &key, const UniValuePtr &value)
+    {
+        size_t nSize = EstimateRenderSize(*value);
+
+        LOCK(cs);
+        if( mapIndex.count(key) || nSize > nMaxBytes )
+            return;
+        listItems.emplace_front(key, value, nSize);
+        mapIndex.emplace(key, listItems.begin());
+        nBytes += nSize;
+        while( nBytes > nMaxBytes )
+            EraseItem(mapIndex.find(listItems.back().key));
+    }
+
+    void EraseBlock(const uint256 &hash)
+    {
+        LOCK(cs);
+        auto it = mapIndex.lower_bound(CBlockRenderKey(hash, std::numeric_limits<int64_t>::min()));
+        while( it != mapIndex.end() && it->first.hash == hash )
+            EraseItem(it++);
+    }
+
+    void Clear()
+    {
+        LOCK(cs);
+        listItems.clear();
+        mapIndex.clear();
+        nBytes = 0;
+    }
+};
+
+static CBlockRenderCache blockRenderCache(nBlockRenderCacheBytes);
+
+class CBlockRenderCacheInterface : public CValidationInterface
+{
+    CCriticalSection cs;
+    const CBlockIndex *pindexLastTip;
+
+public:
+    CBlockRenderCacheInterface(const CBlockIndex *pindexTip) : pindexLastTip(pindexTip) {}
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override
+    {
+        LOCK(cs);
+        // Blocks between the previous tip and the fork point left the active chain.
+        const CBlockIndex *pindex = pindexLastTip;
+        while( pindex && ( !pindexFork || pindex->nHeight > pindexFork->nHeight ) ){
+            blockRenderCache.EraseBlock(pindex->GetBlockHash());
+            pindex = pindex->pprev;
+        }
+        pindexLastTip = pindexNew;
+    }
+};
+
+static std::unique_ptr<CBlockRenderCacheInterface> pBlockRenderCacheInterface;
+
+/** Chain dependent state of a block, captured under cs_main */
+struct CBlockChainState
+{
+    const CBlockIndex *pindex;
+    CDiskBlockPos pos;
+    int nConfirmations;
+    uint256 hashNext;
+};
+
+static void GetBlockChainState(const CBlockIndex *pindex, CBlockChainState &state)
+{
+    AssertLockHeld(cs_main);
+
+    state.pindex = pindex;
+    state.pos = pindex->GetBlockPos();
+    state.nConfirmations = -1;
+    // Only report confirmations if the block is on the main chain
+    if (chainActive.Contains(pindex))
+        state.nConfirmations = chainActive.Height() - pindex->nHeight + 1;
+    CBlockIndex *pnext = chainActive.Next(pindex);
+    state.hashNext = pnext ? pnext->GetBlockHash() : uint256();
+}
+
+/** Read the block of a captured state from disk, must be called without cs_main */
+static bool ReadBlockFromState(CBlock &block, const CBlockChainState &state)
+{
+    if( !ReadBlockFromDisk(block, state.pos, Params().GetConsensus()) )
+        return false;
+
+    return block.GetHash() == state.pindex->GetBlockHash();
+}
+
+/** Push the chain independent header fields which precede the transactions */
+static void BlockHeaderToJSON(const CBlock &block, const CBlockIndex *pindex, UniValue &result)
+{
+    result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
+    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
+    result.push_back(Pair("weight", (int)::GetBlockWeight(block)));
+    result.push_back(Pair("height", pindex->nHeight));
+    result.push_back(Pair("version", block.nVersion));
+    result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
+    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+}
+
+/** Push the chain independent header fields which follow the transactions */
+static void BlockTrailerToJSON(const CBlock &block, const CBlockIndex *pindex, UniValue &result)
+{
+    result.push_back(Pair("time", block.GetBlockTime()));
+    result.push_back(Pair("mediantime", (int64_t)pindex->GetMedianTimePast()));
+    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
+    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    result.push_back(Pair("difficulty", GetDifficulty(pindex)));
+    result.push_back(Pair("chainwork", pindex->nChainWork.GetHex()));
+
+    if (pindex->pprev)
+        result.push_back(Pair("previousblockhash", pindex->pprev->GetBlockHash().GetHex()));
+}
+
+/** Render the chain independent fields of a block with the list of its transaction ids */
+static UniValuePtr RenderBlock(const CBlock &block, const CBlockIndex *pindex)
+{
+    UniValue obj(UniValue::VOBJ);
+    BlockHeaderToJSON(block, pindex, obj);
+    UniValue txs(UniValue::VARR);
+    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+        txs.push_back(tx.GetHash().GetHex());
+    obj.push_back(Pair("tx", txs));
+    BlockTrailerToJSON(block, pindex, obj);
+
+    return std::make_shared<const UniValue>(obj);
+}
+
+/** Render the chain independent fields of a transaction, returns an empty pointer if an input is not available. Must be called without cs_main */
+static UniValuePtr RenderTransaction(const CTransaction &tx, const uint256 &hashBlock)
+{
+    string strHex = EncodeHexTx(tx, SERIALIZE_TRANSACTION_NO_WITNESS);
+
+    UniValue txObj(UniValue::VOBJ);
+    txObj.pushKV("hex", strHex);
+
+    uint256 txid = tx.GetHash();
+    txObj.pushKV("txid", txid.GetHex());
+    txObj.pushKV("size", (int)::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    txObj.pushKV("version", tx.nVersion);
+    txObj.pushKV("locktime", (int64_t)tx.nLockTime);
+    UniValue vin(UniValue::VARR);
+    BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+
+        UniValue in(UniValue::VOBJ);
+        if (tx.IsCoinBase())
+            in.pushKV("coinbase", HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+        else {
+
+            // The inputs of a block's transactions are confirmed, read them through the
+            // transaction index.
+            CTransaction txInput;
+            uint256 hashBlockIn;
+            if (!ReadTransactionFromDisk(txin.prevout.hash, txInput, hashBlockIn))
+                return UniValuePtr();
+
+            const CTxOut& txout = txInput.vout[txin.prevout.n];
+
+            in.pushKV("txid", txin.prevout.hash.GetHex());
+            in.pushKV("value", ValueFromAmount(txout.nValue));
+            in.pushKV("n", (int64_t)txin.prevout.n);
+            UniValue o(UniValue::VOBJ);
+            ScriptPubKeyToJSON(txout.scriptPubKey, o, true);
+            in.pushKV("scriptPubKey", o);
+        }
+
+        in.pushKV("sequence", (int64_t)txin.nSequence);
+        vin.push_back(in);
+    }
+    txObj.pushKV("vin", vin);
+    UniValue vout(UniValue::VARR);
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        const CTxOut& txout = tx.vout[i];
+        UniValue out(UniValue::VOBJ);
+        out.pushKV("value", ValueFromAmount(txout.nValue));
+        out.pushKV("n", (int64_t)i);
+        UniValue o(UniValue::VOBJ);
+        ScriptPubKeyToJSON(txout.scriptPubKey, o, true);
+        out.pushKV("scriptPubKey", o);
+        vout.push_back(out);
+    }
+    txObj.pushKV("vout", vout);
+    txObj.pushKV("blockhash", hashBlock.GetHex());
+
+    return std::make_shared<const UniValue>(txObj);
+}
+
+void RegisterSAPIBlockCache()
+{
+    if( pBlockRenderCacheInterface )
+        return;
+
+    LOCK(cs_main);
+    pBlockRenderCacheInterface.reset(new CBlockRenderCacheInterface(chainActive.Tip()));
+    RegisterValidationInterface(pBlockRenderCacheInterface.get());
+}
+
+void UnregisterSAPIBlockCache()
+{
+    if( !pBlockRenderCacheInterface )
+        return;
+
+    UnregisterValidationInterface(pBlockRenderCacheInterface.get());
+    pBlockRenderCacheInterface.reset();
+    blockRenderCache.Clear();
+}
+
 static bool blockchain_info(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter)
 {
     UniValue obj(UniValue::VOBJ);
@@ -66,6 +363,7 @@ static bool blockchain_height(HTTPRequest* req, const std::map<std::string, std:
     return true;
 }
 
+
 static bool blockchain_block(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter)
 {
     if ( !mapPathParams.count("blockinfo") )
@@ -73,69 +371,61 @@ static bool blockchain_block(HTTPRequest* req, const std::map<std::string, std::
 
     std::string blockInfoStr = mapPathParams.at("blockinfo");
     uint256 hash;
+    CBlockChainState state;
 
-    LOCK(cs_main);
+    {
+        LOCK(cs_main);
+
+        if( IsInteger(blockInfoStr) ){
+
+            int64_t nHeight;
+
+            if( !ParseInt64(blockInfoStr, &nHeight) )
+                return SAPI::Error(req, SAPI::UIntOverflow, "Integer overflow.");
+
+            if ( nHeight < 0 ||  nHeight > chainActive.Height() )
+                return SAPI::Error(req, SAPI::BlockHeightOutOfRange, "Block height out of range");
+
+            CBlockIndex* pblockindex = chainActive[nHeight];
+            hash = pblockindex->GetBlockHash();
+        }else if( !ParseHashStr(blockInfoStr, hash) ){
+            return SAPI::Error(req, SAPI::BlockNotSpecified, "No valid height or hash specified. Use /blockchain/block/<height or hash>");
+        }
 
-    if( IsInteger(blockInfoStr) ){
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
 
-        int64_t nHeight;
+        if (mi == mapBlockIndex.end())
+            return SAPI::Error(req, SAPI::BlockNotFound, "Block not found");
 
-        if( !ParseInt64(blockInfoStr, &nHeight) )
-            return SAPI::Error(req, SAPI::UIntOverflow, "Integer overflow.");
+        CBlockIndex* blockindex = mi->second;
 
-        if ( nHeight < 0 ||  nHeight > chainActive.Height() )
-            return SAPI::Error(req, SAPI::BlockHeightOutOfRange, "Block height out of range");
+        if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
+            return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data)");
 
-        CBlockIndex* pblockindex = chainActive[nHeight];
-        hash = pblockindex->GetBlockHash();
-    }else if( !ParseHashStr(blockInfoStr, hash) ){
-        return SAPI::Error(req, SAPI::BlockNotSpecified, "No valid height or hash specified. Use /blockchain/block/<height or hash>");
+        GetBlockChainState(blockindex, state);
     }
 
-    if (mapBlockIndex.count(hash) == 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not found");
+    CBlockRenderKey key(hash);
+    UniValuePtr rendered = blockRenderCache.Get(key);
 
-    CBlock block;
-    CBlockIndex* blockindex = mapBlockIndex[hash];
+    if( !rendered ){
 
-    if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data)");
+        CBlock block;
 
-    if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk");
+        if( !ReadBlockFromState(block, state) )
+            return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk");
 
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
-    BOOST_FOREACH(const CTransaction&tx, block.vtx)
-    {
-            txs.push_back(tx.GetHash().GetHex());
+        rendered = RenderBlock(block, state.pindex);
+        blockRenderCache.Insert(key, rendered);
     }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
 
-    if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("hash", hash.GetHex()));
+    result.push_back(Pair("confirmations", state.nConfirmations));
+    result.pushKVs(*rendered);
+
+    if (!state.hashNext.IsNull())
+        result.push_back(Pair("nextblockhash", state.hashNext.GetHex()));
 
     SAPI::WriteReply(req, result);
 
@@ -149,162 +439,131 @@ static bool blockchain_block_transactions(HTTPRequest* req, const std::map<std::
     uint256 nHash;
     bool fByHash = bodyParameter.exists(SAPI::Keys::hash);
     bool fByHeight = bodyParameter.exists(SAPI::Keys::height);
+    CBlockChainState state;
 
     if( fByHash && fByHeight ){
         return SAPI::Error(req, HTTPStatus::BAD_REQUEST, "Both, hash and height are given but only one is allowed. Use either 'hash' or 'height' as parameter in the body.");
     }else if( !fByHash && !fByHeight ){
         return SAPI::Error(req, SAPI::BlockNotSpecified, "No valid height or hash specified: Use either 'hash' or 'height' as parameter in the body.");
-    }else if( fByHeight ){
-
-        int64_t nHeight = bodyParameter[SAPI::Keys::height].get_int64();
-
-        if ( nHeight < 0 ||  nHeight > chainActive.Height() )
-            return SAPI::Error(req, SAPI::BlockHeightOutOfRange, "Block height out of range.");
-
-        CBlockIndex* pblockindex = chainActive[nHeight];
-        nHash = pblockindex->GetBlockHash();
-
-    }else if( !ParseHashStr(bodyParameter[SAPI::Keys::hash].get_str(), nHash) ){
+    }else if( fByHash && !ParseHashStr(bodyParameter[SAPI::Keys::hash].get_str(), nHash) ){
         return SAPI::Error(req, SAPI::BlockHashInvalid, "Invalid block hash provided.");
     }
 
     int64_t nPageNumber = bodyParameter[SAPI::Keys::pageNumber].get_int64();
     int64_t nPageSize = bodyParameter[SAPI::Keys::pageSize].get_int64();
 
-    LOCK(cs_main);
+    {
+        LOCK(cs_main);
+
+        if( fByHeight ){
+
+            int64_t nHeight = bodyParameter[SAPI::Keys::height].get_int64();
+
+            if ( nHeight < 0 ||  nHeight > chainActive.Height() )
+                return SAPI::Error(req, SAPI::BlockHeightOutOfRange, "Block height out of range.");
+
+            CBlockIndex* pblockindex = chainActive[nHeight];
+            nHash = pblockindex->GetBlockHash();
+        }
+
+        BlockMap::iterator mi = mapBlockIndex.find(nHash);
+
+        if (mi == mapBlockIndex.end())
+            return SAPI::Error(req, SAPI::BlockNotFound, "Block not found.");
+
+        CBlockIndex* blockindex = mi->second;
+
+        if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
+            return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
+
+        GetBlockChainState(blockindex, state);
+    }
 
     CBlock block;
-    CBlockIndex* blockindex = mapBlockIndex[nHash];
+    bool fHaveBlock = false;
 
-    if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
+    CBlockRenderKey key(nHash);
+    UniValuePtr rendered = blockRenderCache.Get(key);
 
-    if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+    if( !rendered ){
 
-    int nTxCount = block.vtx.size();
+        if( !ReadBlockFromState(block, state) )
+            return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+
+        fHaveBlock = true;
+        rendered = RenderBlock(block, state.pindex);
+        blockRenderCache.Insert(key, rendered);
+    }
+
+    int nTxCount = (*rendered)["tx"].size();
     int nPages = nTxCount / nPageSize;
     if( nTxCount % nPageSize ) nPages++;
 
     if (nPageNumber > nPages)
         return SAPI::Error(req, SAPI::PageOutOfRange, strprintf("Page number out of range: 1 - %d.", nPages));
 
+    // Assemble the page from the cached transactions and add their chain dependent fields.
+    UniValue txs(UniValue::VARR);
 
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+    int64_t nIndexOffset = ( nPageNumber - 1 ) * nPageSize;
 
-    UniValue txs(UniValue::VARR);
+    for( int64_t nTx = nIndexOffset; nTx < nTxCount && nTx < nIndexOffset + nPageSize; ++nTx ){
 
-    int nIndexOffset = static_cast<int>(( nPageNumber - 1 ) * nPageSize);
-    auto tx = block.vtx.begin() + nIndexOffset;
+        CBlockRenderKey txKey(nHash, nTx);
+        UniValuePtr renderedTx = blockRenderCache.Get(txKey);
 
-    while(tx != block.vtx.end() && static_cast<int64_t>(txs.size()) < nPageSize )
-    {
-        string strHex = EncodeHexTx(*tx, SERIALIZE_TRANSACTION_NO_WITNESS);
-
-        UniValue txObj(UniValue::VOBJ);
-        txObj.pushKV("hex", strHex);
-
-        uint256 txid = tx->GetHash();
-        txObj.pushKV("txid", txid.GetHex());
-        txObj.pushKV("size", (int)::GetSerializeSize(*tx, SER_NETWORK, PROTOCOL_VERSION));
-        txObj.pushKV("version", tx->nVersion);
-        txObj.pushKV("locktime", (int64_t)tx->nLockTime);
-        UniValue vin(UniValue::VARR);
-        BOOST_FOREACH(const CTxIn& txin, tx->vin) {
-
-            UniValue in(UniValue::VOBJ);
-            if (tx->IsCoinBase())
-                in.pushKV("coinbase", HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
-            else {
-
-                CTransaction txInput;
-                uint256 hashBlockIn;
-                if (!GetTransaction(txin.prevout.hash, txInput, Params().GetConsensus(), hashBlockIn, false))
-                    return SAPI::Error(req, SAPI::TxNotFound, "No information available about one of the inputs.");
-
-                const CTxOut& txout = txInput.vout[txin.prevout.n];
-
-                in.pushKV("txid", txin.prevout.hash.GetHex());
-                in.pushKV("value", ValueFromAmount(txout.nValue));
-                in.pushKV("n", (int64_t)txin.prevout.n);
-                UniValue o(UniValue::VOBJ);
-                ScriptPubKeyToJSON(txout.scriptPubKey, o, true);
-                in.pushKV("scriptPubKey", o);
-            }
-
-            in.pushKV("sequence", (int64_t)txin.nSequence);
-            vin.push_back(in);
-        }
-        txObj.pushKV("vin", vin);
-        UniValue vout(UniValue::VARR);
-        for (unsigned int i = 0; i < tx->vout.size(); i++) {
-            const CTxOut& txout = tx->vout[i];
-            UniValue out(UniValue::VOBJ);
-            out.pushKV("value", ValueFromAmount(txout.nValue));
-            out.pushKV("n", (int64_t)i);
-            UniValue o(UniValue::VOBJ);
-            ScriptPubKeyToJSON(txout.scriptPubKey, o, true);
-            out.pushKV("scriptPubKey", o);
-            vout.push_back(out);
+        if( !renderedTx ){
+
+            if( !fHaveBlock && !(fHaveBlock = ReadBlockFromState(block, state)) )
+                return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+
+            if( !(renderedTx = RenderTransaction(block.vtx[nTx], nHash)) )
+                return SAPI::Error(req, SAPI::TxNotFound, "No information available about one of the inputs.");
+
+            blockRenderCache.Insert(txKey, renderedTx);
         }
-        txObj.pushKV("vout", vout);
-
-        if (!nHash.IsNull()) {
-            txObj.pushKV("blockhash", nHash.GetHex());
-            BlockMap::iterator mi = mapBlockIndex.find(nHash);
-            if (mi != mapBlockIndex.end() && (*mi).second) {
-                CBlockIndex* pindex = (*mi).second;
-                if (chainActive.Contains(pindex)) {
-                    txObj.pushKV("height", pindex->nHeight);
-                    txObj.pushKV("confirmations", 1 + chainActive.Height() - pindex->nHeight);
-                    txObj.pushKV("blockTime", pindex->GetBlockTime());
-                } else {
-                    txObj.pushKV("height", -1);
-                    txObj.pushKV("confirmations", 0);
-                }
-            }
+
+        UniValue txObj = *renderedTx;
+
+        if( state.nConfirmations > 0 ){
+            txObj.pushKV("height", state.pindex->nHeight);
+            txObj.pushKV("confirmations", state.nConfirmations);
+            txObj.pushKV("blockTime", state.pindex->GetBlockTime());
+        }else{
+            txObj.pushKV("height", -1);
+            txObj.pushKV("confirmations", 0);
         }
 
         txs.push_back(txObj);
-        ++tx;
     }
 
-    UniValue transactions(UniValue::VOBJ);
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("hash", nHash.GetHex()));
+    result.push_back(Pair("confirmations", state.nConfirmations));
 
-    transactions.pushKV("count",static_cast<int64_t>(block.vtx.size()));
-    transactions.pushKV("pages", nPages);
-    transactions.pushKV("page", nPageNumber);
-    transactions.pushKV("data", txs);
+    std::vector<std::string> vecKeys = rendered->getKeys();
 
-    result.push_back(Pair("transactions", transactions));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    for( size_t nKey = 0; nKey < vecKeys.size(); ++nKey ){
+
+        if( vecKeys[nKey] != "tx" ){
+            result.push_back(Pair(vecKeys[nKey], (*rendered)[nKey]));
+            continue;
+        }
 
-    if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+        UniValue transactions(UniValue::VOBJ);
+
+        transactions.pushKV("count", nTxCount);
+        transactions.pushKV("pages", nPages);
+        transactions.pushKV("page", nPageNumber);
+        transactions.pushKV("data", txs);
+
+        result.push_back(Pair("transactions", transactions));
+    }
+
+    if (!state.hashNext.IsNull())
+        result.push_back(Pair("nextblockhash", state.hashNext.GetHex()));
 
     SAPI::WriteReply(req, result);
 
     return true;
 }
-
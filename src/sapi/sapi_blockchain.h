@@ -9,4 +9,8 @@
 
 extern SAPI::EndpointGroup blockchainEndpoints;
 
+/** Start/stop dropping rendered blocks of the block endpoints on reorgs */
+void RegisterSAPIBlockCache();
+void UnregisterSAPIBlockCache();
+
 #endif // SMARTCASH_SAPI_BLOCKCHAIN_H
@@ -3,140 +3,290 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "sapi/sapi.h"
+#include "hash.h"
 #include "netbase.h"
+#include "random.h"
 #include "util.h"
 
-CCriticalSection cs_clients;
-static std::map<std::string, SAPI::Limits::Client*> mapClients;
+#include <atomic>
+#include <limits>
+#include <thread>
 
 static std::vector<int> vecThrottling = {
     10,60,600,3600
 };
 
-SAPI::Limits::Client *SAPI::Limits::GetClient(const CService &peer)
+// Tokens are counted in 1/1000 requests to refill them smoothly.
+static const int64_t nTokensMax = SAPI::Limits::nRequestsPerInterval * 1000;
+
+// The state of a client is packed into one word to update it with a single CAS:
+//   bits 63-20: time in ms since the limiter started. The last request or,
+//               if locked, the time the lock ends
+//   bit     19: locked
+//   bits 18-16: throttling level + 1
+//   bits 15-0 : remaining tokens. While locked the bucket doesn't refill, the
+//               requests during the lock drain it and extend the lock to
+//               the next throttling level once it runs empty.
+static inline uint64_t PackState(int64_t nTime, bool fLocked, int nLevel, int64_t nTokens)
 {
-    SAPI::Limits::Client *client;
-    std::string strIp = peer.ToStringIP(false);
+    return (uint64_t(nTime) << 20) | (uint64_t(fLocked) << 19) | (uint64_t(nLevel + 1) << 16) | uint64_t(nTokens);
+}
+
+static inline int64_t StateTime(uint64_t nState) { return int64_t(nState >> 20); }
+static inline bool StateLocked(uint64_t nState) { return (nState >> 19) & 1; }
+static inline int StateLevel(uint64_t nState) { return int((nState >> 16) & 0x7) - 1; }
+static inline int64_t StateTokens(uint64_t nState) { return int64_t(nState & 0xFFFF); }
+
+struct CClientSlot
+{
+    // SipHash of the binary address, 0 if the slot is free.
+    std::atomic<uint64_t> nKey;
+    std::atomic<uint64_t> nState;
+};
+
+// State of a slot which is taken over by a new client but not initialized yet.
+static const uint64_t nStateInit = std::numeric_limits<uint64_t>::max();
+
+static CClientSlot vecClients[SAPI::Limits::nClientShards][SAPI::Limits::nClientShardSlots];
+static std::atomic<int64_t> nLastSweep(0);
+static const int64_t nLimiterStart = GetTimeMillis();
+
+static inline int64_t GetLimiterTime()
+{
+    return std::max<int64_t>(GetTimeMillis() - nLimiterStart, 0);
+}
 
-    LOCK(cs_clients);
+static inline bool IsExpired(uint64_t nState, int64_t nNow)
+{
+    // Clients which are not locked and were not active for nClientRemovalMs
+    // don't need to be tracked anymore.
+    return nState != nStateInit && nNow - StateTime(nState) > SAPI::Limits::nClientRemovalMs;
+}
 
-    auto it = mapClients.find(strIp);
+static inline uint64_t LoadState(const CClientSlot *slot)
+{
+    uint64_t nState;
 
-    if( it == mapClients.end() ){
-        client = new SAPI::Limits::Client();
-        mapClients.insert(std::make_pair(strIp, client));
-    }else{
-        client = it->second;
+    // Wait until the slot of a new client is initialized, that's just two stores away.
+    while( (nState = slot->nState.load(std::memory_order_acquire)) == nStateInit ){
+        std::this_thread::yield();
     }
 
-    return client;
+    return nState;
 }
 
-void SAPI::Limits::CheckAndRemove()
+static uint64_t GetClientKey(const CNetAddr &peer)
 {
-    LOCK(cs_clients);
+    static const uint64_t k0 = GetRand(std::numeric_limits<uint64_t>::max());
+    static const uint64_t k1 = GetRand(std::numeric_limits<uint64_t>::max());
 
-    LogPrintf("SAPI::Limits::CheckAndRemove() - Clients %d\n", mapClients.size());
+    unsigned char vchAddr[16];
 
-    auto it = mapClients.begin();
+    for( int i = 0; i < 16; ++i ) vchAddr[i] = peer.GetByte(15 - i);
 
-    while( it != mapClients.end() ){
-        if( it->second->CheckAndRemove() ){
-            LogPrintf("SAPI::Limits::CheckAndRemove() - Remove %s\n", it->first);
-            delete it->second;
-            it = mapClients.erase(it);
-        }else{
-            ++it;
-        }
-    }
+    // A single IPv6 host usually gets a whole /64, count it as one client.
+    if( peer.IsIPv6() ) memset(vchAddr + 8, 0, 8);
+
+    uint64_t nKey = CSipHasher(k0, k1).Write(vchAddr, sizeof(vchAddr)).Finalize();
+
+    return nKey ? nKey : 1;
 }
 
-void SAPI::Limits::Client::Request()
+/** Take over a slot for a new client. It stays marked as initializing until the key and the state are written. */
+static bool ClaimSlot(CClientSlot *slot, uint64_t nExpected, const uint64_t nKey, const int64_t nNow)
 {
-    LOCK(cs);
+    if( nExpected == nStateInit || !slot->nState.compare_exchange_strong(nExpected, nStateInit) ) return false;
 
-    int64_t nTime = GetTimeMillis();
-    int64_t nTimePassed = nTime - nLastRequestTime;
+    slot->nKey.store(nKey, std::memory_order_release);
+    slot->nState.store(PackState(nNow, false, -1, nTokensMax), std::memory_order_release);
 
-    IsRequestLimited();
+    return true;
+}
 
-    nRemainingRequests += (static_cast<double>(nTimePassed * nRequestsPerInterval) / nRequestIntervalMs) - 1.0;
+static CClientSlot *GetClient(const uint64_t nKey, const int64_t nNow)
+{
+    CClientSlot *shard = vecClients[nKey % SAPI::Limits::nClientShards];
+    // Each client has two probe windows in its shard, a few busy spots
+    // don't keep new clients out that way.
+    const size_t vecStart[] = {
+        size_t(nKey >> 32) % SAPI::Limits::nClientShardSlots,
+        size_t(nKey >> 16) % SAPI::Limits::nClientShardSlots
+    };
+
+    for( size_t nStart : vecStart ){
+        for( size_t i = 0; i < SAPI::Limits::nClientProbeLength; ++i ){
+            CClientSlot *slot = &shard[(nStart + i) % SAPI::Limits::nClientShardSlots];
+            if( slot->nKey.load(std::memory_order_acquire) == nKey ) return slot;
+        }
+    }
+
+    // Not known yet, take the first free or expired slot and remember the
+    // client which was idle the longest. Locked clients only count once
+    // their lock is over.
+    CClientSlot *pOldest = nullptr;
+    uint64_t nOldestState = 0;
 
-    if( nRemainingRequests > nRequestsPerInterval )
-            nRemainingRequests = nRequestsPerInterval;
+    for( size_t nStart : vecStart ){
+        for( size_t i = 0; i < SAPI::Limits::nClientProbeLength; ++i ){
 
-    LogPrintf("nRemaining before: %f\n", nRemainingRequests);
+            CClientSlot *slot = &shard[(nStart + i) % SAPI::Limits::nClientShardSlots];
+            uint64_t nSlotState = slot->nState.load(std::memory_order_acquire);
+            uint64_t nSlotKey = slot->nKey.load(std::memory_order_acquire);
 
-    if(nRemainingRequests <= 0){
+            // Someone else was faster with the same client.
+            if( nSlotKey == nKey ) return slot;
 
-        if( nThrottling < static_cast<int64_t>(vecThrottling.size() - 1) )
-            ++nThrottling;
+            if( nSlotKey && !IsExpired(nSlotState, nNow) ){
 
-        int64_t nThrottlingTime = vecThrottling.at(nThrottling);
+                if( nSlotState != nStateInit && ( !StateLocked(nSlotState) || StateTime(nSlotState) < nNow ) &&
+                    ( !pOldest || StateTime(nSlotState) < StateTime(nOldestState) ) ){
+                    pOldest = slot;
+                    nOldestState = nSlotState;
+                }
 
-        nRequestsLimitUnlock = nTime + nThrottlingTime * 1000;
-        nRemainingRequests = nRequestIntervalMs;
+                continue;
+            }
 
+            if( ClaimSlot(slot, nSlotState, nKey, nNow) ) return slot;
+        }
     }
 
-    LogPrintf("nRemaining after: %f, throttling %d\n", nRemainingRequests, nThrottling);
+    // All slots around are in use by active clients, evict the least recently
+    // used one. Clients which are still locked are never evicted to keep their lock.
+    if( pOldest && ClaimSlot(pOldest, nOldestState, nKey, nNow) ) return pOldest;
 
-    nLastRequestTime = nTime;
+    return nullptr;
 }
 
-bool SAPI::Limits::Client::IsRequestLimited()
+bool SAPI::Limits::Request(const CNetAddr &peer, int64_t &nLockSeconds)
 {
+    nLockSeconds = 0;
 
-    LOCK(cs);
+    const uint64_t nKey = GetClientKey(peer);
+    int64_t nNow = GetLimiterTime();
+    CClientSlot *client = GetClient(nKey, nNow);
+    uint64_t nState = 0;
 
-    if( nRequestsLimitUnlock < 0 )
-        return false;
+    if( client ) nState = LoadState(client);
 
-    int64_t nTime = GetTimeMillis();
+    while( true ){
 
-    if( nTime > nRequestsLimitUnlock ){
-        nRequestsLimitUnlock = -1;
-        nThrottling = -1;
-        return false;
-    }
+        // No slot left for a new client, only its requests get rejected
+        // until some other client goes idle or its lock ends.
+        if( !client ){
+            nLockSeconds = vecThrottling.front();
+            LogPrint("sapi", "SAPI::Limits::Request - No slot for %s, rejected\n", peer.ToString());
+            return true;
+        }
 
-    LogPrintf("Request limited: %.2fms\n", nRequestsLimitUnlock - nTime);
+        if( nState == nStateInit ) nState = LoadState(client);
 
-    return true;
-}
+        // The slot got handed over to another client in the meantime, look it up again.
+        if( client->nKey.load(std::memory_order_acquire) != nKey ){
+            client = GetClient(nKey, nNow);
+            if( client ) nState = LoadState(client);
+            continue;
+        }
 
-bool SAPI::Limits::Client::IsRessourceLimited()
-{
-    return false;
-}
+        int64_t nTime = StateTime(nState);
+        int nLevel = StateLevel(nState);
+        int64_t nTokens = StateTokens(nState);
 
-bool SAPI::Limits::Client::IsLimited()
-{
-    return IsRequestLimited() || IsRessourceLimited();
-}
+        if( StateLocked(nState) && nNow <= nTime ){
 
-int64_t SAPI::Limits::Client::GetRequestLockSeconds()
-{
-    if( nRequestsLimitUnlock < 0)
-        return 0;
+            // Still locked, the request counts against the bucket of the lock.
+            bool fEscalated = false;
 
-    return (nRequestsLimitUnlock - GetTimeMillis()) / 1000;
-}
+            nTokens -= 1000;
 
-int64_t SAPI::Limits::Client::GetRessourceLockSeconds()
-{
-    if( nRessourcesLimitUnlock < 0)
-        return 0;
+            if( nTokens <= 0 ){
+
+                if( nLevel < static_cast<int>(vecThrottling.size() - 1) )
+                    ++nLevel;
+
+                nTime = nNow + vecThrottling.at(nLevel) * 1000;
+                nTokens = nTokensMax;
+                fEscalated = true;
+            }
+
+            if( client->nState.compare_exchange_weak(nState, PackState(nTime, true, nLevel, nTokens)) ){
+
+                nLockSeconds = (nTime - nNow) / 1000;
+
+                if( fEscalated )
+                    LogPrint("sapi", "SAPI::Limits::Request - Lock %s for %ds, requested while locked\n", peer.ToString(), nLockSeconds);
+
+                return true;
+            }
+
+            continue;
+        }
+
+        // The throttling level is kept until the client was quiet for
+        // nClientRemovalMs, the next lock goes up one step until then.
+        if( nNow - nTime > nClientRemovalMs )
+            nLevel = -1;
+
+        if( StateLocked(nState) ){
+            // The lock is over, start again with a full bucket.
+            nTokens = nTokensMax;
+            nTime = nNow;
+        }
+
+        nTokens += std::max<int64_t>(nNow - nTime, 0) * nTokensMax / nRequestIntervalMs;
+        nTokens = std::min(nTokens, nTokensMax) - 1000;
+
+        bool fLimited = nTokens <= 0;
+
+        if( fLimited ){
 
-    return (nRessourcesLimitUnlock - GetTimeMillis()) / 1000;
+            if( nLevel < static_cast<int>(vecThrottling.size() - 1) )
+                ++nLevel;
+
+            nTime = nNow + vecThrottling.at(nLevel) * 1000;
+            nTokens = nTokensMax;
+        }else{
+            nTime = nNow;
+        }
+
+        if( client->nState.compare_exchange_weak(nState, PackState(nTime, fLimited, nLevel, nTokens)) ){
+
+            if( fLimited ){
+                nLockSeconds = (nTime - nNow) / 1000;
+                LogPrint("sapi", "SAPI::Limits::Request - Lock %s for %ds\n", peer.ToString(), nLockSeconds);
+            }
+
+            return fLimited;
+        }
+    }
 }
 
-bool SAPI::Limits::Client::CheckAndRemove()
+void SAPI::Limits::CheckAndRemove()
 {
-    // If the client is not limited and was not active for nClientRemovalMs
-    // we want to remove it from the list.
-    if( !IsLimited() && ( GetTimeMillis() - nLastRequestTime ) > nClientRemovalMs )
-        return true;
+    int64_t nNow = GetLimiterTime();
+    int64_t nLast = nLastSweep.load();
+
+    // Only one sweep per interval, the other callers leave right away.
+    if( nNow - nLast < nClientSweepIntervalMs || !nLastSweep.compare_exchange_strong(nLast, nNow) )
+        return;
+
+    int64_t nClients = 0, nRemoved = 0;
+
+    for( size_t nShard = 0; nShard < nClientShards; ++nShard ){
+        for( size_t nSlot = 0; nSlot < nClientShardSlots; ++nSlot ){
+
+            CClientSlot &slot = vecClients[nShard][nSlot];
+            uint64_t nKey = slot.nKey.load(std::memory_order_acquire);
+
+            if( !nKey ) continue;
+
+            if( IsExpired(slot.nState.load(std::memory_order_relaxed), nNow) ){
+                if( slot.nKey.compare_exchange_strong(nKey, 0) ) ++nRemoved;
+            }else{
+                ++nClients;
+            }
+        }
+    }
 
-    return false;
+    LogPrint("sapi", "SAPI::Limits::CheckAndRemove() - Clients %d, removed %d\n", nClients, nRemoved);
 }
@@ -57,11 +57,8 @@ static bool CheckAddresses(HTTPRequest* req, std::vector<std::string> vecAddr, s
 
     vecResults.clear();
 
-    TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-    if(!roundsLocked) return SAPI::Error(req, SAPI::RewardsDatabaseBusy, "Rewards database is busy..Try it again!");
-
-    const CSmartRewardRound& current = prewards->GetCurrentRound();
+    CSmartRewardsSnapshotRef snapshot = prewards->GetSnapshot();
+    const CSmartRewardRound& current = snapshot->currentRound;
 
     int nFirst_1_3_Round = Params().GetConsensus().nRewardsFirst_1_3_Round;
 
@@ -78,7 +75,7 @@ static bool CheckAddresses(HTTPRequest* req, std::vector<std::string> vecAddr, s
 
         CSmartRewardEntry entry;
 
-        if( !prewards->GetRewardEntry(id, entry) ){
+        if( !snapshot->GetRewardEntry(id, entry) ){
             code = SAPI::AddressNotFound;
             std::string message = "Couldn't find this SmartCash address in the database.";
             errors.push_back(SAPI::Result(code, message));
@@ -112,11 +109,8 @@ static bool smartrewards_current(HTTPRequest* req, const std::map<std::string, s
 {
     UniValue obj(UniValue::VOBJ);
 
-    TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-    if(!roundsLocked) return SAPI::Error(req, SAPI::RewardsDatabaseBusy, "Rewards database is busy..Try it again!");
-
-    const CSmartRewardRound& current = prewards->GetCurrentRound();
+    CSmartRewardsSnapshotRef snapshot = prewards->GetSnapshot();
+    const CSmartRewardRound& current = snapshot->currentRound;
 
     if( !current.number ) return SAPI::Error(req, SAPI::NoActiveRewardRound, "No active reward round available yet.");
 
@@ -142,11 +136,8 @@ static bool smartrewards_history(HTTPRequest* req, const std::map<std::string, s
 {
     UniValue obj(UniValue::VARR);
 
-    TRY_LOCK(cs_rewardrounds,roundsLocked);
-
-    if(!roundsLocked) return SAPI::Error(req, SAPI::RewardsDatabaseBusy, "Rewards database is busy..Try it again!");
-
-    const CSmartRewardRoundList& history = prewards->GetRewardRounds();
+    CSmartRewardsSnapshotRef snapshot = prewards->GetSnapshot();
+    const CSmartRewardRoundList& history = snapshot->finishedRounds;
 
     int64_t nPayoutDelay = Params().GetConsensus().nRewardsPayoutStartDelay;
 
@@ -8,6 +8,7 @@
 #include "coins.h"
 #include "consensus/validation.h"
 #include "smartnode/instantx.h"
+#include "txmempool.h"
 #include "validation.h"
 
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
@@ -46,9 +47,11 @@ static bool transaction_check(HTTPRequest* req, const std::map<std::string, std:
     if( !ParseHashStr(hashStr, hash) )
         return SAPI::Error(req, SAPI::TxNotSpecified, "Invalid hash specified. Use /transaction/check/<txhash>");
 
+    // Look the transaction and its inputs up without cs_main, it's only needed
+    // briefly for the block index below.
     CTransaction tx;
     uint256 hashBlock;
-    if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, false))
+    if (!mempool.lookup(hash, tx) && !ReadTransactionFromDisk(hash, tx, hashBlock))
         return SAPI::Error(req, SAPI::TxNotFound, "No information available about the transaction");
 
     string strHex = EncodeHexTx(tx, SERIALIZE_TRANSACTION_NO_WITNESS);
@@ -70,7 +73,7 @@ static bool transaction_check(HTTPRequest* req, const std::map<std::string, std:
 
             CTransaction txInput;
             uint256 hashBlockIn;
-            if (!GetTransaction(txin.prevout.hash, txInput, Params().GetConsensus(), hashBlockIn, false))
+            if (!mempool.lookup(txin.prevout.hash, txInput) && !ReadTransactionFromDisk(txin.prevout.hash, txInput, hashBlockIn))
                 return SAPI::Error(req, SAPI::TxNotFound, "No information available about one of the inputs.");
 
             const CTxOut& txout = txInput.vout[txin.prevout.n];
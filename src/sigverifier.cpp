@@ -0,0 +1,97 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigverifier.h"
+
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+CSignatureVerifier signatureVerifier(MAX_SIGVERIFY_QUEUE_SIZE);
+
+void ThreadSignatureVerify() {
+    RenameThread("smartcash-sigverify");
+    signatureVerifier.Thread();
+}
+
+void CSignatureVerifier::Thread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nWorkers++;
+    }
+
+    try {
+        while (true) {
+            std::shared_ptr<CBatch> batch;
+            size_t nBegin, nEnd;
+
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+
+                while (queueBatches.empty()) {
+                    condWorker.wait(lock);
+                }
+
+                // take the next chunk of the oldest batch, drop the batch
+                // from the queue once all of its chunks are taken
+                batch = queueBatches.front();
+                nBegin = batch->nNext;
+                nEnd = std::min(nBegin + CHUNK_SIZE, batch->vecChecks.size());
+                batch->nNext = nEnd;
+                nQueued -= nEnd - nBegin;
+
+                if (nEnd == batch->vecChecks.size()) {
+                    queueBatches.pop_front();
+                }
+            }
+
+            size_t nValid = 0;
+
+            for (size_t i = nBegin; i < nEnd; ++i) {
+                if (batch->vecChecks[i]()) nValid++;
+            }
+
+            batch->nValid += nValid;
+
+            if (batch->nDone.fetch_add(nEnd - nBegin) + (nEnd - nBegin) == batch->vecChecks.size() && batch->completion) {
+                batch->completion(batch->nValid, batch->vecChecks.size());
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nWorkers--;
+        throw;
+    }
+}
+
+bool CSignatureVerifier::Submit(std::vector<CHashSignatureCheck>& vecChecks, const completion_t& completion)
+{
+    if (vecChecks.empty()) return true;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+
+    if (!nWorkers || nQueued + vecChecks.size() > nMaxQueued) {
+        LogPrint("sigverify", "CSignatureVerifier::%s -- rejected %d checks, workers %d, queued %d\n", __func__, vecChecks.size(), nWorkers, nQueued);
+        return false;
+    }
+
+    size_t nChecks = vecChecks.size();
+
+    nQueued += nChecks;
+    queueBatches.push_back(std::make_shared<CBatch>(vecChecks, completion));
+
+    if (nChecks > CHUNK_SIZE)
+        condWorker.notify_all();
+    else
+        condWorker.notify_one();
+
+    return true;
+}
+
+size_t CSignatureVerifier::GetQueueSize()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nQueued;
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SIGVERIFIER_H
+#define SIGVERIFIER_H
+
+#include "messagesigner.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** Maximum number of signatures waiting for verification, further batches get rejected */
+static const size_t MAX_SIGVERIFY_QUEUE_SIZE = 50000;
+
+/**
+ * A received message which got deserialized ahead of its processing so that
+ * its signatures can be verified in the background. ProcessMessages holds
+ * the message back until fVerified is set and then hands the object to the
+ * handler instead of deserializing the message again.
+ */
+class CPrefetchedMessage
+{
+public:
+    std::atomic<bool> fVerified;
+
+    CPrefetchedMessage() : fVerified(false) {}
+    virtual ~CPrefetchedMessage() {}
+};
+
+template<typename T>
+class CPrefetchedMessageObject : public CPrefetchedMessage
+{
+public:
+    T object;
+};
+
+/**
+ * Background verification of message signature batches.
+ *
+ * The worker threads take chunks of CHUNK_SIZE checks from the oldest
+ * batch in the queue, so a large batch gets spread over all idle workers
+ * instead of keeping a single one busy. The completion of a batch runs on
+ * the worker which finished its last chunk.
+ */
+class CSignatureVerifier
+{
+public:
+    /// Called with the number of valid signatures and the size of the batch
+    typedef std::function<void(size_t nValid, size_t nTotal)> completion_t;
+
+private:
+    static const size_t CHUNK_SIZE = 16;
+
+    struct CBatch
+    {
+        std::vector<CHashSignatureCheck> vecChecks;
+        completion_t completion;
+        //! Index of the first check not yet taken by a worker, protected by mutex
+        size_t nNext;
+        std::atomic<size_t> nDone;
+        std::atomic<size_t> nValid;
+
+        CBatch(std::vector<CHashSignatureCheck>& vecChecksIn, const completion_t& completionIn) :
+            completion(completionIn), nNext(0), nDone(0), nValid(0)
+        {
+            vecChecks.swap(vecChecksIn);
+        }
+    };
+
+    //! Mutex to protect the inner state
+    boost::mutex mutex;
+
+    //! Worker threads block on this when out of work
+    boost::condition_variable condWorker;
+
+    //! Batches with checks which are not taken by a worker yet
+    std::deque<std::shared_ptr<CBatch> > queueBatches;
+
+    //! Number of checks in queueBatches not taken by a worker yet
+    size_t nQueued;
+
+    //! Maximum of nQueued
+    size_t nMaxQueued;
+
+    //! Number of running worker threads
+    int nWorkers;
+
+public:
+    CSignatureVerifier(size_t nMaxQueuedIn) : nQueued(0), nMaxQueued(nMaxQueuedIn), nWorkers(0) {}
+
+    //! Worker thread
+    void Thread();
+
+    /**
+     * Queue the checks for verification, vecChecks is empty afterwards if they
+     * got queued. Returns false without touching vecChecks if there is no
+     * worker running or the queue is full.
+     */
+    bool Submit(std::vector<CHashSignatureCheck>& vecChecks, const completion_t& completion = completion_t());
+
+    //! Number of checks waiting for a worker
+    size_t GetQueueSize();
+};
+
+extern CSignatureVerifier signatureVerifier;
+
+void ThreadSignatureVerify();
+
+#endif // SIGVERIFIER_H
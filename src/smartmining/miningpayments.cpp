@@ -145,6 +145,24 @@ bool SmartMining::IsSignatureRequired(const int nHeight){
     return true;
 }
 
+CMiningSignatureIndexValue SmartMining::GetSignatureIndexValue(const CBlock &block)
+{
+    // Second output of the coinbase needs to be the signature.
+    if( !block.vtx.size() || block.vtx[0].vout.size() < 2 ){
+        return CMiningSignatureIndexValue(CMiningSignatureIndexValue::NO_SIGNATURE_OUTPUT, 0);
+    }
+
+    const CScript &sigScript = block.vtx[0].vout[1].scriptPubKey;
+
+    // Check if it is an OP_RETURN and if the startvalue is OP_DATA_MINING_FLAG
+    if( sigScript.size() > nMiningSignatureMinScriptLength &&
+        sigScript[0] == OP_RETURN && sigScript[2] == OP_RETURN_MINING_FLAG ){
+        return CMiningSignatureIndexValue(CMiningSignatureIndexValue::SIGNED, sigScript[3]);
+    }
+
+    return CMiningSignatureIndexValue(CMiningSignatureIndexValue::NO_SIGNATURE, 0);
+}
+
 static bool CheckSignature(const CBlock &block, const CBlockIndex *pindex)
 {
 
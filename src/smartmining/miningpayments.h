@@ -28,6 +28,7 @@ bool Validate(const CBlock& block, CBlockIndex *pindex, CValidationState& state,
 void FillPayment(CMutableTransaction& txNew, int nHeight, CBlockIndex * pindexPrev, CAmount blockReward, CTxOut &outSignature, const CSmartAddress &signingAddress);
 bool IsSignatureRequired(const CBlockIndex *pindex);
 bool IsSignatureRequired(const int nHeight);
+CMiningSignatureIndexValue GetSignatureIndexValue(const CBlock &block);
 
 }
 
@@ -9,6 +9,7 @@
 #include "smartnodesync.h"
 #include "smartnodeman.h"
 #include "../messagesigner.h"
+#include "../sigverifier.h"
 #include "../net.h"
 #include "../protocol.h"
 #include "spork.h"
@@ -61,23 +62,56 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
         CTxLockVote vote;
         vRecv >> vote;
 
-        uint256 nVoteHash = vote.GetHash();
+        ProcessTxLockVoteMessage(pfrom, vote, connman);
+
+        return;
+    }
+}
+
+void CInstantSend::ProcessTxLockVoteMessage(CNode* pfrom, CTxLockVote& vote, CConnman& connman)
+{
+    uint256 nVoteHash = vote.GetHash();
+
+    pfrom->setAskFor.erase(nVoteHash);
+
+    // Ignore any InstantSend messages until smartnode list is synced
+    if(!smartnodeSync.IsSmartnodeListSynced()) return;
+
+    {
+        LOCK(cs_instantsend);
+        auto ret = mapTxLockVotes.emplace(nVoteHash, vote);
+        if (!ret.second) return;
+    }
+
+    ProcessTxLockVote(pfrom, vote, connman);
+}
+
+std::shared_ptr<CPrefetchedMessage> CInstantSend::PrefetchMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, std::vector<CHashSignatureCheck>& vecChecksRet)
+{
+    if(fLiteMode) return nullptr; // disable all SmartCash specific functionality
+    if(!sporkManager.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED)) return nullptr;
 
-        pfrom->setAskFor.erase(nVoteHash);
+    if (strCommand == NetMsgType::TXLOCKVOTE)
+    {
+        if(pfrom->nVersion < MIN_INSTANTSEND_PROTO_VERSION) return nullptr;
+
+        auto prefetched = std::make_shared<CPrefetchedMessageObject<CTxLockVote> >();
+        CTxLockVote& vote = prefetched->object;
+        vRecv >> vote;
 
-        // Ignore any InstantSend messages until smartnode list is synced
-        if(!smartnodeSync.IsSmartnodeListSynced()) return;
+        if(!smartnodeSync.IsSmartnodeListSynced()) return prefetched;
 
         {
             LOCK(cs_instantsend);
-            auto ret = mapTxLockVotes.emplace(nVoteHash, vote);
-            if (!ret.second) return;
+            if(mapTxLockVotes.count(vote.GetHash())) return prefetched;
         }
 
-        ProcessTxLockVote(pfrom, vote, connman);
+        vecChecksRet.push_back(vote.GetSignatureCheck());
 
-        return;
+        return prefetched;
     }
+
+    return nullptr;
 }
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman)
@@ -308,6 +342,8 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
 void CInstantSend::CreateIndex(const CTxLockCandidate &txLockCandidate)
 {
+    if( !fInstantPayIndex ) return;
+
     CInstantPayIndexKey key(txLockCandidate.GetCreationTime(), txLockCandidate.GetHash());
 
     if( !mapLockIndex.count(key) ){
@@ -329,6 +365,8 @@ void CInstantSend::FinalizeIndex(const CTxLockCandidate &txLockCandidate, bool f
     it->second.receivedLocks = txLockCandidate.CountVotes();
     it->second.maxLocks = txLockCandidate.GetMaxVotes();
     it->second.elapsedTime = GetTimeMillis() - it->second.timeCreated;
+
+    mapLockIndexDirty[key] = it->second;
 }
 
 //received a consensus vote
@@ -702,16 +740,21 @@ void CInstantSend::CheckAndRemove()
 
                 // Update the received votes to get some statistics how many valid votes
                 // arrive in time
-                if( it != mapLockIndex.end() && it->second.fProcessed && it->second.fValid ){
+                if( it != mapLockIndex.end() && it->second.fProcessed && it->second.fValid &&
+                    it->second.receivedLocks != txLockCandidate.CountVotes() ){
                     it->second.receivedLocks = txLockCandidate.CountVotes();
+                    mapLockIndexDirty[key] = it->second;
                 }
             }
 
-            ++itLockCandidate;
-        }
+            // No more votes get accepted after the timeout, the entry is final and
+            // was queued for the write at the latest by the update above.
+            if( txLockCandidate.IsTimedOut() ){
+                auto it = mapLockIndex.find(key);
+                if( it != mapLockIndex.end() && it->second.fProcessed ) mapLockIndex.erase(it);
+            }
 
-        if( !pblocktree->WriteInstantPayLocks(mapLockIndex) ){
-            LogPrintf("CInstantSend::CheckAndRemove() - Failed to write instantpay index\n");
+            ++itLockCandidate;
         }
     }
 
@@ -794,6 +837,24 @@ void CInstantSend::CheckAndRemove()
     LogPrintf("CInstantSend::CheckAndRemove -- %s\n", ToString());
 }
 
+void CInstantSend::WriteIndex()
+{
+    if( !fInstantPayIndex ) return;
+
+    std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > vecLockIndex;
+
+    {
+        LOCK(cs_instantsend);
+        vecLockIndex.assign(mapLockIndexDirty.begin(), mapLockIndexDirty.end());
+        mapLockIndexDirty.clear();
+    }
+
+    // The batch write doesn't need cs_instantsend.
+    if( !vecLockIndex.empty() && !pblocktree->WriteInstantPayIndex(vecLockIndex) ){
+        LogPrintf("CInstantSend::WriteIndex() - Failed to write instantpay index\n");
+    }
+}
+
 bool CInstantSend::AlreadyHave(const uint256& hash)
 {
     LOCK(cs_instantsend);
@@ -1122,10 +1183,20 @@ uint256 CTxLockVote::GetHash() const
     return ss.GetHash();
 }
 
+std::string CTxLockVote::GetSignatureMessage() const
+{
+    return txHash.ToString() + outpoint.ToStringShort();
+}
+
+CHashSignatureCheck CTxLockVote::GetSignatureCheck() const
+{
+    return CHashSignatureCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), vchSmartnodeSignature);
+}
+
 bool CTxLockVote::CheckSignature() const
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     smartnode_info_t infoMn;
 
@@ -1145,7 +1216,7 @@ bool CTxLockVote::CheckSignature() const
 bool CTxLockVote::Sign()
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSmartnodeSignature, activeSmartnode.keySmartnode)) {
         LogPrintf("CTxLockVote::Sign -- SignMessage() failed\n");
@@ -6,6 +6,7 @@
 
 #include "../net.h"
 #include "../chain.h"
+#include "../messagesigner.h"
 #include "../utiltime.h"
 #include "primitives/transaction.h"
 #include "txdb.h"
@@ -65,7 +66,11 @@ private:
     //track smartnodes who voted with no txreq (for DOS protection)
     std::map<COutPoint, int64_t> mapSmartnodeOrphanVotes; // mn outpoint - time
 
+    // Index entries of the lock candidates, finalized ones are dropped once
+    // their candidate timed out.
     std::map<CInstantPayIndexKey, CInstantPayValue> mapLockIndex;
+    // Finalized index entries changed since the last write.
+    std::map<CInstantPayIndexKey, CInstantPayValue> mapLockIndexDirty;
 
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void CreateEmptyTxLockCandidate(const uint256& txHash);
@@ -93,6 +98,10 @@ public:
     CCriticalSection cs_instantsend;
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+    void ProcessTxLockVoteMessage(CNode* pfrom, CTxLockVote& vote, CConnman& connman);
+    /// Deserialize a received lock vote ahead of ProcessMessage and add its signature
+    /// to vecChecksRet if it still needs a check, returns nullptr for other messages
+    std::shared_ptr<CPrefetchedMessage> PrefetchMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, std::vector<CHashSignatureCheck>& vecChecksRet);
 
     bool ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman);
     void Vote(const uint256& txHash, CConnman& connman);
@@ -117,6 +126,8 @@ public:
 
     // remove expired entries from maps
     void CheckAndRemove();
+    // write the changed instantpay index entries
+    void WriteIndex();
     // verify if transaction lock timed out
     bool IsTxLockCandidateTimedOut(const uint256& txHash);
 
@@ -201,6 +212,8 @@ public:
     bool IsTimedOut() const;
     bool IsFailed() const;
 
+    std::string GetSignatureMessage() const;
+    CHashSignatureCheck GetSignatureCheck() const;
     bool Sign();
     bool CheckSignature() const;
 
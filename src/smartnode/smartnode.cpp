@@ -71,6 +71,8 @@ bool CSmartnode::UpdateFromNewBroadcast(CSmartnodeBroadcast& mnb, CConnman& conn
     nPoSeBanScore = 0;
     nPoSeBanHeight = 0;
     nTimeLastChecked = 0;
+    // the protocol version might have changed which affects the smartnode ranks
+    mnodeman.NotifySmartnodeListChanged();
     int nDos = 0;
     if(mnb.lastPing == CSmartnodePing() || (mnb.lastPing != CSmartnodePing() && mnb.lastPing.CheckAndUpdate(this, true, nDos, connman))) {
         lastPing = mnb.lastPing;
@@ -149,6 +151,7 @@ void CSmartnode::Check(bool fForce)
         CollateralStatus err = CheckCollateral(vin.prevout, nHeight);
         if (err == COLLATERAL_UTXO_NOT_FOUND) {
             nActiveState = SMARTNODE_OUTPOINT_SPENT;
+            mnodeman.NotifySmartnodeListChanged();
             LogPrint("smartnode", "CSmartnode::Check -- Failed to find Smartnode UTXO, smartnode=%s\n", vin.prevout.ToStringShort());
             return;
         }
@@ -163,6 +166,7 @@ void CSmartnode::Check(bool fForce)
         DecreasePoSeBanScore();
     } else if(nPoSeBanScore >= SMARTNODE_POSE_BAN_MAX_SCORE) {
         nActiveState = SMARTNODE_POSE_BAN;
+        mnodeman.NotifySmartnodeListChanged();
         // ban for the whole payment cycle
         nPoSeBanHeight = nHeight + mnodeman.size();
         LogPrintf("CSmartnode::Check -- Smartnode %s is banned till block %d now\n", vin.prevout.ToStringShort(), nPoSeBanHeight);
@@ -181,6 +185,7 @@ void CSmartnode::Check(bool fForce)
         nActiveState = SMARTNODE_UPDATE_REQUIRED;
         if(nActiveStatePrev != nActiveState) {
             LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
+            mnodeman.NotifySmartnodeListChanged();
         }
         return;
     }
@@ -203,6 +208,7 @@ void CSmartnode::Check(bool fForce)
             nActiveState = SMARTNODE_NEW_START_REQUIRED;
             if(nActiveStatePrev != nActiveState) {
                 LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
+                mnodeman.NotifySmartnodeListChanged();
             }
             return;
         }
@@ -212,6 +218,7 @@ void CSmartnode::Check(bool fForce)
             nActiveState = SMARTNODE_EXPIRED;
             if(nActiveStatePrev != nActiveState) {
                 LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
+                mnodeman.NotifySmartnodeListChanged();
             }
             return;
         }
@@ -221,6 +228,7 @@ void CSmartnode::Check(bool fForce)
         nActiveState = SMARTNODE_PRE_ENABLED;
         if(nActiveStatePrev != nActiveState) {
             LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
+            mnodeman.NotifySmartnodeListChanged();
         }
         return;
     }
@@ -228,6 +236,7 @@ void CSmartnode::Check(bool fForce)
     nActiveState = SMARTNODE_ENABLED; // OK
     if(nActiveStatePrev != nActiveState) {
         LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
+        mnodeman.NotifySmartnodeListChanged();
     }
 }
 
@@ -601,6 +610,18 @@ bool CSmartnodeBroadcast::CheckOutpoint(int& nDos)
     return true;
 }
 
+std::string CSmartnodeBroadcast::GetSignatureMessage() const
+{
+    return addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
+                    pubKeyCollateralAddress.GetID().ToString() + pubKeySmartnode.GetID().ToString() +
+                    boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
+CHashSignatureCheck CSmartnodeBroadcast::GetSignatureCheck() const
+{
+    return CHashSignatureCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), vchSig);
+}
+
 bool CSmartnodeBroadcast::Sign(const CKey& keyCollateralAddress)
 {
     std::string strError;
@@ -608,9 +629,7 @@ bool CSmartnodeBroadcast::Sign(const CKey& keyCollateralAddress)
 
     sigTime = GetAdjustedTime();
 
-    strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
-                    pubKeyCollateralAddress.GetID().ToString() + pubKeySmartnode.GetID().ToString() +
-                    boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSig, keyCollateralAddress)) {
         LogPrintf("CSmartnodeBroadcast::Sign -- SignMessage() failed\n");
@@ -631,9 +650,7 @@ bool CSmartnodeBroadcast::CheckSignature(int& nDos)
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
-                    pubKeyCollateralAddress.GetID().ToString() + pubKeySmartnode.GetID().ToString() +
-                    boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetSignatureMessage();
 
     LogPrint("smartnode", "CSmartnodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
@@ -668,14 +685,24 @@ CSmartnodePing::CSmartnodePing(const COutPoint& outpoint)
     sigTime = GetAdjustedTime();
 }
 
+std::string CSmartnodePing::GetSignatureMessage() const
+{
+    // TODO: add sentinel data
+    return CTxIn(outpoint).ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
+CHashSignatureCheck CSmartnodePing::GetSignatureCheck() const
+{
+    return CHashSignatureCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), vchSig);
+}
+
 bool CSmartnodePing::Sign(const CKey& keySmartnode, const CPubKey& pubKeySmartnode)
 {
     std::string strError;
     std::string strSmartNodeSignMessage;
 
-    // TODO: add sentinel data
     sigTime = GetAdjustedTime();
-    std::string strMessage = CTxIn(outpoint).ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSig, keySmartnode)) {
         LogPrintf("CSmartnodePing::Sign -- SignMessage() failed\n");
@@ -692,8 +719,7 @@ bool CSmartnodePing::Sign(const CKey& keySmartnode, const CPubKey& pubKeySmartno
 
 bool CSmartnodePing::CheckSignature(CPubKey& pubKeySmartnode, int &nDos)
 {
-    // TODO: add sentinel data
-    std::string strMessage = CTxIn(outpoint).ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
     std::string strError = "";
     nDos = 0;
 
@@ -932,6 +958,7 @@ void ThreadSmartnode(CConnman& connman)
                 mnodeman.CheckAndRemove(connman);
                 mnpayments.CheckAndRemove();
                 instantsend.CheckAndRemove();
+                instantsend.WriteIndex();
             }
 
             if(fSmartNode && (nTick % (60 * 5) == 0)) {
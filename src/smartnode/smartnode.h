@@ -6,6 +6,7 @@
 #define SMARTNODE_H
 
 #include "../key.h"
+#include "../messagesigner.h"
 #include "../validation.h"
 #include "spork.h"
 
@@ -85,6 +86,8 @@ public:
 
     bool IsExpired() const { return GetAdjustedTime() - sigTime > SMARTNODE_NEW_START_REQUIRED_SECONDS; }
 
+    std::string GetSignatureMessage() const;
+    CHashSignatureCheck GetSignatureCheck() const;
     bool Sign(const CKey& keySmartnode, const CPubKey& pubKeySmartnode);
     bool CheckSignature(CPubKey& pubKeySmartnode, int &nDos);
     bool SimpleCheck(int& nDos);
@@ -357,6 +360,8 @@ public:
     bool Update(CSmartnode* pmn, int& nDos, CConnman& connman);
     bool CheckOutpoint(int& nDos);
 
+    std::string GetSignatureMessage() const;
+    CHashSignatureCheck GetSignatureCheck() const;
     bool Sign(const CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
     void Relay(CConnman& connman);
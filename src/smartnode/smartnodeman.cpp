@@ -6,6 +6,7 @@
 #include "../addrman.h"
 //#include "governance.h"
 #include "../messagesigner.h"
+#include "../sigverifier.h"
 #include "script/standard.h"
 #include "smartnodepayments.h"
 #include "smartnodesync.h"
@@ -49,14 +50,87 @@ struct CompareByAddr
     }
 };
 
-struct CompareRankPair
+CSmartnodeRanks::CSmartnodeRanks(std::map<COutPoint, CSmartnode>& mapSmartnodes, const uint256& nBlockHash, int nMinProtocol)
 {
-    bool operator()(const CSmartnodeMan::rank_pair_t& t1,
-                    const CSmartnodeMan::rank_pair_t& t2) const
-    {
-        return t1.first < t2.first;
+    // calculate scores
+    vecScores.reserve(mapSmartnodes.size());
+
+    for (auto& mnpair : mapSmartnodes) {
+        if (mnpair.second.nProtocolVersion >= nMinProtocol) {
+            vecScores.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
+        }
+    }
+
+    sort(vecScores.rbegin(), vecScores.rend(), CompareScoreMN());
+
+    // enabled smartnodes get ranked by their score, all others go to the end without rank
+    std::vector<CSmartnode*> vecNoRank;
+    vecRanks.reserve(vecScores.size());
+    mapRanks.reserve(vecScores.size());
+
+    int nRank = 0;
+    for (auto& scorePair : vecScores) {
+
+        if( scorePair.second->IsEnabled() ){
+            nRank++;
+            vecRanks.push_back(std::make_pair(nRank, scorePair.second));
+            mapRanks.emplace(scorePair.second->vin.prevout, nRank);
+        }else{
+            vecNoRank.push_back(scorePair.second);
+            mapRanks.emplace(scorePair.second->vin.prevout, MNPAYMENTS_NO_RANK);
+        }
+    }
+
+    for (auto pmn : vecNoRank) {
+        vecRanks.push_back(std::make_pair(MNPAYMENTS_NO_RANK, pmn));
+    }
+}
+
+bool CSmartnodeRanks::GetRank(const COutPoint& outpoint, int& nRankRet) const
+{
+    auto it = mapRanks.find(outpoint);
+
+    if( it == mapRanks.end() )
+        return false;
+
+    nRankRet = it->second;
+    return true;
+}
+
+CSmartnodeRanksRef CSmartnodeRanksCache::Get(std::map<COutPoint, CSmartnode>& mapSmartnodes, uint64_t nListVersionIn, const uint256& nBlockHash, int nMinProtocol)
+{
+    if( nListVersionIn != nListVersion ){
+        Clear();
+        nListVersion = nListVersionIn;
+    }
+
+    key_t key = std::make_pair(nBlockHash, nMinProtocol);
+    auto it = mapEntries.find(key);
+
+    if( it != mapEntries.end() ){
+        // move it to the front, it's the most recently used one now
+        listEntries.splice(listEntries.begin(), listEntries, it->second);
+        return it->second->second;
+    }
+
+    CSmartnodeRanksRef ranks = std::make_shared<const CSmartnodeRanks>(mapSmartnodes, nBlockHash, nMinProtocol);
+
+    listEntries.push_front(std::make_pair(key, ranks));
+    mapEntries[key] = listEntries.begin();
+
+    while( listEntries.size() > nMaxEntries ){
+        mapEntries.erase(listEntries.back().first);
+        listEntries.pop_back();
     }
-};
+
+    return ranks;
+}
+
+void CSmartnodeRanksCache::Clear()
+{
+    listEntries.clear();
+    mapEntries.clear();
+}
 
 CSmartnodeMan::CSmartnodeMan()
 : cs(),
@@ -72,6 +146,8 @@ CSmartnodeMan::CSmartnodeMan()
   fSmartnodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  nListVersion(0),
+  ranksCache(RANKS_CACHE_MAX_ENTRIES),
   mapSeenSmartnodeBroadcast(),
   mapSeenSmartnodePing(),
   nDsqCount(0)
@@ -84,6 +160,7 @@ bool CSmartnodeMan::Add(CSmartnode &mn)
     LogPrint("smartnode", "CSmartnodeMan::Add -- Adding new Smartnode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapSmartnodes[mn.vin.prevout] = mn;
     fSmartnodesAdded = true;
+    NotifySmartnodeListChanged();
     return true;
 }
 
@@ -204,6 +281,7 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
                 it->second.FlagGovernanceItemsAsDirty();
                 mapSmartnodes.erase(it++);
                 fSmartnodesRemoved = true;
+                NotifySmartnodeListChanged();
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
                             smartnodeSync.IsSynced() &&
@@ -358,6 +436,8 @@ void CSmartnodeMan::Clear()
 {
     LOCK(cs);
     mapSmartnodes.clear();
+    ranksCache.Clear();
+    NotifySmartnodeListChanged();
     mAskedUsForSmartnodeList.clear();
     mWeAskedForSmartnodeList.clear();
     mWeAskedForSmartnodeListEntry.clear();
@@ -620,27 +700,27 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     return false;
 }
 
-bool CSmartnodeMan::GetSmartnodeScores(const uint256& nBlockHash, CSmartnodeMan::score_pair_vec_t& vecSmartnodeScoresRet, int nMinProtocol)
+CSmartnodeRanksRef CSmartnodeMan::GetSmartnodeRanksRef(int nBlockHeight, int nMinProtocol)
 {
-    vecSmartnodeScoresRet.clear();
-
-    if (!smartnodeSync.IsSmartnodeListSynced())
-        return false;
-
+    AssertLockHeld(cs_main);
     AssertLockHeld(cs);
 
     if (mapSmartnodes.empty())
-        return false;
+        return nullptr;
 
-    // calculate scores
-    for (auto& mnpair : mapSmartnodes) {
-        if (mnpair.second.nProtocolVersion >= nMinProtocol) {
-            vecSmartnodeScoresRet.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
-        }
+    // make sure we know about this block
+    uint256 nBlockHash = uint256();
+    if (!GetBlockHash(nBlockHash, nBlockHeight)) {
+        LogPrintf("CSmartnodeMan::%s -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", __func__, nBlockHeight);
+        return nullptr;
     }
 
-    sort(vecSmartnodeScoresRet.rbegin(), vecSmartnodeScoresRet.rend(), CompareScoreMN());
-    return !vecSmartnodeScoresRet.empty();
+    CSmartnodeRanksRef ranks = ranksCache.Get(mapSmartnodes, nListVersion, nBlockHash, nMinProtocol);
+
+    if( ranks->vecScores.empty() )
+        return nullptr;
+
+    return ranks;
 }
 
 bool CSmartnodeMan::GetSmartnodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
@@ -650,20 +730,11 @@ bool CSmartnodeMan::GetSmartnodeRank(const COutPoint& outpoint, int& nRankRet, i
     if (!smartnodeSync.IsSmartnodeListSynced())
         return false;
 
-    CSmartnodeMan::rank_pair_vec_t vecSmartnodeRanks;
-    if (!GetSmartnodeRanks(vecSmartnodeRanks, nBlockHeight, nMinProtocol))
-        return false;
-
-    auto hasRank = std::find_if(vecSmartnodeRanks.begin(), vecSmartnodeRanks.end(), [outpoint](const CSmartnodeMan::rank_pair_t &rankPair) -> bool {
-        return outpoint == rankPair.second.vin.prevout;
-    });
+    LOCK2(cs_main, cs);
 
-    if( hasRank != vecSmartnodeRanks.end() ){
-        nRankRet = hasRank->first;
-        return true;
-    }
+    CSmartnodeRanksRef ranks = GetSmartnodeRanksRef(nBlockHeight, nMinProtocol);
 
-    return false;
+    return ranks && ranks->GetRank(outpoint, nRankRet);
 }
 
 bool CSmartnodeMan::GetSmartnodeRanks(CSmartnodeMan::rank_pair_vec_t& vecSmartnodeRanksRet, int nBlockHeight, int nMinProtocol)
@@ -675,30 +746,17 @@ bool CSmartnodeMan::GetSmartnodeRanks(CSmartnodeMan::rank_pair_vec_t& vecSmartno
 
     LOCK2(cs_main, cs);
 
-    // make sure we know about this block
-    uint256 nBlockHash = uint256();
-    if (!GetBlockHash(nBlockHash, nBlockHeight)) {
-        LogPrintf("CSmartnodeMan::%s -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", __func__, nBlockHeight);
-        return false;
-    }
+    CSmartnodeRanksRef ranks = GetSmartnodeRanksRef(nBlockHeight, nMinProtocol);
 
-    score_pair_vec_t vecSmartnodeScores;
-    if (!GetSmartnodeScores(nBlockHash, vecSmartnodeScores, nMinProtocol))
+    if( !ranks )
         return false;
 
-    int nRank = 0;
-    for (auto& scorePair : vecSmartnodeScores) {
+    vecSmartnodeRanksRet.reserve(ranks->vecRanks.size());
 
-        if( scorePair.second->IsEnabled() ){
-            nRank++;
-            vecSmartnodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
-        }else{
-            vecSmartnodeRanksRet.push_back(std::make_pair(MNPAYMENTS_NO_RANK, *scorePair.second));
-        }
+    for (const auto& rankPair : ranks->vecRanks) {
+        vecSmartnodeRanksRet.push_back(std::make_pair(rankPair.first, *rankPair.second));
     }
 
-    std::sort(vecSmartnodeRanksRet.begin(), vecSmartnodeRanksRet.end(), CompareRankPair());
-
     return true;
 }
 
@@ -798,66 +856,14 @@ void CSmartnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         CSmartnodeBroadcast mnb;
         vRecv >> mnb;
 
-        if(!smartnodeSync.IsSmartNodeSyncStarted()) return;
-
-        pfrom->setAskFor.erase(mnb.GetHash());
-
-        LogPrint("smartnode", "MNANNOUNCE -- Smartnode announce, smartnode=%s\n", mnb.vin.prevout.ToStringShort());
-
-        int nDos = 0;
+        ProcessBroadcast(pfrom, mnb, connman);
 
-        if (CheckMnbAndUpdateSmartnodeList(pfrom, mnb, nDos, connman)) {
-            // use announced Smartnode as a peer
-            connman.AddNewAddress(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
-        } else if(nDos > 0) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), nDos);
-        }
-
-        if(fSmartnodesAdded) {
-            NotifySmartnodeUpdates(connman);
-        }
     } else if (strCommand == NetMsgType::MNPING) { //Smartnode Ping
 
         CSmartnodePing mnp;
         vRecv >> mnp;
 
-        uint256 nHash = mnp.GetHash();
-
-        pfrom->setAskFor.erase(nHash);
-
-        if(!smartnodeSync.IsSmartNodeSyncStarted()) return;
-
-        LogPrint("smartnode", "MNPING -- Smartnode ping, smartnode=%s\n", mnp.outpoint.ToStringShort());
-
-        // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
-        LOCK2(cs_main, cs);
-
-        if(mapSeenSmartnodePing.count(nHash)) return; //seen
-        mapSeenSmartnodePing.insert(std::make_pair(nHash, mnp));
-
-        LogPrint("smartnode", "MNPING -- Smartnode ping, smartnode=%s new\n", mnp.outpoint.ToStringShort());
-
-        // see if we have this Smartnode
-        CSmartnode* pmn = Find(mnp.outpoint);
-
-        // too late, new MNANNOUNCE is required
-        if(pmn && pmn->IsNewStartRequired()) return;
-
-        int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
-
-        if(nDos > 0) {
-            // if anything significant failed, mark that node
-            Misbehaving(pfrom->GetId(), nDos);
-        } else if(pmn != NULL) {
-            // nothing significant failed, mn is a known one too
-            return;
-        }
-
-        // something significant is broken or mn is unknown,
-        // we might have to ask for a smartnode entry once
-        AskForMN(pfrom, mnp.outpoint, connman);
+        ProcessPing(pfrom, mnp, connman);
 
     } else if (strCommand == NetMsgType::DSEG) { //Get Smartnode list or specific entry
         // Ignore such requests until we are fully synced.
@@ -908,6 +914,113 @@ void CSmartnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
     }
 }
 
+void CSmartnodeMan::ProcessBroadcast(CNode* pfrom, CSmartnodeBroadcast& mnb, CConnman& connman)
+{
+    if(!smartnodeSync.IsSmartNodeSyncStarted()) return;
+
+    pfrom->setAskFor.erase(mnb.GetHash());
+
+    LogPrint("smartnode", "MNANNOUNCE -- Smartnode announce, smartnode=%s\n", mnb.vin.prevout.ToStringShort());
+
+    int nDos = 0;
+
+    if (CheckMnbAndUpdateSmartnodeList(pfrom, mnb, nDos, connman)) {
+        // use announced Smartnode as a peer
+        connman.AddNewAddress(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
+    } else if(nDos > 0) {
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), nDos);
+    }
+
+    if(fSmartnodesAdded) {
+        NotifySmartnodeUpdates(connman);
+    }
+}
+
+void CSmartnodeMan::ProcessPing(CNode* pfrom, CSmartnodePing& mnp, CConnman& connman)
+{
+    uint256 nHash = mnp.GetHash();
+
+    pfrom->setAskFor.erase(nHash);
+
+    if(!smartnodeSync.IsSmartNodeSyncStarted()) return;
+
+    LogPrint("smartnode", "MNPING -- Smartnode ping, smartnode=%s\n", mnp.outpoint.ToStringShort());
+
+    // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
+    LOCK2(cs_main, cs);
+
+    if(mapSeenSmartnodePing.count(nHash)) return; //seen
+    mapSeenSmartnodePing.insert(std::make_pair(nHash, mnp));
+
+    LogPrint("smartnode", "MNPING -- Smartnode ping, smartnode=%s new\n", mnp.outpoint.ToStringShort());
+
+    // see if we have this Smartnode
+    CSmartnode* pmn = Find(mnp.outpoint);
+
+    // too late, new MNANNOUNCE is required
+    if(pmn && pmn->IsNewStartRequired()) return;
+
+    int nDos = 0;
+    if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
+
+    if(nDos > 0) {
+        // if anything significant failed, mark that node
+        Misbehaving(pfrom->GetId(), nDos);
+    } else if(pmn != NULL) {
+        // nothing significant failed, mn is a known one too
+        return;
+    }
+
+    // something significant is broken or mn is unknown,
+    // we might have to ask for a smartnode entry once
+    AskForMN(pfrom, mnp.outpoint, connman);
+}
+
+std::shared_ptr<CPrefetchedMessage> CSmartnodeMan::PrefetchMessage(const std::string& strCommand, CDataStream& vRecv, std::vector<CHashSignatureCheck>& vecChecksRet)
+{
+    if(fLiteMode) return nullptr; // disable all SmartCash specific functionality
+
+    if (strCommand == NetMsgType::MNANNOUNCE) {
+
+        auto prefetched = std::make_shared<CPrefetchedMessageObject<CSmartnodeBroadcast> >();
+        CSmartnodeBroadcast& mnb = prefetched->object;
+        vRecv >> mnb;
+
+        if(!smartnodeSync.IsSmartNodeSyncStarted()) return prefetched;
+
+        LOCK(cs);
+
+        // seen broadcasts and pings don't get their signatures checked again
+        if(!mapSeenSmartnodeBroadcast.count(mnb.GetHash())) {
+            vecChecksRet.push_back(mnb.GetSignatureCheck());
+            if(mnb.lastPing != CSmartnodePing() && !mapSeenSmartnodePing.count(mnb.lastPing.GetHash())) {
+                vecChecksRet.push_back(mnb.lastPing.GetSignatureCheck());
+            }
+        }
+
+        return prefetched;
+
+    } else if (strCommand == NetMsgType::MNPING) {
+
+        auto prefetched = std::make_shared<CPrefetchedMessageObject<CSmartnodePing> >();
+        CSmartnodePing& mnp = prefetched->object;
+        vRecv >> mnp;
+
+        if(!smartnodeSync.IsSmartNodeSyncStarted()) return prefetched;
+
+        LOCK(cs);
+
+        if(!mapSeenSmartnodePing.count(mnp.GetHash())) {
+            vecChecksRet.push_back(mnp.GetSignatureCheck());
+        }
+
+        return prefetched;
+    }
+
+    return nullptr;
+}
+
 void CSmartnodeMan::SyncSingle(CNode* pnode, const COutPoint& outpoint, CConnman& connman)
 {
     // do not provide any data until our node is synced
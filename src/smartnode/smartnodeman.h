@@ -6,16 +6,77 @@
 #define SMARTNODEMAN_H
 
 #include "smartnode.h"
+#include "../coins.h"
 #include "../sync.h"
 
+#include <atomic>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
 using namespace std;
 
 class CSmartnodeMan;
 class CConnman;
+class CPrefetchedMessage;
 struct CSmartNodeWinners;
 
 extern CSmartnodeMan mnodeman;
 
+/**
+ * Scores and ranks of all smartnodes for one block hash and minimum protocol
+ * version. The entries point into CSmartnodeMan::mapSmartnodes and are only
+ * valid while CSmartnodeMan::cs is held and the list did not change since
+ * the ranks were calculated.
+ */
+class CSmartnodeRanks
+{
+public:
+    typedef std::pair<arith_uint256, CSmartnode*> score_pair_t;
+    typedef std::pair<int, CSmartnode*> rank_ptr_pair_t;
+
+    /// Scores of all smartnodes matching the protocol, best score first
+    std::vector<score_pair_t> vecScores;
+    /// Ranks sorted ascending, not enabled smartnodes last with MNPAYMENTS_NO_RANK
+    std::vector<rank_ptr_pair_t> vecRanks;
+    /// Rank of each smartnode in vecRanks
+    std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapRanks;
+
+    CSmartnodeRanks(std::map<COutPoint, CSmartnode>& mapSmartnodes, const uint256& nBlockHash, int nMinProtocol);
+
+    bool GetRank(const COutPoint& outpoint, int& nRankRet) const;
+};
+
+typedef std::shared_ptr<const CSmartnodeRanks> CSmartnodeRanksRef;
+
+/**
+ * LRU cache of CSmartnodeRanks keyed by (block hash, minimum protocol).
+ * The cache is tied to a version of the smartnode list and drops all
+ * entries as soon as it gets asked with a different version.
+ */
+class CSmartnodeRanksCache
+{
+public:
+    typedef std::pair<uint256, int> key_t;
+
+private:
+    typedef std::list<std::pair<key_t, CSmartnodeRanksRef> > entry_list_t;
+
+    size_t nMaxEntries;
+    uint64_t nListVersion;
+    entry_list_t listEntries;
+    std::map<key_t, entry_list_t::iterator> mapEntries;
+
+public:
+    CSmartnodeRanksCache(size_t nMaxEntriesIn) : nMaxEntries(nMaxEntriesIn), nListVersion(0) {}
+
+    /// Get the ranks for nBlockHash, calculate them if they are not cached for nListVersionIn yet.
+    CSmartnodeRanksRef Get(std::map<COutPoint, CSmartnode>& mapSmartnodes, uint64_t nListVersionIn, const uint256& nBlockHash, int nMinProtocol);
+
+    void Clear();
+    size_t size() const { return listEntries.size(); }
+};
+
 class CSmartnodeMan
 {
 public:
@@ -42,6 +103,8 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const size_t RANKS_CACHE_MAX_ENTRIES     = 8;
+
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
@@ -77,11 +140,17 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    /// Bumped whenever a smartnode gets added, removed or changes its state/protocol
+    std::atomic<uint64_t> nListVersion;
+    /// Scores and ranks per (block hash, min protocol) of the current list version
+    CSmartnodeRanksCache ranksCache;
+
     friend class CSmartnodeSync;
     /// Find an entry
     CSmartnode* Find(const COutPoint& outpoint);
 
-    bool GetSmartnodeScores(const uint256& nBlockHash, score_pair_vec_t& vecSmartnodeScoresRet, int nMinProtocol = 0);
+    /// Get the cached scores and ranks for nBlockHeight, requires cs_main and cs
+    CSmartnodeRanksRef GetSmartnodeRanksRef(int nBlockHeight, int nMinProtocol);
 
 public:
     // Keep track of all broadcasts I've seen
@@ -119,6 +188,9 @@ public:
 
         READWRITE(mapSeenSmartnodeBroadcast);
         READWRITE(mapSeenSmartnodePing);
+        if(ser_action.ForRead()) {
+            NotifySmartnodeListChanged();
+        }
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
@@ -189,6 +261,11 @@ public:
     void ProcessPendingMnvRequests(CConnman& connman);
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+    void ProcessBroadcast(CNode* pfrom, CSmartnodeBroadcast& mnb, CConnman& connman);
+    void ProcessPing(CNode* pfrom, CSmartnodePing& mnp, CConnman& connman);
+    /// Deserialize a received mnb/mnp ahead of ProcessMessage and add the signatures
+    /// which still need a check to vecChecksRet, returns nullptr for other messages
+    std::shared_ptr<CPrefetchedMessage> PrefetchMessage(const std::string& strCommand, CDataStream& vRecv, std::vector<CHashSignatureCheck>& vecChecksRet);
 
     void DoFullVerificationStep(CConnman& connman);
     void CheckSameAddr();
@@ -197,6 +274,9 @@ public:
     void ProcessVerifyReply(CNode* pnode, CSmartnodeVerification& mnv);
     void ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerification& mnv);
 
+    /// Invalidate the cached scores and ranks, called when the list or the state of a smartnode changed
+    void NotifySmartnodeListChanged() { ++nListVersion; }
+
     /// Return the number of (unique) Smartnodes
     int size() { return mapSmartnodes.size(); }
 
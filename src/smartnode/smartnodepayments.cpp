@@ -9,6 +9,7 @@
 #include "smartnodeman.h"
 #include "smarthive/hive.h"
 #include "../messagesigner.h"
+#include "../sigverifier.h"
 #include "netfulfilledman.h"
 #include "script/standard.h"
 #include "spork.h"
@@ -386,97 +387,144 @@ void CSmartnodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand, C
         CSmartnodePaymentVote vote;
         vRecv >> vote;
 
-        uint256 nHash = vote.GetHash();
+        ProcessPaymentVote(pfrom, vote, connman);
+    }
+}
 
-        pfrom->setAskFor.erase(nHash);
+void CSmartnodePayments::ProcessPaymentVote(CNode* pfrom, CSmartnodePaymentVote& vote, CConnman& connman)
+{
+    uint256 nHash = vote.GetHash();
 
-        // TODO: clear setAskFor for MSG_SMARTNODE_PAYMENT_BLOCK too
+    pfrom->setAskFor.erase(nHash);
 
-        // Ignore any payments messages until smartnode list is synced
-        if(!smartnodeSync.IsSmartnodeListSynced()) return;
+    // TODO: clear setAskFor for MSG_SMARTNODE_PAYMENT_BLOCK too
 
-        {
-            LOCK(cs_mapSmartnodePaymentVotes);
+    // Ignore any payments messages until smartnode list is synced
+    if(!smartnodeSync.IsSmartnodeListSynced()) return;
 
-            auto res = mapSmartnodePaymentVotes.emplace(nHash, vote);
+    {
+        LOCK(cs_mapSmartnodePaymentVotes);
 
-            // Avoid processing same vote multiple times if it was already verified earlier
-            if(!res.second && res.first->second.IsVerified()) {
-                LogPrint("mnpayments", "SMARTNODEPAYMENTVOTE -- hash=%s, nBlockHeight=%d/%d seen\n",
-                            nHash.ToString(), vote.nBlockHeight, nCachedBlockHeight);
-                return;
-            }
+        auto res = mapSmartnodePaymentVotes.emplace(nHash, vote);
 
-            res.first->second.MarkAsNotVerified();
+        // Avoid processing same vote multiple times if it was already verified earlier
+        if(!res.second && res.first->second.IsVerified()) {
+            LogPrint("mnpayments", "SMARTNODEPAYMENTVOTE -- hash=%s, nBlockHeight=%d/%d seen\n",
+                        nHash.ToString(), vote.nBlockHeight, nCachedBlockHeight);
+            return;
         }
 
-        int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
+        res.first->second.MarkAsNotVerified();
+    }
 
-        if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight + MNPAYMENTS_FUTURE_VOTES * 2) {
-            LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
-            return;
-        }
+    int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
 
-        std::string strError = "";
-        if(!vote.IsValid(pfrom, nCachedBlockHeight, strError, connman)) {
-            LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
-            return;
-        }
+    if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight + MNPAYMENTS_FUTURE_VOTES * 2) {
+        LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
+        return;
+    }
 
-        smartnode_info_t mnInfo;
-        if(!mnodeman.GetSmartnodeInfo(vote.vinSmartnode.prevout, mnInfo)) {
-            // mn was not found, so we can't check vote, some info is probably missing
-            LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- smartnode is missing %s\n", vote.vinSmartnode.prevout.ToStringShort());
-            mnodeman.AskForMN(pfrom, vote.vinSmartnode.prevout, connman);
-            return;
-        }
+    std::string strError = "";
+    if(!vote.IsValid(pfrom, nCachedBlockHeight, strError, connman)) {
+        LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
+        return;
+    }
 
-        int nDos = 0;
-        if(!vote.CheckSignature(mnInfo.pubKeySmartnode, nCachedBlockHeight, nDos)) {
-            if(nDos) {
-                LOCK(cs_main);
-                LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- ERROR: invalid signature\n");
-                Misbehaving(pfrom->GetId(), nDos);
-            } else {
-                // only warn about anything non-critical (i.e. nDos == 0) in debug mode
-                LogPrint("mnpayments", "SMARTNODEPAYMENTVOTE -- WARNING: invalid signature\n");
-            }
-            // Either our info or vote info could be outdated.
-            // In case our info is outdated, ask for an update,
-            mnodeman.AskForMN(pfrom, vote.vinSmartnode.prevout, connman);
-            // but there is nothing we can do if vote info itself is outdated
-            // (i.e. it was signed by a mn which changed its key),
-            // so just quit here.
-            return;
-        }
+    smartnode_info_t mnInfo;
+    if(!mnodeman.GetSmartnodeInfo(vote.vinSmartnode.prevout, mnInfo)) {
+        // mn was not found, so we can't check vote, some info is probably missing
+        LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- smartnode is missing %s\n", vote.vinSmartnode.prevout.ToStringShort());
+        mnodeman.AskForMN(pfrom, vote.vinSmartnode.prevout, connman);
+        return;
+    }
 
-        if(!UpdateLastVote(vote)) {
-            LogPrintf("SMARTNODEPAYMENTVOTE -- smartnode already voted, smartnode=%s\n", vote.vinSmartnode.prevout.ToStringShort());
-            return;
+    int nDos = 0;
+    if(!vote.CheckSignature(mnInfo.pubKeySmartnode, nCachedBlockHeight, nDos)) {
+        if(nDos) {
+            LOCK(cs_main);
+            LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- ERROR: invalid signature\n");
+            Misbehaving(pfrom->GetId(), nDos);
+        } else {
+            // only warn about anything non-critical (i.e. nDos == 0) in debug mode
+            LogPrint("mnpayments", "SMARTNODEPAYMENTVOTE -- WARNING: invalid signature\n");
         }
+        // Either our info or vote info could be outdated.
+        // In case our info is outdated, ask for an update,
+        mnodeman.AskForMN(pfrom, vote.vinSmartnode.prevout, connman);
+        // but there is nothing we can do if vote info itself is outdated
+        // (i.e. it was signed by a mn which changed its key),
+        // so just quit here.
+        return;
+    }
 
-        for( const auto& payee : vote.payees ){
-            CTxDestination address1;
-            ExtractDestination(payee, address1);
-            CBitcoinAddress address2(address1);
+    if(!UpdateLastVote(vote)) {
+        LogPrintf("SMARTNODEPAYMENTVOTE -- smartnode already voted, smartnode=%s\n", vote.vinSmartnode.prevout.ToStringShort());
+        return;
+    }
 
-            LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s, hash=%s new\n",
-                        address2.ToString(), vote.nBlockHeight, nCachedBlockHeight, vote.vinSmartnode.prevout.ToStringShort(), nHash.ToString());
-        }
+    for( const auto& payee : vote.payees ){
+        CTxDestination address1;
+        ExtractDestination(payee, address1);
+        CBitcoinAddress address2(address1);
+
+        LogPrint("mnpaymentvote", "SMARTNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s, hash=%s new\n",
+                    address2.ToString(), vote.nBlockHeight, nCachedBlockHeight, vote.vinSmartnode.prevout.ToStringShort(), nHash.ToString());
+    }
 
-        if(AddOrUpdatePaymentVote(vote)){
-            vote.Relay(connman);
-            smartnodeSync.BumpAssetLastTime("SMARTNODEPAYMENTVOTE");
+    if(AddOrUpdatePaymentVote(vote)){
+        vote.Relay(connman);
+        smartnodeSync.BumpAssetLastTime("SMARTNODEPAYMENTVOTE");
+    }
+}
+
+std::shared_ptr<CPrefetchedMessage> CSmartnodePayments::PrefetchMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, std::vector<CHashSignatureCheck>& vecChecksRet)
+{
+    if(fLiteMode) return nullptr; // disable all SmartCash specific functionality
+
+    if (strCommand == NetMsgType::SMARTNODEPAYMENTVOTE) {
+
+        // obsolete peers get rejected by ProcessMessage before the vote is read
+        if(pfrom->nVersion < GetMinSmartnodePaymentsProto()) return nullptr;
+
+        auto prefetched = std::make_shared<CPrefetchedMessageObject<CSmartnodePaymentVote> >();
+        CSmartnodePaymentVote& vote = prefetched->object;
+        vRecv >> vote;
+
+        if(!smartnodeSync.IsSmartnodeListSynced()) return prefetched;
+
+        {
+            LOCK(cs_mapSmartnodePaymentVotes);
+            auto it = mapSmartnodePaymentVotes.find(vote.GetHash());
+            if(it != mapSmartnodePaymentVotes.end() && it->second.IsVerified()) return prefetched;
         }
+
+        int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
+        if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight + MNPAYMENTS_FUTURE_VOTES * 2) return prefetched;
+
+        vecChecksRet.push_back(vote.GetSignatureCheck());
+
+        return prefetched;
     }
+
+    return nullptr;
 }
 
-bool CSmartnodePaymentVote::Sign()
+std::string CSmartnodePaymentVote::GetSignatureMessage() const
 {
-    std::string strError;
-    std::string strMessage = vinSmartnode.prevout.ToStringShort() +
+    return vinSmartnode.prevout.ToStringShort() +
                 boost::lexical_cast<std::string>(nBlockHeight) +
                 payees.ToString();
+}
+
+CHashSignatureCheck CSmartnodePaymentVote::GetSignatureCheck() const
+{
+    return CHashSignatureCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), vchSig);
+}
+
+bool CSmartnodePaymentVote::Sign()
+{
+    std::string strError;
+    std::string strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSig, activeSmartnode.keySmartnode)) {
         LogPrintf("CSmartnodePaymentVote::Sign -- SignMessage() failed\n");
@@ -1041,9 +1089,7 @@ bool CSmartnodePaymentVote::CheckSignature(const CPubKey& pubKeySmartnode, int n
     // do not ban by default
     nDos = 0;
 
-    std::string strMessage = vinSmartnode.prevout.ToStringShort() +
-                boost::lexical_cast<std::string>(nBlockHeight) +
-                payees.ToString();
+    std::string strMessage = GetSignatureMessage();
 
     std::string strError = "";
     if (!CMessageSigner::VerifyMessage(pubKeySmartnode, vchSig, strMessage, strError)) {
@@ -183,6 +183,8 @@ public:
         return ss.GetHash();
     }
 
+    std::string GetSignatureMessage() const;
+    CHashSignatureCheck GetSignatureCheck() const;
     bool Sign();
     bool CheckSignature(const CPubKey& pubKeySmartnode, int nValidationHeight, int &nDos);
 
@@ -246,6 +248,10 @@ public:
 
     int GetMinSmartnodePaymentsProto();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+    void ProcessPaymentVote(CNode* pfrom, CSmartnodePaymentVote& vote, CConnman& connman);
+    /// Deserialize a received payment vote ahead of ProcessMessage and add its signature
+    /// to vecChecksRet if it still needs a check, returns nullptr for other messages
+    std::shared_ptr<CPrefetchedMessage> PrefetchMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, std::vector<CHashSignatureCheck>& vecChecksRet);
     std::string GetRequiredPaymentsString(int nBlockHeight);
     UniValue GetPaymentBlockObject(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, std::vector<CTxOut>& voutSmartNodes);
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "checkqueue.h"
 #include "consensus/consensus.h"
 #include "init.h"
 #include "smartrewards/rewards.h"
@@ -11,6 +12,7 @@
 #include "smartnode/smartnodepayments.h"
 #include "ui_interface.h"
 #include "validation.h"
+#include "memusage.h"
 
 #include <boost/thread.hpp>
 #include <boost/range/irange.hpp>
@@ -21,6 +23,59 @@ CSmartRewards *prewards = NULL;
 CCriticalSection cs_rewardsdb;
 CCriticalSection cs_rewardrounds;
 
+size_t nRewardsCacheUsage = (nRewardsDefaultDbCache << 20) - ((nRewardsDefaultDbCache << 20) / nRewardsDbCacheShare);
+
+static CCheckQueue<CSmartRewardEntryPrefetch> rewardsprefetchqueue(16);
+
+void ThreadSmartRewardsPrefetch() {
+    RenameThread("smartcash-rewardpf");
+    rewardsprefetchqueue.Thread();
+}
+
+bool CSmartRewardEntryPrefetch::operator()()
+{
+    // LevelDB supports concurrent reads, no need for cs_rewardsdb here.
+    *pfFound = pdb->ReadRewardEntry(pEntry->id, *pEntry);
+    return true;
+}
+
+CSmartRewardsSnapshot::CSmartRewardsSnapshot(CSmartRewardsDB *pdbIn, const CSmartRewardEntryLayerRef &pendingIn, const CSmartRewardBlock &blockIn, const CSmartRewardRound &currentRoundIn, const CSmartRewardRoundList &finishedRoundsIn) :
+    pdb(pdbIn), psnapshot(pdbIn->GetSnapshot()), pending(pendingIn), block(blockIn), currentRound(currentRoundIn), finishedRounds(finishedRoundsIn)
+{
+}
+
+CSmartRewardsSnapshot::~CSmartRewardsSnapshot()
+{
+    pdb->ReleaseSnapshot(psnapshot);
+}
+
+bool CSmartRewardsSnapshot::GetRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry) const
+{
+    // The newest layer comes first.
+    for( const CSmartRewardEntryLayer *pLayer = pending.get(); pLayer; pLayer = pLayer->pprev.get() ){
+
+        auto it = pLayer->entries.find(id);
+
+        if( it != pLayer->entries.end() ){
+            if( it->second->balance <= 0 ) return false;
+            entry = *it->second;
+            return true;
+        }
+    }
+
+    return pdb->ReadRewardEntry(id, entry, psnapshot);
+}
+
+bool CSmartRewardsSnapshot::GetRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results) const
+{
+    return pdb->ReadRewardRoundResults(round, results, psnapshot);
+}
+
+bool CSmartRewardsSnapshot::GetRewardPayouts(const int16_t round, CSmartRewardRoundResultList &payouts) const
+{
+    return pdb->ReadRewardPayouts(round, payouts, psnapshot);
+}
+
 // Used for time conversions.
 boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
 
@@ -69,10 +124,18 @@ void CalculateRewardRatio(CSmartRewardRound &round)
     }
 }
 
-bool CSmartRewards::Verify()
+bool CSmartRewards::Verify(bool fFull)
 {
     LOCK(cs_rewardsdb);
-    return pdb->Verify(rewardHeight);
+
+    // A round finalization which could not be continued at startup leaves
+    // the rounds and payees half written, never continue with them.
+    CSmartRewardRoundJournal journal;
+    if( pdb->ReadRoundJournal(journal) ){
+        return error("CSmartRewards::Verify - Unfinished %s of round %d", journal.fUndo ? "undo" : "finalization", journal.current.number);
+    }
+
+    return pdb->Verify(rewardHeight, fFull);
 }
 
 
@@ -163,22 +226,138 @@ void CSmartRewards::EvaluateRound(CSmartRewardRound &current, CSmartRewardRound
     }
 }
 
-bool CSmartRewards::StartFirstRound(const CSmartRewardRound &first, const CSmartRewardEntryList &entries)
+bool CSmartRewards::ProcessRoundJournal(CSmartRewardRoundJournal &journal)
 {
     LOCK(cs_rewardsdb);
-    return pdb->StartFirstRound(first,entries);
+
+    int nTime1 = GetTimeMicros();
+
+    // Walk through the entries (or the snapshot when undoing) in bounded batches
+    // and store the progress with each batch to keep the memory usage flat.
+    while( journal.nStep == CSmartRewardRoundJournal::STEP_ENTRIES ){
+
+        CSmartRewardEntryList entries;
+        CSmartRewardRoundSnapshot snapshot;
+        uint32_t nChunk = journal.nChunks;
+
+        if( journal.fUndo ){
+
+            if( !pdb->ReadRewardRoundSnapshot(journal.current.number, nChunk, snapshot) ) break;
+
+            journal.nProcessed += snapshot.results.size();
+            ++journal.nChunks;
+
+        }else{
+
+            const CSmartAddress *pLast = journal.nProcessed ? &journal.lastId : nullptr;
+
+            if( !pdb->ReadRewardEntries(pLast, nRewardsFinalizeBatchEntries, entries) ){
+                return error("CSmartRewards::ProcessRoundJournal - Failed to read reward entries");
+            }
+
+            if( entries.empty() ){
+                CalculateRewardRatio(journal.next);
+                journal.nStep = CSmartRewardRoundJournal::STEP_ORDER;
+                break;
+            }
+
+            EvaluateRound(journal.current, journal.next, entries, snapshot.results);
+
+            journal.lastId = entries.back().id;
+            journal.nProcessed += entries.size();
+
+            if( snapshot.results.size() ) ++journal.nChunks;
+        }
+
+        if( !pdb->WriteRoundJournal(journal, nChunk, entries, snapshot) ){
+            return error("CSmartRewards::ProcessRoundJournal - Failed to write batch");
+        }
+    }
+
+    if( !journal.fUndo ){
+
+        // Bring the payees into the order they get paid. Since we use payouts stretched
+        // out over a week the 1.3 rounds use some "random" order based on a score calculated
+        // with the round start's blockhash. The order is kept in the database, one snapshot
+        // record at a time.
+        bool fScore = journal.current.number >= Params().GetConsensus().nRewardsFirst_1_3_Round;
+
+        while( journal.nStep == CSmartRewardRoundJournal::STEP_ORDER ){
+
+            CSmartRewardRoundSnapshot snapshot;
+
+            if( journal.nOrdered < journal.nChunks ){
+
+                if( !pdb->ReadRewardRoundSnapshot(journal.current.number, journal.nOrdered, snapshot) ){
+                    return error("CSmartRewards::ProcessRoundJournal - Failed to read round %d snapshot %d", journal.current.number, journal.nOrdered);
+                }
+
+                ++journal.nOrdered;
+            }
+
+            if( journal.nOrdered == journal.nChunks ) journal.nStep = CSmartRewardRoundJournal::STEP_PAYEES;
+
+            if( !pdb->WriteRoundPayeeOrder(journal, snapshot, fScore) ){
+                return error("CSmartRewards::ProcessRoundJournal - Failed to write the payee order");
+            }
+        }
+
+        // Split the ordered payees into the payee records, again in bounded batches.
+        bool fDone = false;
+
+        while( !fDone ){
+            if( !pdb->WriteRoundPayees(journal, nRewardsFinalizeBatchEntries, fDone) ){
+                return error("CSmartRewards::ProcessRoundJournal - Failed to write the payees");
+            }
+        }
+    }
+
+    if( !pdb->CommitRoundJournal(journal) ){
+        return error("CSmartRewards::ProcessRoundJournal - Failed to commit round %d", journal.current.number);
+    }
+
+    int nTime2 = GetTimeMicros();
+
+    LogPrint("smartrewards-block", "CSmartRewards::ProcessRoundJournal - Round %d%s: %d entries, %d payees - %.2fms\n", journal.current.number, journal.fUndo ? " (undo)" : "", journal.nProcessed, journal.nPayees, (nTime2 - nTime1) * 0.001);
+
+    return true;
 }
 
-bool CSmartRewards::FinalizeRound(const CSmartRewardRound &current, const CSmartRewardRound &next, const CSmartRewardEntryList &entries, const CSmartRewardRoundResultList &results)
+bool CSmartRewards::FinalizeRound(const CBlockIndex *pIndex, CSmartRewardRound &current, CSmartRewardRound &next)
 {
     LOCK(cs_rewardsdb);
-    return pdb->FinalizeRound(current, next, entries, results);
+
+    UpdatePayoutParameter(current);
+
+    uint256 hashStartBlock;
+
+    if( current.number ){
+
+        const CBlockIndex *pStartIndex = pIndex->GetAncestor(current.startBlockHeight);
+
+        if( !pStartIndex ){
+            return error("CSmartRewards::FinalizeRound - No start block %d for round %d", current.startBlockHeight, current.number);
+        }
+
+        hashStartBlock = pStartIndex->GetBlockHash();
+    }
+
+    CSmartRewardRoundJournal journal(false, current, next, hashStartBlock);
+
+    if( !ProcessRoundJournal(journal) ) return false;
+
+    next = journal.next;
+
+    return true;
 }
 
-bool CSmartRewards::UndoFinalizeRound(const CSmartRewardRound &current, const CSmartRewardRoundResultList &results)
+bool CSmartRewards::UndoFinalizeRound(const CSmartRewardRound &current)
 {
     LOCK(cs_rewardsdb);
-    return pdb->UndoFinalizeRound(current, results);
+
+    CSmartRewardRoundJournal journal(true, current, CSmartRewardRound(), uint256());
+
+    return ProcessRoundJournal(journal);
 }
 
 bool CSmartRewards::GetRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results)
@@ -193,10 +372,16 @@ bool CSmartRewards::GetRewardPayouts(const int16_t round, CSmartRewardRoundResul
     return pdb->ReadRewardPayouts(round, payouts);
 }
 
-bool CSmartRewards::GetRewardPayouts(const int16_t round, CSmartRewardRoundResultPtrList &payouts)
+bool CSmartRewards::GetRewardPayeeCount(const int16_t round, int64_t &nPayees)
 {
     LOCK(cs_rewardsdb);
-    return pdb->ReadRewardPayouts(round, payouts);
+    return pdb->ReadRewardPayeeCount(round, nPayees);
+}
+
+bool CSmartRewards::GetRewardPayoutBlock(const int16_t round, const uint32_t nRewardBlock, CSmartRewardRoundResultPtrList &payouts)
+{
+    LOCK(cs_rewardsdb);
+    return pdb->ReadRewardPayoutBlock(round, nRewardBlock, payouts);
 }
 
 bool CSmartRewards::GetCachedRewardEntry(const CSmartAddress &id, CSmartRewardEntry *&entry)
@@ -214,10 +399,31 @@ bool CSmartRewards::GetCachedRewardEntry(const CSmartAddress &id, CSmartRewardEn
     return false;
 }
 
+// Only used by the block processing, it caches what it reads.
 bool CSmartRewards::ReadRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry)
 {
     LOCK(cs_rewardsdb);
-    return pdb->ReadRewardEntry(id,entry);
+
+    // Already looked up by the block prefetch.
+    if( setPrefetchMissing.count(id) ) return false;
+
+    auto it = cacheEntries.find(id);
+
+    if( it != cacheEntries.end() ){
+        if( it->second.balance <= 0 ) return false;
+        entry = it->second;
+        return true;
+    }
+
+    if( !pdb->ReadRewardEntry(id,entry) ){
+        // Remember the miss, the entry gets created by the block anyway.
+        cacheEntries.insert(std::make_pair(id, CSmartRewardEntry(id)));
+        return false;
+    }
+
+    cacheEntries.insert(std::make_pair(id, entry));
+
+    return true;
 }
 
 bool CSmartRewards::GetRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry)
@@ -231,36 +437,161 @@ bool CSmartRewards::GetRewardEntry(const CSmartAddress &id, CSmartRewardEntry &e
         return true;
     }
 
-    return ReadRewardEntry(id,entry);
+    // Read through, the cache only gets populated by the block processing.
+    auto it = cacheEntries.find(id);
+
+    if( it != cacheEntries.end() ){
+        if( it->second.balance <= 0 ) return false;
+        entry = it->second;
+        return true;
+    }
+
+    return pdb->ReadRewardEntry(id,entry);
 }
 
-bool CSmartRewards::GetRewardEntries(CSmartRewardEntryList &entries)
+CSmartRewardsSnapshotRef CSmartRewards::GetSnapshot() const
 {
-    LOCK(cs_rewardsdb);
-    return pdb->ReadRewardEntries(entries);
+    LOCK(csSnapshot);
+    return snapshot;
 }
 
-bool CSmartRewards::SyncCached(bool fUndo)
+void CSmartRewards::UpdateSnapshot(bool fFlushed)
 {
-    return SyncCached(CSmartRewardBlock(), fUndo);
+    CSmartRewardsSnapshotRef next;
+
+    {
+        // Called right after a commit or a flush. The database matches the
+        // last flush, the layers carry the entries committed since then up
+        // to currentBlock.
+        LOCK2(cs_rewardsdb, cs_rewardrounds);
+
+        if( fFlushed ){
+            snapshotLayer.reset();
+        }else if( !setSnapshotEntries.empty() ){
+
+            // Copy only the entries committed since the last update, the
+            // ones before are shared with the previous snapshots.
+            std::shared_ptr<CSmartRewardEntryLayer> layer = std::make_shared<CSmartRewardEntryLayer>();
+
+            BOOST_FOREACH(const CSmartAddress &id, setSnapshotEntries) {
+                layer->entries.insert(std::make_pair(id, std::make_shared<const CSmartRewardEntry>(cacheEntries.find(id)->second)));
+            }
+
+            if( snapshotLayer && snapshotLayer->nLayers >= nRewardsSnapshotMaxLayers ){
+                // Merge the stack to keep the lookups short, the entries
+                // itself are shared. Newer layers win on insert.
+                for( const CSmartRewardEntryLayer *pLayer = snapshotLayer.get(); pLayer; pLayer = pLayer->pprev.get() ){
+                    layer->entries.insert(pLayer->entries.begin(), pLayer->entries.end());
+                }
+            }else if( snapshotLayer ){
+                layer->pprev = snapshotLayer;
+                layer->nLayers = snapshotLayer->nLayers + 1;
+            }
+
+            snapshotLayer = layer;
+        }
+
+        setSnapshotEntries.clear();
+
+        next = std::make_shared<const CSmartRewardsSnapshot>(pdb, snapshotLayer, currentBlock, currentRound, finishedRounds);
+    }
+
+    // Swap outside of the database locks, the last reader of the old
+    // snapshot releases it.
+    LOCK(csSnapshot);
+    snapshot.swap(next);
 }
 
-bool CSmartRewards::SyncCached(const CSmartRewardBlock &block, bool fUndo)
+void CSmartRewards::CommitCache(bool fUndo)
 {
-    LOCK2(cs_rewardsdb, cs_rewardrounds);
-
-    bool ret =  pdb->SyncCached(block, currentRound, rewardEntries, transactionEntries, fUndo);
+    LOCK(cs_rewardsdb);
 
     for( std::pair<CSmartAddress, CSmartRewardEntry*> it : rewardEntries ){
+        cacheEntries[it.first] = *it.second;
+        setDirtyEntries.insert(it.first);
+        setSnapshotEntries.insert(it.first);
         delete it.second;
     }
 
+    BOOST_FOREACH(const CSmartRewardTransaction &t, transactionEntries) {
+        if( fUndo ){
+            cacheTransactions.erase(t.hash);
+            setErasedTransactions.insert(t.hash);
+        }else{
+            cacheTransactions[t.hash] = t;
+            setErasedTransactions.erase(t.hash);
+        }
+    }
+
     rewardEntries.clear();
     transactionEntries.clear();
+    setPrefetchMissing.clear();
+}
+
+void CSmartRewards::ClearCache()
+{
+    LOCK(cs_rewardsdb);
+
+    cacheEntries.clear();
+    setDirtyEntries.clear();
+    setSnapshotEntries.clear();
+    cacheTransactions.clear();
+    setErasedTransactions.clear();
+    cacheBlocks.clear();
+}
+
+bool CSmartRewards::Flush()
+{
+    int64_t nTime1 = GetTimeMicros();
+
+    size_t nEntries;
+    bool ret;
+
+    {
+        LOCK2(cs_rewardsdb, cs_rewardrounds);
+
+        CSmartRewardEntryList entries;
+        CSmartRewardBlockList blocks;
+
+        entries.reserve(setDirtyEntries.size());
+        blocks.reserve(cacheBlocks.size());
+
+        BOOST_FOREACH(const CSmartAddress &id, setDirtyEntries) {
+            entries.push_back(cacheEntries[id]);
+        }
+
+        for( const auto &it : cacheBlocks ){
+            blocks.push_back(it.second);
+        }
+
+        nEntries = entries.size();
+        ret = pdb->WriteCache(currentBlock, currentRound, blocks, entries, cacheTransactions, setErasedTransactions);
+
+        // Keep nothing around on failure, the node gets shut down anyway.
+        ClearCache();
+    }
+
+    UpdateSnapshot(true);
+
+    int64_t nTime2 = GetTimeMicros();
+
+    LogPrint("smartrewards-block", "CSmartRewards::Flush - %d entries up to block %d - %.2fms\n", nEntries, currentBlock.nHeight, (nTime2 - nTime1) * 0.001);
 
     return ret;
 }
 
+size_t CSmartRewards::DynamicMemoryUsage() const
+{
+    LOCK(cs_rewardsdb);
+
+    return memusage::DynamicUsage(cacheEntries) +
+           memusage::DynamicUsage(setDirtyEntries) +
+           memusage::DynamicUsage(setSnapshotEntries) +
+           memusage::DynamicUsage(cacheTransactions) +
+           memusage::DynamicUsage(setErasedTransactions) +
+           memusage::DynamicUsage(cacheBlocks);
+}
+
 bool CSmartRewards::IsSynced()
 {
     int nSyncDistance = MainNet() ? nRewardsSyncDistance : nRewardsSyncDistance_Testnet;
@@ -303,6 +634,19 @@ CSmartRewards::CSmartRewards(CSmartRewardsDB *prewardsdb)  : pdb(prewardsdb)
 {
     LOCK(cs_rewardsdb);
 
+    CSmartRewardRoundJournal journal;
+
+    // Continue a round finalization which got interrupted.
+    if( pdb->ReadRoundJournal(journal) ){
+
+        LogPrintf("CSmartRewards - Continue %s of round %d after %d entries\n", journal.fUndo ? "undo" : "finalization", journal.current.number, journal.nProcessed);
+
+        // Verify() refuses the database if this fails.
+        if( !ProcessRoundJournal(journal) ){
+            error("CSmartRewards - Failed to process the round journal of round %d", journal.current.number);
+        }
+    }
+
     // Get the last written block of the rewards database.
     if(!pdb->ReadLastBlock(currentBlock)){
         // If there is no one available yet
@@ -321,6 +665,8 @@ CSmartRewards::CSmartRewards(CSmartRewardsDB *prewardsdb)  : pdb(prewardsdb)
     }
 
     pdb->ReadCurrentRound(currentRound);
+
+    UpdateSnapshot(true);
 }
 
 void CSmartRewards::Lock()
@@ -342,8 +688,70 @@ bool CSmartRewards::GetLastBlock(CSmartRewardBlock &block)
     return pdb->ReadLastBlock(block);
 }
 
+bool CSmartRewards::PruneTransactions()
+{
+    // Older versions recorded every transaction for the duplicate check, past
+    // nRewardsDuplicateTxHeight only the coinbase records are still needed.
+    if( pdb->IsTransactionsPruned(nRewardsDuplicateTxHeight) ) return true;
+
+    const Consensus::Params &consensus = Params().GetConsensus();
+    const int nStart = nRewardsDuplicateTxHeight + 1;
+    int nEnd;
+
+    {
+        LOCK2(cs_main, cs_rewardsdb);
+        nEnd = std::min(currentBlock.nHeight, chainActive.Height());
+    }
+
+    // Coinbase hash per height starting at nStart. A null hash marks a block
+    // which isn't available on disk, its records are kept.
+    std::vector<uint256> vecCoinbase;
+    vecCoinbase.reserve(std::max(0, nEnd - nStart + 1));
+
+    LogPrintf("CSmartRewards::PruneTransactions - Collecting the coinbase transactions of the blocks %d - %d...\n", nStart, nEnd);
+
+    for( int nHeight = nStart; nHeight <= nEnd; ++nHeight ){
+
+        boost::this_thread::interruption_point();
+
+        if( ShutdownRequested() ) return false;
+
+        if( (nHeight - nStart) % 10000 == 0 ){
+            int nProgress = (int)(100.0 * (nHeight - nStart) / (nEnd - nStart + 1));
+            uiInterface.InitMessage(strprintf(_("Pruning SmartRewards transactions... %d%%"), nProgress));
+            LogPrintf("CSmartRewards::PruneTransactions - Block %d, %d%%\n", nHeight, nProgress);
+        }
+
+        CBlockIndex *pindex;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[nHeight];
+        }
+
+        CBlock block;
+        if( pindex == NULL || !ReadBlockFromDisk(block, pindex, consensus) || block.vtx.empty() ){
+            vecCoinbase.push_back(uint256());
+        }else{
+            vecCoinbase.push_back(block.vtx[0].GetHash());
+        }
+    }
+
+    bool ret = pdb->PruneTransactions(nRewardsDuplicateTxHeight, [&vecCoinbase, nStart](const CSmartRewardTransaction &transaction){
+        int nIndex = transaction.blockHeight - nStart;
+        // Keep the records of blocks not covered by the walk above.
+        if( nIndex < 0 || nIndex >= (int)vecCoinbase.size() || vecCoinbase[nIndex].IsNull() ) return true;
+        return vecCoinbase[nIndex] == transaction.hash;
+    });
+
+    if( !ret ) LogPrintf("CSmartRewards::PruneTransactions - Failed to prune the transaction records!\n");
+
+    return ret;
+}
+
 bool CSmartRewards::GetTransaction(const uint256 hash, CSmartRewardTransaction &transaction)
 {
+    LOCK(cs_rewardsdb);
+
     // If the transaction is already in the cache use this one.
     BOOST_FOREACH(CSmartRewardTransaction t, transactionEntries) {
         if(t.hash == hash){
@@ -352,6 +760,16 @@ bool CSmartRewards::GetTransaction(const uint256 hash, CSmartRewardTransaction &
         }
     }
 
+    // Erased by a disconnected block, not flushed yet.
+    if( setErasedTransactions.count(hash) ) return false;
+
+    auto it = cacheTransactions.find(hash);
+
+    if( it != cacheTransactions.end() ){
+        transaction = it->second;
+        return true;
+    }
+
     return pdb->ReadTransaction(hash, transaction);
 }
 
@@ -378,8 +796,112 @@ void CSmartRewards::UpdateHeights(const int nHeight, const int nRewardHeight)
 
 void CSmartRewards::StartBlock()
 {
+    LOCK(cs_rewardsdb);
+
+    // Drop the leftovers of a block which failed to connect.
+    for( std::pair<CSmartAddress, CSmartRewardEntry*> it : rewardEntries ){
+        delete it.second;
+    }
+
     rewardEntries.clear();
     transactionEntries.clear();
+    setPrefetchMissing.clear();
+}
+
+void CSmartRewards::PrefetchBlock(const CBlockIndex* pIndex, const CBlock& block, CCoinsViewCache& coins)
+{
+    if( !pIndex->nHeight || pIndex->nHeight > sporkManager.GetSporkValue(SPORK_15_SMARTREWARDS_BLOCKS_ENABLED) ){
+        return;
+    }
+
+    int nTime1 = GetTimeMicros();
+
+    std::set<CSmartAddress> setIds;
+
+    // Collect all addresses the block's transactions will touch. The coins view
+    // is not thread safe so this part has to be done here.
+    BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+
+        if( !tx.IsCoinBase() ){
+
+            BOOST_FOREACH(const CTxIn &in, tx.vin) {
+
+                if( in.scriptSig.IsZerocoinSpend() ) continue;
+
+                std::vector<CSmartAddress> ids;
+                int required = ParseScript(coins.AccessCoin(in.prevout).out.scriptPubKey, ids);
+
+                if( required == 1 && ids.size() == 1 ) setIds.insert(ids.at(0));
+            }
+        }
+
+        BOOST_FOREACH(const CTxOut &out, tx.vout) {
+
+            if( out.scriptPubKey.IsZerocoinMint() ) continue;
+
+            std::vector<CSmartAddress> ids;
+            int required = ParseScript(out.scriptPubKey, ids);
+
+            if( required == 1 && ids.size() == 1 ) setIds.insert(ids.at(0));
+        }
+    }
+
+    LOCK(cs_rewardsdb);
+
+    std::vector<CSmartRewardEntry> vecEntries;
+    std::vector<char> vecFound(setIds.size(), 0);
+
+    vecEntries.reserve(setIds.size());
+
+    BOOST_FOREACH(const CSmartAddress &id, setIds) {
+
+        if( rewardEntries.find(id) != rewardEntries.end() ) continue;
+
+        auto it = cacheEntries.find(id);
+
+        if( it == cacheEntries.end() ){
+            vecEntries.push_back(CSmartRewardEntry(id));
+        }else if( it->second.balance > 0 ){
+            rewardEntries.insert(make_pair(id, new CSmartRewardEntry(it->second)));
+        }else{
+            setPrefetchMissing.insert(id);
+        }
+    }
+
+    if( nScriptCheckThreads && (int64_t)vecEntries.size() >= nRewardsPrefetchParallelMin ){
+
+        std::vector<CSmartRewardEntryPrefetch> vChecks;
+        vChecks.reserve(vecEntries.size());
+
+        for( size_t i = 0; i < vecEntries.size(); ++i ){
+            vChecks.push_back(CSmartRewardEntryPrefetch(pdb, &vecEntries[i], &vecFound[i]));
+        }
+
+        CCheckQueueControl<CSmartRewardEntryPrefetch> control(&rewardsprefetchqueue);
+        control.Add(vChecks);
+        control.Wait();
+
+    }else{
+        for( size_t i = 0; i < vecEntries.size(); ++i ){
+            vecFound[i] = pdb->ReadRewardEntry(vecEntries[i].id, vecEntries[i]);
+        }
+    }
+
+    // Entries which are not in the database yet get created by ProcessTransaction
+    // as usual, just remember them to avoid a second lookup there.
+    for( size_t i = 0; i < vecEntries.size(); ++i ){
+        if( vecFound[i] ){
+            rewardEntries.insert(make_pair(vecEntries[i].id, new CSmartRewardEntry(vecEntries[i])));
+            cacheEntries.insert(make_pair(vecEntries[i].id, vecEntries[i]));
+        }else{
+            setPrefetchMissing.insert(vecEntries[i].id);
+            cacheEntries.insert(make_pair(vecEntries[i].id, CSmartRewardEntry(vecEntries[i].id)));
+        }
+    }
+
+    int nTime2 = GetTimeMicros();
+
+    LogPrint("smartrewards-block", "CSmartRewards::PrefetchBlock - %d entries, %d new - %.2fms\n", vecEntries.size(), setPrefetchMissing.size(), (nTime2 - nTime1) * 0.001);
 }
 
 void CSmartRewards::ProcessTransaction(CBlockIndex* pIndex, const CTransaction& tx, CCoinsViewCache& coins, const CChainParams& chainparams, CSmartRewardsUpdateResult &result)
@@ -404,18 +926,23 @@ void CSmartRewards::ProcessTransaction(CBlockIndex* pIndex, const CTransaction&
 
     int nTime1 = GetTimeMicros();
 
-    CSmartRewardTransaction testTx;
+    // Duplicates are only possible up to nRewardsDuplicateTxHeight, coinbase
+    // transactions can repeat at any height.
+    if( nHeight <= nRewardsDuplicateTxHeight || tx.IsCoinBase() ){
 
-    // First check if the transaction hash did already come up in the past.
-    if( GetTransaction(tx.GetHash(), testTx) ){
+        CSmartRewardTransaction testTx;
 
-        // If yes we want to ignore it! There are some double appearing transactions in the history due to zerocoin exploits.
-        LogPrint("smartrewards-tx", "CSmartRewards::ProcessTransaction - [%s] Double appearance! First in %d - Now in %d\n", testTx.hash.ToString(), testTx.blockHeight, pIndex->nHeight);
-        return;
+        // First check if the transaction hash did already come up in the past.
+        if( GetTransaction(tx.GetHash(), testTx) ){
 
-    }else{
-        // If not save add it to the database.
-        AddTransaction(CSmartRewardTransaction(pIndex->nHeight, tx.GetHash()));
+            // If yes we want to ignore it! There are some double appearing transactions in the history due to zerocoin exploits.
+            LogPrint("smartrewards-tx", "CSmartRewards::ProcessTransaction - [%s] Double appearance! First in %d - Now in %d\n", testTx.hash.ToString(), testTx.blockHeight, pIndex->nHeight);
+            return;
+
+        }else{
+            // If not save add it to the database.
+            AddTransaction(CSmartRewardTransaction(pIndex->nHeight, tx.GetHash()));
+        }
     }
 
     CSmartAddress *voteProofCheck = nullptr;
@@ -687,13 +1214,16 @@ void CSmartRewards::UndoTransaction(CBlockIndex* pIndex, const CTransaction& tx,
 
     int nTime1 = GetTimeMicros();
 
-    CSmartRewardTransaction testTx;
+    // Only undo the first appearance of a duplicate, see ProcessTransaction.
+    if( nHeight <= nRewardsDuplicateTxHeight || tx.IsCoinBase() ){
 
-    // First check if the transaction hash did already come up in the past.
-    if( GetTransaction(tx.GetHash(), testTx) && testTx.blockHeight == pIndex->nHeight ){
-        AddTransaction(testTx);
-    }else{
-        return;
+        CSmartRewardTransaction testTx;
+
+        if( GetTransaction(tx.GetHash(), testTx) && testTx.blockHeight == pIndex->nHeight ){
+            AddTransaction(testTx);
+        }else{
+            return;
+        }
     }
 
     CSmartAddress *voteProofCheck = nullptr;
@@ -943,9 +1473,11 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
         return false;
     }
 
-    if(!SyncCached(result.block, false)){
-        LogPrintf("CSmartRewards::CommitBlock - Failed to sync cache - Initial!");
-        return false;
+    CommitCache(false);
+
+    {
+        LOCK(cs_rewardsdb);
+        cacheBlocks[result.block.nHeight] = result.block;
     }
 
     // Update the current block to the processed one
@@ -966,21 +1498,14 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
             // Estimate the block, gets updated on the end of the round to the real one.
             first.endBlockHeight = MainNet() ? nFirstRoundEndBlock : nFirstRoundEndBlock_Testnet;
 
-            CSmartRewardEntryList entries;
-            CSmartRewardRoundResultList results;
-
-            // Get the current entries
-            if( !GetRewardEntries(entries) ){
-                LogPrintf("CSmartRewards::CommitBlock - Failed to read all reward entries!");
+            // The finalization works on the database, bring it up to date first.
+            if( !Flush() ){
+                LogPrintf("CSmartRewards::CommitBlock - Failed to flush the cache!");
                 return false;
             }
 
-            // Evaluate the round and update the next rounds parameter.
-            EvaluateRound(currentRound, first, entries, results );
-
-            CalculateRewardRatio(first);
-
-            if( !StartFirstRound(first, entries) ){
+            // Evaluate the entries and update the first round's parameter.
+            if( !FinalizeRound(pIndex, currentRound, first) ){
                 LogPrintf("CSmartRewards::CommitBlock - Failed to finalize round!");
                 return false;
             }
@@ -1011,9 +1536,6 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
         currentRound.endBlockHeight = pIndex->nHeight;
         currentRound.endBlockTime = pIndex->GetBlockTime();
 
-        CSmartRewardEntryList entries;
-        CSmartRewardRoundResultList results;
-
         // Create the next round.
         CSmartRewardRound next;
         next.number = currentRound.number + 1;
@@ -1047,20 +1569,16 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
             next.endBlockTime = startTime + nBlocksPerRound * 55;
         }
 
-        // Get the current entries
-        if( !GetRewardEntries(entries) ){
-            LogPrintf("CSmartRewards::CommitBlock - Failed to read all reward entries!");
+        CalculateRewardRatio(currentRound);
+
+        // The finalization works on the database, bring it up to date first.
+        if( !Flush() ){
+            LogPrintf("CSmartRewards::CommitBlock - Failed to flush the cache!");
             return false;
         }
 
-        CalculateRewardRatio(currentRound);
-
         // Evaluate the round and update the next rounds parameter.
-        EvaluateRound(currentRound, next, entries, results);
-
-        CalculateRewardRatio(next);
-
-        if( !FinalizeRound(currentRound, next, entries, results) ){
+        if( !FinalizeRound(pIndex, currentRound, next) ){
             LogPrintf("CSmartRewards::CommitBlock - Failed to finalize round!");
             return false;
         }
@@ -1072,13 +1590,12 @@ bool CSmartRewards::CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateRe
         currentRound = next;
     }
 
-    if(!SyncCached()){
-        LogPrintf("CSmartRewards::CommitBlock - Failed to sync cached - Processed!");
-        return false;
-    }
-
     prewards->UpdateHeights(GetBlockHeight(pIndex), currentBlock.nHeight);
 
+    // While syncing the snapshot stays at the last flush, copying the
+    // pending entries for each block is not worth it there.
+    if( IsSynced() ) UpdateSnapshot(false);
+
     int nTime2 = GetTimeMicros();
 
     if( LogAcceptCategory("smartrewards-block") ){
@@ -1108,9 +1625,11 @@ bool CSmartRewards::CommitUndoBlock(CBlockIndex *pIndex, const CSmartRewardsUpda
         return false;
     }
 
-    if(!SyncCached(result.block, true)){
-        LogPrintf("CSmartRewards::CommitUndoBlock - Failed to sync cache - Initial!");
-        return false;
+    CommitCache(true);
+
+    {
+        LOCK(cs_rewardsdb);
+        cacheBlocks.erase(pIndex->nHeight);
     }
 
     currentBlock = CSmartRewardBlock(pIndex->pprev->nHeight, pIndex->pprev->GetBlockHash(), pIndex->pprev->GetBlockTime() );
@@ -1136,37 +1655,31 @@ bool CSmartRewards::CommitUndoBlock(CBlockIndex *pIndex, const CSmartRewardsUpda
 
         LOCK2(cs_rewardsdb, cs_rewardrounds);
 
+        // The undo works on the database, bring it up to date first.
+        if( !Flush() ){
+            LogPrintf("CSmartRewards::CommitUndoBlock - Failed to flush the cache!");
+            return false;
+        }
+
         // Recover the last round from the history as current round
         currentRound = finishedRounds.back();
         finishedRounds.pop_back();
 
         lastRound = finishedRounds.back();
 
-        CSmartRewardEntryList entries;
-        CSmartRewardRoundResultList results;
-
-        // Get the current entries
-        if( !GetRewardRoundResults(currentRound.number, results) ){
-            LogPrintf("CSmartRewards::CommitUndoBlock - Failed to read last round's results!");
-            return false;
-        }
-
         CalculateRewardRatio(currentRound);
 
-        if( !UndoFinalizeRound(currentRound, results) ){
+        if( !UndoFinalizeRound(currentRound) ){
             LogPrintf("CSmartRewards::CommitUndoBlock - Failed to finalize round!");
             return false;
         }
 
     }
 
-    if(!SyncCached(true)){
-        LogPrintf("CSmartRewards::CommitUndoBlock - Failed to sync cached - Processed!");
-        return false;
-    }
-
     prewards->UpdateHeights(GetBlockHeight(pIndex), currentBlock.nHeight);
 
+    if( IsSynced() ) UpdateSnapshot(false);
+
     int nTime2 = GetTimeMicros();
 
     if( LogAcceptCategory("smartrewards-block") ){
@@ -10,11 +10,23 @@
 #include <smartrewards/rewardsdb.h>
 #include "consensus/consensus.h"
 
+#include <memory>
+
 using namespace std;
 
 static const CAmount SMART_REWARDS_MIN_BALANCE = 1000 * COIN;
-// Cache max. n prepared entries before the sync (leveldb batch write).
-const int64_t nCacheEntires = 8000;
+// Share of -rewardsdbcache used by LevelDB, the rest goes to the reward entry cache.
+const int64_t nRewardsDbCacheShare = 4;
+// Max. number of reward entries evaluated per batch at the end of a round.
+const int64_t nRewardsFinalizeBatchEntries = 10000;
+// Duplicate txids came up through zerocoin spends, which are rejected after this height.
+// Only transactions up to it and coinbase transactions get checked for duplicates and
+// recorded. Coinbase txids can still repeat, BIP34 isn't enforced.
+const int nRewardsDuplicateTxHeight = HF_ZEROCOIN_DISABLE;
+// Minimum number of addresses touched by a block to read them in parallel.
+const int64_t nRewardsPrefetchParallelMin = 32;
+// Max. number of pending entry layers stacked by the snapshots before they get merged.
+const int nRewardsSnapshotMaxLayers = 16;
 // Minimum distance of the last processed block compared to the current chain
 // height to assume the rewards are synced.
 const int64_t nRewardsSyncDistance = 150;
@@ -39,11 +51,16 @@ const int64_t nFirstRoundStartBlock_Testnet = TESTNET_V1_2_PAYMENTS_HEIGHT;
 const int64_t nFirstRoundEndBlock_Testnet = nFirstRoundStartBlock_Testnet + 1000;
 
 void ThreadSmartRewards(bool fRecreate = false);
+/** Run an instance of the reward entry prefetch thread */
+void ThreadSmartRewardsPrefetch();
 CAmount CalculateRewardsForBlockRange(int64_t start, int64_t end);
 
 extern CCriticalSection cs_rewardsdb;
 extern CCriticalSection cs_rewardrounds;
 
+/** Memory budget of the reward entry cache, flushed by FlushStateToDisk once exceeded */
+extern size_t nRewardsCacheUsage;
+
 struct CSmartRewardsUpdateResult
 {
     int64_t disqualifiedEntries;
@@ -54,6 +71,75 @@ struct CSmartRewardsUpdateResult
     CSmartRewardsUpdateResult(const int nHeight, const uint256* pBlockHash, const int64_t nBlockTime) : disqualifiedEntries(0), disqualifiedSmart(0), qualifiedEntries(0), qualifiedSmart(0), block(nHeight, pBlockHash, nBlockTime) { }
 };
 
+/**
+ * Closure representing one reward entry lookup of a block prefetch.
+ * The result slots are owned by CSmartRewards::PrefetchBlock.
+ */
+class CSmartRewardEntryPrefetch
+{
+private:
+    CSmartRewardsDB *pdb;
+    CSmartRewardEntry *pEntry;
+    char *pfFound;
+
+public:
+    CSmartRewardEntryPrefetch(): pdb(nullptr), pEntry(nullptr), pfFound(nullptr) {}
+    CSmartRewardEntryPrefetch(CSmartRewardsDB *pdbIn, CSmartRewardEntry *pEntryIn, char *pfFoundIn) :
+        pdb(pdbIn), pEntry(pEntryIn), pfFound(pfFoundIn) {}
+
+    bool operator()();
+
+    void swap(CSmartRewardEntryPrefetch &check) {
+        std::swap(pdb, check.pdb);
+        std::swap(pEntry, check.pEntry);
+        std::swap(pfFound, check.pfFound);
+    }
+};
+
+/**
+ * Reward entries committed between two snapshot updates, stacked on the
+ * layer of the previous update. Layers are immutable once created and shared
+ * by all snapshots until the next flush.
+ */
+struct CSmartRewardEntryLayer
+{
+    std::map<CSmartAddress, std::shared_ptr<const CSmartRewardEntry>> entries;
+    std::shared_ptr<const CSmartRewardEntryLayer> pprev;
+    int nLayers;
+
+    CSmartRewardEntryLayer() : nLayers(1) {}
+};
+
+typedef std::shared_ptr<const CSmartRewardEntryLayer> CSmartRewardEntryLayerRef;
+
+/**
+ * Immutable read view of the SmartRewards state at the last committed block.
+ * It pairs a LevelDB snapshot with copies of the rounds and the layers of the
+ * reward entries changed since the last flush so that queries can run
+ * concurrently with the block processing and the round finalization.
+ */
+class CSmartRewardsSnapshot
+{
+    CSmartRewardsDB *pdb;
+    const leveldb::Snapshot *psnapshot;
+    // Entries not flushed to the database yet, a balance <= 0 marks an erased entry.
+    const CSmartRewardEntryLayerRef pending;
+
+public:
+    const CSmartRewardBlock block;
+    const CSmartRewardRound currentRound;
+    const CSmartRewardRoundList finishedRounds;
+
+    CSmartRewardsSnapshot(CSmartRewardsDB *pdbIn, const CSmartRewardEntryLayerRef &pendingIn, const CSmartRewardBlock &blockIn, const CSmartRewardRound &currentRoundIn, const CSmartRewardRoundList &finishedRoundsIn);
+    ~CSmartRewardsSnapshot();
+
+    bool GetRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry) const;
+    bool GetRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results) const;
+    bool GetRewardPayouts(const int16_t round, CSmartRewardRoundResultList &payouts) const;
+};
+
+typedef std::shared_ptr<const CSmartRewardsSnapshot> CSmartRewardsSnapshotRef;
+
 class CSmartRewards
 {
     CSmartRewardsDB * pdb;
@@ -65,34 +151,65 @@ class CSmartRewards
     int chainHeight;
     int rewardHeight;
 
+    // Transactions and reward entries of the block in progress, they get
+    // merged into the write-back cache when the block is committed.
     CSmartRewardTransactionList transactionEntries;
     CSmartRewardEntryMap rewardEntries;
+    // Addresses the last prefetch found not to be in the database yet.
+    std::set<CSmartAddress> setPrefetchMissing;
+
+    // Write-back cache of the reward entries. An entry with a balance <= 0
+    // stands for one which is not (or no longer) in the database.
+    CSmartRewardEntryCache cacheEntries;
+    // Entries of cacheEntries changed since the last flush.
+    std::set<CSmartAddress> setDirtyEntries;
+    // Transactions added and erased since the last flush.
+    CSmartRewardTransactionMap cacheTransactions;
+    std::set<uint256> setErasedTransactions;
+    // Block records committed since the last flush.
+    std::map<int, CSmartRewardBlock> cacheBlocks;
 
     mutable CCriticalSection csRounds;
 
+    // Entries of cacheEntries committed since the last snapshot update and
+    // the layer of the entries committed before, both reset on flush.
+    std::set<CSmartAddress> setSnapshotEntries;
+    CSmartRewardEntryLayerRef snapshotLayer;
+
+    // Read view of the last committed block, replaced after each commit.
+    CSmartRewardsSnapshotRef snapshot;
+    mutable CCriticalSection csSnapshot;
+
+    void UpdateSnapshot(bool fFlushed);
+    void CommitCache(bool fUndo);
+    void ClearCache();
+
     void UpdatePayoutParameter(CSmartRewardRound &round);
 
     bool GetCachedRewardEntry(const CSmartAddress &id, CSmartRewardEntry *&entry);
     bool ReadRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry);
-    bool GetRewardEntries(CSmartRewardEntryList &entries);
+    bool ProcessRoundJournal(CSmartRewardRoundJournal &journal);
     void AddTransaction(const CSmartRewardTransaction &transaction);
 public:
 
     CSmartRewards(CSmartRewardsDB *prewardsdb);
-    ~CSmartRewards() { delete pdb; }
+    ~CSmartRewards() { snapshot.reset(); delete pdb; }
     void Lock();
     bool IsLocked();
 
     bool GetLastBlock(CSmartRewardBlock &block);
     bool GetTransaction(const uint256 hash, CSmartRewardTransaction &transaction);
+    /** Erase the records of the duplicate check not needed anymore, needs the block index */
+    bool PruneTransactions();
     const CSmartRewardRound& GetCurrentRound();
     const CSmartRewardRound &GetLastRound();
     const CSmartRewardRoundList& GetRewardRounds();
 
     void UpdateHeights(const int nHeight, const int nRewardHeight);
-    bool Verify();
-    bool SyncCached(bool fUndo = false);
-    bool SyncCached(const CSmartRewardBlock &block, bool fUndo = false);
+    bool Verify(bool fFull = false);
+    /** Write the cached changes to the database, called by FlushStateToDisk before the coins get flushed */
+    bool Flush();
+    size_t DynamicMemoryUsage() const;
     bool IsSynced();
     double GetProgress();
     int GetLastHeight();
@@ -103,21 +220,24 @@ public:
     bool UpdateRound(const CSmartRewardRound &round);
 
     void StartBlock();
+    void PrefetchBlock(const CBlockIndex* pIndex, const CBlock& block, CCoinsViewCache& coins);
     void ProcessTransaction(CBlockIndex* pLastIndex, const CTransaction& tx, CCoinsViewCache& coins, const CChainParams& chainparams, CSmartRewardsUpdateResult &result);
     void UndoTransaction(CBlockIndex* pIndex, const CTransaction& tx, CCoinsViewCache& coins, const CChainParams& chainparams, CSmartRewardsUpdateResult &result);
     bool CommitBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateResult& result);
     bool CommitUndoBlock(CBlockIndex* pIndex, const CSmartRewardsUpdateResult& result);
 
     bool GetRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry);
+    /** Return the read view of the last committed block, doesn't block on the block processing */
+    CSmartRewardsSnapshotRef GetSnapshot() const;
 
     void EvaluateRound(CSmartRewardRound &current, CSmartRewardRound &next, CSmartRewardEntryList &entries, CSmartRewardRoundResultList &results);
-    bool StartFirstRound(const CSmartRewardRound &next, const CSmartRewardEntryList &entries);
-    bool FinalizeRound(const CSmartRewardRound &current, const CSmartRewardRound &next, const CSmartRewardEntryList &entries, const CSmartRewardRoundResultList &results);
-    bool UndoFinalizeRound(const CSmartRewardRound &current, const CSmartRewardRoundResultList &results);
+    bool FinalizeRound(const CBlockIndex *pIndex, CSmartRewardRound &current, CSmartRewardRound &next);
+    bool UndoFinalizeRound(const CSmartRewardRound &current);
 
     bool GetRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results);
     bool GetRewardPayouts(const int16_t round, CSmartRewardRoundResultList &payouts);
-    bool GetRewardPayouts(const int16_t round, CSmartRewardRoundResultPtrList &payouts);
+    bool GetRewardPayeeCount(const int16_t round, int64_t &nPayees);
+    bool GetRewardPayoutBlock(const int16_t round, const uint32_t nRewardBlock, CSmartRewardRoundResultPtrList &payouts);
 };
 
 /** Global variable that points to the active rewards object (protected by cs_main) */
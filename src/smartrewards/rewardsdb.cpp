@@ -4,6 +4,7 @@
 
 #include "smartrewards/rewardsdb.h"
 
+#include "arith_uint256.h"
 #include "chainparams.h"
 #include "hash.h"
 #include "pow.h"
@@ -19,14 +20,134 @@
 
 using namespace std;
 
+// Key of the snapshot and payee list records of a round. Big endian to keep
+// the records of a round in order.
+struct CSmartRewardRoundChunkKey
+{
+    uint32_t round;
+    uint32_t chunk;
+
+    CSmartRewardRoundChunkKey(uint32_t roundIn = 0, uint32_t chunkIn = 0) : round(roundIn), chunk(chunkIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 8;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata32be(s, round);
+        ser_writedata32be(s, chunk);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        round = ser_readdata32be(s);
+        chunk = ser_readdata32be(s);
+    }
+};
+
+// Key of the records which bring a round's payees into their payout order
+// while the round gets finalized. LevelDB keeps them sorted on disk so the
+// order doesn't need all payees in memory.
+struct CSmartRewardPayeeOrderKey
+{
+    static const size_t nOrderSize = 32 + 8 + 23;
+
+    uint32_t round;
+    std::vector<unsigned char> vchOrder;
+
+    CSmartRewardPayeeOrderKey(uint32_t roundIn = 0) : round(roundIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 4 + vchOrder.size();
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata32be(s, round);
+        if( vchOrder.size() ) s.write((const char*)vchOrder.data(), vchOrder.size());
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        round = ser_readdata32be(s);
+        vchOrder.resize(nOrderSize);
+        s.read((char*)vchOrder.data(), nOrderSize);
+    }
+};
+
+static void AppendOrderAmount(std::vector<unsigned char> &vch, const CAmount nAmount)
+{
+    // Big endian with the sign bit flipped, sorts like the signed value.
+    uint64_t n = uint64_t(nAmount) ^ (uint64_t(1) << 63);
+    for( int i = 7; i >= 0; --i ) vch.push_back((n >> (i * 8)) & 0xFF);
+}
+
+// Byte string which sorts like the payout order of the result, the score
+// (then the balance) for the 1.3 rounds, the address (then the reward)
+// before. The address comes last to make it unique.
+static std::vector<unsigned char> GetPayeeOrder(CSmartRewardRoundResult &result, bool fScore, const uint256 &hashStartBlock)
+{
+    std::vector<unsigned char> vchOrder, vchId;
+
+    CDataStream ss(SER_DISK, 0);
+    ss << result.entry.id;
+    vchId.assign(ss.begin(), ss.end());
+    vchId.resize(23, 0);
+
+    if( fScore ){
+        uint256 score = ArithToUint256(result.CalculateScore(hashStartBlock));
+        vchOrder.assign(score.begin(), score.end());
+        std::reverse(vchOrder.begin(), vchOrder.end());
+        AppendOrderAmount(vchOrder, result.entry.balance);
+        vchOrder.insert(vchOrder.end(), vchId.begin(), vchId.end());
+    }else{
+        vchOrder = vchId;
+        AppendOrderAmount(vchOrder, result.reward);
+        vchOrder.resize(CSmartRewardPayeeOrderKey::nOrderSize, 0);
+    }
+
+    return vchOrder;
+}
+
+// Read all chunks of a round stored under the given prefix in order.
+static bool ReadRoundChunks(CDBWrapper &db, const char chPrefix, const int16_t round, CSmartRewardRoundResultList &results, bool fPayoutsOnly, const leveldb::Snapshot *psnapshot)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator(psnapshot));
+
+    pcursor->Seek(make_pair(chPrefix, CSmartRewardRoundChunkKey(round, 0)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CSmartRewardRoundChunkKey> key;
+        if (pcursor->GetKey(key) && key.first == chPrefix && key.second.round == uint32_t(round)) {
+            CSmartRewardRoundSnapshot nValue;
+            if (pcursor->GetValue(nValue)) {
+                BOOST_FOREACH(const CSmartRewardRoundResult &r, nValue.results) {
+                    if( !fPayoutsOnly || r.reward ) results.push_back(r);
+                }
+                pcursor->Next();
+            } else {
+                return error("failed to get round %d chunk %d", round, key.second.chunk);
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
 static const char DB_ROUND_CURRENT = 'R';
 static const char DB_ROUND = 'r';
 static const char DB_ROUND_SNAPSHOT = 's';
+static const char DB_ROUND_JOURNAL = 'J';
+static const char DB_ROUND_PAYEES = 'p';
+static const char DB_ROUND_PAYEE_COUNT = 'P';
+static const char DB_ROUND_PAYEE_ORDER = 'o';
 
 static const char DB_REWARD_ENTRY = 'E';
 static const char DB_BLOCK = 'B';
 static const char DB_BLOCK_LAST = 'b';
+static const char DB_VERIFY_CHECKPOINT = 'K';
 static const char DB_TX_HASH = 't';
+static const char DB_TX_HASH_PRUNED = 'T';
 
 static const char DB_VERSION = 'V';
 static const char DB_LOCK = 'L';
@@ -41,10 +162,20 @@ CSmartRewardsDB::CSmartRewardsDB(size_t nCacheSize, bool fMemory, bool fWipe) :
 
 }
 
-bool CSmartRewardsDB::Verify(int& lastBlockHeight)
+void CSmartRewardVerifyCheckpoint::Add(const CSmartRewardBlock &block)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << hashRolling << block;
+
+    hashRolling = ss.GetHash();
+    nHeight = block.nHeight;
+    blockHash = block.blockHash;
+}
+
+bool CSmartRewardsDB::Verify(int& lastBlockHeight, bool fFull)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
     CSmartRewardBlock last;
+    CSmartRewardVerifyCheckpoint stored, checkpoint;
     uint8_t dbVersion;
 
     lastBlockHeight = 0;
@@ -66,37 +197,39 @@ bool CSmartRewardsDB::Verify(int& lastBlockHeight)
 
     lastBlockHeight = last.nHeight;
 
-    LogPrintf("CSmartRewards::Verify() Verify blocks 1 - %d\n", last.nHeight);
+    // The checkpoint is only usable if its block record was not replaced by a reorg since.
+    bool fCheckpoint = Read(DB_VERIFY_CHECKPOINT, stored) && stored.nHeight > 0 && stored.nHeight <= last.nHeight;
 
-    std::vector<CSmartRewardBlock> testBlocks;
+    if( fCheckpoint ){
+        CSmartRewardBlock block;
+        fCheckpoint = ReadBlock(stored.nHeight, block) && block.blockHash == stored.blockHash;
+    }
 
-    pcursor->Seek(DB_BLOCK);
+    if( fCheckpoint && !fFull ){
+        checkpoint = stored;
+    }
+
+    LogPrintf("CSmartRewards::Verify() Verify blocks %d - %d\n", checkpoint.nHeight + 1, last.nHeight);
+
+    for( int nHeight = checkpoint.nHeight + 1; nHeight <= last.nHeight; nHeight++ ){
 
-    while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,int> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK) {
-            CSmartRewardBlock nValue;
-            if (pcursor->GetValue(nValue)) {
-                if( nValue.nHeight != key.second ) return error("Block value %d contains wrong height: %s",key.second, nValue.ToString());
-                pcursor->Next();
-                testBlocks.push_back(nValue);
-            } else {
-                return error("failed to get block entry %d", key.second);
-            }
-        } else {
-            if( testBlocks.size() < size_t(last.nHeight) ) return error("Odd block count %d <> %d", testBlocks.size(), last.nHeight);
-            break;
-        }
-    }
 
-    std::sort(testBlocks.begin(), testBlocks.end());
-    vector<CSmartRewardBlock>::iterator it;
-    for(it = testBlocks.begin() + 1; it != testBlocks.end(); it++ )    {
-        if( (it-1)->nHeight + 1 != it->nHeight) return error("Block %d missing", it->nHeight);
+        CSmartRewardBlock block;
+
+        if( !ReadBlock(nHeight, block) ) return error("Block %d missing", nHeight);
+        if( block.nHeight != nHeight ) return error("Block value %d contains wrong height: %s", nHeight, block.ToString());
+
+        checkpoint.Add(block);
+
+        if( fCheckpoint && nHeight == stored.nHeight && checkpoint.hashRolling != stored.hashRolling )
+            return error("Block records 1 - %d don't match the verified state", nHeight);
     }
 
-    return true;
+    if( checkpoint.nHeight != last.nHeight || checkpoint.blockHash != last.blockHash )
+        return error("Last block %s doesn't match block %d", last.ToString(), checkpoint.nHeight);
+
+    return Write(DB_VERIFY_CHECKPOINT, checkpoint, true);
 }
 
 void CSmartRewardsDB::Lock()
@@ -134,6 +267,58 @@ bool CSmartRewardsDB::ReadTransaction(const uint256 hash, CSmartRewardTransactio
     return Read(make_pair(DB_TX_HASH,hash), transaction);
 }
 
+bool CSmartRewardsDB::IsTransactionsPruned(const int nHeight)
+{
+    int nPrunedHeight;
+    return Read(DB_TX_HASH_PRUNED, nPrunedHeight) && nPrunedHeight <= nHeight;
+}
+
+bool CSmartRewardsDB::PruneTransactions(const int nHeight, const std::function<bool(const CSmartRewardTransaction&)> &fKeep)
+{
+    if( IsTransactionsPruned(nHeight) ) return true;
+
+    LogPrintf("CSmartRewardsDB::PruneTransactions - Erasing transaction records above block %d...\n", nHeight);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    size_t nErased = 0;
+
+    pcursor->Seek(DB_TX_HASH);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,uint256> key;
+        if (pcursor->GetKey(key) && key.first == DB_TX_HASH) {
+            CSmartRewardTransaction transaction;
+            if (!pcursor->GetValue(transaction)) {
+                return error("failed to get reward transaction");
+            }
+
+            if( transaction.blockHeight > nHeight && !fKeep(transaction) ){
+                batch.Erase(key);
+                ++nErased;
+            }
+
+            if( batch.SizeEstimate() > (1 << 20) ){
+                if( !WriteBatch(batch) ) return false;
+                batch.Clear();
+            }
+
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    batch.Write(DB_TX_HASH_PRUNED, nHeight);
+
+    if( !WriteBatch(batch, true) ) return false;
+
+    LogPrintf("CSmartRewardsDB::PruneTransactions - Erased %d transaction records\n", nErased);
+
+    return true;
+}
+
 bool CSmartRewardsDB::ReadRound(const int16_t number, CSmartRewardRound &round)
 {
     return Read(make_pair(DB_ROUND,number), round);
@@ -169,161 +354,221 @@ bool CSmartRewardsDB::ReadCurrentRound(CSmartRewardRound &round)
     return Read(DB_ROUND_CURRENT, round);
 }
 
-bool CSmartRewardsDB::ReadRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry)
+bool CSmartRewardsDB::ReadRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry, const leveldb::Snapshot *psnapshot)
 {
-    return Read(make_pair(DB_REWARD_ENTRY,id), entry);
+    return Read(make_pair(DB_REWARD_ENTRY,id), entry, psnapshot);
 }
 
-bool CSmartRewardsDB::SyncCached(const CSmartRewardRound& current, const CSmartRewardEntryMap &rewards, const CSmartRewardTransactionList &transactions, bool fUndo)
-{
-    return SyncCached(CSmartRewardBlock(), current, rewards, transactions, fUndo);
-}
-bool CSmartRewardsDB::SyncCached(const CSmartRewardBlock &block, const CSmartRewardRound& current, const CSmartRewardEntryMap &rewards, const CSmartRewardTransactionList &transactions, bool fUndo)
+bool CSmartRewardsDB::WriteCache(const CSmartRewardBlock &last, const CSmartRewardRound& current, const CSmartRewardBlockList &blocks, const CSmartRewardEntryList &entries,
+                                 const CSmartRewardTransactionMap &transactions, const std::set<uint256> &erasedTransactions)
 {
     CDBBatch batch(*this);
 
-    BOOST_FOREACH(const PAIRTYPE(CSmartAddress, CSmartRewardEntry*)& r, rewards) {
-        if( r.second->balance <= 0 ){
-            batch.Erase(make_pair(DB_REWARD_ENTRY,r.first));
+    BOOST_FOREACH(const CSmartRewardEntry &e, entries) {
+        if( e.balance <= 0 ){
+            batch.Erase(make_pair(DB_REWARD_ENTRY,e.id));
         }else{
-            batch.Write(make_pair(DB_REWARD_ENTRY,r.first), *r.second);
+            batch.Write(make_pair(DB_REWARD_ENTRY,e.id), e);
         }
     }
 
-    BOOST_FOREACH(const CSmartRewardTransaction &t, transactions) {
+    BOOST_FOREACH(const uint256 &hash, erasedTransactions) {
+        batch.Erase(make_pair(DB_TX_HASH, hash));
+    }
 
-        if( fUndo ){
-            batch.Erase(make_pair(DB_TX_HASH, t.hash));
-        }else{
-            batch.Write(make_pair(DB_TX_HASH,t.hash), t);
-        }
+    BOOST_FOREACH(const PAIRTYPE(uint256, CSmartRewardTransaction)& t, transactions) {
+        batch.Write(make_pair(DB_TX_HASH,t.first), t.second);
     }
 
-    if( block.IsValid() ){
+    BOOST_FOREACH(const CSmartRewardBlock &block, blocks) {
         batch.Write(make_pair(DB_BLOCK,block.nHeight), block);
-        batch.Write(DB_BLOCK_LAST, block);
+    }
+
+    // The last block goes into the same batch as the changes it stands for.
+    if( last.IsValid() ){
+        batch.Write(DB_BLOCK_LAST, last);
     }
 
     batch.Write(DB_ROUND_CURRENT, current);
 
-    return WriteBatch(batch);
+    // Synced, the chainstate gets flushed right after and must never be ahead of the rewards.
+    return WriteBatch(batch, true);
+}
+
+bool CSmartRewardsDB::ReadRoundJournal(CSmartRewardRoundJournal &journal)
+{
+    return Read(DB_ROUND_JOURNAL, journal);
 }
 
-bool CSmartRewardsDB::StartFirstRound(const CSmartRewardRound &start, const CSmartRewardEntryList &entries)
+bool CSmartRewardsDB::WriteRoundJournal(const CSmartRewardRoundJournal &journal, const uint32_t nChunk, const CSmartRewardEntryList &entries, const CSmartRewardRoundSnapshot &snapshot)
 {
     CDBBatch batch(*this);
 
-    BOOST_FOREACH(const CSmartRewardEntry &e, entries) {
-        batch.Write(make_pair(DB_REWARD_ENTRY,e.id), e);
-    }
+    if( journal.fUndo ){
 
-    batch.Write(DB_ROUND_CURRENT, start);
+        batch.Erase(make_pair(DB_ROUND_SNAPSHOT, CSmartRewardRoundChunkKey(journal.current.number, nChunk)));
 
-    return WriteBatch(batch);
-}
+        BOOST_FOREACH(const CSmartRewardRoundResult &s, snapshot.results) {
+            batch.Write(make_pair(DB_REWARD_ENTRY,s.entry.id), s.entry);
+        }
 
-bool CSmartRewardsDB::FinalizeRound(const CSmartRewardRound &current, const CSmartRewardRound &next, const CSmartRewardEntryList &entries, const CSmartRewardRoundResultList &results)
-{
-    CDBBatch batch(*this);
+    }else{
 
-    BOOST_FOREACH(const CSmartRewardRoundResult &s, results) {
-        batch.Write(make_pair(DB_ROUND_SNAPSHOT, make_pair(current.number, s.entry.id)), s);
-    }
+        if( snapshot.results.size() ){
+            batch.Write(make_pair(DB_ROUND_SNAPSHOT, CSmartRewardRoundChunkKey(journal.current.number, nChunk)), snapshot);
+        }
 
-    BOOST_FOREACH(const CSmartRewardEntry &e, entries) {
-        batch.Write(make_pair(DB_REWARD_ENTRY,e.id), e);
+        BOOST_FOREACH(const CSmartRewardEntry &e, entries) {
+            batch.Write(make_pair(DB_REWARD_ENTRY,e.id), e);
+        }
     }
 
-    batch.Write(make_pair(DB_ROUND,current.number), current);
-    batch.Write(DB_ROUND_CURRENT, next);
+    batch.Write(DB_ROUND_JOURNAL, journal);
 
     return WriteBatch(batch);
 }
 
-bool CSmartRewardsDB::UndoFinalizeRound(const CSmartRewardRound &current, const CSmartRewardRoundResultList &results)
+bool CSmartRewardsDB::WriteRoundPayeeOrder(const CSmartRewardRoundJournal &journal, CSmartRewardRoundSnapshot &snapshot, bool fScore)
 {
     CDBBatch batch(*this);
 
-    BOOST_FOREACH(const CSmartRewardRoundResult &s, results) {
-        batch.Erase(make_pair(DB_ROUND_SNAPSHOT, make_pair(current.number, s.entry.id)));
-        batch.Write(make_pair(DB_REWARD_ENTRY,s.entry.id), s.entry);
+    BOOST_FOREACH(CSmartRewardRoundResult &r, snapshot.results) {
+        if( !r.reward ) continue;
+        CSmartRewardPayeeOrderKey key(journal.current.number);
+        key.vchOrder = GetPayeeOrder(r, fScore, journal.hashStartBlock);
+        batch.Write(make_pair(DB_ROUND_PAYEE_ORDER, key), r);
     }
 
-    batch.Erase(make_pair(DB_ROUND, current.number));
-    batch.Write(DB_ROUND_CURRENT, current);
+    batch.Write(DB_ROUND_JOURNAL, journal);
 
     return WriteBatch(batch);
 }
 
-bool CSmartRewardsDB::ReadRewardEntries(CSmartRewardEntryList &entries) {
+bool CSmartRewardsDB::WriteRoundPayees(CSmartRewardRoundJournal &journal, const size_t nMax, bool &fDone)
+{
+    CDBBatch batch(*this);
+    CSmartRewardRoundSnapshot chunk;
+    size_t nBlockPayees = std::max<int64_t>(journal.current.nBlockPayees, 1);
+    size_t nMoved = 0;
+
+    fDone = true;
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(DB_REWARD_ENTRY);
+    // The moved records get erased, the remaining ones always start at the beginning.
+    pcursor->Seek(make_pair(DB_ROUND_PAYEE_ORDER, CSmartRewardPayeeOrderKey(journal.current.number)));
 
+    // Store the payees in payout order, one record for each payout block.
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CSmartAddress> key;
-        if (pcursor->GetKey(key) && key.first == DB_REWARD_ENTRY) {
-            CSmartRewardEntry nValue;
-            if (pcursor->GetValue(nValue)) {
-                entries.push_back(nValue);
-                pcursor->Next();
-            } else {
-                return error("failed to get reward entry");
+        std::pair<char,CSmartRewardPayeeOrderKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ROUND_PAYEE_ORDER && key.second.round == uint32_t(journal.current.number)) {
+
+            CSmartRewardRoundResult result;
+            if (!pcursor->GetValue(result)) {
+                return error("failed to get round %d payee", journal.current.number);
             }
+
+            chunk.results.push_back(result);
+            batch.Erase(key);
+            ++journal.nPayees;
+
+            if( chunk.results.size() == nBlockPayees ){
+                batch.Write(make_pair(DB_ROUND_PAYEES, CSmartRewardRoundChunkKey(journal.current.number, journal.nPayeeChunks++)), chunk);
+                chunk.results.clear();
+
+                // Only stop at the end of a payout block to not write partial records.
+                if( (nMoved += nBlockPayees) >= nMax ){
+                    fDone = false;
+                    break;
+                }
+            }
+
+            pcursor->Next();
         } else {
             break;
         }
     }
 
-    return true;
+    if( chunk.results.size() ){
+        batch.Write(make_pair(DB_ROUND_PAYEES, CSmartRewardRoundChunkKey(journal.current.number, journal.nPayeeChunks++)), chunk);
+    }
+
+    batch.Write(DB_ROUND_JOURNAL, journal);
+
+    return WriteBatch(batch);
 }
 
-bool CSmartRewardsDB::ReadRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results) {
+bool CSmartRewardsDB::CommitRoundJournal(const CSmartRewardRoundJournal &journal)
+{
+    CDBBatch batch(*this);
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    if( journal.fUndo ){
 
-    pcursor->Seek(make_pair(DB_ROUND_SNAPSHOT,round));
+        boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,std::pair<int16_t, CSmartAddress>> key;
-        if (pcursor->GetKey(key) && key.first == DB_ROUND_SNAPSHOT) {
+        pcursor->Seek(make_pair(DB_ROUND_PAYEES, CSmartRewardRoundChunkKey(journal.current.number, 0)));
 
-            if( key.second.first != round ) break;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char,CSmartRewardRoundChunkKey> key;
+            if (pcursor->GetKey(key) && key.first == DB_ROUND_PAYEES && key.second.round == journal.current.number) {
+                batch.Erase(key);
+
+                // The journal stays until the last batch, an interrupted undo erases the rest.
+                if( batch.SizeEstimate() > (1 << 20) ){
+                    if( !WriteBatch(batch) ) return false;
+                    batch.Clear();
+                }
 
-            CSmartRewardRoundResult nValue;
-            if (pcursor->GetValue(nValue)) {
-                results.push_back(nValue);
                 pcursor->Next();
             } else {
-                return error("failed to get reward entry");
+                break;
             }
-        } else {
-            break;
         }
+
+        batch.Erase(make_pair(DB_ROUND_PAYEE_COUNT, journal.current.number));
+        batch.Erase(make_pair(DB_ROUND, journal.current.number));
+        batch.Write(DB_ROUND_CURRENT, journal.current);
+
+    }else{
+
+        batch.Write(make_pair(DB_ROUND_PAYEE_COUNT, journal.current.number), journal.nPayees);
+
+        // There is no round 0 to store when the first round starts.
+        if( journal.current.number ) batch.Write(make_pair(DB_ROUND,journal.current.number), journal.current);
+        batch.Write(DB_ROUND_CURRENT, journal.next);
     }
 
-    return true;
+    batch.Erase(DB_ROUND_JOURNAL);
+
+    return WriteBatch(batch, true);
 }
 
-bool CSmartRewardsDB::ReadRewardPayouts(const int16_t round, CSmartRewardRoundResultList &payouts) {
+bool CSmartRewardsDB::ReadRewardEntries(const CSmartAddress *pLast, const size_t nMax, CSmartRewardEntryList &entries) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(make_pair(DB_ROUND_SNAPSHOT,round));
+    if( pLast ){
+        pcursor->Seek(make_pair(DB_REWARD_ENTRY,*pLast));
+    }else{
+        pcursor->Seek(DB_REWARD_ENTRY);
+    }
 
-    while (pcursor->Valid()) {
+    while (pcursor->Valid() && entries.size() < nMax) {
         boost::this_thread::interruption_point();
-        std::pair<char,std::pair<int16_t, CSmartAddress>> key;
-        if (pcursor->GetKey(key) && key.first == DB_ROUND_SNAPSHOT) {
+        std::pair<char,CSmartAddress> key;
+        if (pcursor->GetKey(key) && key.first == DB_REWARD_ENTRY) {
 
-            if( key.second.first != round ) break;
+            // Continue after the last entry of the previous call.
+            if( pLast && key.second == *pLast ){
+                pcursor->Next();
+                continue;
+            }
 
-            CSmartRewardRoundResult nValue;
+            CSmartRewardEntry nValue;
             if (pcursor->GetValue(nValue)) {
-                if( nValue.reward ) payouts.push_back(nValue);
+                entries.push_back(nValue);
                 pcursor->Next();
             } else {
                 return error("failed to get reward entry");
@@ -336,32 +581,42 @@ bool CSmartRewardsDB::ReadRewardPayouts(const int16_t round, CSmartRewardRoundRe
     return true;
 }
 
-bool CSmartRewardsDB::ReadRewardPayouts(const int16_t round, CSmartRewardRoundResultPtrList &payouts) {
+bool CSmartRewardsDB::ReadRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results, const leveldb::Snapshot *psnapshot) {
+    return ReadRoundChunks(*this, DB_ROUND_SNAPSHOT, round, results, false, psnapshot);
+}
+
+bool CSmartRewardsDB::ReadRewardRoundSnapshot(const int16_t round, const uint32_t nChunk, CSmartRewardRoundSnapshot &snapshot) {
+    return Read(make_pair(DB_ROUND_SNAPSHOT, CSmartRewardRoundChunkKey(round, nChunk)), snapshot);
+}
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+bool CSmartRewardsDB::ReadRewardPayouts(const int16_t round, CSmartRewardRoundResultList &payouts, const leveldb::Snapshot *psnapshot) {
+    return ReadRoundChunks(*this, DB_ROUND_PAYEES, round, payouts, true, psnapshot);
+}
 
-    pcursor->Seek(make_pair(DB_ROUND_SNAPSHOT,round));
+bool CSmartRewardsDB::ReadRewardPayeeCount(const int16_t round, int64_t &nPayees) {
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,std::pair<int16_t, CSmartAddress>> key;
-        if (pcursor->GetKey(key) && key.first == DB_ROUND_SNAPSHOT) {
+    if( Read(make_pair(DB_ROUND_PAYEE_COUNT, round), nPayees) ) return true;
 
-            if( key.second.first != round ) break;
+    // Rounds finalized before the count was stored, count the payout records.
+    CSmartRewardRoundResultList payouts;
 
-            CSmartRewardRoundResult nValue;
-            if (pcursor->GetValue(nValue)) {
-                if( nValue.reward ) payouts.push_back(new CSmartRewardRoundResult(nValue));
-                pcursor->Next();
-            } else {
-                // Delete everything if something fails
-                for( auto it : payouts ) delete it;
-                payouts.clear();
-                return error("failed to get reward entry");
-            }
-        } else {
-            break;
-        }
+    if( !ReadRewardPayouts(round, payouts) ) return false;
+
+    nPayees = payouts.size();
+
+    return true;
+}
+
+bool CSmartRewardsDB::ReadRewardPayoutBlock(const int16_t round, const uint32_t nRewardBlock, CSmartRewardRoundResultPtrList &payouts) {
+
+    CSmartRewardRoundSnapshot slice;
+
+    if( !Read(make_pair(DB_ROUND_PAYEES, CSmartRewardRoundChunkKey(round, nRewardBlock)), slice) ) return false;
+
+    payouts.reserve(payouts.size() + slice.results.size());
+
+    BOOST_FOREACH(const CSmartRewardRoundResult &r, slice.results) {
+        payouts.push_back(new CSmartRewardRoundResult(r));
     }
 
     return true;
@@ -12,7 +12,9 @@
 #include "base58.h"
 #include "smarthive/hive.h"
 
-static constexpr uint8_t REWARDS_DB_VERSION = 0x09;
+#include <functional>
+
+static constexpr uint8_t REWARDS_DB_VERSION = 0x0A;
 
 //! Compensate for extra memory peak (x1.5-x1.9) at flush time.
 static constexpr int REWARDS_DB_PEAK_USAGE_FACTOR = 2;
@@ -25,7 +27,10 @@ class CSmartRewardBlock;
 class CSmartRewardEntry;
 class CSmartRewardRound;
 class CSmartRewardRoundResult;
+class CSmartRewardRoundJournal;
+class CSmartRewardRoundSnapshot;
 class CSmartRewardTransaction;
+class CSmartRewardVerifyCheckpoint;
 
 typedef std::vector<CSmartRewardBlock> CSmartRewardBlockList;
 typedef std::vector<CSmartRewardEntry> CSmartRewardEntryList;
@@ -35,6 +40,8 @@ typedef std::vector<CSmartRewardRoundResult*> CSmartRewardRoundResultPtrList;
 typedef std::vector<CSmartRewardTransaction> CSmartRewardTransactionList;
 
 typedef std::map<CSmartAddress, CSmartRewardEntry*> CSmartRewardEntryMap;
+typedef std::map<CSmartAddress, CSmartRewardEntry> CSmartRewardEntryCache;
+typedef std::map<uint256, CSmartRewardTransaction> CSmartRewardTransactionMap;
 
 class CSmartRewardTransaction
 {
@@ -264,6 +271,186 @@ public:
     arith_uint256 CalculateScore(const uint256& blockHash);
 };
 
+/**
+ * Columnar encoding of a part of a round's results (snapshot or payee list).
+ * The addresses are stored with the number of bytes they share with their
+ * predecessor, the amounts as zigzag VARINTs and the mostly null hashes only
+ * where the flag column marks them as set.
+ */
+class CSmartRewardRoundSnapshot
+{
+    enum {
+        FLAG_DISQUALIFYING_TX = (1 << 0),
+        FLAG_VOTE_PROOF = (1 << 1),
+        FLAG_SMARTNODE_PAYMENT_TX = (1 << 2)
+    };
+
+    template <typename Stream, typename Operation>
+    static void ReadWriteAmount(Stream& s, CAmount &nAmount, Operation ser_action, int nType, int nVersion) {
+        uint64_t n = (uint64_t(nAmount) << 1) ^ uint64_t(nAmount >> 63);
+        READWRITE(VARINT(n));
+        if( ser_action.ForRead() ) nAmount = CAmount(n >> 1) ^ -CAmount(n & 1);
+    }
+
+public:
+
+    CSmartRewardRoundResultList results;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+
+        uint64_t nCount = results.size();
+        READWRITE(COMPACTSIZE(nCount));
+
+        if( ser_action.ForRead() ){
+            if( nCount > MAX_SIZE ) throw std::ios_base::failure("CSmartRewardRoundSnapshot: size too large");
+            results.resize(nCount);
+        }
+
+        std::vector<unsigned char> vchPrev;
+
+        for( CSmartRewardRoundResult &r : results ){
+
+            std::vector<unsigned char> vchId, vchRest;
+            uint8_t nShared = 0;
+
+            if( !ser_action.ForRead() ){
+                CDataStream ss(SER_DISK, 0);
+                ss << r.entry.id;
+                vchId.assign(ss.begin(), ss.end());
+                while( nShared < 0xFF && nShared < vchPrev.size() && nShared < vchId.size() &&
+                       vchPrev[nShared] == vchId[nShared] ) ++nShared;
+                vchRest.assign(vchId.begin() + nShared, vchId.end());
+            }
+
+            READWRITE(nShared);
+            READWRITE(vchRest);
+
+            if( ser_action.ForRead() ){
+                if( nShared > vchPrev.size() ) throw std::ios_base::failure("CSmartRewardRoundSnapshot: invalid address prefix");
+                vchId.assign(vchPrev.begin(), vchPrev.begin() + nShared);
+                vchId.insert(vchId.end(), vchRest.begin(), vchRest.end());
+                CDataStream ss(vchId, SER_DISK, 0);
+                ss >> r.entry.id;
+            }
+
+            vchPrev.swap(vchId);
+        }
+
+        for( CSmartRewardRoundResult &r : results ) ReadWriteAmount(s, r.entry.balance, ser_action, nType, nVersion);
+        for( CSmartRewardRoundResult &r : results ) ReadWriteAmount(s, r.entry.balanceAtStart, ser_action, nType, nVersion);
+        for( CSmartRewardRoundResult &r : results ) ReadWriteAmount(s, r.entry.balanceEligible, ser_action, nType, nVersion);
+        for( CSmartRewardRoundResult &r : results ) ReadWriteAmount(s, r.reward, ser_action, nType, nVersion);
+
+        std::vector<uint8_t> vecFlags(results.size(), 0);
+
+        for( size_t i = 0; i < results.size(); ++i ){
+            if( !ser_action.ForRead() ){
+                const CSmartRewardEntry &e = results[i].entry;
+                vecFlags[i] = (e.disqualifyingTx.IsNull() ? 0 : FLAG_DISQUALIFYING_TX) |
+                              (e.voteProof.IsNull() ? 0 : FLAG_VOTE_PROOF) |
+                              (e.smartnodePaymentTx.IsNull() ? 0 : FLAG_SMARTNODE_PAYMENT_TX);
+            }
+            READWRITE(vecFlags[i]);
+        }
+
+        for( size_t i = 0; i < results.size(); ++i ){
+            CSmartRewardEntry &e = results[i].entry;
+            if( vecFlags[i] & FLAG_DISQUALIFYING_TX ) READWRITE(e.disqualifyingTx);
+            if( vecFlags[i] & FLAG_VOTE_PROOF ) READWRITE(e.voteProof);
+            if( vecFlags[i] & FLAG_SMARTNODE_PAYMENT_TX ) READWRITE(e.smartnodePaymentTx);
+        }
+    }
+};
+
+/**
+ * Progress of a round finalization (or its undo) which runs in several
+ * batches. It gets written with each batch and erased with the last one so
+ * an interrupted finalization can be continued at the next startup.
+ */
+class CSmartRewardRoundJournal
+{
+
+public:
+
+    enum Step {
+        // Evaluate the entries into the snapshot records (or undo them)
+        STEP_ENTRIES = 0,
+        // Add the snapshot's payees to the on-disk payout order
+        STEP_ORDER = 1,
+        // Split the ordered payees into the payee records
+        STEP_PAYEES = 2
+    };
+
+    bool fUndo;
+    CSmartRewardRound current;
+    CSmartRewardRound next;
+    // Hash of the current round's start block, seeds the payee order.
+    uint256 hashStartBlock;
+    // Last processed address, only valid if nProcessed > 0
+    CSmartAddress lastId;
+    int64_t nProcessed;
+    // Number of snapshot records written (or undone) so far
+    uint32_t nChunks;
+    uint8_t nStep;
+    // Number of snapshot records added to the payout order so far
+    uint32_t nOrdered;
+    // Number of payees and payee records written so far
+    int64_t nPayees;
+    uint32_t nPayeeChunks;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(fUndo);
+        READWRITE(current);
+        READWRITE(next);
+        READWRITE(hashStartBlock);
+        READWRITE(lastId);
+        READWRITE(nProcessed);
+        READWRITE(nChunks);
+        READWRITE(nStep);
+        READWRITE(nOrdered);
+        READWRITE(nPayees);
+        READWRITE(nPayeeChunks);
+    }
+
+    CSmartRewardRoundJournal() : fUndo(false), nProcessed(0), nChunks(0), nStep(STEP_ENTRIES), nOrdered(0), nPayees(0), nPayeeChunks(0) {}
+    CSmartRewardRoundJournal(bool fUndoIn, const CSmartRewardRound &currentIn, const CSmartRewardRound &nextIn, const uint256 &hashStartBlockIn) :
+        fUndo(fUndoIn), current(currentIn), next(nextIn), hashStartBlock(hashStartBlockIn), nProcessed(0), nChunks(0),
+        nStep(STEP_ENTRIES), nOrdered(0), nPayees(0), nPayeeChunks(0) {}
+};
+
+/**
+ * Result of the last block record verification. The rolling hash commits to
+ * the block records 1 - nHeight so startup only needs to check the records
+ * added since, a full verification recomputes and compares it.
+ */
+class CSmartRewardVerifyCheckpoint
+{
+
+public:
+
+    int nHeight;
+    uint256 blockHash;
+    uint256 hashRolling;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nHeight);
+        READWRITE(blockHash);
+        READWRITE(hashRolling);
+    }
+
+    CSmartRewardVerifyCheckpoint() : nHeight(0) {}
+
+    void Add(const CSmartRewardBlock &block);
+};
 
 /** Access to the rewards database (rewards/) */
 class CSmartRewardsDB : public CDBWrapper
@@ -279,7 +466,7 @@ private:
     void Unlock();
 public:
 
-    bool Verify(int& lastBlockHeight);
+    bool Verify(int& lastBlockHeight, bool fFull = false);
 
     void Lock();
     bool IsLocked();
@@ -288,24 +475,35 @@ public:
     bool ReadLastBlock(CSmartRewardBlock &block);
 
     bool ReadTransaction(const uint256 hash, CSmartRewardTransaction &transaction);
+    /** Whether the transaction records above nHeight got pruned already */
+    bool IsTransactionsPruned(const int nHeight);
+    /** Erase the transaction records above nHeight which fKeep doesn't ask to keep */
+    bool PruneTransactions(const int nHeight, const std::function<bool(const CSmartRewardTransaction&)> &fKeep);
 
     bool ReadRound(const int16_t number, CSmartRewardRound &round);
     bool ReadRounds(CSmartRewardRoundList &vect);
 
     bool ReadCurrentRound(CSmartRewardRound &round);
 
-    bool ReadRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry);
-    bool ReadRewardEntries(CSmartRewardEntryList &vect);
-
-    bool ReadRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results);
-    bool ReadRewardPayouts(const int16_t round, CSmartRewardRoundResultList &payouts);
-    bool ReadRewardPayouts(const int16_t round, CSmartRewardRoundResultPtrList &payouts);
-
-    bool SyncCached(const CSmartRewardRound& current, const CSmartRewardEntryMap &rewards, const CSmartRewardTransactionList &transactions, bool fUndo = false);
-    bool SyncCached(const CSmartRewardBlock &block, const CSmartRewardRound& current, const CSmartRewardEntryMap &rewards, const CSmartRewardTransactionList &transactions, bool fUndo = false);
-    bool StartFirstRound(const CSmartRewardRound &start, const CSmartRewardEntryList &entries);
-    bool FinalizeRound(const CSmartRewardRound &current, const CSmartRewardRound &next, const CSmartRewardEntryList &entries, const CSmartRewardRoundResultList &results);
-    bool UndoFinalizeRound(const CSmartRewardRound &current, const CSmartRewardRoundResultList &results);
+    bool ReadRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry, const leveldb::Snapshot *psnapshot = NULL);
+    bool ReadRewardEntries(const CSmartAddress *pLast, const size_t nMax, CSmartRewardEntryList &vect);
+
+    bool ReadRewardRoundResults(const int16_t round, CSmartRewardRoundResultList &results, const leveldb::Snapshot *psnapshot = NULL);
+    bool ReadRewardRoundSnapshot(const int16_t round, const uint32_t nChunk, CSmartRewardRoundSnapshot &snapshot);
+    bool ReadRewardPayouts(const int16_t round, CSmartRewardRoundResultList &payouts, const leveldb::Snapshot *psnapshot = NULL);
+    bool ReadRewardPayeeCount(const int16_t round, int64_t &nPayees);
+    bool ReadRewardPayoutBlock(const int16_t round, const uint32_t nRewardBlock, CSmartRewardRoundResultPtrList &payouts);
+
+    bool WriteCache(const CSmartRewardBlock &last, const CSmartRewardRound& current, const CSmartRewardBlockList &blocks, const CSmartRewardEntryList &entries,
+                    const CSmartRewardTransactionMap &transactions, const std::set<uint256> &erasedTransactions);
+
+    bool ReadRoundJournal(CSmartRewardRoundJournal &journal);
+    bool WriteRoundJournal(const CSmartRewardRoundJournal &journal, const uint32_t nChunk, const CSmartRewardEntryList &entries, const CSmartRewardRoundSnapshot &snapshot);
+    /** Add the payees of a snapshot record to the payout order, fScore selects the order of the 1.3 rounds */
+    bool WriteRoundPayeeOrder(const CSmartRewardRoundJournal &journal, CSmartRewardRoundSnapshot &snapshot, bool fScore);
+    /** Move up to about nMax ordered payees into the payee records, fDone is set once all are moved */
+    bool WriteRoundPayees(CSmartRewardRoundJournal &journal, const size_t nMax, bool &fDone);
+    bool CommitRoundJournal(const CSmartRewardRoundJournal &journal);
 };
 
 
@@ -16,7 +16,8 @@
 
 #include <stdint.h>
 
-static std::pair<int,CSmartRewardRoundResultPtrList> *paymentData = nullptr;
+// Payees of the last requested payout block, keyed by round and payout block index.
+static std::pair<std::pair<int, int64_t>,CSmartRewardRoundResultPtrList> *paymentData = nullptr;
 
 static void ResetPaymentData()
 {
@@ -29,28 +30,10 @@ static void ResetPaymentData()
         delete paymentData;
     }
 
-    paymentData = new std::pair<int,CSmartRewardRoundResultPtrList>();
+    paymentData = new std::pair<std::pair<int, int64_t>,CSmartRewardRoundResultPtrList>();
     paymentData->second.clear();
 }
 
-struct CompareRewardScore
-{
-    bool operator()(const std::pair<arith_uint256, CSmartRewardRoundResult*>& s1,
-                    const std::pair<arith_uint256, CSmartRewardRoundResult*>& s2) const
-    {
-        return (s1.first != s2.first) ? (s1.first < s2.first) : (s1.second->entry.balance < s2.second->entry.balance);
-    }
-};
-
-struct ComparePaymentPrtList
-{
-    bool operator()(const CSmartRewardRoundResult* p1,
-                    const CSmartRewardRoundResult* p2) const
-    {
-        return *p1 < *p2;
-    }
-};
-
 CSmartRewardRoundResultPtrList SmartRewardPayments::GetPayments(const CSmartRewardRound &round, const int64_t nPayoutDelay, const int nHeight, int64_t blockTime, SmartRewardPayments::Result &result)
 {
     int64_t nPayeeCount = round.eligibleEntries - round.disqualifiedEntries;
@@ -61,8 +44,6 @@ CSmartRewardRoundResultPtrList SmartRewardPayments::GetPayments(const CSmartRewa
         return CSmartRewardRoundResultPtrList();
     }
 
-    int nFirst_1_3_Round = Params().GetConsensus().nRewardsFirst_1_3_Round;
-
     int64_t nBlockPayees = round.nBlockPayees;
     int64_t nPayoutInterval = round.nBlockInterval;
 
@@ -75,79 +56,52 @@ CSmartRewardRoundResultPtrList SmartRewardPayments::GetPayments(const CSmartRewa
     if( nHeight <= nLastRoundBlock && !(( nLastRoundBlock - nHeight ) % nPayoutInterval) ){
         // We have a reward block! Now try to create the payments vector.
 
-        // Do this stuff only one time and leave it in memory until all blocks are paid
-        if( !paymentData || paymentData->first != round.number ){
+        // Index of the current payout block for this round.
+        int64_t nRewardBlock = nRewardBlocks - ( (nLastRoundBlock - nHeight) / nPayoutInterval );
+        int64_t nFinalBlockPayees = nBlockPayees;
 
-            ResetPaymentData();
+        // If the to be paid addresses are no multile of nRewardsPayoutsPerBlock
+        // the last payout block has less payees than the others.
+        if( nRewardBlock == nRewardBlocks && nPayeeCount % nBlockPayees ){
+            // Use the remainders here..
+            nFinalBlockPayees = nPayeeCount % nBlockPayees;
+        }
 
-            if( round.number < nFirst_1_3_Round ){
+        std::pair<int, int64_t> key = std::make_pair(round.number, nRewardBlock);
 
-                if( !prewards->GetRewardPayouts( round.number, paymentData->second ) ||
-                    paymentData->second.size() != static_cast<size_t>(nPayeeCount) ){
-                    result = SmartRewardPayments::DatabaseError;
-                    return CSmartRewardRoundResultPtrList();
-                }
+        // The payees of each payout block are stored in their payout order when the
+        // round gets finalized, just read the slice of this block.
+        if( !paymentData || paymentData->first != key ){
 
-                // Sort it to make sure the slices are the same network wide.
-                std::sort(paymentData->second.begin(), paymentData->second.end(), ComparePaymentPrtList() );
+            // Once per round make sure the persisted schedule covers exactly the payees of the round.
+            if( !paymentData || paymentData->first.first != round.number ){
 
-            }else{
+                int64_t nScheduledPayees = 0;
 
-                CSmartRewardRoundResultPtrList roundPayments;
-                if( !prewards->GetRewardPayouts( round.number, roundPayments ) ||
-                    roundPayments.size() != static_cast<size_t>(nPayeeCount) ){
+                if( !prewards->GetRewardPayeeCount( round.number, nScheduledPayees ) || nScheduledPayees != nPayeeCount ){
+                    LogPrintf("SmartRewardPayments::GetPayments -- ERROR: Round %d has %d scheduled payees, expected %d\n", round.number, nScheduledPayees, nPayeeCount);
+                    ResetPaymentData();
                     result = SmartRewardPayments::DatabaseError;
                     return CSmartRewardRoundResultPtrList();
                 }
-
-                uint256 blockHash;
-                if(!GetBlockHash(blockHash, round.startBlockHeight)) {
-                    LogPrintf("SmartRewardPayments::GetPayments_1_3 -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", round.startBlockHeight);
-                    result = SmartRewardPayments::CoreError;
-                    return CSmartRewardRoundResultPtrList();
-                }
-
-                std::vector<std::pair<arith_uint256, CSmartRewardRoundResult*>> vecScores;
-                // Since we use payouts stretched out over a week better to have some "random" sort here
-                // based on a score calculated with the round start's blockhash.
-                for (auto s : roundPayments) {
-                    arith_uint256 nScore = s->CalculateScore(blockHash);
-                    vecScores.push_back(std::make_pair(nScore,s));
-                }
-
-                std::sort(vecScores.begin(), vecScores.end(), CompareRewardScore());
-
-                for(auto s : vecScores)
-                    paymentData->second.push_back(s.second);
             }
-            // And set the round number the payment data belongs to
-            paymentData->first = round.number;
-        }
 
-        // Index of the current payout block for this round.
-        int64_t nRewardBlock = nRewardBlocks - ( (nLastRoundBlock - nHeight) / nPayoutInterval );
-        int64_t nFinalBlockPayees = nBlockPayees;
+            ResetPaymentData();
 
-        // If the to be paid addresses are no multile of nRewardsPayoutsPerBlock
-        // the last payout block has less payees than the others.
-        if( nRewardBlock == nRewardBlocks && nPayeeCount % nBlockPayees ){
-            // Use the remainders here..
-            nFinalBlockPayees = nPayeeCount % nBlockPayees;
-        }
+            if( !prewards->GetRewardPayoutBlock( round.number, nRewardBlock - 1, paymentData->second ) ||
+                paymentData->second.size() != static_cast<size_t>(nFinalBlockPayees) ){
+                // Should not happen!
+                ResetPaymentData();
+                result = SmartRewardPayments::DatabaseError;
+                return CSmartRewardRoundResultPtrList();
+            }
 
-        // As start index we want to use the current payout block index + payouts per block as offset.
-        size_t nStartIndex = (nRewardBlock - 1) * nBlockPayees;
-        // As ennd index we use the startIndex + number of payees for this round.
-        size_t nEndIndex = nStartIndex + nFinalBlockPayees;
-        // If for any reason the calculations end up in an overflow of the vector return an error.
-        if( nEndIndex > paymentData->second.size() ){
-            // Should not happen!
-            result = SmartRewardPayments::DatabaseError;
-            return CSmartRewardRoundResultPtrList();
+            // And set the round and block the payment data belongs to
+            paymentData->first = key;
         }
 
-        // Finally return the subvector with the payees of this blockHeight!
-        return CSmartRewardRoundResultPtrList(paymentData->second.begin() + nStartIndex, paymentData->second.begin() + nEndIndex);
+        // Finally return the payees of this blockHeight!
+        return paymentData->second;
     }
 
     // If we arent in any rounds payout range!
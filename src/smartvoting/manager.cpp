@@ -486,6 +486,17 @@ std::vector<CProposalVote> CSmartVotingManager::GetCurrentVotes(const uint256& n
     return vecResult;
 }
 
+void CSmartVotingManager::UpdateVotingPower(const std::map<CVoteKey, int64_t>& mapVotingPower)
+{
+    if( mapVotingPower.empty() ) return;
+
+    LOCK(cs);
+
+    for( auto& it : mapProposals ){
+        it.second.UpdateVotingPower(mapVotingPower);
+    }
+}
+
 std::vector<const CProposal*> CSmartVotingManager::GetAllNewerThan(int64_t nMoreThanTime) const
 {
     LOCK(cs);
@@ -164,6 +164,9 @@ public:
 
     void AddProposal(CProposal& proposal, CConnman& connman, CNode* pfrom = NULL);
 
+    /// Pass the new voting power of the given vote keys to the proposal tallies
+    void UpdateVotingPower(const std::map<CVoteKey, int64_t>& mapVotingPower);
+
     void UpdateCachesAndClean();
 
     void CheckAndRemove() {UpdateCachesAndClean();}
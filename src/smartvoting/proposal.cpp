@@ -39,6 +39,9 @@ CProposal::CProposal() :
     mapCurrentVKVotes(),
     cmmapOrphanVotes(),
     fileVotes(),
+    arrVoteTally(),
+    mapVoteTallyPower(),
+    fDirtyVoteTally(true),
     cs()
 {
 
@@ -61,6 +64,9 @@ CProposal::CProposal(const CProposal &other) :
     mapCurrentVKVotes(other.mapCurrentVKVotes),
     cmmapOrphanVotes(other.cmmapOrphanVotes),
     fileVotes(other.fileVotes),
+    arrVoteTally(other.arrVoteTally),
+    mapVoteTallyPower(other.mapVoteTallyPower),
+    fDirtyVoteTally(other.fDirtyVoteTally),
     cs()
 {}
 
@@ -406,7 +412,22 @@ bool CProposal::ProcessVote(CNode* pfrom,
 //        return false;
 //    }
 
-    voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+    if( !fDirtyVoteTally ){
+
+        // Replace the contribution of the vote key with its updated votes.
+        int64_t nPower = std::max<int64_t>(0, ::GetVotingPower(vote.GetVoteKey()));
+        int64_t &nTallyPower = mapVoteTallyPower[vote.GetVoteKey()];
+
+        AddVoteTally(voteRecordRef, -nTallyPower);
+        voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+        AddVoteTally(voteRecordRef, nPower);
+
+        nTallyPower = nPower;
+
+    }else{
+        voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+    }
+
     fileVotes.AddVote(vote);
     InvalidateVoteCache();
     return true;
@@ -426,6 +447,65 @@ void CProposal::ClearVoteKeyVotes()
 //            ++it;
 //        }
     }
+
+    fDirtyVoteTally = true;
+}
+
+void CProposal::UpdateVotingPower(const std::map<CVoteKey, int64_t>& mapVotingPower)
+{
+    LOCK(cs);
+
+    // Gets rebuilt with the current voting power on the next access.
+    if( fDirtyVoteTally ) return;
+
+    for( const auto& power : mapVotingPower ){
+
+        vote_m_cit it = mapCurrentVKVotes.find(power.first);
+        if( it == mapCurrentVKVotes.end() ) continue;
+
+        int64_t nPower = std::max<int64_t>(0, power.second);
+        int64_t &nTallyPower = mapVoteTallyPower[power.first];
+
+        if( nPower == nTallyPower ) continue;
+
+        AddVoteTally(it->second, nPower - nTallyPower);
+        nTallyPower = nPower;
+    }
+}
+
+void CProposal::AddVoteTally(const vote_rec_t& voteRecord, int64_t nPower) const
+{
+    AssertLockHeld(cs);
+
+    for( const auto& instance : voteRecord.mapInstances ){
+
+        if( instance.first <= VOTE_SIGNAL_NONE || instance.first > MAX_SUPPORTED_VOTE_SIGNAL ) continue;
+        if( instance.second.eOutcome <= VOTE_OUTCOME_NONE || instance.second.eOutcome > VOTE_OUTCOME_ABSTAIN ) continue;
+
+        arrVoteTally[instance.first][instance.second.eOutcome] += nPower;
+    }
+}
+
+const CProposal::vote_tally_t& CProposal::GetVoteTally(vote_signal_enum_t eVoteSignalIn) const
+{
+    AssertLockHeld(cs);
+
+    if( fDirtyVoteTally ){
+
+        arrVoteTally = std::array<vote_tally_t, MAX_SUPPORTED_VOTE_SIGNAL + 1>();
+        mapVoteTallyPower.clear();
+
+        for( const auto& votepair : mapCurrentVKVotes ){
+            // Its -1 if the votekey got not updated yet
+            int64_t nPower = std::max<int64_t>(0, ::GetVotingPower(votepair.first));
+            mapVoteTallyPower[votepair.first] = nPower;
+            AddVoteTally(votepair.second, nPower);
+        }
+
+        fDirtyVoteTally = false;
+    }
+
+    return arrVoteTally[eVoteSignalIn];
 }
 
 void CProposal::UpdateLocalValidity()
@@ -601,16 +681,10 @@ int64_t CProposal::GetVotingPower(vote_signal_enum_t eVoteSignalIn, vote_outcome
 {
     LOCK(cs);
 
-    int64_t nTotalPower = 0;
-    for (const auto& votepair : mapCurrentVKVotes) {
-        const vote_rec_t& recVote = votepair.second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 != recVote.mapInstances.end() && it2->second.eOutcome == eVoteOutcomeIn) {
-            int64_t nPower = ::GetVotingPower(votepair.first);
-            nTotalPower += std::max<int64_t>(0,nPower);
-        }
-    }
-    return nTotalPower;
+    if( eVoteSignalIn <= VOTE_SIGNAL_NONE || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL ) return 0;
+    if( eVoteOutcomeIn <= VOTE_OUTCOME_NONE || eVoteOutcomeIn > VOTE_OUTCOME_ABSTAIN ) return 0;
+
+    return GetVoteTally(eVoteSignalIn)[eVoteOutcomeIn];
 }
 
 CVoteOutcomes CProposal::GetVotingPower(const std::set<CVoteKey> &setVoteKeys, vote_signal_enum_t eVoteSignalIn) const
@@ -681,9 +755,15 @@ CAmount CProposal::GetAbstainPower(vote_signal_enum_t eVoteSignalIn) const
 
 CVoteResult CProposal::GetVotingResult(vote_signal_enum_t eVoteSignalIn) const
 {
-    return CVoteResult(GetYesPower(eVoteSignalIn),
-                       GetNoPower(eVoteSignalIn),
-                       GetAbstainPower(eVoteSignalIn));
+    LOCK(cs);
+
+    if( eVoteSignalIn <= VOTE_SIGNAL_NONE || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL ) return CVoteResult(0, 0, 0);
+
+    const vote_tally_t& tally = GetVoteTally(eVoteSignalIn);
+
+    return CVoteResult(tally[VOTE_OUTCOME_YES],
+                       tally[VOTE_OUTCOME_NO],
+                       tally[VOTE_OUTCOME_ABSTAIN]);
 }
 
 void CProposal::GetActiveVoteKeys(std::set<CVoteKey> &setVoteKeys) const
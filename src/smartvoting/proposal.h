@@ -17,6 +17,8 @@
 #include "smartvoting/voting.h"
 #include "smartvoting/votedb.h"
 
+#include <array>
+
 class CSmartVotingManager;
 class CProposal;
 class CProposalVote;
@@ -147,6 +149,9 @@ class CProposal
 public:
     typedef std::map<CVoteKey, vote_rec_t> vote_m_t;
 
+    /// voting power per outcome of one vote signal
+    typedef std::array<int64_t, VOTE_OUTCOME_ABSTAIN + 1> vote_tally_t;
+
     typedef vote_m_t::iterator vote_m_it;
 
     typedef vote_m_t::const_iterator vote_m_cit;
@@ -194,10 +199,22 @@ protected:
 
     CProposalVoteFile fileVotes;
 
+    /// voting power of mapCurrentVKVotes per vote signal and outcome
+    mutable std::array<vote_tally_t, MAX_SUPPORTED_VOTE_SIGNAL + 1> arrVoteTally;
+
+    /// voting power each vote key currently contributes to arrVoteTally
+    mutable std::map<CVoteKey, int64_t> mapVoteTallyPower;
+
+    /// true == arrVoteTally needs to be rebuilt from mapCurrentVKVotes
+    mutable bool fDirtyVoteTally;
+
 private:
     /// critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    void AddVoteTally(const vote_rec_t& voteRecord, int64_t nPower) const;
+    const vote_tally_t& GetVoteTally(vote_signal_enum_t eVoteSignalIn) const;
+
 public:
 
     CProposal();
@@ -293,6 +310,9 @@ public:
     void ClearVoteKeyVotes();
     void CheckOrphanVotes(CConnman &connman);
 
+    /// Update the tallies with the new voting power of the given vote keys
+    void UpdateVotingPower(const std::map<CVoteKey, int64_t>& mapVotingPower);
+
     int64_t GetVotingPower(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const;
     CVoteOutcomes GetVotingPower(const std::set<CVoteKey> &setVoteKeys, vote_signal_enum_t eVoteSignalIn) const;
     CAmount GetAbsoluteYesPower(vote_signal_enum_t eVoteSignalIn) const;
@@ -327,6 +347,9 @@ public:
             READWRITE(fExpired);
             READWRITE(mapCurrentVKVotes);
             READWRITE(fileVotes);
+            if(ser_action.ForRead()) {
+                fDirtyVoteTally = true;
+            }
             LogPrint("proposal", "CProposal::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
     }
@@ -11,12 +11,205 @@
 #include "validation.h"
 #include "wallet/wallet.h"
 #include "txdb.h"
+#include "validationinterface.h"
 
+#include <memory>
+
+// Protects the vote keys being validated and their address lookup. The
+// proposal tallies get updated with it held to keep the changes in order.
 static CCriticalSection cs;
 
 static std::map<CVoteKey, CVotingPower> mapActiveVoteKeys;
+static std::map<std::pair<int, uint160>, std::set<CVoteKey>> mapAddressVoteKeys;
+
+typedef std::shared_ptr<const std::map<CVoteKey, CVotingPower>> CVotingPowerMapRef;
+
+// Read only copy of mapActiveVoteKeys for the GetVotingPower callers, gets
+// replaced whenever the voting power changed.
+static CCriticalSection csVotingPower;
+static CVotingPowerMapRef mapVotingPower = std::make_shared<const std::map<CVoteKey, CVotingPower>>();
+
+class CSmartVotingInterface final : public CValidationInterface
+{
+protected:
+    void BlockAddressDeltas(const CBlockIndex *pindex, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vecDeltas, bool fConnect) override;
+};
+
+static CSmartVotingInterface *pSmartVotingInterface = nullptr;
+
+static void PublishVotingPower()
+{
+    AssertLockHeld(cs);
+
+    CVotingPowerMapRef mapNew = std::make_shared<const std::map<CVoteKey, CVotingPower>>(mapActiveVoteKeys);
+
+    LOCK(csVotingPower);
+    mapVotingPower.swap(mapNew);
+}
+
+static CVotingPowerMapRef GetVotingPowerMap()
+{
+    LOCK(csVotingPower);
+    return mapVotingPower;
+}
+
+// Voting power of a vote key as used by the proposal tallies, requires cs.
+static int64_t GetTallyPower(const CVotingPower &power)
+{
+    return power.IsValid() ? std::max<int64_t>(0, power.nPower / COIN) : 0;
+}
+
+static void AddActiveVoteKeys(const std::set<CVoteKey> &setVoteKeys)
+{
+    std::vector<CVoteKey> vecMissing;
+    std::vector<std::pair<CVoteKey, CVoteKeyValue>> vecNew;
+
+    {
+        LOCK(cs);
+
+        for( const CVoteKey &voteKey : setVoteKeys ){
+            if( !mapActiveVoteKeys.count(voteKey) ) vecMissing.push_back(voteKey);
+        }
+    }
+
+    for( const CVoteKey &voteKey : vecMissing ){
+
+        CVoteKeyValue voteKeyValue;
+        if( GetVoteKeyValue(voteKey, voteKeyValue) )
+            vecNew.push_back(std::make_pair(voteKey, voteKeyValue));
+    }
+
+    if( vecNew.empty() ) return;
+
+    std::map<CVoteKey, int64_t> mapChanged;
+
+    // Read the current balances with cs_main held so that no block gets
+    // connected before the keys are registered for the block deltas.
+    LOCK(cs_main);
+
+    {
+        LOCK(cs);
+
+        for( const auto &it : vecNew ){
+
+            uint160 hashBytes;
+            int type = 0;
+            CAddressBalanceValue balance;
+
+            if( mapActiveVoteKeys.count(it.first) ) continue;
+
+            if( !it.second.voteAddress.GetIndexKey(hashBytes, type) ||
+                !GetAddressBalance(hashBytes, type, balance) ) continue;
+
+            CVotingPower power(it.second.voteAddress);
+            power.nPower = balance.balance;
+            power.nBlockHeight = chainActive.Height();
+
+            mapActiveVoteKeys.insert(std::make_pair(it.first, power));
+            mapAddressVoteKeys[std::make_pair(type, hashBytes)].insert(it.first);
+            mapChanged[it.first] = GetTallyPower(power);
+        }
+
+        PublishVotingPower();
+        smartVoting.UpdateVotingPower(mapChanged);
+    }
+}
+
+static void RemoveInactiveVoteKeys(const std::set<CVoteKey> &setActiveKeys)
+{
+    std::map<CVoteKey, int64_t> mapChanged;
+
+    {
+        LOCK(cs);
+
+        for (auto it = mapActiveVoteKeys.begin(); it != mapActiveVoteKeys.end();){
+
+            // Check if the address we validate is not longer active
+            if( !setActiveKeys.count(it->first) ){
+
+                uint160 hashBytes;
+                int type = 0;
+
+                if( it->second.address.GetIndexKey(hashBytes, type) ){
+
+                    auto itAddress = mapAddressVoteKeys.find(std::make_pair(type, hashBytes));
+
+                    if( itAddress != mapAddressVoteKeys.end() ){
+                        itAddress->second.erase(it->first);
+                        if( itAddress->second.empty() ) mapAddressVoteKeys.erase(itAddress);
+                    }
+                }
+
+                mapChanged[it->first] = 0;
+                it = mapActiveVoteKeys.erase(it);
+                continue;
+            }
+
+            ++it;
+        }
+
+        if( mapChanged.size() ){
+            PublishVotingPower();
+            smartVoting.UpdateVotingPower(mapChanged);
+        }
+    }
+}
 
-bool GetBalanceDelta(const CSmartAddress &address, int nStartBlock, int nEndBlock, CAmount &delta);
+void CSmartVotingInterface::BlockAddressDeltas(const CBlockIndex *pindex, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vecDeltas, bool fConnect)
+{
+    std::map<CVoteKey, int64_t> mapChanged;
+
+    {
+        LOCK(cs);
+
+        if( mapActiveVoteKeys.empty() ) return;
+
+        std::set<CVoteKey> setTouched;
+
+        for( const auto &delta : vecDeltas ){
+
+            auto it = mapAddressVoteKeys.find(std::make_pair(int(delta.first.type), delta.first.hashBytes));
+
+            if( it == mapAddressVoteKeys.end() ) continue;
+
+            for( const CVoteKey &voteKey : it->second ){
+                mapActiveVoteKeys[voteKey].nPower += fConnect ? delta.second : -delta.second;
+                setTouched.insert(voteKey);
+            }
+        }
+
+        int nHeight = fConnect ? pindex->nHeight : pindex->nHeight - 1;
+
+        for( auto &it : mapActiveVoteKeys ){
+            it.second.nBlockHeight = nHeight;
+        }
+
+        for( const CVoteKey &voteKey : setTouched ){
+            mapChanged[voteKey] = GetTallyPower(mapActiveVoteKeys[voteKey]);
+        }
+
+        PublishVotingPower();
+        smartVoting.UpdateVotingPower(mapChanged);
+    }
+}
+
+void RegisterSmartVotingInterface()
+{
+    // The voting power gets tracked based on the address index.
+    if( fLiteMode || !fAddressIndex || pSmartVotingInterface ) return;
+
+    pSmartVotingInterface = new CSmartVotingInterface();
+    RegisterValidationInterface(pSmartVotingInterface);
+}
+
+void UnregisterSmartVotingInterface()
+{
+    if( !pSmartVotingInterface ) return;
+
+    UnregisterValidationInterface(pSmartVotingInterface);
+    delete pSmartVotingInterface;
+    pSmartVotingInterface = nullptr;
+}
 
 void ThreadSmartVoting()
 {
@@ -30,7 +223,8 @@ void ThreadSmartVoting()
     // Make this thread recognisable as the SmartVoting thread
     RenameThread("smartvoting");
 
-    // Check if we have some unparsed votekey registrations every block
+    // Check if we have some new active votekeys every block, their voting
+    // power gets updated by the validation interface.
     int nLastChecked = 0;
 
     while (true)
@@ -58,10 +252,6 @@ void ThreadSmartVoting()
                     proposal->GetActiveVoteKeys(setActiveKeys);
                 }
 
-                for( auto it : setActiveKeys ){
-                    AddActiveVoteKey(it);
-                }
-
             }
 
             if( pwalletMain ){
@@ -79,93 +269,26 @@ void ThreadSmartVoting()
                 for( auto keyId : setWalletKeyIds ){
 
                     CVoteKey voteKey(keyId);
-                    CVoteKeyValue value;
-
-                    if( IsRegisteredForVoting(voteKey) ){
 
-                        if( !setActiveKeys.count(voteKey) )
-                            setActiveKeys.insert(voteKey);
-
-                        AddActiveVoteKey(voteKey);
-                    }
+                    if( IsRegisteredForVoting(voteKey) )
+                        setActiveKeys.insert(voteKey);
                 }
 
             }
 
-            LOCK(cs);
+            AddActiveVoteKeys(setActiveKeys);
 
-            for (auto it = mapActiveVoteKeys.begin(); it != mapActiveVoteKeys.end();){
-
-                // Check if the address we validate is not longer active
-                if( setActiveKeys.size() && !setActiveKeys.count(it->first) ){
-                    it = mapActiveVoteKeys.erase(it);
-                    continue;
-                }
-
-                int nStart = 0;
-
-                if( it->second.IsValid() ){
-
-                    if( it->second.nBlockHeight < nHeight ){
-                        nStart = it->second.nBlockHeight + 1;
-                    }else{
-                        ++it;
-                        continue;
-                    }
-
-                }
-
-                if( nHeight < nValidationConfirmations ){
-                    ++it;
-                    continue;
-                }
-
-                if( ( nHeight - nStart ) < nValidationConfirmations ){
-                    ++it;
-                    continue;
-                }
-
-                CAmount nDelta = 0;
-
-                if( GetBalanceDelta(it->second.address, nStart, nHeight, nDelta) ){
-                    it->second.nPower += nDelta;
-                    it->second.nBlockHeight = nHeight;
-                }
-
-                ++it;
-
-            }
+            if( setActiveKeys.size() ) RemoveInactiveVoteKeys(setActiveKeys);
         }
     }
 }
 
-bool GetBalanceDelta(const CSmartAddress &address, int nStartBlock, int nEndBlock, CAmount &delta)
-{
-    uint160 hashBytes;
-    int type = 0;
-
-    if (!address.GetIndexKey(hashBytes, type)) {
-        return false;
-    }
-
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    if ( !GetAddressIndex(hashBytes, type, addressIndex, nStartBlock, nEndBlock) ) {
-        return false;
-    }
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
-        delta += it->second;
-
-    return true;
-}
-
 void GetVotingPower(const CVoteKey &voteKey, CVotingPower &votingPower)
 {
-    LOCK(cs);
-    auto it = mapActiveVoteKeys.find(voteKey);
+    CVotingPowerMapRef mapPower = GetVotingPowerMap();
+    auto it = mapPower->find(voteKey);
 
-    if( it != mapActiveVoteKeys.end() && it->second.IsValid() ){
+    if( it != mapPower->end() && it->second.IsValid() ){
         votingPower = it->second;
         votingPower.nPower /= COIN;
     }else{
@@ -175,10 +298,10 @@ void GetVotingPower(const CVoteKey &voteKey, CVotingPower &votingPower)
 
 int64_t GetVotingPower(const CVoteKey &voteKey)
 {
-    LOCK(cs);
-    auto it = mapActiveVoteKeys.find(voteKey);
+    CVotingPowerMapRef mapPower = GetVotingPowerMap();
+    auto it = mapPower->find(voteKey);
 
-    if( it != mapActiveVoteKeys.end() && it->second.IsValid() ){
+    if( it != mapPower->end() && it->second.IsValid() ){
 
         if( it->second.nPower > 0 )
             return it->second.nPower / COIN;
@@ -191,11 +314,5 @@ int64_t GetVotingPower(const CVoteKey &voteKey)
 
 void AddActiveVoteKey(const CVoteKey &voteKey)
 {
-    LOCK(cs);
-
-    if( !mapActiveVoteKeys.count(voteKey) ){
-        CVoteKeyValue voteKeyValue;
-        if(GetVoteKeyValue(voteKey, voteKeyValue) )
-            mapActiveVoteKeys.insert(std::make_pair(voteKey, CVotingPower(voteKeyValue.voteAddress)));
-    }
+    AddActiveVoteKeys(std::set<CVoteKey>{voteKey});
 }
@@ -14,8 +14,6 @@
 #include "streams.h"
 #include "uint256.h"
 
-// Update all vote's voting power every nValidationConfirmations blocks
-static const int nValidationConfirmations = 6;
 // Check unparsed registrations every x seconds and remove them after n tries
 static const int nRegistrationCheckInterval = 2;
 static const int nRegistrationCheckMaxTries = 40;
@@ -37,6 +35,9 @@ struct CVotingPower{
 };
 
 void ThreadSmartVoting();
+/** Keep the voting power of the active vote keys in sync with the connected blocks */
+void RegisterSmartVotingInterface();
+void UnregisterSmartVotingInterface();
 void AddActiveVoteKey(const CVoteKey &voteKey);
 void GetVotingPower(const CVoteKey &voteKey, CVotingPower &votingPower);
 int64_t GetVotingPower(const CVoteKey &voteKey);
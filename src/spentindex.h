@@ -247,6 +247,86 @@ struct CAddressUnspentValue {
     }
 };
 
+struct CAddressAmountKey {
+    unsigned int type;
+    uint160 hashBytes;
+    CAmount nAmount;
+    uint256 txhash;
+    size_t index;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 65;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+        // Amounts are stored big-endian to iterate the outputs of an address sorted by value
+        ser_writedata32be(s, static_cast<uint32_t>(static_cast<uint64_t>(nAmount) >> 32));
+        ser_writedata32be(s, static_cast<uint32_t>(nAmount));
+        txhash.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, index);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s, nType, nVersion);
+        uint64_t nHigh = ser_readdata32be(s);
+        nAmount = static_cast<CAmount>((nHigh << 32) | ser_readdata32be(s));
+        txhash.Unserialize(s, nType, nVersion);
+        index = ser_readdata32be(s);
+    }
+
+    CAddressAmountKey(unsigned int addressType, uint160 addressHash, CAmount amount, uint256 txid, size_t indexValue) {
+        type = addressType;
+        hashBytes = addressHash;
+        nAmount = amount;
+        txhash = txid;
+        index = indexValue;
+    }
+
+    CAddressAmountKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        type = 0;
+        hashBytes.SetNull();
+        nAmount = 0;
+        txhash.SetNull();
+        index = 0;
+    }
+
+    bool IsNull() const { return hashBytes.IsNull(); }
+};
+
+struct CAddressAmountValue {
+    int nBlockHeight;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nBlockHeight);
+    }
+
+    CAddressAmountValue(int height) {
+        nBlockHeight = height;
+    }
+
+    CAddressAmountValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        nBlockHeight = -1;
+    }
+
+    bool IsNull() const {
+        return (nBlockHeight == -1);
+    }
+};
+
 struct CAddressIndexKey {
     unsigned int type;
     uint160 hashBytes;
@@ -409,6 +489,41 @@ struct CAddressListEntry {
     bool IsNull(){ return hashBytes.IsNull(); }
 };
 
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    int nFirstHeight;
+    int nLastHeight;
+    int64_t nUtxoCount;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(nFirstHeight);
+        READWRITE(nLastHeight);
+        READWRITE(nUtxoCount);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        nFirstHeight = -1;
+        nLastHeight = -1;
+        nUtxoCount = 0;
+    }
+
+    bool IsNull() const {
+        return (nFirstHeight == -1);
+    }
+};
+
 struct CDepositIndexKey {
     unsigned int type;
     uint160 hashBytes;
@@ -731,7 +846,6 @@ struct CInstantPayIndexKey {
 
 struct CInstantPayValue {
     bool fProcessed; // Internal only
-    bool fWritten; // Internal only
     int64_t timeCreated; // Internal only
 
     bool fValid;
@@ -751,7 +865,6 @@ struct CInstantPayValue {
 
     CInstantPayValue(bool valid, int receivedLocks, int maxLocks, int elapsedTime) :
                                                            fProcessed(false),
-                                                           fWritten(false),
                                                            fValid(valid),
                                                            receivedLocks(receivedLocks),
                                                            maxLocks(maxLocks),
@@ -770,7 +883,6 @@ struct CInstantPayValue {
 
     void SetNull() {
         fProcessed = false;
-        fWritten = false;
         timeCreated = 0;
 
         fValid = false;
@@ -813,5 +925,77 @@ struct CInstantPayIndexIteratorTimeKey {
     }
 };
 
+struct CMiningSignatureIndexKey {
+    int nHeight;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 4;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata32be(s, nHeight);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        nHeight = ser_readdata32be(s);
+    }
+
+    CMiningSignatureIndexKey(int height) {
+        nHeight = height;
+    }
+
+    CMiningSignatureIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        nHeight = 0;
+    }
+};
+
+struct CMiningSignatureIndexValue {
+    enum Status {
+        SIGNED = 0,
+        NO_SIGNATURE = 1,
+        NO_SIGNATURE_OUTPUT = 2,
+    };
+
+    uint8_t nStatus;
+    uint8_t nKeyId;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nStatus);
+        READWRITE(nKeyId);
+    }
+
+    CMiningSignatureIndexValue(uint8_t status, uint8_t keyId) {
+        nStatus = status;
+        nKeyId = keyId;
+    }
+
+    CMiningSignatureIndexValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        nStatus = NO_SIGNATURE;
+        nKeyId = 0;
+    }
+
+    bool IsSigned() const {
+        return nStatus == SIGNED;
+    }
+
+    // The key id if signed, -1 without signature and -3 if the coinbase has no signature output
+    int64_t GetKey() const {
+        if (nStatus == SIGNED) return nKeyId;
+        if (nStatus == NO_SIGNATURE_OUTPUT) return -3;
+        return -1;
+    }
+};
+
 
 #endif // BITCOIN_SPENTINDEX_H
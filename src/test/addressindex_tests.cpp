@@ -0,0 +1,250 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "spentindex.h"
+#include "txdb.h"
+#include "utilstrencodings.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+static const int nAddressType = 1;
+
+static uint256 TxHash(int n)
+{
+    return ArithToUint256(arith_uint256(n + 1) * 7919);
+}
+
+static std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > ReadUnspents(CBlockTreeDB &db, const uint160 &hash)
+{
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vect;
+    BOOST_CHECK(db.ReadAddressUnspentIndex(hash, nAddressType, vect));
+    return vect;
+}
+
+static void CheckUnspentPages(CBlockTreeDB &db, const uint160 &hash, size_t nExpected)
+{
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vectAll = ReadUnspents(db, hash);
+    BOOST_CHECK_EQUAL(vectAll.size(), nExpected);
+
+    int nCount;
+    CAddressUnspentKey lastIndex;
+    BOOST_CHECK(db.ReadAddressUnspentIndexCount(hash, nAddressType, nCount, lastIndex));
+    BOOST_CHECK_EQUAL(nCount, (int)nExpected);
+
+    // Every offset reached through the anchors has to match the plain scan
+    for (size_t nOffset = 0; nOffset < nExpected; nOffset += 97) {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vect;
+        BOOST_CHECK(db.ReadAddressUnspentIndex(hash, nAddressType, vect, CAddressUnspentKey(), nOffset, 1));
+        BOOST_CHECK_EQUAL(vect.size(), 1U);
+        if (vect.size() == 1)
+            BOOST_CHECK(vect[0].first.txhash == vectAll[nOffset].first.txhash);
+    }
+
+    if (nExpected) {
+        BOOST_CHECK(lastIndex.txhash == vectAll.back().first.txhash);
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vect;
+        BOOST_CHECK(db.ReadAddressUnspentIndex(hash, nAddressType, vect, CAddressUnspentKey(), nExpected, 1));
+        BOOST_CHECK(vect.empty());
+    }
+
+    // The entries are counted per address type
+    BOOST_CHECK(db.ReadAddressUnspentIndexCount(hash, nAddressType + 1, nCount, lastIndex));
+    BOOST_CHECK_EQUAL(nCount, 0);
+    BOOST_CHECK(lastIndex.IsNull());
+}
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(addressindex_balance)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 hash(std::vector<unsigned char>(20, 1));
+    CAddressBalanceValue value;
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vectBlock10;
+    vectBlock10.push_back(std::make_pair(CAddressIndexKey(nAddressType, hash, 10, 0, TxHash(0), 0, false), 50));
+    vectBlock10.push_back(std::make_pair(CAddressIndexKey(nAddressType, hash, 10, 1, TxHash(1), 1, false), 20));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vectBlock11;
+    vectBlock11.push_back(std::make_pair(CAddressIndexKey(nAddressType, hash, 11, 1, TxHash(2), 0, true), -50));
+    vectBlock11.push_back(std::make_pair(CAddressIndexKey(nAddressType, hash, 11, 1, TxHash(2), 0, false), 5));
+
+    // Connect, connecting a block again after an unclean shutdown must not count it twice
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.WriteAddressIndex(vectBlock10));
+        BOOST_CHECK(db.ReadAddressBalance(hash, nAddressType, value));
+        BOOST_CHECK_EQUAL(value.balance, 70);
+        BOOST_CHECK_EQUAL(value.received, 70);
+        BOOST_CHECK_EQUAL(value.nFirstHeight, 10);
+        BOOST_CHECK_EQUAL(value.nLastHeight, 10);
+        BOOST_CHECK_EQUAL(value.nUtxoCount, 2);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.WriteAddressIndex(vectBlock11));
+        BOOST_CHECK(db.ReadAddressBalance(hash, nAddressType, value));
+        BOOST_CHECK_EQUAL(value.balance, 25);
+        BOOST_CHECK_EQUAL(value.received, 75);
+        BOOST_CHECK_EQUAL(value.nFirstHeight, 10);
+        BOOST_CHECK_EQUAL(value.nLastHeight, 11);
+        BOOST_CHECK_EQUAL(value.nUtxoCount, 2);
+    }
+
+    // Disconnect
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.EraseAddressIndex(vectBlock11));
+        BOOST_CHECK(db.ReadAddressBalance(hash, nAddressType, value));
+        BOOST_CHECK_EQUAL(value.balance, 70);
+        BOOST_CHECK_EQUAL(value.received, 70);
+        BOOST_CHECK_EQUAL(value.nFirstHeight, 10);
+        BOOST_CHECK_EQUAL(value.nLastHeight, 10);
+        BOOST_CHECK_EQUAL(value.nUtxoCount, 2);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.EraseAddressIndex(vectBlock10));
+        BOOST_CHECK(!db.ReadAddressBalance(hash, nAddressType, value));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_unspent_pages)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 hash(std::vector<unsigned char>(20, 2));
+    const uint160 hashOther(std::vector<unsigned char>(20, 3));
+    const std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > vectAmounts;
+
+    // A single block big enough to split the first bucket several times
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vectConnect;
+    for (int i = 0; i < 4500; ++i)
+        vectConnect.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hash, TxHash(i), 0, 1), CAddressUnspentValue(i + 1, CScript(), 1)));
+    vectConnect.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hashOther, TxHash(0), 0, 1), CAddressUnspentValue(1, CScript(), 1)));
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.UpdateAddressUnspentIndex(vectConnect, vectAmounts));
+        CheckUnspentPages(db, hash, 4500);
+        CheckUnspentPages(db, hashOther, 1);
+    }
+
+    // Spend every third output and add outputs created and spent within the same block
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vectSpend;
+    for (int i = 0; i < 4500; i += 3)
+        vectSpend.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hash, TxHash(i), 0, 1), CAddressUnspentValue()));
+    for (int i = 5000; i < 5010; ++i) {
+        vectSpend.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hash, TxHash(i), 0, 2), CAddressUnspentValue(i, CScript(), 2)));
+        vectSpend.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hash, TxHash(i), 0, 2), CAddressUnspentValue()));
+    }
+    vectSpend.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hash, TxHash(6000), 0, 2), CAddressUnspentValue(6000, CScript(), 2)));
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.UpdateAddressUnspentIndex(vectSpend, vectAmounts));
+        CheckUnspentPages(db, hash, 3001);
+    }
+
+    // Disconnect the spending block, the undo data restores the spent outputs
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vectUndo;
+    vectUndo.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hash, TxHash(6000), 0, 2), CAddressUnspentValue()));
+    for (int i = 0; i < 4500; i += 3)
+        vectUndo.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hash, TxHash(i), 0, 1), CAddressUnspentValue(i + 1, CScript(), 1)));
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.UpdateAddressUnspentIndex(vectUndo, vectAmounts));
+        CheckUnspentPages(db, hash, 4500);
+    }
+
+    // Disconnect the first block
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vectErase;
+    for (auto it = vectConnect.begin(); it != vectConnect.end(); ++it)
+        vectErase.push_back(std::make_pair(it->first, CAddressUnspentValue()));
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.UpdateAddressUnspentIndex(vectErase, vectAmounts));
+        CheckUnspentPages(db, hash, 0);
+        CheckUnspentPages(db, hashOther, 0);
+    }
+
+    // Rebuilding the anchors from scratch pages the same way
+    BOOST_CHECK(db.UpdateAddressUnspentIndex(vectConnect, vectAmounts));
+    BOOST_CHECK(db.UpdateAddressUnspentIndex(vectSpend, vectAmounts));
+    BOOST_CHECK(db.ReindexAddressPageAnchors(true, false));
+    CheckUnspentPages(db, hash, 3001);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_deposit_pages)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 hash(std::vector<unsigned char>(20, 4));
+
+    std::vector<std::pair<CDepositIndexKey, CDepositValue> > vectBlock1, vectBlock2;
+    for (int i = 0; i < 2500; ++i)
+        vectBlock1.push_back(std::make_pair(CDepositIndexKey(nAddressType, hash, 1000 + i, TxHash(i)), CDepositValue(i + 1, 1)));
+    for (int i = 2500; i < 3000; ++i)
+        vectBlock2.push_back(std::make_pair(CDepositIndexKey(nAddressType, hash, 1000 + i, TxHash(i)), CDepositValue(i + 1, 2)));
+
+    int nCount, nFirstTime, nLastTime;
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.WriteDepositIndex(vectBlock1));
+        BOOST_CHECK(db.WriteDepositIndex(vectBlock2));
+        BOOST_CHECK(db.ReadDepositIndexCount(hash, nAddressType, nCount, nFirstTime, nLastTime, 0, 0));
+        BOOST_CHECK_EQUAL(nCount, 3000);
+        BOOST_CHECK_EQUAL(nFirstTime, 1000);
+        BOOST_CHECK_EQUAL(nLastTime, 3999);
+    }
+
+    // Counting a time range and jumping to an offset go through the anchors
+    BOOST_CHECK(db.ReadDepositIndexCount(hash, nAddressType, nCount, nFirstTime, nLastTime, 1500, 3499));
+    BOOST_CHECK_EQUAL(nCount, 2000);
+
+    for (int nOffset = 0; nOffset < 3000; nOffset += 131) {
+        std::vector<std::pair<CDepositIndexKey, CDepositValue> > vect;
+        BOOST_CHECK(db.ReadDepositIndex(hash, nAddressType, vect, 0, nOffset, 1));
+        BOOST_CHECK_EQUAL(vect.size(), 1U);
+        if (vect.size() == 1)
+            BOOST_CHECK_EQUAL(vect[0].first.timestamp, 1000U + nOffset);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK(db.EraseDepositIndex(vectBlock2));
+        BOOST_CHECK(db.ReadDepositIndexCount(hash, nAddressType, nCount, nFirstTime, nLastTime, 0, 0));
+        BOOST_CHECK_EQUAL(nCount, 2500);
+        BOOST_CHECK_EQUAL(nLastTime, 3499);
+    }
+
+    std::vector<std::pair<CDepositIndexKey, CDepositValue> > vect;
+    BOOST_CHECK(db.ReadDepositIndex(hash, nAddressType, vect, 0, 2499, 1));
+    BOOST_CHECK_EQUAL(vect.size(), 1U);
+
+    BOOST_CHECK(db.EraseDepositIndex(vectBlock1));
+    BOOST_CHECK(db.ReadDepositIndexCount(hash, nAddressType, nCount, nFirstTime, nLastTime, 0, 0));
+    BOOST_CHECK_EQUAL(nCount, 0);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_amount_key_serialization)
+{
+    const uint160 hash = uint160(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    const CAmount vecAmounts[] = {0, 1, 12345 * COIN, MAX_MONEY, std::numeric_limits<CAmount>::max()};
+
+    for (const CAmount nAmount : vecAmounts) {
+        CAddressAmountKey key(nAddressType, hash, nAmount, TxHash(3), 7);
+
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << key;
+        BOOST_CHECK_EQUAL(key.GetSerializeSize(SER_DISK, CLIENT_VERSION), ss.size());
+        BOOST_CHECK_EQUAL(::GetSerializeSize(key, SER_DISK, CLIENT_VERSION), ss.size());
+
+        CAddressAmountKey keyRead;
+        ss >> keyRead;
+        BOOST_CHECK(ss.empty());
+        BOOST_CHECK_EQUAL(keyRead.type, key.type);
+        BOOST_CHECK(keyRead.hashBytes == key.hashBytes);
+        BOOST_CHECK_EQUAL(keyRead.nAmount, key.nAmount);
+        BOOST_CHECK(keyRead.txhash == key.txhash);
+        BOOST_CHECK_EQUAL(keyRead.index, key.index);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,193 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "key.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+#include "test/test_bitcoin.h"
+#include "txdb.h"
+#include "validation.h"
+#include "version.h"
+
+#include <map>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+struct CoinsCommitmentSetup : public TestChain100Setup {
+    CoinsCommitmentSetup()
+    {
+        FlushStateToDisk();
+        LOCK(cs_main);
+        assert(LoadCoinsCommitment(pcoinsdbview));
+    }
+
+    ~CoinsCommitmentSetup()
+    {
+        LOCK(cs_main);
+        pcoinsdbview->SetCoinsCommitment(NULL);
+        delete pcoinscommitment;
+        pcoinscommitment = NULL;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(coinstats_tests, CoinsCommitmentSetup)
+
+static void ApplySerialStats(CCoinsStats& stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    ss << hash;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << *(const CScriptBase*)(&output.second.out.scriptPubKey);
+        ss << VARINT(output.second.out.nValue);
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += output.second.out.nValue;
+    }
+    ss << VARINT(0);
+}
+
+// The single cursor scan gettxoutsetinfo did before the coins got scanned in ranges
+static bool GetSerialUTXOStats(CCoinsView* view, CCoinsStats& stats)
+{
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor());
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    stats.hashBlock = pcursor->GetBestBlock();
+    ss << stats.hashBlock;
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
+    while (pcursor->Valid()) {
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+            return false;
+        if (!outputs.empty() && key.hash != prevkey) {
+            ApplySerialStats(stats, ss, prevkey, outputs);
+            outputs.clear();
+        }
+        prevkey = key.hash;
+        outputs[key.n] = std::move(coin);
+        pcursor->Next();
+    }
+    if (!outputs.empty()) {
+        ApplySerialStats(stats, ss, prevkey, outputs);
+    }
+    stats.hashSerialized = ss.GetHash();
+    return true;
+}
+
+static void CheckCoinsStats(CCoinsViewDB* view)
+{
+    FlushStateToDisk();
+
+    CCoinsStats serial, scanned, muhash, committed;
+    BOOST_REQUIRE(GetSerialUTXOStats(view, serial));
+    BOOST_REQUIRE(GetUTXOStats(view, scanned, COINSTATS_HASH_SERIALIZED));
+    BOOST_REQUIRE(GetUTXOStats(view, muhash, COINSTATS_HASH_MUHASH));
+
+    // the ranges hash to the same hash_serialized_2 as the single cursor
+    BOOST_CHECK(scanned.hashBlock == serial.hashBlock);
+    BOOST_CHECK(scanned.hashSerialized == serial.hashSerialized);
+    BOOST_CHECK_EQUAL(scanned.nTransactions, serial.nTransactions);
+    BOOST_CHECK_EQUAL(scanned.nTransactionOutputs, serial.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(scanned.nTotalAmount, serial.nTotalAmount);
+
+    // the rolling commitment matches a full scan of the flushed coins
+    LOCK(cs_main);
+    BOOST_REQUIRE(pcoinscommitment);
+    pcoinscommitment->GetStats(committed);
+    BOOST_CHECK(committed.hashBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(committed.hashBlock == muhash.hashBlock);
+    BOOST_CHECK(committed.hashMuHash == muhash.hashMuHash);
+    BOOST_CHECK_EQUAL(committed.nTransactionOutputs, muhash.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(committed.nBogoSize, muhash.nBogoSize);
+    BOOST_CHECK_EQUAL(committed.nTotalAmount, muhash.nTotalAmount);
+}
+
+static void SignSpend(CMutableTransaction& tx, unsigned int nIn, const CScript& scriptPubKey, const CKey& key)
+{
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, tx, nIn, SIGHASH_ALL);
+    BOOST_REQUIRE(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[nIn].scriptSig << vchSig;
+}
+
+BOOST_AUTO_TEST_CASE(coinstats_commitment_connect_disconnect)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    CheckCoinsStats(pcoinsdbview);
+
+    std::vector<uint256> vBlocks;
+
+    for (int i = 0; i < 3; i++) {
+        // spend a mature coinbase into two outputs
+        CMutableTransaction spend;
+        spend.vin.resize(1);
+        spend.vin[0].prevout = COutPoint(coinbaseTxns[i].GetHash(), 0);
+        spend.vout.resize(2);
+        spend.vout[0].nValue = 11 * CENT;
+        spend.vout[0].scriptPubKey = scriptPubKey;
+        spend.vout[1].nValue = 12 * CENT;
+        spend.vout[1].scriptPubKey = scriptPubKey;
+        SignSpend(spend, 0, coinbaseTxns[i].vout[0].scriptPubKey, coinbaseKey);
+
+        // and one of those outputs again in the same block, so that coin
+        // gets created and spent without ever reaching the database
+        CMutableTransaction chained;
+        chained.vin.resize(1);
+        chained.vin[0].prevout = COutPoint(spend.GetHash(), 0);
+        chained.vout.resize(1);
+        chained.vout[0].nValue = 10 * CENT;
+        chained.vout[0].scriptPubKey = scriptPubKey;
+        SignSpend(chained, 0, scriptPubKey, coinbaseKey);
+
+        std::vector<CMutableTransaction> txns;
+        txns.push_back(spend);
+        txns.push_back(chained);
+
+        CBlock block = CreateAndProcessBlock(txns, scriptPubKey);
+        BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        vBlocks.push_back(block.GetHash());
+
+        CheckCoinsStats(pcoinsdbview);
+    }
+
+    // disconnect the blocks again, the in-block spends restore the coinbase outputs
+    const CChainParams& chainparams = Params();
+    for (int i = vBlocks.size() - 1; i >= 0; i--) {
+        CValidationState state;
+        {
+            LOCK(cs_main);
+            BOOST_REQUIRE(InvalidateBlock(state, chainparams.GetConsensus(), mapBlockIndex[vBlocks[i]]));
+        }
+        BOOST_REQUIRE(ActivateBestChain(state, chainparams));
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() != vBlocks[i]);
+
+        CheckCoinsStats(pcoinsdbview);
+    }
+
+    // and connect them once more
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE(ResetBlockFailureFlags(mapBlockIndex[vBlocks[0]]));
+    }
+    CValidationState state;
+    BOOST_REQUIRE(ActivateBestChain(state, chainparams));
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == vBlocks.back());
+
+    CheckCoinsStats(pcoinsdbview);
+
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
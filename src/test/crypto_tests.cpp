@@ -3,12 +3,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "crypto/aes.h"
+#include "crypto/common.h"
+#include "crypto/keccak256.h"
+#include "crypto/muhash.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/sph_keccak.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
@@ -55,6 +59,17 @@ void TestSHA1(const std::string &in, const std::string &hexout) { TestVector(CSH
 void TestSHA256(const std::string &in, const std::string &hexout) { TestVector(CSHA256(), in, ParseHex(hexout));}
 void TestSHA512(const std::string &in, const std::string &hexout) { TestVector(CSHA512(), in, ParseHex(hexout));}
 void TestRIPEMD160(const std::string &in, const std::string &hexout) { TestVector(CRIPEMD160(), in, ParseHex(hexout));}
+void TestKeccak256(const std::string &in, const std::string &hexout) { TestVector(CKeccak256(), in, ParseHex(hexout));}
+
+std::vector<unsigned char> SphKeccak256(const unsigned char* data, size_t len)
+{
+    sph_keccak256_context ctx;
+    std::vector<unsigned char> hash(CKeccak256::OUTPUT_SIZE);
+    sph_keccak256_init(&ctx);
+    sph_keccak256(&ctx, data, len);
+    sph_keccak256_close(&ctx, &hash[0]);
+    return hash;
+}
 
 void TestHMACSHA256(const std::string &hexkey, const std::string &hexin, const std::string &hexout) {
     std::vector<unsigned char> key = ParseHex(hexkey);
@@ -292,6 +307,129 @@ BOOST_AUTO_TEST_CASE(sha512_testvectors) {
                "37de8c3ef5459d76a52cedc02dc499a3c9ed9dedbfb3281afd9653b8a112fafc");
 }
 
+BOOST_AUTO_TEST_CASE(keccak256_testvectors) {
+    TestKeccak256("", "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+    TestKeccak256("abc", "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45");
+    TestKeccak256("The quick brown fox jumps over the lazy dog",
+                  "4d741b6f1eb29cb2a9b9911c82f56fa8d73b04959d3d9d222895df6c0b28aa15");
+    TestKeccak256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+                  "45d3b367a6904e6e8d502ee04999a7c27647f91fa845d456525fd352ae3d7371");
+    TestKeccak256("As Bitcoin relies on 80 byte header hashes, we want to have an example for that.",
+                  "d014c33f665c1a7cbf66149112d4cef1d437179d2cb75ecca6b106c31bca21da");
+    TestKeccak256(std::string(1000000, 'a'),
+                  "fadae6b49f129bbb812be8407b7b2894f34aecf6dbd1f9b0f0c7e9853098fc96");
+    TestKeccak256(test1, "94757deafc80852651956f9d0b8c0870d5f333a31dff767a40a1edba2339466c");
+}
+
+BOOST_AUTO_TEST_CASE(keccak256_kernels) {
+    // Every kernel width has to match the reference implementation, for
+    // lengths around the block size and for partially filled lane groups.
+    const size_t vLanes[] = {1, 4, 8};
+
+    for (size_t nMaxLanes : vLanes) {
+        Keccak256AutoDetect(nMaxLanes);
+
+        for (size_t len = 0; len <= 3 * CKeccak256::RATE; len += 1 + insecure_rand() % 7) {
+            std::vector<unsigned char> data(len + 1);
+            for (unsigned char& c : data) c = insecure_rand();
+
+            std::vector<unsigned char> hash(CKeccak256::OUTPUT_SIZE);
+            CKeccak256().Write(&data[0], len).Finalize(&hash[0]);
+            BOOST_CHECK(hash == SphKeccak256(&data[0], len));
+        }
+
+        for (size_t nCount = 1; nCount <= 19; nCount++) {
+            const size_t len = insecure_rand() % (2 * CKeccak256::RATE);
+            std::vector<std::vector<unsigned char> > inputs(nCount, std::vector<unsigned char>(len + 1));
+            std::vector<std::vector<unsigned char> > hashes(nCount, std::vector<unsigned char>(CKeccak256::OUTPUT_SIZE));
+            std::vector<const unsigned char*> vpInputs;
+            std::vector<unsigned char*> vpHashes;
+
+            for (size_t i = 0; i < nCount; i++) {
+                for (unsigned char& c : inputs[i]) c = insecure_rand();
+                vpInputs.push_back(&inputs[i][0]);
+                vpHashes.push_back(&hashes[i][0]);
+            }
+
+            Keccak256Multi(&vpInputs[0], len, &vpHashes[0], nCount);
+
+            for (size_t i = 0; i < nCount; i++) {
+                BOOST_CHECK(hashes[i] == SphKeccak256(&inputs[i][0], len));
+            }
+        }
+
+        unsigned char header[CKeccak256Header::HEADER_SIZE];
+        for (unsigned char& c : header) c = insecure_rand();
+
+        const uint32_t nNonceStart = insecure_rand();
+        const size_t nCount = 37;
+        std::vector<unsigned char> hashes(nCount * CKeccak256::OUTPUT_SIZE);
+        CKeccak256Header headerHasher(header);
+        headerHasher.HashNonces(nNonceStart, nCount, &hashes[0]);
+
+        for (size_t i = 0; i < nCount; i++) {
+            const uint32_t nNonce = nNonceStart + i;
+            WriteLE32(header + 76, nNonce);
+
+            std::vector<unsigned char> hash(CKeccak256::OUTPUT_SIZE);
+            headerHasher.Hash(nNonce, &hash[0]);
+            BOOST_CHECK(hash == SphKeccak256(header, sizeof(header)));
+            BOOST_CHECK(std::vector<unsigned char>(hashes.begin() + i * CKeccak256::OUTPUT_SIZE, hashes.begin() + (i + 1) * CKeccak256::OUTPUT_SIZE) == hash);
+        }
+    }
+
+    Keccak256AutoDetect();
+}
+
+static std::string MuHashHex(MuHash3072 muhash)
+{
+    unsigned char out[MuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(out);
+    return HexStr(out, out + sizeof(out));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests) {
+    const unsigned char a[] = "a", b[] = "b", c[] = "c";
+
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072()), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072().Insert(a, 1).Insert(b, 1)), "5693661efcb101a2faa5dd944dd8540d4ecf85d19ee953d6ad8a64c983c4d5f6");
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072().Insert(b, 1).Insert(a, 1)), "5693661efcb101a2faa5dd944dd8540d4ecf85d19ee953d6ad8a64c983c4d5f6");
+    BOOST_CHECK_EQUAL(MuHashHex(MuHash3072().Insert(a, 1).Insert(b, 1).Insert(c, 1).Remove(b, 1)), "ce703ab504583ff3964f1662df0ee7c94ae3f4ed9701b0bb4a250e6b3244211e");
+
+    // Removals before the insertions and merged deltas give the same set.
+    MuHash3072 delta;
+    delta.Remove(a, 1).Insert(c, 1);
+    MuHash3072 set;
+    set.Insert(a, 1).Insert(b, 1);
+    set *= delta;
+    BOOST_CHECK_EQUAL(MuHashHex(set), MuHashHex(MuHash3072().Insert(c, 1).Insert(b, 1)));
+
+    // The state survives a round trip, finalized or not.
+    unsigned char state[MuHash3072::STATE_SIZE];
+    set.GetState(state);
+    MuHash3072 restored;
+    restored.SetState(state);
+    BOOST_CHECK_EQUAL(MuHashHex(restored), MuHashHex(set));
+
+    for (int i = 0; i < 8; i++) {
+        unsigned char data[Num3072::BYTE_SIZE];
+        for (size_t j = 0; j < sizeof(data); j++) {
+            data[j] = insecure_rand();
+        }
+        // All bits set is above the modulus.
+        if (i == 0)
+            memset(data, 0xff, sizeof(data));
+
+        Num3072 x(data);
+        Num3072 y = x.GetInverse();
+        y.Multiply(x);
+        BOOST_CHECK(y.limbs[0] == 1);
+        for (int j = 1; j < Num3072::LIMBS; j++) {
+            BOOST_CHECK(y.limbs[j] == 0);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(hmac_sha256_testvectors) {
     // test cases 1, 2, 3, 4, 6 and 7 of RFC 4231
     TestHMACSHA256("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
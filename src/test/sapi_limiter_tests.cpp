@@ -0,0 +1,52 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "netbase.h"
+#include "sapi/sapi.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sapi_limiter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sapi_limiter_lock_escalation)
+{
+    const int64_t vecLocks[] = {10, 60, 600, 3600};
+
+    CNetAddr peer;
+    BOOST_REQUIRE(LookupHost("10.77.0.1", peer, false));
+
+    // Run the bucket empty, the client gets the first lock
+    int64_t nLockSeconds = 0;
+    int nRequests = 0;
+    while( !SAPI::Limits::Request(peer, nLockSeconds) ){
+        BOOST_REQUIRE(++nRequests <= 2 * SAPI::Limits::nRequestsPerInterval);
+    }
+    BOOST_CHECK(nLockSeconds >= vecLocks[0] - 1 && nLockSeconds <= vecLocks[0]);
+
+    // Keep sending through the locks, each time the bucket runs empty
+    // again the lock goes up to the next step and stays there at the end
+    for( size_t nLevel = 1; nLevel <= 4; ++nLevel ){
+
+        int64_t nLock = vecLocks[std::min<size_t>(nLevel, 3)];
+        int64_t nLockLast = nLockSeconds;
+
+        for( int64_t i = 1; i < SAPI::Limits::nRequestsPerInterval; ++i ){
+            BOOST_CHECK(SAPI::Limits::Request(peer, nLockSeconds));
+            BOOST_CHECK(nLockSeconds <= nLockLast);
+        }
+
+        BOOST_CHECK(SAPI::Limits::Request(peer, nLockSeconds));
+        BOOST_CHECK(nLockSeconds >= nLock - 1 && nLockSeconds <= nLock);
+        if( nLevel < 4 ) BOOST_CHECK(nLockSeconds > nLockLast);
+    }
+
+    // Other clients are not affected
+    CNetAddr other;
+    BOOST_REQUIRE(LookupHost("10.77.0.2", other, false));
+    BOOST_CHECK(!SAPI::Limits::Request(other, nLockSeconds));
+    BOOST_CHECK_EQUAL(nLockSeconds, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include "txdb.h"
 
 #include "chainparams.h"
+#include "coinstats.h"
 #include "hash.h"
 #include "pow.h"
 #include "uint256.h"
@@ -13,6 +14,7 @@
 #include "init.h"
 
 #include <stdint.h>
+#include <limits>
 
 #include <boost/thread.hpp>
 
@@ -24,9 +26,15 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCEINDEX = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_DEPOSITINDEX = 'd';
+static const char DB_ADDRESSUNSPENTCOUNT = 'U';
+static const char DB_ADDRESSUNSPENTANCHOR = 'w';
+static const char DB_DEPOSITCOUNT = 'D';
+static const char DB_DEPOSITANCHOR = 'e';
+static const char DB_ADDRESSAMOUNTINDEX = 'm';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_VOTE_KEY_REGISTRATION = 'r';
@@ -35,6 +43,10 @@ static const char DB_VOTE_MAP_KEY_TO_ADDRESS = 'V';
 
 static const char DB_INSTANTPAY_INDEX = 'i';
 
+static const char DB_MININGSIGINDEX = 'k';
+
+static const char DB_COINS_COMMITMENT = 'M';
+
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
@@ -64,7 +76,7 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true), pcommitment(NULL)
 {
 }
 
@@ -102,6 +114,9 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
+    // In the same batch, so the commitment always matches the stored coins.
+    if (pcommitment && !hashBlock.IsNull() && pcommitment->hashBlock == hashBlock)
+        batch.Write(DB_COINS_COMMITMENT, *pcommitment);
 
     bool ret = db.WriteBatch(batch);
     LogPrint("coindb", "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
@@ -113,6 +128,11 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
+bool CCoinsViewDB::ReadCoinsCommitment(CCoinsCommitment &commitment) const
+{
+    return db.Read(DB_COINS_COMMITMENT, commitment);
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -154,6 +174,24 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
     return i;
 }
 
+CCoinsViewCursor *CCoinsViewDB::Cursor(const COutPoint &start, const leveldb::Snapshot *psnapshot) const
+{
+    uint256 hashBestChain;
+    if (!db.Read(DB_BEST_BLOCK, hashBestChain, psnapshot))
+        hashBestChain.SetNull();
+
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(psnapshot), hashBestChain);
+    i->pcursor->Seek(CoinEntry(&start));
+    if (i->pcursor->Valid()) {
+        CoinEntry entry(&i->keyTmp.second);
+        i->pcursor->GetKey(entry);
+        i->keyTmp.first = entry.key;
+    } else {
+        i->keyTmp.first = 0;
+    }
+    return i;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
@@ -206,10 +244,13 @@ bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
     return Read(make_pair(DB_TXINDEX, txid), pos);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
+bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect,
+                                const std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &miningSignatureIndex) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_TXINDEX, it->first), it->second);
+    for (std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> >::const_iterator it=miningSignatureIndex.begin(); it!=miningSignatureIndex.end(); it++)
+        batch.Write(make_pair(DB_MININGSIGINDEX, it->first), it->second);
     return WriteBatch(batch);
 }
 
@@ -229,8 +270,412 @@ bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey,
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+/**
+ * Page anchors for the address unspent and deposit indexes
+ *
+ * Every address has a counter record with the number of its index entries and a sparse set of
+ * anchor records. Each anchor is keyed with an index key of the address and holds the number of
+ * entries from that key up to the next anchor, so that counting is a single read and jumping
+ * to an offset only walks the anchors plus at most one bucket of entries.
+ */
+
+//! Target number of index entries between two page anchors
+static const int64_t nPageAnchorInterval = 1000;
+
+template <typename K>
+static std::string SerializeIndexKey(const K &key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return ss.str();
+}
+
+/**
+ * Find the nPosition-th entry of the bucket starting at anchor, with the pending changes of
+ * the address (serialized key -> key, present) applied on top of the database.
+ */
+template <typename K>
+static bool FindBucketEntry(CBlockTreeDB &db, char chIndex, const K &anchor,
+                            const std::map<std::string, std::pair<K, bool> > &mapPending, int64_t nPosition, K &entry)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(chIndex, anchor));
+    auto pending = mapPending.lower_bound(SerializeIndexKey(anchor));
+
+    while (true) {
+        std::pair<char, K> key;
+        const bool fStored = pcursor->Valid() && pcursor->GetKey(key) && key.first == chIndex &&
+                             key.second.type == anchor.type && key.second.hashBytes == anchor.hashBytes;
+        const std::string strStored = fStored ? SerializeIndexKey(key.second) : std::string();
+
+        if (!fStored && pending == mapPending.end())
+            return false;
+
+        bool fPresent = true;
+        if (pending != mapPending.end() && (!fStored || pending->first <= strStored)) {
+            if (fStored && pending->first == strStored)
+                pcursor->Next();
+            key.second = pending->second.first;
+            fPresent = pending->second.second;
+            ++pending;
+        } else {
+            pcursor->Next();
+        }
+
+        if (fPresent && nPosition-- == 0) {
+            entry = key.second;
+            return true;
+        }
+    }
+}
+
+/**
+ * Apply a list of index writes (false) and erases (true) to the counters and anchors of the affected
+ * addresses. All writes go into the batch of the index entries, so they are applied atomically.
+ */
+template <typename K>
+static void UpdatePageAnchors(CBlockTreeDB &db, CDBBatch &batch, char chIndex, char chAnchor, char chCount,
+                              const std::vector<std::pair<K, bool> > &vecChanges)
+{
+    // Whether the first and the last change of every entry is an erase
+    std::map<std::string, std::pair<bool, bool> > mapFirstLast;
+
+    for (auto it = vecChanges.begin(); it != vecChanges.end(); ++it) {
+        auto result = mapFirstLast.insert(std::make_pair(SerializeIndexKey(it->first), std::make_pair(it->second, it->second)));
+        if (!result.second)
+            result.first->second.second = it->second;
+    }
+
+    // Blocks get connected again after an unclean shutdown. The changes of a block are written
+    // in one batch, so a single entry the changes flip tells whether all of them are applied.
+    for (auto it = vecChanges.begin(); it != vecChanges.end(); ++it) {
+        const std::pair<bool, bool> &firstLast = mapFirstLast[SerializeIndexKey(it->first)];
+        if (firstLast.first == firstLast.second) {
+            if (db.Exists(std::make_pair(chIndex, it->first)) == !firstLast.second)
+                return;
+            break;
+        }
+    }
+
+    std::map<std::pair<unsigned int, uint160>, std::vector<std::pair<K, bool> > > mapChanges;
+
+    for (auto it = vecChanges.begin(); it != vecChanges.end(); ++it)
+        mapChanges[std::make_pair(it->first.type, it->first.hashBytes)].push_back(*it);
+
+    for (auto addr = mapChanges.begin(); addr != mapChanges.end(); ++addr) {
+
+        const CAddressIndexIteratorKey addressKey(addr->first.first, addr->first.second);
+
+        int64_t nCount = 0;
+        db.Read(std::make_pair(chCount, addressKey), nCount);
+        const int64_t nCountBefore = nCount;
+
+        // Load the anchors of the address, there are only nCount / nPageAnchorInterval of them
+        std::map<std::string, std::pair<K, int64_t> > mapAnchors;
+        std::map<std::string, int64_t> mapAnchorsBefore;
+        boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+        pcursor->Seek(std::make_pair(chAnchor, addressKey));
+
+        while (pcursor->Valid()) {
+            std::pair<char, K> key;
+            int64_t nAnchorCount;
+            if (!pcursor->GetKey(key) || key.first != chAnchor ||
+                key.second.type != addressKey.type || key.second.hashBytes != addressKey.hashBytes ||
+                !pcursor->GetValue(nAnchorCount))
+                break;
+
+            std::string strKey = SerializeIndexKey(key.second);
+            mapAnchors.insert(std::make_pair(strKey, std::make_pair(key.second, nAnchorCount)));
+            mapAnchorsBefore.insert(std::make_pair(strKey, nAnchorCount));
+            pcursor->Next();
+        }
+
+        std::map<std::string, std::pair<K, bool> > mapPresent;
+
+        for (auto change = addr->second.begin(); change != addr->second.end(); ++change) {
+
+            const K &key = change->first;
+            const bool fErase = change->second;
+            const std::string strKey = SerializeIndexKey(key);
+
+            // Entries are present before the batch if their first change erases them
+            auto present = mapPresent.find(strKey);
+            bool fPresent = present != mapPresent.end() ? present->second.second : mapFirstLast[strKey].first;
+
+            if (fPresent == !fErase)
+                continue;
+
+            mapPresent[strKey] = std::make_pair(key, !fErase);
+            nCount += fErase ? -1 : 1;
+
+            // The bucket of an entry is the one of the greatest anchor less or equal to it
+            auto bucket = mapAnchors.upper_bound(strKey);
+
+            if (bucket == mapAnchors.begin()) {
+
+                if (fErase) {
+                    if (bucket == mapAnchors.end())
+                        continue;
+                } else {
+                    // Entries below the first anchor move the first anchor down
+                    int64_t nFirstCount = 0;
+                    if (bucket != mapAnchors.end()) {
+                        nFirstCount = bucket->second.second;
+                        mapAnchors.erase(bucket);
+                    }
+                    mapAnchors.insert(std::make_pair(strKey, std::make_pair(key, nFirstCount + 1)));
+                    continue;
+                }
+
+            } else {
+                --bucket;
+            }
+
+            if (!fErase) {
+                ++bucket->second.second;
+                continue;
+            }
+
+            if (--bucket->second.second <= 0) {
+                mapAnchors.erase(bucket);
+            } else if (bucket != mapAnchors.begin() && bucket->second.second < nPageAnchorInterval / 2) {
+                // Merge small buckets into their predecessor
+                auto prev = bucket;
+                --prev;
+                if (prev->second.second + bucket->second.second <= nPageAnchorInterval) {
+                    prev->second.second += bucket->second.second;
+                    mapAnchors.erase(bucket);
+                }
+            }
+        }
+
+        // Split oversized buckets in the middle, counting the entries of this batch as written
+        for (auto it = mapAnchors.begin(); it != mapAnchors.end(); ) {
+            if (it->second.second > 2 * nPageAnchorInterval) {
+                const int64_t nHalf = it->second.second / 2;
+                K split;
+                if (FindBucketEntry(db, chIndex, it->second.first, mapPresent, nHalf, split)) {
+                    mapAnchors.insert(std::make_pair(SerializeIndexKey(split), std::make_pair(split, it->second.second - nHalf)));
+                    it->second.second = nHalf;
+                    continue;
+                }
+                LogPrintf("%s: page anchor bucket smaller than expected\n", __func__);
+            }
+            ++it;
+        }
+
+        for (auto it = mapAnchorsBefore.begin(); it != mapAnchorsBefore.end(); ++it) {
+            if (!mapAnchors.count(it->first)) {
+                CDataStream ss(it->first.data(), it->first.data() + it->first.size(), SER_DISK, CLIENT_VERSION);
+                K key;
+                ss >> key;
+                batch.Erase(std::make_pair(chAnchor, key));
+            }
+        }
+
+        for (auto it = mapAnchors.begin(); it != mapAnchors.end(); ++it) {
+            auto before = mapAnchorsBefore.find(it->first);
+            if (before == mapAnchorsBefore.end() || before->second != it->second.second)
+                batch.Write(std::make_pair(chAnchor, it->second.first), it->second.second);
+        }
+
+        if (nCount != nCountBefore) {
+            if (nCount > 0)
+                batch.Write(std::make_pair(chCount, addressKey), nCount);
+            else
+                batch.Erase(std::make_pair(chCount, addressKey));
+        }
+    }
+}
+
+/** Position the cursor at the nPosition-th index entry of an address. Returns false if there is no such entry. */
+template <typename K>
+static bool SeekPagePosition(CBlockTreeDB &db, CDBIterator *pcursor, char chIndex, char chAnchor,
+                             const CAddressIndexIteratorKey &addressKey, int64_t nPosition)
+{
+    if (nPosition < 0)
+        return false;
+
+    boost::scoped_ptr<CDBIterator> panchors(db.NewIterator());
+    panchors->Seek(std::make_pair(chAnchor, addressKey));
+
+    int64_t nSkipped = 0;
+
+    while (panchors->Valid()) {
+        std::pair<char, K> key;
+        int64_t nAnchorCount;
+        if (!panchors->GetKey(key) || key.first != chAnchor ||
+            key.second.type != addressKey.type || key.second.hashBytes != addressKey.hashBytes ||
+            !panchors->GetValue(nAnchorCount))
+            break;
+
+        if (nSkipped + nAnchorCount > nPosition) {
+
+            pcursor->Seek(std::make_pair(chIndex, key.second));
+
+            for (; nSkipped < nPosition && pcursor->Valid(); ++nSkipped)
+                pcursor->Next();
+
+            return pcursor->Valid();
+        }
+
+        nSkipped += nAnchorCount;
+        panchors->Next();
+    }
+
+    return false;
+}
+
+/** Number of index entries of an address which sort before seekKey. */
+template <typename K, typename S>
+static int64_t GetPageRank(CBlockTreeDB &db, char chIndex, char chAnchor,
+                           const CAddressIndexIteratorKey &addressKey, const S &seekKey)
+{
+    const std::string strSeek = SerializeIndexKey(seekKey);
+
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(chAnchor, addressKey));
+
+    int64_t nRank = 0, nLastCount = 0;
+    K lastAnchor;
+    bool fFound = false;
+
+    while (pcursor->Valid()) {
+        std::pair<char, K> key;
+        int64_t nAnchorCount;
+        if (!pcursor->GetKey(key) || key.first != chAnchor ||
+            key.second.type != addressKey.type || key.second.hashBytes != addressKey.hashBytes ||
+            !pcursor->GetValue(nAnchorCount) || SerializeIndexKey(key.second) >= strSeek)
+            break;
+
+        nRank += nLastCount;
+        nLastCount = nAnchorCount;
+        lastAnchor = key.second;
+        fFound = true;
+        pcursor->Next();
+    }
+
+    if (!fFound)
+        return 0;
+
+    // Count the entries of the last bucket below the seek key
+    pcursor->Seek(std::make_pair(chIndex, lastAnchor));
+
+    for (int64_t i = 0; i < nLastCount && pcursor->Valid(); ++i, ++nRank) {
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chIndex || SerializeIndexKey(key.second) >= strSeek)
+            break;
+        pcursor->Next();
+    }
+
+    return nRank;
+}
+
+/** Write the batch once it holds about 1 MiB of erased keys. */
+static bool FlushEraseBatch(CBlockTreeDB &db, CDBBatch &batch)
+{
+    if (batch.SizeEstimate() <= (1 << 20))
+        return true;
+
+    if (!db.WriteBatch(batch))
+        return false;
+
+    batch.Clear();
+    return true;
+}
+
+/** Build the counters and anchors of an existing index from scratch. */
+template <typename K>
+static bool ReindexPageAnchors(CBlockTreeDB &db, char chIndex, char chAnchor, char chCount)
+{
+    const size_t nMaxBatchSize = 16 * 1024 * 1024;
+
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    CDBBatch batch(db);
+
+    // Drop leftovers of a previous build first
+    pcursor->Seek(chAnchor);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chAnchor)
+            break;
+        batch.Erase(key);
+        if (!FlushEraseBatch(db, batch))
+            return false;
+        pcursor->Next();
+    }
+
+    pcursor->Seek(chCount);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CAddressIndexIteratorKey> key;
+        if (!pcursor->GetKey(key) || key.first != chCount)
+            break;
+        batch.Erase(key);
+        if (!FlushEraseBatch(db, batch))
+            return false;
+        pcursor->Next();
+    }
+
+    pcursor->Seek(chIndex);
+
+    CAddressIndexIteratorKey currentKey;
+    K anchorKey;
+    int64_t nCount = 0, nAnchorCount = 0;
+
+    auto finishAddress = [&]() {
+        if (nCount) {
+            batch.Write(std::make_pair(chCount, currentKey), nCount);
+            batch.Write(std::make_pair(chAnchor, anchorKey), nAnchorCount);
+        }
+        nCount = 0;
+        nAnchorCount = 0;
+    };
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chIndex)
+            break;
+
+        if (key.second.type != currentKey.type || key.second.hashBytes != currentKey.hashBytes) {
+
+            finishAddress();
+
+            if (batch.SizeEstimate() > nMaxBatchSize) {
+                if (!db.WriteBatch(batch))
+                    return false;
+                batch.Clear();
+            }
+
+            currentKey = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+        }
+
+        if (!nCount || nAnchorCount == nPageAnchorInterval) {
+            if (nAnchorCount)
+                batch.Write(std::make_pair(chAnchor, anchorKey), nAnchorCount);
+            anchorKey = key.second;
+            nAnchorCount = 0;
+        }
+
+        ++nCount;
+        ++nAnchorCount;
+        pcursor->Next();
+    }
+
+    finishAddress();
+
+    return db.WriteBatch(batch, true);
+}
+
+bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect,
+                                             const std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > &vectAmounts) {
     CDBBatch batch(*this);
+    std::vector<std::pair<CAddressUnspentKey, bool> > vecChanges;
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        vecChanges.push_back(make_pair(it->first, it->second.IsNull()));
+    UpdatePageAnchors(*this, batch, DB_ADDRESSUNSPENTINDEX, DB_ADDRESSUNSPENTANCHOR, DB_ADDRESSUNSPENTCOUNT, vecChanges);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
@@ -238,37 +683,44 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
             batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
         }
     }
+    for (std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> >::const_iterator it=vectAmounts.begin(); it!=vectAmounts.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSAMOUNTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSAMOUNTINDEX, it->first), it->second);
+        }
+    }
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex) {
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    const CAddressIndexIteratorKey addressKey(type, addressHash);
+    int64_t nEntries = 0;
 
     lastIndex.SetNull();
     nCount = 0;
 
-    std::pair<char,CAddressUnspentKey> key;
+    if (!Read(make_pair(DB_ADDRESSUNSPENTCOUNT, addressKey), nEntries) || nEntries <= 0)
+        return true;
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            ++nCount;
-            pcursor->Next();
-        } else if( nCount ) {
+    nCount = static_cast<int>(nEntries);
 
-            pcursor->Prev();
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-            if(pcursor->Valid() && pcursor->GetKey(key))
-                lastIndex = key.second;
+    // Seek behind the highest possible key of the address and step back to its last entry
+    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorHeightKey(type, addressHash, std::numeric_limits<int>::max())));
 
-            break;
-        }else{
-            break;
-        }
-    }
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else if (!SeekPagePosition<CAddressUnspentKey>(*this, pcursor.get(), DB_ADDRESSUNSPENTINDEX, DB_ADDRESSUNSPENTANCHOR, addressKey, nEntries - 1))
+        return error("%s: failed to seek the last unspent index entry", __func__);
+
+    std::pair<char,CAddressUnspentKey> key;
+
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX &&
+        key.second.type == (unsigned int)type && key.second.hashBytes == addressHash)
+        lastIndex = key.second;
 
     return true;
 }
@@ -277,13 +729,30 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
                                            const CAddressUnspentKey &start, int offset, int limit, bool reverse) {
 
+    const CAddressIndexIteratorKey addressKey(type, addressHash);
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-    int nOffsetCount = 0, nFound = 0;
+    int nFound = 0;
 
-    if( start.IsNull() )
-        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    else
-        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, start));
+    if( offset < 0 ){
+
+        if( start.IsNull() )
+            pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, addressKey));
+        else
+            pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, start));
+
+    }else{
+
+        // Jump to the requested offset with the page anchors instead of skipping the entries
+        int64_t nPosition = 0;
+
+        if( !start.IsNull() )
+            nPosition = GetPageRank<CAddressUnspentKey>(*this, DB_ADDRESSUNSPENTINDEX, DB_ADDRESSUNSPENTANCHOR, addressKey, start);
+
+        nPosition += reverse ? -offset : offset;
+
+        if( !SeekPagePosition<CAddressUnspentKey>(*this, pcursor.get(), DB_ADDRESSUNSPENTINDEX, DB_ADDRESSUNSPENTANCHOR, addressKey, nPosition) )
+            return true;
+    }
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
@@ -295,10 +764,8 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
 
-                if( offset < 0 || ++nOffsetCount > offset ){
-                    unspentOutputs.push_back(make_pair(key.second, nValue));
-                    ++nFound;
-                }
+                unspentOutputs.push_back(make_pair(key.second, nValue));
+                ++nFound;
 
                 if( reverse ) pcursor->Prev();
                 else          pcursor->Next();
@@ -314,8 +781,120 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressAmountIndex(uint160 addressHash, int type,
+                                          std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > &vect,
+                                          const CAddressAmountKey &start, int limit, bool reverse) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    std::pair<char,CAddressAmountKey> key;
+    int nFound = 0;
+
+    if( !reverse ){
+
+        if( start.IsNull() )
+            pcursor->Seek(make_pair(DB_ADDRESSAMOUNTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+        else
+            pcursor->Seek(make_pair(DB_ADDRESSAMOUNTINDEX, start));
+
+    }else{
+
+        // Seek to the first entry behind the start and step back from there
+        if( start.IsNull() )
+            pcursor->Seek(make_pair(DB_ADDRESSAMOUNTINDEX, CAddressAmountKey(type, addressHash, std::numeric_limits<CAmount>::max(),
+                                                                             uint256S(std::string(64, 'f')), std::numeric_limits<uint32_t>::max())));
+        else
+            pcursor->Seek(make_pair(DB_ADDRESSAMOUNTINDEX, start));
+
+        if( !pcursor->Valid() )
+            pcursor->SeekToLast();
+        else if( start.IsNull() || !pcursor->GetKey(key) || key.first != DB_ADDRESSAMOUNTINDEX ||
+                 key.second.type != start.type || key.second.hashBytes != start.hashBytes ||
+                 key.second.nAmount != start.nAmount || key.second.txhash != start.txhash || key.second.index != start.index )
+            pcursor->Prev();
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSAMOUNTINDEX &&
+            key.second.type == static_cast<unsigned int>(type) && key.second.hashBytes == addressHash) {
+            if (limit > 0 && nFound == limit) {
+                break;
+            }
+            CAddressAmountValue nValue;
+            if (pcursor->GetValue(nValue)) {
+
+                vect.push_back(make_pair(key.second, nValue));
+                ++nFound;
+
+                if( reverse ) pcursor->Prev();
+                else          pcursor->Next();
+
+            } else {
+                return error("failed to get address amount value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::ReindexAddressAmounts() {
+
+    const size_t nMaxBatchSize = 16 * 1024 * 1024;
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    int64_t nOutputs = 0;
+
+    // Drop leftovers of an interrupted run
+    pcursor->Seek(DB_ADDRESSAMOUNTINDEX);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressAmountKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSAMOUNTINDEX)
+            break;
+        batch.Erase(key);
+        if (!FlushEraseBatch(*this, batch))
+            return error("%s: failed to erase address amounts", __func__);
+        pcursor->Next();
+    }
+
+    pcursor->Seek(DB_ADDRESSUNSPENTINDEX);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX)
+            break;
+
+        CAddressUnspentValue value;
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to get address unspent value", __func__);
+
+        batch.Write(make_pair(DB_ADDRESSAMOUNTINDEX, CAddressAmountKey(key.second.type, key.second.hashBytes, value.satoshis, key.second.txhash, key.second.index)),
+                    CAddressAmountValue(key.second.nBlockHeight));
+        ++nOutputs;
+
+        if( batch.SizeEstimate() > nMaxBatchSize ){
+            if( !WriteBatch(batch) )
+                return error("%s: failed to write address amounts", __func__);
+            batch.Clear();
+            LogPrintf("%s: %d outputs processed\n", __func__, nOutputs);
+        }
+
+        pcursor->Next();
+    }
+
+    LogPrintf("%s: %d outputs processed\n", __func__, nOutputs);
+
+    return WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    UpdateAddressBalances(batch, vect, false);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
     return WriteBatch(batch);
@@ -323,11 +902,155 @@ bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
+    UpdateAddressBalances(batch, vect, true);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
     return WriteBatch(batch);
 }
 
+void CBlockTreeDB::UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) {
+
+    // Sum up the deltas per address first so that each aggregate gets read and written only once
+    std::map<std::pair<unsigned int, uint160>, CAddressBalanceValue> mapDeltas;
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+
+        CAddressBalanceValue &delta = mapDeltas[make_pair(it->first.type, it->first.hashBytes)];
+
+        if( delta.IsNull() || it->first.blockHeight < delta.nFirstHeight )
+            delta.nFirstHeight = it->first.blockHeight;
+
+        delta.nLastHeight = std::max(delta.nLastHeight, it->first.blockHeight);
+        delta.balance += it->second;
+        if (it->second > 0)
+            delta.received += it->second;
+        delta.nUtxoCount += it->first.spending ? -1 : 1;
+    }
+
+    for (auto it = mapDeltas.begin(); it != mapDeltas.end(); ++it) {
+
+        const CAddressIndexIteratorKey key(it->first.first, it->first.second);
+        const CAddressBalanceValue &delta = it->second;
+        CAddressBalanceValue value;
+
+        if( !Read(make_pair(DB_ADDRESSBALANCEINDEX, key), value) )
+            value.SetNull();
+
+        // Blocks get connected again after an unclean shutdown. The deltas of a block are written
+        // in one batch with the aggregate, so its last height tells whether they are accounted for.
+        if( !fErase && !value.IsNull() && value.nLastHeight >= delta.nFirstHeight )
+            continue;
+
+        if( fErase && (value.IsNull() || value.nLastHeight < delta.nFirstHeight) )
+            continue;
+
+        if( !fErase ){
+
+            if( value.IsNull() || delta.nFirstHeight < value.nFirstHeight )
+                value.nFirstHeight = delta.nFirstHeight;
+
+            value.nLastHeight = std::max(value.nLastHeight, delta.nLastHeight);
+            value.balance += delta.balance;
+            value.received += delta.received;
+            value.nUtxoCount += delta.nUtxoCount;
+
+        }else{
+
+            value.balance -= delta.balance;
+            value.received -= delta.received;
+            value.nUtxoCount -= delta.nUtxoCount;
+
+            // The erased deltas were the latest activity of the address, so look up
+            // the last delta below them which is not affected by this batch.
+            boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(key.type, key.hashBytes, delta.nFirstHeight)));
+
+            if( pcursor->Valid() ) pcursor->Prev();
+            else pcursor->SeekToLast();
+
+            std::pair<char,CAddressIndexKey> prevKey;
+            if (pcursor->Valid() && pcursor->GetKey(prevKey) && prevKey.first == DB_ADDRESSINDEX &&
+                prevKey.second.type == key.type && prevKey.second.hashBytes == key.hashBytes) {
+                value.nLastHeight = prevKey.second.blockHeight;
+            } else {
+                // No activity left for this address
+                value.SetNull();
+            }
+        }
+
+        if( value.IsNull() )
+            batch.Erase(make_pair(DB_ADDRESSBALANCEINDEX, key));
+        else
+            batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, key), value);
+    }
+}
+
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    return Read(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value);
+}
+
+bool CBlockTreeDB::ReindexAddressBalances() {
+
+    const size_t nMaxBatchSize = 16 * 1024 * 1024;
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+
+    pcursor->Seek(DB_ADDRESSINDEX);
+
+    CAddressIndexIteratorKey currentKey;
+    CAddressBalanceValue currentValue;
+    int64_t nAddresses = 0;
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX)
+            break;
+
+        if( key.second.type != currentKey.type || key.second.hashBytes != currentKey.hashBytes ){
+
+            if( !currentValue.IsNull() ){
+                batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, currentKey), currentValue);
+                ++nAddresses;
+            }
+
+            if( batch.SizeEstimate() > nMaxBatchSize ){
+                if( !WriteBatch(batch) )
+                    return error("%s: failed to write address balances", __func__);
+                batch.Clear();
+                LogPrintf("%s: %d addresses processed\n", __func__, nAddresses);
+            }
+
+            currentKey = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+            currentValue.SetNull();
+        }
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("%s: failed to get address index value", __func__);
+
+        if( currentValue.IsNull() )
+            currentValue.nFirstHeight = key.second.blockHeight;
+
+        currentValue.nLastHeight = key.second.blockHeight;
+        currentValue.balance += nValue;
+        if (nValue > 0)
+            currentValue.received += nValue;
+        currentValue.nUtxoCount += key.second.spending ? -1 : 1;
+
+        pcursor->Next();
+    }
+
+    if( !currentValue.IsNull() ){
+        batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, currentKey), currentValue);
+        ++nAddresses;
+    }
+
+    LogPrintf("%s: %d addresses processed\n", __func__, nAddresses);
+
+    return WriteBatch(batch, true);
+}
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
@@ -474,8 +1197,48 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &timestamp, uint256 &bl
     return false;
 }
 
+bool CBlockTreeDB::WriteMiningSignatureIndex(const std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(make_pair(DB_MININGSIGINDEX, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadMiningSignatureIndex(const CMiningSignatureIndexKey &key, CMiningSignatureIndexValue &value) {
+    return Read(make_pair(DB_MININGSIGINDEX, key), value);
+}
+
+bool CBlockTreeDB::ReadMiningSignatureIndex(int nStart, int nEnd, std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &vect) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_MININGSIGINDEX, CMiningSignatureIndexKey(nStart)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CMiningSignatureIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_MININGSIGINDEX && key.second.nHeight <= nEnd) {
+            CMiningSignatureIndexValue value;
+            if (pcursor->GetValue(value)) {
+                vect.push_back(make_pair(key.second, value));
+                pcursor->Next();
+            } else {
+                return error("failed to get mining signature index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
 bool CBlockTreeDB::WriteDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue > >&vect) {
     CDBBatch batch(*this);
+    std::vector<std::pair<CDepositIndexKey, bool> > vecChanges;
+    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        vecChanges.push_back(make_pair(it->first, false));
+    UpdatePageAnchors(*this, batch, DB_DEPOSITINDEX, DB_DEPOSITANCHOR, DB_DEPOSITCOUNT, vecChanges);
     for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_DEPOSITINDEX, it->first), it->second);
     return WriteBatch(batch);
@@ -483,6 +1246,10 @@ bool CBlockTreeDB::WriteDepositIndex(const std::vector<std::pair<CDepositIndexKe
 
 bool CBlockTreeDB::EraseDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue > >&vect) {
     CDBBatch batch(*this);
+    std::vector<std::pair<CDepositIndexKey, bool> > vecChanges;
+    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        vecChanges.push_back(make_pair(it->first, true));
+    UpdatePageAnchors(*this, batch, DB_DEPOSITINDEX, DB_DEPOSITANCHOR, DB_DEPOSITCOUNT, vecChanges);
     for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(make_pair(DB_DEPOSITINDEX, it->first));
     return WriteBatch(batch);
@@ -492,15 +1259,19 @@ bool CBlockTreeDB::ReadDepositIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex,
                                     int start, int offset, int limit, bool reverse) {
 
+    const CAddressIndexIteratorKey addressKey(type, addressHash);
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    int nCount = 0;
+    // Jump to the requested offset with the page anchors instead of skipping the entries
+    int64_t nPosition = 0;
 
-    if (start > 0) {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorKey(type, addressHash)));
-    }
+    if (start > 0)
+        nPosition = GetPageRank<CDepositIndexKey>(*this, DB_DEPOSITINDEX, DB_DEPOSITANCHOR, addressKey, CDepositIndexIteratorTimeKey(type, addressHash, start));
+
+    nPosition += reverse ? -offset : offset;
+
+    if (!SeekPagePosition<CDepositIndexKey>(*this, pcursor.get(), DB_DEPOSITINDEX, DB_DEPOSITANCHOR, addressKey, nPosition))
+        return true;
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
@@ -511,8 +1282,7 @@ bool CBlockTreeDB::ReadDepositIndex(uint160 addressHash, int type,
             }
             CDepositValue nValue;
             if (pcursor->GetValue(nValue)) {
-                if( ++nCount > offset )
-                    depositIndex.push_back(make_pair(key.second, nValue));
+                depositIndex.push_back(make_pair(key.second, nValue));
 
                 if( reverse ) pcursor->Prev();
                 else          pcursor->Next();
@@ -533,53 +1303,64 @@ bool CBlockTreeDB::ReadDepositIndexCount(uint160 addressHash, int type,
                                     int &firstTime, int &lastTime,
                                     int start, int end) {
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    const CAddressIndexIteratorKey addressKey(type, addressHash);
+    int64_t nEntries = 0;
 
     count = 0;
     firstTime = 0;
     lastTime = 0;
 
-    if (start > 0) {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorKey(type, addressHash)));
-    }
+    if (!Read(make_pair(DB_DEPOSITCOUNT, addressKey), nEntries) || nEntries <= 0)
+        return true;
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CDepositIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_DEPOSITINDEX && key.second.hashBytes == addressHash) {
+    int nEndExclusive = end > 0 && end < std::numeric_limits<int>::max() ? end + 1 : std::numeric_limits<int>::max();
 
-            if( !firstTime ) firstTime = key.second.timestamp;
+    int64_t nFirst = 0, nEnd = nEntries;
 
-            if (end > 0 && key.second.timestamp > (unsigned int)end) {
-                if( !lastTime ) lastTime = firstTime;
-                break;
-            }
+    if (start > 0)
+        nFirst = GetPageRank<CDepositIndexKey>(*this, DB_DEPOSITINDEX, DB_DEPOSITANCHOR, addressKey, CDepositIndexIteratorTimeKey(type, addressHash, start));
 
-            lastTime = key.second.timestamp;
-            count++;
-            pcursor->Next();
+    if (nEndExclusive < std::numeric_limits<int>::max())
+        nEnd = GetPageRank<CDepositIndexKey>(*this, DB_DEPOSITINDEX, DB_DEPOSITANCHOR, addressKey, CDepositIndexIteratorTimeKey(type, addressHash, nEndExclusive));
 
-        } else {
-            break;
-        }
-    }
+    if (nEnd <= nFirst)
+        return true;
+
+    count = static_cast<int>(nEnd - nFirst);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    std::pair<char,CDepositIndexKey> key;
+
+    pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, start)));
+
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_DEPOSITINDEX &&
+        key.second.type == (unsigned int)type && key.second.hashBytes == addressHash)
+        firstTime = key.second.timestamp;
+
+    pcursor->Seek(make_pair(DB_DEPOSITINDEX, CDepositIndexIteratorTimeKey(type, addressHash, nEndExclusive)));
+
+    if (pcursor->Valid())
+        pcursor->Prev();
+
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_DEPOSITINDEX &&
+        key.second.type == (unsigned int)type && key.second.hashBytes == addressHash)
+        lastTime = key.second.timestamp;
 
     return true;
 }
 
-bool CBlockTreeDB::WriteInstantPayLocks(std::map<CInstantPayIndexKey, CInstantPayValue> &mapLocks)
+bool CBlockTreeDB::ReindexAddressPageAnchors(bool fUnspent, bool fDeposit) {
+    return (!fUnspent || ReindexPageAnchors<CAddressUnspentKey>(*this, DB_ADDRESSUNSPENTINDEX, DB_ADDRESSUNSPENTANCHOR, DB_ADDRESSUNSPENTCOUNT)) &&
+           (!fDeposit || ReindexPageAnchors<CDepositIndexKey>(*this, DB_DEPOSITINDEX, DB_DEPOSITANCHOR, DB_DEPOSITCOUNT));
+}
+
+bool CBlockTreeDB::WriteInstantPayIndex(const std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &vect)
 {
     CDBBatch batch(*this);
-    for (auto& lock : mapLocks ){
-
-        if( lock.second.fProcessed && !lock.second.fWritten ){
-            lock.second.fWritten = true;
-            batch.Write(make_pair(DB_INSTANTPAY_INDEX, lock.first), lock.second);
-        }
+    for (std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        batch.Write(make_pair(DB_INSTANTPAY_INDEX, it->first), it->second);
     }
-    return batch.SizeEstimate() ? WriteBatch(batch) : true;
+    return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadInstantPayIndex( std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &instantPayIndex,
@@ -19,6 +19,7 @@
 #include <boost/function.hpp>
 
 class CBlockIndex;
+class CCoinsCommitment;
 class CCoinsViewDBCursor;
 class uint256;
 struct CSmartAddress;
@@ -72,6 +73,7 @@ class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    const CCoinsCommitment *pcommitment;
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -81,6 +83,15 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    //! Cursor starting at the first coin not below start, reading from psnapshot if it isn't NULL
+    CCoinsViewCursor *Cursor(const COutPoint &start, const leveldb::Snapshot *psnapshot) const;
+    const leveldb::Snapshot *GetSnapshot() { return db.GetSnapshot(); }
+    void ReleaseSnapshot(const leveldb::Snapshot *psnapshot) { db.ReleaseSnapshot(psnapshot); }
+
+    //! Write the commitment with every batch it is up to date for, NULL to stop
+    void SetCoinsCommitment(const CCoinsCommitment *pcommitmentIn) { pcommitment = pcommitmentIn; }
+    bool ReadCoinsCommitment(CCoinsCommitment &commitment) const;
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
@@ -116,6 +127,7 @@ public:
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
+    void UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase);
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &fileinfo);
@@ -123,24 +135,37 @@ public:
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    /** The mining signature index entries of the block go into the same batch */
+    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list,
+                      const std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &miningSignatureIndex = std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> >());
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
+    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect,
+                                   const std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > &vectAmounts);
     bool ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
                                  const CAddressUnspentKey &start = CAddressUnspentKey(),
                                  int offset = -1, int limit = -1, bool reverse = false);
+    bool ReadAddressAmountIndex(uint160 addressHash, int type,
+                                std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > &vect,
+                                const CAddressAmountKey &start = CAddressAmountKey(),
+                                int limit = -1, bool reverse = false);
+    bool ReindexAddressAmounts();
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
     bool ReadAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+    bool ReindexAddressBalances();
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool ReadTimestampIndex(const unsigned int &timestamp, uint256 &blockHash);
+    bool WriteMiningSignatureIndex(const std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &vect);
+    bool ReadMiningSignatureIndex(const CMiningSignatureIndexKey &key, CMiningSignatureIndexValue &value);
+    bool ReadMiningSignatureIndex(int nStart, int nEnd, std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &vect);
     bool WriteDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue> > &vect);
     bool EraseDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue> > &vect);
     bool ReadDepositIndex(uint160 addressHash, int type,
@@ -150,8 +175,9 @@ public:
                                         int &count,
                                         int &firstTime, int &lastTime,
                                         int start, int end);
+    bool ReindexAddressPageAnchors(bool fUnspent, bool fDeposit);
 
-    bool WriteInstantPayLocks(std::map<CInstantPayIndexKey, CInstantPayValue> &mapLocks);
+    bool WriteInstantPayIndex(const std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &vect);
     bool ReadInstantPayIndex(std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &instantPayIndex,
                                             int start, int offset, int limit, bool reverse);
     bool ReadInstantPayIndexCount(int &count, int &firstTime, int &lastTime,
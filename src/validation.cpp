@@ -10,6 +10,7 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinstats.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
@@ -38,6 +39,7 @@
 #include "wallet/wallet.h"
 #include "warnings.h"
 
+#include <atomic>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -81,6 +83,9 @@ bool fAddressIndex = true;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
 bool fDepositIndex = false;
+bool fMiningSignatureIndex = DEFAULT_MININGSIGNATUREINDEX;
+/** Set once ThreadBuildMiningSignatureIndex found the index complete, the entries can't be trusted before */
+static std::atomic<bool> fMiningSignatureIndexComplete(false);
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -1142,6 +1147,22 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
     return true;
 }
 
+bool GetMiningSignatureIndex(int nStart, int nEnd, std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &vect)
+{
+    if (!fMiningSignatureIndex)
+        return error("Mining signature index not enabled");
+
+    // While the index gets rebuilt it might still hold entries of blocks which were
+    // reorganized away while it was disabled, the callers read the blocks meanwhile.
+    if (!fMiningSignatureIndexComplete)
+        return false;
+
+    if (!pblocktree->ReadMiningSignatureIndex(nStart, nEnd, vect))
+        return error("Unable to get mining signatures for heights %d to %d", nStart, nEnd);
+
+    return true;
+}
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
     if (!fSpentIndex)
@@ -1168,6 +1189,18 @@ bool GetAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    // Addresses without any activity have no aggregate record
+    if (!pblocktree->ReadAddressBalance(addressHash, type, balance))
+        balance.SetNull();
+
+    return true;
+}
+
 bool GetAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances)
 {
     if (!fAddressIndex)
@@ -1204,6 +1237,19 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressAmounts(uint160 addressHash, int type,
+                       std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > &amountOutputs,
+                       const CAddressAmountKey &start, int limit, bool reverse)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressAmountIndex(addressHash, type, amountOutputs, start, limit, reverse))
+        return error("unable to get amounts for address");
+
+    return true;
+}
+
 bool GetDepositIndexCount(uint160 addressHash, int type, int &count, int &firstTime, int &lastTime, int start, int end)
 {
     if (!fDepositIndex)
@@ -1268,6 +1314,29 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
 }
 
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
+bool ReadTransactionFromDisk(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock)
+{
+    CDiskTxPos postx;
+    if (!fTxIndex || !pblocktree->ReadTxIndex(hash, postx))
+        return false;
+
+    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: OpenBlockFile failed", __func__);
+    CBlockHeader header;
+    try {
+        file >> header;
+        fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+        file >> txOut;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    hashBlock = header.GetHash();
+    if (txOut.GetHash() != hash)
+        return error("%s: txid mismatch", __func__);
+    return true;
+}
+
 bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
     CBlockIndex *pindexSlow = NULL;
@@ -1279,26 +1348,8 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
         return true;
     }
 
-    if (fTxIndex) {
-        CDiskTxPos postx;
-        if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
-            CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            }
-            hashBlock = header.GetHash();
-            if (txOut.GetHash() != hash)
-                return error("%s: txid mismatch", __func__);
-            return true;
-        }
-    }
+    if (ReadTransactionFromDisk(hash, txOut, hashBlock))
+        return true;
 
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
         const Coin& coin = AccessByTxid(*pcoinsTip, hash);
@@ -1398,6 +1449,49 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(CDataStream& stream, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < 8)
+        return error("ReadRawBlockFromDisk: invalid block position %s", pos.ToString());
+
+    // Start at the index header written by WriteBlockToDisk
+    pos.nPos -= 8;
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    size_t nOffset = stream.size();
+
+    try {
+        CMessageHeader::MessageStartChars blockStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blockStart) >> nSize;
+
+        if (memcmp(blockStart, messageStart, MESSAGE_START_SIZE))
+            return error("ReadRawBlockFromDisk: block magic mismatch at %s", pos.ToString());
+
+        if (nSize < CBlockHeader::HEADER_SIZE || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("ReadRawBlockFromDisk: invalid block size %u at %s", nSize, pos.ToString());
+
+        stream.resize(nOffset + nSize);
+        filein.read(&stream[nOffset], nSize);
+    }
+    catch (const std::exception& e) {
+        stream.resize(nOffset);
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    // The header check is cheap and catches a mismatch between index and block files
+    if (HashKeccak(stream.begin() + nOffset, stream.begin() + nOffset + CBlockHeader::HEADER_SIZE) != pindex->GetBlockHash()) {
+        stream.resize(nOffset);
+        return error("ReadRawBlockFromDisk: block hash doesn't match index for %s at %s", pindex->ToString(), pos.ToString());
+    }
+
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     if (nHeight == 0)
@@ -1828,8 +1922,9 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 }
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
- *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state. */
-static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view)
+ *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state.
+ *  The changes to the UTXO set get collected in pcommitmentDelta, if it isn't NULL. */
+static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, CCoinsCommitment* pcommitmentDelta = NULL)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
@@ -1854,6 +1949,7 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > addressAmountIndex;
     std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
     std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
     /* WIP-VOTING uncomment
@@ -1907,6 +2003,7 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
 
                     // undo unspent index
                     addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, hash, k, pindex->nHeight), CAddressUnspentValue()));
+                    addressAmountIndex.push_back(make_pair(CAddressAmountKey(addressType, hashBytes, out.nValue, hash, k), CAddressAmountValue()));
                 }
 
                 if ( fDepositIndex ) {
@@ -1937,6 +2034,8 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
                 if (!is_spent || tx.vout[o] != coin.out || pindex->nHeight != coin.nHeight || is_coinbase != coin.fCoinBase) {
                     fClean = false; // transaction output mismatch
                 }
+                if (is_spent && pcommitmentDelta)
+                    pcommitmentDelta->RemoveCoin(out, coin);
             }
         }
 
@@ -1954,6 +2053,9 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
 
+                if (pcommitmentDelta)
+                    pcommitmentDelta->AddCoin(out, view.AccessCoin(out));
+
                 const CTxIn input = tx.vin[j];
 
                 if (fSpentIndex) {
@@ -2010,6 +2112,7 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
 
                         // restore unspent index
                         addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, undoHeight), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
+                        addressAmountIndex.push_back(make_pair(CAddressAmountKey(addressType, hashBytes, prevout.nValue, input.prevout.hash, input.prevout.n), CAddressAmountValue(undoHeight)));
                     }
 
                 }
@@ -2088,10 +2191,12 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             AbortNode(state, "Failed to delete address index");
             return DISCONNECT_FAILED;
         }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
+        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex, addressAmountIndex)) {
             AbortNode(state, "Failed to write address unspent index");
             return DISCONNECT_FAILED;
         }
+
+        GetMainSignals().BlockAddressDeltas(pindex, addressIndex, false);
     }
 
     if( !prewards->CommitUndoBlock( (CBlockIndex*) pindex, smartRewardsResult) ){
@@ -2221,8 +2326,9 @@ static int64_t nTimeTotal = 0;
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
- *  can fail if those validity checks fail (among other reasons). */
-static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck = false)
+ *  can fail if those validity checks fail (among other reasons).
+ *  The changes to the UTXO set get collected in pcommitmentDelta, if it isn't NULL. */
+static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck = false, CCoinsCommitment* pcommitmentDelta = NULL)
 {
     const CChainParams& chainparams = Params();
     AssertLockHeld(cs_main);
@@ -2353,6 +2459,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > addressAmountIndex;
     std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
     std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
     /* WIP-VOTING uncomment
@@ -2366,6 +2473,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     //bool fDIP0001Active_context = (VersionBitsState(pindex->pprev, chainparams.GetConsensus(), Consensus::DEPLOYMENT_DIP0001, versionbitscache) == THRESHOLD_ACTIVE);
 
     prewards->StartBlock();
+    // Load the reward entries of all addresses involved in parallel upfront.
+    prewards->PrefetchBlock(pindex, block, view);
 
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
@@ -2446,6 +2555,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
                         // remove address from unspent index
                         addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, coin.nHeight), CAddressUnspentValue()));
+                        addressAmountIndex.push_back(make_pair(CAddressAmountKey(addressType, hashBytes, prevout.nValue, input.prevout.hash, input.prevout.n), CAddressAmountValue()));
                     }
 
                     if (fSpentIndex) {
@@ -2520,6 +2630,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                     addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
                     // record unspent output
                     addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k, pindex->nHeight), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+                    addressAmountIndex.push_back(make_pair(CAddressAmountKey(addressType, hashBytes, out.nValue, txhash, k), CAddressAmountValue(pindex->nHeight)));
                 }
 
             }
@@ -2604,6 +2715,15 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         }
         UpdateCoins(tx, state, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
+        if (pcommitmentDelta) {
+            if (i > 0) {
+                const CTxUndo &txundo = blockundo.vtxundo.back();
+                for (unsigned int j = 0; j < txundo.vprevout.size(); j++)
+                    pcommitmentDelta->RemoveCoin(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+            pcommitmentDelta->AddOutputs(tx, pindex->nHeight);
+        }
+
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
@@ -2655,18 +2775,30 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
+    // Index the mining signature key while the coinbase is in memory. Entries
+    // of disconnected blocks get overwritten once their height is connected again.
+    std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > miningSignatureIndex;
+    if (fMiningSignatureIndex)
+        miningSignatureIndex.push_back(make_pair(CMiningSignatureIndexKey(pindex->nHeight), SmartMining::GetSignatureIndexValue(block)));
+
+    if (fTxIndex) {
+        if (!pblocktree->WriteTxIndex(vPos, miningSignatureIndex))
             return AbortNode(state, "Failed to write transaction index");
+    } else if (!miningSignatureIndex.empty()) {
+        if (!pblocktree->WriteMiningSignatureIndex(miningSignatureIndex))
+            return AbortNode(state, "Failed to write mining signature index");
+    }
 
     if (fAddressIndex) {
         if (!pblocktree->WriteAddressIndex(addressIndex)) {
             return AbortNode(state, "Failed to write address index");
         }
 
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
+        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex, addressAmountIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
+
+        GetMainSignals().BlockAddressDeltas(pindex, addressIndex, true);
     }
 
     if (fSpentIndex)
@@ -2747,10 +2879,11 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         nLastSetChain = nNow;
     }
     size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+    size_t rewardsCacheSize = prewards ? prewards->DynamicMemoryUsage() : 0;
     // The cache is large and close to the limit, but we have time now (not in the middle of a block processing).
-    bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0/9) > nCoinCacheUsage;
+    bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && (cacheSize * (10.0/9) > nCoinCacheUsage || rewardsCacheSize * (10.0/9) > nRewardsCacheUsage);
     // The cache is over the limit, we have to write now.
-    bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && cacheSize > nCoinCacheUsage;
+    bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && (cacheSize > nCoinCacheUsage || rewardsCacheSize > nRewardsCacheUsage);
     // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
     bool fPeriodicWrite = mode == FLUSH_STATE_PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
     // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
@@ -2796,6 +2929,10 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         // overwrite one. Still, use a conservative safety factor of 2.
         if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
+        // Flush the rewards first, the chainstate must never be ahead of them. After a crash
+        // in between the rewards database is ahead of the chainstate, see RewindSmartRewards.
+        if (prewards && !prewards->Flush())
+            return AbortNode(state, "Failed to write to smartrewards database");
         // Flush the chainstate (which may refer to block index entries).
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
@@ -2902,9 +3039,12 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        if (DisconnectBlock(block, state, pindexDelete, view) != DISCONNECT_OK)
+        CCoinsCommitment commitmentDelta;
+        if (DisconnectBlock(block, state, pindexDelete, view, pcoinscommitment ? &commitmentDelta : NULL) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         assert(view.Flush());
+        if (pcoinscommitment)
+            pcoinscommitment->Apply(commitmentDelta, pindexDelete->pprev->GetBlockHash());
     }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
 
@@ -2966,7 +3106,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
         CCoinsViewCache view(pcoinsTip);
-        bool rv = ConnectBlock(*pblock, state, pindexNew, view);
+        CCoinsCommitment commitmentDelta;
+        bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, pcoinscommitment ? &commitmentDelta : NULL);
         GetMainSignals().BlockChecked(*pblock, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2976,6 +3117,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
         assert(view.Flush());
+        if (pcoinscommitment)
+            pcoinscommitment->Apply(commitmentDelta, pindexNew->GetBlockHash());
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
@@ -2989,6 +3132,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, !IsInitialBlockDownload());
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    GetMainSignals().BlockConnected(*pblock, pindexNew);
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH(const CTransaction &tx, txConflicted) {
@@ -4210,6 +4354,79 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
     return pindexNew;
 }
 
+void ThreadBuildMiningSignatureIndex()
+{
+    RenameThread("smartcash-sigindex");
+
+    bool fIndexed = false;
+    pblocktree->ReadFlag("miningsignatureindex", fIndexed);
+    if (fIndexed) {
+        fMiningSignatureIndexComplete = true;
+        return;
+    }
+
+    LogPrintf("%s: building mining signature index...\n", __func__);
+
+    const Consensus::Params& consensus = Params().GetConsensus();
+    const size_t nBatchSize = 1000;
+    std::vector<std::pair<const CBlockIndex*, CMiningSignatureIndexValue> > vecBatch;
+
+    for (int nHeight = 0; ; ++nHeight) {
+
+        boost::this_thread::interruption_point();
+
+        if (ShutdownRequested()) {
+            LogPrintf("%s: interrupted at height %d\n", __func__, nHeight);
+            return;
+        }
+
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[nHeight];
+        }
+
+        // Pruned blocks stay unindexed, the rpc reports them as unsigned
+        if (pindex && (pindex->nStatus & BLOCK_HAVE_DATA)) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, consensus)) {
+                error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+                return;
+            }
+            vecBatch.push_back(make_pair(pindex, SmartMining::GetSignatureIndexValue(block)));
+        }
+
+        if (pindex && vecBatch.size() < nBatchSize)
+            continue;
+
+        // ConnectBlock indexes the new blocks meanwhile, only write the entries
+        // of blocks which are still part of the active chain.
+        LOCK(cs_main);
+
+        std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > vect;
+        for (const auto& entry : vecBatch) {
+            if (chainActive[entry.first->nHeight] == entry.first)
+                vect.push_back(make_pair(CMiningSignatureIndexKey(entry.first->nHeight), entry.second));
+        }
+        vecBatch.clear();
+
+        if (!pblocktree->WriteMiningSignatureIndex(vect)) {
+            error("%s: failed to write the mining signature index", __func__);
+            return;
+        }
+
+        if (!pindex) {
+            pblocktree->WriteFlag("miningsignatureindex", true);
+            fMiningSignatureIndexComplete = true;
+            LogPrintf("%s: indexed %d blocks\n", __func__, nHeight);
+            return;
+        }
+
+        if (nHeight % 100000 < (int)nBatchSize)
+            LogPrintf("%s: indexed up to height %d\n", __func__, nHeight);
+    }
+}
+
 bool static LoadBlockIndexDB()
 {
     const CChainParams& chainparams = Params();
@@ -4313,6 +4530,41 @@ bool static LoadBlockIndexDB()
     fReindex |= !fCheckIndex;
     LogPrintf("%s: addressindex index %s\n", __func__, fCheckIndex ? "enabled" : "disabled");
 
+    // Build the per address balance aggregates for address indexes created before they existed
+    fCheckIndex = false;
+    pblocktree->ReadFlag("addressbalanceindex", fCheckIndex);
+    if (fAddressIndex && !fReindex && !fCheckIndex) {
+        LogPrintf("%s: building address balance index...\n", __func__);
+        uiInterface.InitMessage(_("Building address balance index..."));
+        if (!pblocktree->ReindexAddressBalances())
+            return error("%s: failed to build the address balance index", __func__);
+        pblocktree->WriteFlag("addressbalanceindex", true);
+    }
+
+    // Build the counters and page anchors of the unspent and deposit indexes
+    bool fDepositIndexEnabled = false;
+    pblocktree->ReadFlag("depositindex", fDepositIndexEnabled);
+    fCheckIndex = false;
+    pblocktree->ReadFlag("addresspageindex", fCheckIndex);
+    if ((fAddressIndex || fDepositIndexEnabled) && !fReindex && !fCheckIndex) {
+        LogPrintf("%s: building address page index...\n", __func__);
+        uiInterface.InitMessage(_("Building address page index..."));
+        if (!pblocktree->ReindexAddressPageAnchors(fAddressIndex, fDepositIndexEnabled))
+            return error("%s: failed to build the address page index", __func__);
+        pblocktree->WriteFlag("addresspageindex", true);
+    }
+
+    // Build the amount sorted unspent index for address indexes created before it existed
+    fCheckIndex = false;
+    pblocktree->ReadFlag("addressamountindex", fCheckIndex);
+    if (fAddressIndex && !fReindex && !fCheckIndex) {
+        LogPrintf("%s: building address amount index...\n", __func__);
+        uiInterface.InitMessage(_("Building address amount index..."));
+        if (!pblocktree->ReindexAddressAmounts())
+            return error("%s: failed to build the address amount index", __func__);
+        pblocktree->WriteFlag("addressamountindex", true);
+    }
+
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
@@ -4321,6 +4573,11 @@ bool static LoadBlockIndexDB()
 
     PruneBlockIndexCandidates();
 
+    // Blocks connected without the mining signature index leave gaps (or stale entries
+    // after a reorg), rebuild it in ThreadBuildMiningSignatureIndex once it gets enabled again.
+    if (!fMiningSignatureIndex)
+        pblocktree->WriteFlag("miningsignatureindex", false);
+
     LogPrintf("%s: hashBestChain=%s height=%d date=%s progress=%f\n", __func__,
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(),
         DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
@@ -4425,6 +4682,69 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     return true;
 }
 
+bool RewindSmartRewards(const CChainParams& chainparams)
+{
+    LOCK(cs_main);
+
+    CSmartRewardBlock last;
+    if (!prewards->GetLastBlock(last))
+        return true;
+
+    BlockMap::iterator mi = mapBlockIndex.find(last.blockHash);
+    if (mi == mapBlockIndex.end())
+        return error("RewindSmartRewards(): unknown block %s", last.blockHash.ToString());
+
+    CBlockIndex* pindex = mi->second;
+    while (!chainActive.Contains(pindex)) {
+        boost::this_thread::interruption_point();
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            return error("RewindSmartRewards(): ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+
+        CBlockUndo blockUndo;
+        CDiskBlockPos pos = pindex->GetUndoPos();
+        if (pos.IsNull() || !UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash()))
+            return error("RewindSmartRewards(): failure reading undo data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+
+        if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+            return error("RewindSmartRewards(): block and undo data inconsistent");
+
+        // The chainstate doesn't know the block, the undo data provides the
+        // spent outputs the rewards need to look up the spending addresses.
+        CCoinsView viewDummy;
+        CCoinsViewCache view(&viewDummy);
+
+        CSmartRewardsUpdateResult smartRewardsResult(pindex->nHeight, pindex->phashBlock, pindex->nTime);
+
+        prewards->StartBlock();
+
+        // Same order as DisconnectBlock
+        for (int i = block.vtx.size() - 1; i >= 0; i--) {
+            const CTransaction &tx = block.vtx[i];
+
+            if (i > 0) {
+                CTxUndo &txundo = blockUndo.vtxundo[i-1];
+                if (txundo.vprevout.size() != tx.vin.size())
+                    return error("RewindSmartRewards(): transaction and undo data inconsistent");
+                for (unsigned int j = tx.vin.size(); j-- > 0;)
+                    view.AddCoin(tx.vin[j].prevout, std::move(txundo.vprevout[j]), true);
+            }
+
+            prewards->UndoTransaction(pindex, tx, view, chainparams, smartRewardsResult);
+        }
+
+        if (!prewards->CommitUndoBlock(pindex, smartRewardsResult))
+            return error("RewindSmartRewards(): failed to undo block %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+
+        LogPrintf("RewindSmartRewards(): undid block %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+
+        pindex = pindex->pprev;
+    }
+
+    return prewards->Flush();
+}
+
 void UnloadBlockIndex()
 {
     LOCK(cs_main);
@@ -4474,6 +4794,8 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     //fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    pblocktree->WriteFlag("addressbalanceindex", fAddressIndex);
+    pblocktree->WriteFlag("addressamountindex", fAddressIndex);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -4485,11 +4807,15 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fDepositIndex = GetBoolArg("-depositindex", DEFAULT_DEPOSITINDEX);
     pblocktree->WriteFlag("depositindex", fDepositIndex);
+    pblocktree->WriteFlag("addresspageindex", fAddressIndex || fDepositIndex);
 
     // Check whether we're already initialized
     if (chainActive.Genesis() != NULL)
         return true;
 
+    // A new or reindexed chain fills the mining signature index while connecting
+    pblocktree->WriteFlag("miningsignatureindex", fMiningSignatureIndex);
+
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -4519,10 +4845,75 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+bool ProcessImportedBlock(const CChainParams& chainparams, const CBlock& block, const uint256& hash, const CDiskBlockPos *dbp, int& nLoaded)
+{
+    // detect out of order blocks, and store them for later
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            CBlock child;
+            if (ReadBlockFromDisk(child, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, child.GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(child, dummy, chainparams, NULL, true, &it->second, NULL))
+                {
+                    nLoaded++;
+                    queue.push_back(child.GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+
+    return true;
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
@@ -4564,64 +4955,8 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 blkdat >> block;
                 nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(block, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
-                }
+                if (!ProcessImportedBlock(chainparams, block, block.GetHash(), dbp, nLoaded))
+                    break;
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
@@ -150,6 +150,7 @@ static const bool DEFAULT_ADDRESSINDEX = false; // WIP-VOTING, Voting set to tru
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
 static const bool DEFAULT_DEPOSITINDEX = false;
+static const bool DEFAULT_MININGSIGNATUREINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 static const bool DEFAULT_TESTSAFEMODE = false;
@@ -191,7 +192,9 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
 extern bool fInstantPayIndex;
+extern bool fMiningSignatureIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
@@ -279,6 +282,8 @@ FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/** Store an imported block, dbp is its position if it is read from a block file (reindex). Returns false if the import should stop. */
+bool ProcessImportedBlock(const CChainParams& chainparams, const CBlock& block, const uint256& hash, const CDiskBlockPos *dbp, int& nLoaded);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
@@ -298,6 +303,8 @@ bool IsInitialBlockDownload();
  */
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256 &hash, CTransaction &tx, const Consensus::Params& params, uint256 &hashBlock, bool fAllowSlow = false);
+/** Read a confirmed transaction through the transaction index, doesn't need cs_main */
+bool ReadTransactionFromDisk(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock);
 /** Find the best known block, and make it the tip of the block chain */
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, const CBlock* pblock = NULL);
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
@@ -501,15 +508,23 @@ public:
 
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+bool GetMiningSignatureIndex(int nStart, int nEnd, std::vector<std::pair<CMiningSignatureIndexKey, CMiningSignatureIndexValue> > &vect);
+/** Rebuild the -miningsignatureindex for the blocks connected while it was disabled */
+void ThreadBuildMiningSignatureIndex();
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance);
 bool GetAddresses(std::vector<CAddressListEntry> &addressList,int nEndHeight = -1, bool excludeZeroBalances = false);
 bool GetAddressUnspentCount(uint160 addressHash, int type, int &count, CAddressUnspentKey &lastIndex);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
                        const CAddressUnspentKey &start = CAddressUnspentKey(),
                        int offset = -1, int limit = -1, bool reverse = false);
+bool GetAddressAmounts(uint160 addressHash, int type,
+                       std::vector<std::pair<CAddressAmountKey, CAddressAmountValue> > &amountOutputs,
+                       const CAddressAmountKey &start = CAddressAmountKey(),
+                       int limit = -1, bool reverse = false);
 bool GetDepositIndexCount(uint160 addressHash, int type, int &count, int &firstTime, int &lastTime, int start, int end);
 bool GetDepositIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CDepositIndexKey, CDepositValue>> &depositIndex,
@@ -528,6 +543,8 @@ bool GetInvalidVoteKeyRegistration(const uint256 &txHash);
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Append the block of pindex to stream as it is serialized in the block files, without deserializing it */
+bool ReadRawBlockFromDisk(CDataStream& stream, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -556,6 +573,9 @@ bool IsWitnessEnabled(const CBlockIndex* pindexPrev, const Consensus::Params& pa
 /** When there are blocks in the active chain with missing data, rewind the chainstate and remove them from the block index */
 bool RewindBlockIndex(const CChainParams& params);
 
+/** Undo the SmartRewards blocks not part of the active chain, left over by a crash between the rewards and the chainstate flush */
+bool RewindSmartRewards(const CChainParams& chainparams);
+
 /** Update uncommitted block structures (currently: only the witness nonce). This is safe for submitted blocks. */
 void UpdateUncommittedBlockStructures(CBlock& block, const CBlockIndex* pindexPrev, const Consensus::Params& consensusParams);
 
@@ -6,9 +6,14 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
+#include "amount.h"
+
+#include <vector>
+
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 
+struct CAddressIndexKey;
 class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
@@ -34,6 +39,8 @@ protected:
     virtual void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) {}
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
+    virtual void BlockConnected(const CBlock &block, const CBlockIndex *pindex) {}
+    virtual void BlockAddressDeltas(const CBlockIndex *pindex, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vecDeltas, bool fConnect) {}
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
@@ -56,6 +63,10 @@ struct CMainSignals {
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
     boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
+    /** Notifies listeners of a block connected to the active chain, while it is still in memory. */
+    boost::signals2::signal<void (const CBlock &, const CBlockIndex *)> BlockConnected;
+    /** Notifies listeners of the address index deltas of a connected (fConnect) or disconnected block. */
+    boost::signals2::signal<void (const CBlockIndex *, const std::vector<std::pair<CAddressIndexKey, CAmount> > &, bool fConnect)> BlockAddressDeltas;
     /** Notifies listeners of an updated transaction lock without new data. */
     boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
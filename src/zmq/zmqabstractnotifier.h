@@ -7,15 +7,18 @@
 
 #include "zmqconfig.h"
 
+#include <atomic>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class CZMQPublisher;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(0) { }
+    CZMQAbstractNotifier() : psocket(0), publisher(0), nSent(0), nDropped(0) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -28,10 +31,15 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    void SetPublisher(CZMQPublisher *p) { publisher = p; }
+
+    uint64_t GetSent() const { return nSent; }
+    uint64_t GetDropped() const { return nDropped; }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
+    virtual bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex);
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
@@ -40,6 +48,13 @@ protected:
     void *psocket;
     std::string type;
     std::string address;
+    CZMQPublisher *publisher;
+
+    // Updated by the publisher
+    std::atomic<uint64_t> nSent;
+    std::atomic<uint64_t> nDropped;
+
+    friend class CZMQPublisher;
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
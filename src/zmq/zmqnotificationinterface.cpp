@@ -4,6 +4,7 @@
 
 #include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
+#include "zmqpublisher.h"
 
 #include "version.h"
 #include "validation.h"
@@ -15,7 +16,9 @@ void zmqError(const char *str)
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface* pzmqNotificationInterface = NULL;
+
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL), publisher(NULL)
 {
 }
 
@@ -27,6 +30,18 @@ CZMQNotificationInterface::~CZMQNotificationInterface()
     {
         delete *i;
     }
+
+    delete publisher;
+}
+
+std::list<const CZMQAbstractNotifier*> CZMQNotificationInterface::GetActiveNotifiers() const
+{
+    std::list<const CZMQAbstractNotifier*> result;
+    for (std::list<CZMQAbstractNotifier*>::const_iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        result.push_back(*i);
+    }
+    return result;
 }
 
 CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const std::map<std::string, std::string> &args)
@@ -58,8 +73,31 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
 
     if (!notifiers.empty())
     {
+        size_t nHighWaterMark = DEFAULT_ZMQ_HWM;
+        std::map<std::string, std::string>::const_iterator j = args.find("-zmqhwm");
+        if (j != args.end() && atoi64(j->second) > 0)
+            nHighWaterMark = atoi64(j->second);
+
+        std::string strDropPolicy = DEFAULT_ZMQ_DROP_POLICY;
+        j = args.find("-zmqdroppolicy");
+        if (j != args.end())
+            strDropPolicy = j->second;
+
+        CZMQPublisher::DropPolicy dropPolicy;
+        if (!CZMQPublisher::ParseDropPolicy(strDropPolicy, dropPolicy))
+        {
+            LogPrintf("zmq: Unknown -zmqdroppolicy '%s', using '%s'\n", strDropPolicy, DEFAULT_ZMQ_DROP_POLICY);
+            CZMQPublisher::ParseDropPolicy(DEFAULT_ZMQ_DROP_POLICY, dropPolicy);
+        }
+
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        notificationInterface->publisher = new CZMQPublisher(nHighWaterMark, dropPolicy);
+
+        for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
+        {
+            (*i)->SetPublisher(notificationInterface->publisher);
+        }
 
         if (!notificationInterface->Initialize())
         {
@@ -105,6 +143,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    publisher->Start();
+
     return true;
 }
 
@@ -114,6 +154,9 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        // The publisher thread is the only one sending on the sockets
+        publisher->Stop();
+
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -146,6 +189,23 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
     }
 }
 
+void CZMQNotificationInterface::BlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyBlockConnected(block, pindex))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
 void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
@@ -6,11 +6,13 @@
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include "validationinterface.h"
+#include <list>
 #include <string>
 #include <map>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class CZMQPublisher;
 
 class CZMQNotificationInterface : public CValidationInterface
 {
@@ -19,12 +21,16 @@ public:
 
     static CZMQNotificationInterface* CreateWithArguments(const std::map<std::string, std::string> &args);
 
+    std::list<const CZMQAbstractNotifier*> GetActiveNotifiers() const;
+    CZMQPublisher* GetPublisher() const { return publisher; }
+
 protected:
     bool Initialize();
     void Shutdown();
 
     // CValidationInterface
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
+    void BlockConnected(const CBlock &block, const CBlockIndex *pindex);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     void NotifyTransactionLock(const CTransaction &tx);
 
@@ -33,6 +39,9 @@ private:
 
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    CZMQPublisher *publisher;
 };
 
+extern CZMQNotificationInterface* pzmqNotificationInterface;
+
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -0,0 +1,140 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmqpublisher.h"
+#include "zmqpublishnotifier.h"
+
+#include "util.h"
+
+#include <algorithm>
+
+CZMQPublisher::CZMQPublisher(size_t nHighWaterMark, DropPolicy dropPolicyIn) :
+    vRing(std::max<size_t>(nHighWaterMark, 1)),
+    nHead(0),
+    nQueued(0),
+    dropPolicy(dropPolicyIn),
+    fStop(false),
+    nSent(0),
+    nDropped(0)
+{
+}
+
+CZMQPublisher::~CZMQPublisher()
+{
+    Stop();
+}
+
+void CZMQPublisher::Start()
+{
+    assert(!thread.joinable());
+    fStop = false;
+    thread = boost::thread(&CZMQPublisher::Thread, this);
+}
+
+void CZMQPublisher::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+        cond.notify_one();
+    }
+
+    if (thread.joinable())
+        thread.join();
+}
+
+void CZMQPublisher::Drop(const CZMQPublishMessage& msg)
+{
+    LogPrint("zmq", "zmq: Queue full, dropped %s notification %d\n", msg.command, msg.nSequence);
+    nDropped++;
+    msg.notifier->nDropped++;
+}
+
+void CZMQPublisher::Push(CZMQAbstractPublishNotifier* notifier, const char* command, std::vector<unsigned char>& data)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+
+    CZMQPublishMessage msg;
+    msg.notifier = notifier;
+    msg.command = command;
+    msg.nSequence = notifier->nSequence++;
+
+    if (nQueued == vRing.size()) {
+        if (dropPolicy == DROP_NEWEST) {
+            Drop(msg);
+            return;
+        }
+
+        Drop(vRing[nHead]);
+        nHead = (nHead + 1) % vRing.size();
+        nQueued--;
+    }
+
+    CZMQPublishMessage& entry = vRing[(nHead + nQueued) % vRing.size()];
+    entry = msg;
+    entry.data.swap(data);
+    nQueued++;
+
+    cond.notify_one();
+}
+
+size_t CZMQPublisher::GetQueueSize()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nQueued;
+}
+
+void CZMQPublisher::Thread()
+{
+    RenameThread("smartcash-zmqpub");
+
+    while (true) {
+        CZMQPublishMessage msg;
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+
+            while (!nQueued && !fStop) {
+                cond.wait(lock);
+            }
+
+            if (fStop)
+                return;
+
+            CZMQPublishMessage& entry = vRing[nHead];
+            msg.notifier = entry.notifier;
+            msg.command = entry.command;
+            msg.nSequence = entry.nSequence;
+            msg.data.swap(entry.data);
+            nHead = (nHead + 1) % vRing.size();
+            nQueued--;
+        }
+
+        if (msg.notifier->SendMessage(msg.command, msg.data.data(), msg.data.size(), msg.nSequence)) {
+            nSent++;
+            msg.notifier->nSent++;
+        } else {
+            nDropped++;
+            msg.notifier->nDropped++;
+        }
+    }
+}
+
+bool CZMQPublisher::ParseDropPolicy(const std::string& strPolicy, DropPolicy& policy)
+{
+    if (strPolicy == "oldest") {
+        policy = DROP_OLDEST;
+    } else if (strPolicy == "newest") {
+        policy = DROP_NEWEST;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+std::string CZMQPublisher::DropPolicyToString(DropPolicy policy)
+{
+    return policy == DROP_NEWEST ? "newest" : "oldest";
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ZMQ_ZMQPUBLISHER_H
+#define BITCOIN_ZMQ_ZMQPUBLISHER_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+class CZMQAbstractPublishNotifier;
+
+/** Default for -zmqhwm, the maximum number of notifications waiting to be published */
+static const size_t DEFAULT_ZMQ_HWM = 1000;
+/** Default for -zmqdroppolicy */
+static const char* const DEFAULT_ZMQ_DROP_POLICY = "oldest";
+
+/** A notification waiting to be published */
+struct CZMQPublishMessage
+{
+    CZMQAbstractPublishNotifier* notifier;
+    const char* command;
+    std::vector<unsigned char> data;
+    uint32_t nSequence;
+
+    CZMQPublishMessage() : notifier(NULL), command(NULL), nSequence(0) {}
+};
+
+/**
+ * Publishes the notifications on a dedicated thread, so neither slow
+ * subscribers nor big messages hold up the validation callbacks.
+ *
+ * The notifications wait in a ring of nHighWaterMark entries. Once it is
+ * full, either the oldest waiting or the new notification gets dropped.
+ * Every notification gets its sequence number when it is queued, so
+ * subscribers see the dropped ones as gaps.
+ */
+class CZMQPublisher
+{
+public:
+    enum DropPolicy {
+        DROP_OLDEST,
+        DROP_NEWEST,
+    };
+
+private:
+    //! Mutex to protect the inner state
+    boost::mutex mutex;
+    //! The publisher thread waits on this for notifications
+    boost::condition_variable cond;
+
+    //! Ring of the notifications waiting to be published
+    std::vector<CZMQPublishMessage> vRing;
+    //! Index of the oldest waiting notification in vRing
+    size_t nHead;
+    //! Number of waiting notifications
+    size_t nQueued;
+
+    const DropPolicy dropPolicy;
+    bool fStop;
+
+    boost::thread thread;
+
+    std::atomic<uint64_t> nSent;
+    std::atomic<uint64_t> nDropped;
+
+    void Thread();
+    void Drop(const CZMQPublishMessage& msg);
+
+public:
+    CZMQPublisher(size_t nHighWaterMark, DropPolicy dropPolicyIn);
+    ~CZMQPublisher();
+
+    void Start();
+    void Stop();
+
+    /** Queue data for publishing by notifier, never blocks */
+    void Push(CZMQAbstractPublishNotifier* notifier, const char* command, std::vector<unsigned char>& data);
+
+    uint64_t GetSent() const { return nSent; }
+    uint64_t GetDropped() const { return nDropped; }
+    size_t GetQueueSize();
+    size_t GetHighWaterMark() const { return vRing.size(); }
+    DropPolicy GetDropPolicy() const { return dropPolicy; }
+
+    static bool ParseDropPolicy(const std::string& strPolicy, DropPolicy& policy);
+    static std::string DropPolicyToString(DropPolicy policy);
+};
+
+#endif // BITCOIN_ZMQ_ZMQPUBLISHER_H
@@ -5,9 +5,12 @@
 #include "chainparams.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
+#include "zmqpublisher.h"
 #include "validation.h"
 #include "util.h"
 
+#include <algorithm>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK  = "hashblock";
@@ -126,72 +129,112 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
-bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size, uint32_t nMsgSequence)
 {
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
+    WriteLE32(&msgseq[0], nMsgSequence);
     int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
     if (rc == -1)
         return false;
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
-
     return true;
 }
 
+void CZMQAbstractPublishNotifier::Publish(const char *command, std::vector<unsigned char>& data)
+{
+    assert(publisher);
+    publisher->Push(this, command, data);
+}
+
+static std::vector<unsigned char> ReversedHash(const uint256& hash)
+{
+    std::vector<unsigned char> data(hash.begin(), hash.end());
+    std::reverse(data.begin(), data.end());
+    return data;
+}
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHBLOCK, data, 32);
+    std::vector<unsigned char> data = ReversedHash(hash);
+    Publish(MSG_HASHBLOCK, data);
+    return true;
 }
 
 bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish hashtx %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHTX, data, 32);
+    std::vector<unsigned char> data = ReversedHash(hash);
+    Publish(MSG_HASHTX, data);
+    return true;
 }
 
 bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish hashtxlock %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHTXLOCK, data, 32);
+    std::vector<unsigned char> data = ReversedHash(hash);
+    Publish(MSG_HASHTXLOCK, data);
+    return true;
+}
+
+bool CZMQPublishRawBlockNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    // Only the new tip gets published, and nothing during the initial block download.
+    // A block below the best header is most likely followed by the next one in the
+    // same step, so don't serialize it under cs_main just to throw it away. Should
+    // it stay the tip after all NotifyBlock reads it back from disk.
+    AssertLockHeld(cs_main);
+    if (IsInitialBlockDownload() || pindex != pindexBestHeader)
+        return true;
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+
+    LOCK(cs);
+    hashConnected = pindex->GetBlockHash();
+    vchConnected.assign(ss.begin(), ss.end());
+    return true;
 }
 
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<unsigned char> data;
     {
-        LOCK(cs_main);
+        LOCK(cs);
+        if (hashConnected == pindex->GetBlockHash()) {
+            data.swap(vchConnected);
+            hashConnected.SetNull();
+        }
+    }
+
+    if (data.empty()) {
+        // Not connected while we were listening, read it from disk
+        const Consensus::Params& consensusParams = Params().GetConsensus();
         CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
         {
-            zmqError("Can't read block from disk");
-            return false;
+            LOCK(cs_main);
+            if(!ReadBlockFromDisk(block, pindex, consensusParams))
+            {
+                zmqError("Can't read block from disk");
+                return true;
+            }
         }
 
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
         ss << block;
+        data.assign(ss.begin(), ss.end());
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    Publish(MSG_RAWBLOCK, data);
+    return true;
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -200,7 +243,9 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    std::vector<unsigned char> data(ss.begin(), ss.end());
+    Publish(MSG_RAWTX, data);
+    return true;
 }
 
 bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
@@ -209,5 +254,7 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     LogPrint("zmq", "zmq: Publish rawtxlock %s\n", hash.GetHex());
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << transaction;
-    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+    std::vector<unsigned char> data(ss.begin(), ss.end());
+    Publish(MSG_RAWTXLOCK, data);
+    return true;
 }
@@ -6,23 +6,34 @@
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include "zmqabstractnotifier.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <vector>
 
 class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; // upcounting per message sequence number
+    uint32_t nSequence; // upcounting per message sequence number, assigned by the publisher
+
+    friend class CZMQPublisher;
+
+protected:
+    /* queue data for the publisher thread, which sends it with SendMessage */
+    void Publish(const char *command, std::vector<unsigned char>& data);
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0) {}
 
-    /* send zmq multipart message
+    /* send zmq multipart message, only called by the publisher thread
        parts:
           * command
           * data
           * message sequence number
     */
-    bool SendMessage(const char *command, const void* data, size_t size);
+    bool SendMessage(const char *command, const void* data, size_t size, uint32_t nMsgSequence);
 
     bool Initialize(void *pcontext);
     void Shutdown();
@@ -48,7 +59,14 @@ public:
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
+private:
+    CCriticalSection cs;
+    // the last connected block, serialized while it was still in memory
+    uint256 hashConnected;
+    std::vector<unsigned char> vchConnected;
+
 public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex);
     bool NotifyBlock(const CBlockIndex *pindex);
 };
 
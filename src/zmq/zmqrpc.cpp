@@ -0,0 +1,81 @@
+// Copyright (c) 2017 - 2019 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmqrpc.h"
+
+#include "rpc/server.h"
+#include "utilstrencodings.h"
+#include "zmqabstractnotifier.h"
+#include "zmqnotificationinterface.h"
+#include "zmqpublisher.h"
+
+#include <univalue.h>
+
+UniValue getzmqnotifications(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getzmqnotifications\n"
+            "\nReturns information about the active ZeroMQ notifications.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"hwm\": n,                  (numeric) Maximum number of notifications waiting to be published\n"
+            "  \"droppolicy\": \"xxxx\",      (string) Notification dropped once hwm is reached, oldest or newest\n"
+            "  \"queued\": n,               (numeric) Number of notifications waiting to be published\n"
+            "  \"sent\": n,                 (numeric) Total number of published notifications\n"
+            "  \"dropped\": n,              (numeric) Total number of dropped notifications\n"
+            "  \"notifiers\": [\n"
+            "    {\n"
+            "      \"type\": \"pubhashtx\",   (string) Type of notification\n"
+            "      \"address\": \"...\",      (string) Address of the publisher\n"
+            "      \"sent\": n,             (numeric) Number of published notifications\n"
+            "      \"dropped\": n           (numeric) Number of dropped notifications\n"
+            "    },\n"
+            "    ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqnotifications", "")
+            + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    UniValue result(UniValue::VOBJ);
+    UniValue notifiers(UniValue::VARR);
+
+    if (pzmqNotificationInterface) {
+        CZMQPublisher* pub = pzmqNotificationInterface->GetPublisher();
+        if (pub) {
+            result.push_back(Pair("hwm", (uint64_t)pub->GetHighWaterMark()));
+            result.push_back(Pair("droppolicy", CZMQPublisher::DropPolicyToString(pub->GetDropPolicy())));
+            result.push_back(Pair("queued", (uint64_t)pub->GetQueueSize()));
+            result.push_back(Pair("sent", pub->GetSent()));
+            result.push_back(Pair("dropped", pub->GetDropped()));
+        }
+
+        for (const CZMQAbstractNotifier* notifier : pzmqNotificationInterface->GetActiveNotifiers()) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("type", notifier->GetType()));
+            obj.push_back(Pair("address", notifier->GetAddress()));
+            obj.push_back(Pair("sent", notifier->GetSent()));
+            obj.push_back(Pair("dropped", notifier->GetDropped()));
+            notifiers.push_back(obj);
+        }
+    }
+
+    result.push_back(Pair("notifiers", notifiers));
+
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true  },
+};
+
+void RegisterZMQRPCCommands(CRPCTable &tableRPC)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}